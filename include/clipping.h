@@ -6,12 +6,24 @@
 #define PRIMITIVE_VISIBLE 0x1
 #define PRIMITIVE_NO_VISIBLE 0x0
 
+// Guard band, the sides of the viewport scaled by GUARD_BAND_SCALE on clip space
+#define GUARD_BAND_SCALE 2.0f
+
+// Largest polygon that results from clipping a triangle against the six planes
+#define MAX_POLYGON_SIZE 9
+
 int calculate_outcode(struct er_VertexOutput *vertex);
 
-int clip_point(unsigned int input_index);
+void calculate_outcodes(float position[4][ER_VERTEX_BATCH_SIZE], unsigned int *outcodes, unsigned int size);
+
+int clip_point(er_Context *ctx, unsigned int input_index);
+
+int clip_line(er_Context *ctx, unsigned int vertex0_index, unsigned int vertex1_index);
+
+void reset_clip_cache(er_Context *ctx);
 
-int clip_line(unsigned int vertex0_index, unsigned int vertex1_index);
+int cull_triangle(er_Context *ctx, unsigned int vertex0_index, unsigned int vertex1_index, unsigned int vertex2_index);
 
-int clip_triangle(unsigned int vertex0_index, unsigned int vertex1_index, unsigned int vertex2_index);
+int clip_triangle(er_Context *ctx, unsigned int vertex0_index, unsigned int vertex1_index, unsigned int vertex2_index);
 
 #endif
@@ -0,0 +1,175 @@
+#ifndef __CONTEXT__
+#define __CONTEXT__
+
+#include <pthread.h>
+
+/* Indices already placed on the input buffer of the current batch */
+#define BATCH_CACHE_SIZE 128
+
+typedef struct BatchCacheRegister{
+    unsigned int input_index;
+    unsigned int output_index;
+} BatchCacheRegister;
+
+/*
+ * Post-transform vertex cache, set associative, keeps the shaded vertices of the
+ * previous batches of a draw call.
+*/
+#define VERTEX_CACHE_WAYS 4
+#define VERTEX_CACHE_DEFAULT_SIZE 256
+#define VERTEX_CACHE_MAX_SIZE 65536
+
+typedef struct VertexCacheRegister{
+    unsigned int input_index;
+    unsigned int generation;    /* Draw call that wrote the entry */
+    unsigned int tick;          /* Last use with LRU, insertion with FIFO */
+    unsigned int outcode;
+    struct er_VertexOutput vertex;
+} VertexCacheRegister;
+
+/* Vertices generated by clipping on the current batch, by edge and plane */
+#define CLIP_CACHE_SIZE 256
+
+typedef struct ClipCacheRegister{
+    unsigned int vertex0_index;
+    unsigned int vertex1_index;
+    unsigned int plane;
+    unsigned int output_index;
+    unsigned int generation;    /* Batch that wrote the entry */
+} ClipCacheRegister;
+
+/*
+ * Rendering context. Holds all the state of the pipeline, so independent
+ * contexts can be used at the same time from different threads.
+*/
+struct er_Context{
+
+    //Matrix stacks
+    er_MatrixModeEnum matrix_mode;
+    unsigned int mv_stack_counter;
+    mat4 mv_stack[MODELVIEW_MATRIX_STACK_SIZE];
+    mat4 inv_mv_stack[MODELVIEW_MATRIX_STACK_SIZE];
+    mat3 nm_stack[MODELVIEW_MATRIX_STACK_SIZE];
+    er_Bool mv_flag[MODELVIEW_MATRIX_STACK_SIZE];
+    unsigned int proj_stack_counter;
+    mat4 proj_stack[PROJECTION_MATRIX_STACK_SIZE];
+    mat4 inv_proj_stack[PROJECTION_MATRIX_STACK_SIZE];
+    er_Bool proj_flag[PROJECTION_MATRIX_STACK_SIZE];
+    mat4 mv_proj_matrix;
+
+    //Vertex Cache
+    BatchCacheRegister batch_cache[BATCH_CACHE_SIZE];
+    VertexCacheRegister *vertex_cache;
+    unsigned int vertex_cache_size;
+    er_VertexCachePolicyEnum vertex_cache_policy;
+    unsigned int vertex_cache_generation;
+    unsigned int vertex_cache_tick;
+    er_Bool vertex_cache_write;
+    unsigned int cached_vertices[TRIANGLES_BATCH_SIZE * 3];
+    unsigned int cached_vertices_size;
+    unsigned int input_elements[TRIANGLES_BATCH_SIZE * 3];
+
+    //Input and output buffers
+    struct er_VertexInput *input_buffer;
+    unsigned int input_buffer_size;
+    unsigned int *input_indices;
+    unsigned int input_indices_size;
+    struct OutputBufferRegister *output_buffer;
+    unsigned int output_buffer_size;
+    unsigned int *output_indices;
+    unsigned int output_indices_size;
+    unsigned int output_polygon_sizes[TRIANGLES_BATCH_SIZE];
+    unsigned int output_polygons_size;
+    ClipCacheRegister clip_cache[CLIP_CACHE_SIZE];
+    unsigned int clip_cache_generation;
+
+    //Current vertex state
+    vec3 current_normal;
+    vec4 current_tex_coord;
+    vec4 current_color;
+    float current_fog_coord;
+
+    //Begin/End calls
+    unsigned int be_batch_size;
+    void (*be_process_func)(struct er_Context *ctx);
+    er_PrimitiveEnum be_primitive;
+    unsigned int be_vertex_count;
+    unsigned int be_first;          /* Input buffer slots of the vertices shared with the next primitives */
+    unsigned int be_previous[2];
+
+    //Viewport data
+    unsigned int window_origin_x, window_origin_y, window_width, window_height;
+
+    //Front and back face settings
+    er_PolygonOrientationEnum front_face_orientation;
+    er_PolygonModeEnum front_face_mode;
+    er_PolygonModeEnum back_face_mode;
+    er_Bool cull_face_enable;
+    er_PolygonFaceEnum cull_face;
+
+    //Point sprites settings
+    er_PointSpriteEnum point_sprite_coord_origin;
+    er_Bool point_sprite_enable;
+
+    //Current program, vertex array and uniform vars
+    struct er_Program *current_program;
+    struct er_VertexArray *current_vertex_array;
+    er_UniVars global_variables;
+
+    //Framebuffer and depth test
+    struct er_Framebuffer *current_framebuffer;
+    unsigned int *color_buffer;
+    float *depth_buffer;
+    unsigned int buffer_width, buffer_height;
+    unsigned char *hiz_writes;
+    unsigned int hiz_width;
+    er_Bool hiz_enable;
+    er_Bool depth_test_enable;
+    er_DepthFuncEnum depth_func;
+    er_Bool depth_mask;
+    vec4 clear_color;
+    float clear_depth;
+
+    //Triangle rasterizer
+    er_Bool half_space_enable;
+    er_Bool guard_band_enable;
+    er_Bool fixed_point_enable;
+    unsigned int subpixel_bits;
+    er_Bool perspective_correction_enable;  /* Varyings divided by w after clipping, corrected per fragment */
+
+    //Tiled rasterization
+    er_Bool tiling_enable;
+    unsigned int thread_count;
+    struct TiledPrimitive *primitives;
+    unsigned int primitives_size;
+    unsigned int primitives_capacity;
+    er_VertexOutput *polygon_vertices;
+    unsigned int polygon_vertices_size;
+    unsigned int polygon_vertices_capacity;
+    struct Tile *tiles;
+    unsigned int tiles_capacity;
+    unsigned int tiles_number;
+    unsigned int next_tile;
+    pthread_t workers[MAX_THREADS];
+    unsigned int workers_size;
+    unsigned int active_workers;
+    unsigned int job_generation;
+    unsigned int spawn_generation;
+    er_Bool quit_workers;
+    pthread_mutex_t tiling_mutex;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+
+    //Counters
+    er_Statistics statistics;
+
+};
+
+extern _Thread_local struct er_Context *current_context;
+
+/* Counters can be updated from the rasterization threads */
+static inline void add_statistic(unsigned long *counter, unsigned long value){
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -114,7 +114,8 @@ typedef enum {
     ER_LOD_MAX = 0x2A,
     ER_WRAP_S = 0x2B,
     ER_WRAP_T = 0x2C,
-    ER_WRAP_R = 0x2D
+    ER_WRAP_R = 0x2D,
+    ER_TEXTURE_MAX_ANISOTROPY = 0x64
 } er_TextureParamEnum;
 
 /* Point sprites */
@@ -130,7 +131,8 @@ typedef enum {
     ER_NORMAL_ARRAY = 0x32,
     ER_COLOR_ARRAY = 0x33,
     ER_FOG_COORD_ARRAY = 0x34,
-    ER_TEX_COORD_ARRAY = 0x35
+    ER_TEX_COORD_ARRAY = 0x35,
+    ER_INSTANCE_ARRAY = 0x50
 } er_VertexArrayEnum;
 
 /* Texture formats */
@@ -139,17 +141,82 @@ typedef enum {
     ER_RG32F = 0x37,
     ER_RGB32F = 0x38,
     ER_RGBA32F = 0x39,
-    ER_DEPTH32F =0x3A
+    ER_DEPTH32F =0x3A,
+    ER_R8 = 0x57,               /* Unsigned normalized, sampled on [0, 1] */
+    ER_RG8 = 0x58,
+    ER_RGBA8 = 0x59,
+    ER_R16F = 0x5A,             /* Half floats */
+    ER_RG16F = 0x5B,
+    ER_RGBA16F = 0x5C,
+    ER_BC1 = 0x60,              /* Compressed 4x4 blocks: RGB with 1 bit alpha, 8 bytes */
+    ER_BC3 = 0x61,              /* RGBA, 16 bytes */
+    ER_BC4 = 0x62,              /* R, 8 bytes */
+    ER_BC5 = 0x63               /* RG, 16 bytes */
 } er_TextureFormatEnum;
 
+/* Texel storage order of 2D textures and cubemap faces */
+typedef enum {
+    ER_ROW_MAJOR = 0x5D,
+    ER_TILED_4X4 = 0x5E,        /* Row major 4x4 tiles of row major texels, kept by compressed formats */
+    ER_MORTON_ORDER = 0x5F      /* Z order curve, on squares of the smallest dimension */
+} er_TextureLayoutEnum;
+
 /* Settings */
 typedef enum {
     ER_CULL_FACE = 0x3B,
-    ER_POINT_SPRITES = 0x3C
+    ER_POINT_SPRITES = 0x3C,
+    ER_TILED_RASTERIZATION = 0x3D,
+    ER_HALF_SPACE_RASTERIZATION = 0x3E,
+    ER_DEPTH_TEST = 0x3F,
+    ER_HIERARCHICAL_DEPTH_TEST = 0x4D,
+    ER_GUARD_BAND_CLIPPING = 0x51,
+    ER_FIXED_POINT_RASTERIZATION = 0x52,
+    ER_PERSPECTIVE_CORRECTION = 0x53
 } er_EnableSettingEnum;
 
+/* Interpolation qualifiers of varying attributes */
+typedef enum {
+    ER_SMOOTH = 0x54,
+    ER_NOPERSPECTIVE = 0x55,
+    ER_FLAT = 0x56
+} er_InterpolationEnum;
+
+/* Depth test functions */
+typedef enum {
+    ER_NEVER = 0x40,
+    ER_LESS = 0x41,
+    ER_EQUAL = 0x42,
+    ER_LEQUAL = 0x43,
+    ER_GREATER = 0x44,
+    ER_NOTEQUAL = 0x45,
+    ER_GEQUAL = 0x46,
+    ER_ALWAYS = 0x47
+} er_DepthFuncEnum;
+
+/* Framebuffer attachments */
+typedef enum {
+    ER_COLOR_ATTACHMENT = 0x48,
+    ER_DEPTH_ATTACHMENT = 0x49
+} er_AttachmentEnum;
+
+/* Buffers to clear */
+typedef enum {
+    ER_COLOR_BUFFER = 0x4A,
+    ER_DEPTH_BUFFER = 0x4B,
+    ER_COLOR_AND_DEPTH_BUFFER = 0x4C
+} er_ClearBufferEnum;
+
+/* Replacement policies of the post-transform vertex cache */
+typedef enum {
+    ER_CACHE_FIFO = 0x4E,
+    ER_CACHE_LRU = 0x4F
+} er_VertexCachePolicyEnum;
+
 #define ATTRIBUTES_SIZE 16
 
+/* Alignment of the arrays processed with SIMD instructions */
+#define ER_ALIGNED __attribute__((aligned(16)))
+
 typedef struct er_VertexInput {
     vec4 position;
     vec3 normal;
@@ -164,6 +231,28 @@ typedef struct er_VertexOutput{
     float point_size;
 } er_VertexOutput;
 
+/* Vertices on each call of a batch vertex shader */
+#define ER_VERTEX_BATCH_SIZE 16
+
+/*
+ * Inputs and outputs of a batch vertex shader, with every component on its own array.
+ * Only the first size vertices are valid, the shader may process the rest of the lanes.
+*/
+typedef struct er_VertexBatchInput{
+    float position[4][ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    float normal[3][ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    float color[4][ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    float fog_coord[ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    float tex_coord[4][ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    unsigned int size;
+} er_VertexBatchInput;
+
+typedef struct er_VertexBatchOutput{
+    float position[4][ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    float attributes[ATTRIBUTES_SIZE][ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+    float point_size[ER_VERTEX_BATCH_SIZE] ER_ALIGNED;
+} er_VertexBatchOutput;
+
 typedef struct er_FragInput{
     vec4 frag_coord;
     float attributes[ATTRIBUTES_SIZE];
@@ -174,14 +263,58 @@ typedef struct er_FragInput{
     vec2 point_coord; 
     float point_size;
     er_Bool front_facing;
+    vec4 frag_color;    /* Output color, written to the bound framebuffer */
+    er_Bool discard;    /* Set by the fragment shader to discard the fragment */
 } er_FragInput;
 
+/* Fragments on each call of a span fragment shader */
+#define ER_SPAN_SIZE 16
+
+/*
+ * Packet of up to ER_SPAN_SIZE fragments of the same primitive, with every parameter on its own array.
+ * Bit i of mask is set when fragment i is covered and passed the depth test. The shader clears the
+ * bits of discarded fragments, and writes color when a framebuffer is bound.
+*/
+typedef struct er_FragSpan{
+    int x[ER_SPAN_SIZE] ER_ALIGNED;
+    int y[ER_SPAN_SIZE] ER_ALIGNED;
+    float z[ER_SPAN_SIZE] ER_ALIGNED;
+    float w[ER_SPAN_SIZE] ER_ALIGNED;
+    float attributes[ATTRIBUTES_SIZE][ER_SPAN_SIZE] ER_ALIGNED;
+    float color[4][ER_SPAN_SIZE] ER_ALIGNED;
+    unsigned int mask;
+    unsigned int size;
+    float ddx[ATTRIBUTES_SIZE];
+    float ddy[ATTRIBUTES_SIZE];
+    float dz_dx, dz_dy;
+    float dw_dx, dw_dy;
+    vec2 point_coord;
+    float point_size;
+    er_Bool front_facing;
+} er_FragSpan;
+
 typedef struct er_Texture er_Texture;
 
 typedef struct er_VertexArray er_VertexArray;
 
 typedef struct er_Program er_Program;
 
+typedef struct er_Context er_Context;
+
+typedef struct er_Framebuffer er_Framebuffer;
+
+/* Pipeline counters */
+typedef struct er_Statistics {
+    unsigned long hiz_rejected_triangles;   /* Counted once for each tile band when tiled */
+    unsigned long hiz_rejected_blocks;
+    unsigned long vertex_cache_hits;        /* Indexed vertices that weren't shaded again */
+    unsigned long vertex_cache_misses;
+    unsigned long guard_band_triangles;     /* Partially visible triangles that skipped clipping */
+    unsigned long culled_back_faces;        /* Triangles culled before clipping */
+    unsigned long culled_degenerate_triangles;
+    unsigned long culled_empty_triangles;   /* Bounding box without pixel centers */
+} er_Statistics;
+
 typedef struct er_UniVars {
     float (*modelview)[4];
     float (*modelview_projection)[4];
@@ -195,6 +328,8 @@ typedef struct er_UniVars {
     float *uniform_float;
     void **uniform_ptr;
     struct er_Texture **uniform_texture;
+    unsigned int instance_id;           /* Instance drawn, valid on the vertex shader */
+    float *instance_attributes;         /* Row of the instance array, NULL when it's disabled */
 } er_UniVars;
 
 /* Viewport settings */
@@ -261,6 +396,8 @@ er_StatusEnum er_fog_coord_pointer(er_VertexArray *va, unsigned int stride, floa
 
 er_StatusEnum er_tex_coord_pointer(er_VertexArray *va, unsigned int stride, unsigned int components, float *pointer);
 
+er_StatusEnum er_instance_pointer(er_VertexArray *va, unsigned int stride, float *pointer);
+
 /* Drawing routines: Begin/End style */
 
 er_StatusEnum er_begin(er_PrimitiveEnum primitive);
@@ -317,12 +454,52 @@ er_StatusEnum er_draw_elements(er_PrimitiveEnum primitive, unsigned int size, un
 
 er_StatusEnum er_draw_arrays(er_PrimitiveEnum primitive, unsigned int first, unsigned int count);
 
+er_StatusEnum er_draw_elements_instanced(er_PrimitiveEnum primitive, unsigned int size, unsigned int *index, unsigned int instance_count);
+
+er_StatusEnum er_draw_arrays_instanced(er_PrimitiveEnum primitive, unsigned int first, unsigned int count, unsigned int instance_count);
+
 /* Init routines */
 
 er_StatusEnum er_init();
 
 void er_quit();
 
+/* Rendering contexts */
+
+er_StatusEnum er_create_context(er_Context **ctx);
+
+er_StatusEnum er_delete_context(er_Context *ctx);
+
+er_StatusEnum er_make_current(er_Context *ctx);
+
+er_Context* er_get_current_context();
+
+/* Framebuffer and depth test */
+
+er_Framebuffer* er_create_framebuffer(unsigned int width, unsigned int height);
+
+er_StatusEnum er_delete_framebuffer(er_Framebuffer *fb);
+
+er_StatusEnum er_bind_framebuffer(er_Framebuffer *fb);
+
+er_StatusEnum er_framebuffer_ptr(er_Framebuffer *fb, er_AttachmentEnum attachment, void **data);
+
+void er_clear_color(float r, float g, float b, float a);
+
+void er_clear_depth(float depth);
+
+er_StatusEnum er_clear(er_ClearBufferEnum buffer);
+
+er_StatusEnum er_depth_func(er_DepthFuncEnum func);
+
+void er_depth_mask(er_Bool enable);
+
+/* Pipeline counters */
+
+er_StatusEnum er_get_statistics(er_Statistics *stats);
+
+void er_reset_statistics();
+
 /* Status Strings */
 
 const char* er_status_string(er_StatusEnum status);
@@ -339,6 +516,12 @@ er_StatusEnum er_polygon_mode(er_PolygonFaceEnum face, er_PolygonModeEnum mode);
 
 er_StatusEnum er_point_parameteri(er_PointSpriteEnum param, er_PointSpriteEnum value);
 
+er_StatusEnum er_thread_count(unsigned int count);
+
+er_StatusEnum er_vertex_cache(unsigned int size, er_VertexCachePolicyEnum policy);
+
+er_StatusEnum er_subpixel_bits(unsigned int bits);
+
 /* Texture mapping setup */
 
 er_StatusEnum er_create_texture1D(er_Texture** tex, int width, er_TextureFormatEnum internal_format);
@@ -351,10 +534,16 @@ er_StatusEnum er_delete_texture(er_Texture *tex);
 
 er_StatusEnum er_texture_ptr(er_Texture *tex, er_TextureTargetEnum texture_target, int level, float **data);
 
+er_StatusEnum er_texture_image(er_Texture *tex, er_TextureTargetEnum texture_target, int level, float *data);
+
 er_StatusEnum er_texture_filtering(er_Texture *tex, er_TextureParamEnum parameter, er_TextureFilterEnum value);
 
 er_StatusEnum er_texture_wrap_mode(er_Texture *tex, er_TextureParamEnum, er_TextureWrapModeEnum value);
 
+er_StatusEnum er_texture_parameterf(er_Texture *tex, er_TextureParamEnum parameter, float value);
+
+er_StatusEnum er_texture_layout(er_Texture *tex, er_TextureLayoutEnum layout);
+
 er_StatusEnum er_generate_mipmaps(er_Texture *tex);
 
 /* Texture functions */
@@ -369,6 +558,14 @@ void er_texture_grad(er_Texture *tex, float *coord, float *ddx, float *ddy, floa
 
 void er_write_texture(er_Texture *tex, int *coord, int lod, float *color);
 
+/*
+ * Sampling of up to ER_SPAN_SIZE lanes, with every component of the coordinates, derivatives and colors on its
+ * own array like the attributes of er_FragSpan. The texture is dispatched once for all the lanes.
+*/
+void er_texture_lod_span(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]);
+
+void er_texture_grad_span(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float ddx[][ER_SPAN_SIZE], float ddy[][ER_SPAN_SIZE], float color[][ER_SPAN_SIZE]);
+
 /* Program settings */
 
 er_Program* er_create_program();
@@ -387,10 +584,16 @@ er_StatusEnum er_uniform_texture_ptr(er_Program *p, unsigned int index, er_Textu
 
 er_StatusEnum er_varying_attributes(er_Program *p, int number);
 
+er_StatusEnum er_varying_interpolation(er_Program *p, unsigned int index, er_InterpolationEnum interpolation);
+
 er_StatusEnum er_load_fragment_shader(er_Program *p, void (*fragment_shader)(int, int, er_FragInput*, er_UniVars*));
 
+er_StatusEnum er_load_fragment_span_shader(er_Program *p, void (*fragment_span_shader)(er_FragSpan*, er_UniVars*));
+
 er_StatusEnum er_load_vertex_shader(er_Program *p, void (*vertex_shader)(er_VertexInput*, er_VertexOutput*, er_UniVars*) );
 
+er_StatusEnum er_load_vertex_batch_shader(er_Program *p, void (*vertex_batch_shader)(er_VertexBatchInput*, er_VertexBatchOutput*, er_UniVars*) );
+
 er_StatusEnum er_load_homogeneous_division(er_Program *p, void (*homogeneous_division)(er_VertexOutput*) );
 
 #endif
@@ -0,0 +1,147 @@
+#ifndef __FRAMEBUFFER__
+#define __FRAMEBUFFER__
+
+/*
+ * Framebuffer owned by the library. The color attachment is stored as packed 32 bits ARGB
+ * with the first row on the top of the window, so it can be copied directly to the screen.
+ * The depth attachment is stored with the first row on the bottom, like window coordinates.
+*/
+struct er_Framebuffer{
+    unsigned int width, height;
+    unsigned int *color;
+    float *depth;
+    /*
+     * Hierarchical Z: minimum and maximum depth of each tile. After depth writes the range is stale
+     * but still conservative on the direction of the depth function, so it's only recomputed when
+     * it can't reject a fragment and enough writes have been done on the tile.
+    */
+    unsigned int hiz_width, hiz_height;
+    float *hiz_min;
+    float *hiz_max;
+    unsigned char *hiz_writes;
+    int hiz_direction;
+};
+
+/* Size of the Hi-Z tiles, same size than the blocks of the half-space rasterizer */
+#define HIZ_TILE_BITS 3
+#define HIZ_TILE_SIZE (1 << HIZ_TILE_BITS)
+/* Tile range that must be recomputed before being used */
+#define HIZ_INVALID 255
+/* Depth writes after which a stale tile range is recomputed, one per pixel of the tile */
+#define HIZ_UPDATE_WRITES 64
+
+er_StatusEnum update_framebuffer_state(er_Context *ctx);
+
+er_Bool hiz_reject_tile(er_Context *ctx, int tile_x, int tile_y, float min_z, float max_z);
+
+er_Bool hiz_reject_area(er_Context *ctx, int start_x, int end_x, int start_y, int end_y, float min_z, float max_z);
+
+/* Hi-Z tests are done when the depth test runs on a library framebuffer */
+static inline er_Bool hiz_active(er_Context *ctx){
+    return (ctx->hiz_enable == ER_TRUE && ctx->depth_test_enable == ER_TRUE && ctx->depth_buffer != NULL) ? ER_TRUE: ER_FALSE;
+}
+
+/*
+ * Hi-Z test of the tile at (block_x, block_y), on pixels. Depth of the primitive on the tile is bounded by its plane
+ * extrapolated from the corner of the tile, and by the depth range [min_z, max_z] of its vertices.
+*/
+static inline er_Bool hiz_reject_block(er_Context *ctx, const er_VertexOutput *reference, const er_FragInput *input, float min_z, float max_z, int block_x, int block_y){
+
+    float dz_dx = input->dz_dx * (HIZ_TILE_SIZE - 1);
+    float dz_dy = input->dz_dy * (HIZ_TILE_SIZE - 1);
+    float block_z = reference->position[VAR_Z] + input->dz_dx * (block_x - reference->position[VAR_X]) + input->dz_dy * (block_y - reference->position[VAR_Y]);
+    float block_min_z = block_z + min(dz_dx, 0.0f) + min(dz_dy, 0.0f);
+    float block_max_z = block_z + max(dz_dx, 0.0f) + max(dz_dy, 0.0f);
+    return hiz_reject_tile(ctx, block_x >> HIZ_TILE_BITS, block_y >> HIZ_TILE_BITS, max(block_min_z, min_z), min(block_max_z, max_z));
+
+}
+
+/*
+ * Early depth test, run by the rasterizer before the fragment shader is called.
+*/
+static inline er_Bool depth_test(er_Context *ctx, int y, int x, float z){
+
+    if(ctx->depth_test_enable == ER_FALSE || ctx->depth_buffer == NULL){
+        return ER_TRUE;
+    }
+    float depth = ctx->depth_buffer[y * ctx->buffer_width + x];
+    switch(ctx->depth_func){
+        case ER_LESS:
+            return z < depth ? ER_TRUE: ER_FALSE;
+        case ER_LEQUAL:
+            return z <= depth ? ER_TRUE: ER_FALSE;
+        case ER_GREATER:
+            return z > depth ? ER_TRUE: ER_FALSE;
+        case ER_GEQUAL:
+            return z >= depth ? ER_TRUE: ER_FALSE;
+        case ER_EQUAL:
+            return z == depth ? ER_TRUE: ER_FALSE;
+        case ER_NOTEQUAL:
+            return z != depth ? ER_TRUE: ER_FALSE;
+        case ER_ALWAYS:
+            return ER_TRUE;
+        default:
+            return ER_FALSE;
+    }
+
+}
+
+/*
+ * Write the color and depth of a fragment on the bound framebuffer.
+*/
+static inline void write_fragment(er_Context *ctx, int y, int x, float red, float green, float blue, float alpha, float z){
+
+    if(ctx->color_buffer != NULL){
+        unsigned int r = uiround(255.0f * clamp(red, 0.0f, 1.0f));
+        unsigned int g = uiround(255.0f * clamp(green, 0.0f, 1.0f));
+        unsigned int b = uiround(255.0f * clamp(blue, 0.0f, 1.0f));
+        unsigned int a = uiround(255.0f * clamp(alpha, 0.0f, 1.0f));
+        ctx->color_buffer[(ctx->buffer_height - 1 - y) * ctx->buffer_width + x] = a << 24 | r << 16 | g << 8 | b;
+    }
+    if(ctx->depth_test_enable == ER_TRUE && ctx->depth_mask == ER_TRUE && ctx->depth_buffer != NULL){
+        ctx->depth_buffer[y * ctx->buffer_width + x] = z;
+        unsigned char *writes = &ctx->hiz_writes[(y >> HIZ_TILE_BITS) * ctx->hiz_width + (x >> HIZ_TILE_BITS)];
+        if(*writes < HIZ_INVALID - 1){
+            (*writes)++;
+        }
+    }
+
+}
+
+/*
+ * Call the fragment shader and, when a framebuffer is bound, write its color and depth.
+*/
+static inline void run_fragment_shader(er_Context *ctx, int y, int x, er_FragInput *input){
+
+    if(ctx->current_framebuffer == NULL){
+        ctx->current_program->fragment_shader(y, x, input, &ctx->global_variables);
+        return;
+    }
+    input->discard = ER_FALSE;
+    ctx->current_program->fragment_shader(y, x, input, &ctx->global_variables);
+    if(input->discard == ER_TRUE){
+        return;
+    }
+    write_fragment(ctx, y, x, input->frag_color[VAR_R], input->frag_color[VAR_G], input->frag_color[VAR_B], input->frag_color[VAR_A], input->frag_coord[VAR_Z]);
+
+}
+
+/*
+ * Shade a fragment with the fragment shader, perspective correct when enabled.
+ * Programs with only a span shader get a span of one fragment.
+*/
+static inline void shade_fragment(er_Context *ctx, int y, int x, er_FragInput *input){
+
+    if(ctx->current_program->fragment_shader == NULL){
+        shade_fragment_span(ctx, y, x, input);
+        return;
+    }
+    if(ctx->perspective_correction_enable == ER_TRUE){
+        shade_fragment_perspective(ctx, y, x, input);
+        return;
+    }
+    run_fragment_shader(ctx, y, x, input);
+
+}
+
+#endif
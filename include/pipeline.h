@@ -20,36 +20,26 @@ typedef struct OutputBufferRegister{
 #include "clipping.h"
 #include "texture_mapping.h"
 #include "rasterization.h"
+#include "tiling.h"
 #include "program.h"
+#include "context.h"
+#include "framebuffer.h"
 
-extern unsigned int window_origin_x;
-extern unsigned int window_origin_y;
-extern unsigned int window_width;
-extern unsigned int window_height;
 
-extern er_PrimitiveEnum current_primitive;
-extern struct er_VertexInput *input_buffer;
-extern unsigned int input_buffer_size;
-extern unsigned int *input_indices;
-extern unsigned int input_indices_size;
-extern struct OutputBufferRegister *output_buffer;
-extern unsigned int output_buffer_size;
-extern unsigned int *output_indices;
-extern unsigned int output_indices_size;
-extern struct er_UniVars global_variables;
-extern vec3 current_normal;
-extern vec4 current_tex_coord;
-extern vec4 current_color;
-extern float current_fog_coord;
 
-void process_points();
+void process_points(er_Context *ctx);
 
-void process_lines();
+void process_lines(er_Context *ctx);
 
-void process_triangles();
+void process_triangles(er_Context *ctx);
 
-void reset_buffers_size();
+void reset_buffers_size(er_Context *ctx);
 
-void update_uniform_vars();
+void update_uniform_vars(er_Context *ctx);
+
+/* Vertices are divided by w after clipping, by the program or by the library */
+static inline er_Bool homogeneous_division_enabled(er_Context *ctx){
+    return (ctx->perspective_correction_enable == ER_TRUE || ctx->current_program->homogeneous_division != NULL) ? ER_TRUE: ER_FALSE;
+}
 
 #endif
@@ -3,15 +3,20 @@
 
 struct er_Program {
     void (*fragment_shader)(int y, int x, struct er_FragInput *input, struct er_UniVars *vars);
+    void (*fragment_span_shader)(struct er_FragSpan *span, struct er_UniVars *vars);
     void (*vertex_shader)(struct er_VertexInput *input, struct er_VertexOutput *output, struct er_UniVars *vars);
+    void (*vertex_batch_shader)(struct er_VertexBatchInput *input, struct er_VertexBatchOutput *output, struct er_UniVars *vars);
     void (*homogeneous_division)(struct er_VertexOutput *vertex);
     int varying_attributes;
+    er_InterpolationEnum interpolation[ATTRIBUTES_SIZE];
+    int interpolated_attributes;    /* Varyings up to the last one that isn't flat, the rest are set once per primitive */
+    int flat_attributes;
+    int interpolated_flat_attributes;   /* Flat varyings before the last interpolated one, every vertex must hold their values */
+    const struct RasterizerVariant *rasterizer;     /* Specialized for interpolated_attributes */
     int uniform_integer[32];
     float uniform_float[32];
     void* uniform_ptr[32];
     struct er_Texture* uniform_texture[32];
 };
 
-extern struct er_Program* current_program;
-
 #endif
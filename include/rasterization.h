@@ -1,13 +1,91 @@
 #ifndef __RASTERIZATION__
 #define __RASTERIZATION__
 
-void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face);
+#include <stdint.h>
 
-void draw_point(er_VertexOutput *vertex, er_PolygonFaceEnum face);
+/* Subpixel precision of the fixed point and half-space rasterizers, edges are set up on 64 bits */
+#define DEFAULT_SUBPIXEL_BITS 8
+#define MAX_SUBPIXEL_BITS 16
 
-void draw_triangle(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, er_PolygonFaceEnum face);
+/*
+ * Rasterizer loops are written once with the number of varying attributes as a parameter, and
+ * instantiated for a few constant counts (see RASTERIZER_VARIANT and HALF_SPACE_VARIANT).
+*/
+#if defined(__GNUC__)
+#define RASTER_INLINE static inline __attribute__((always_inline))
+#else
+#define RASTER_INLINE static inline
+#endif
 
-void draw_line(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face);
+/* Coordinate on the grid of 2^bits subpixels */
+static inline int64_t snap(float value, unsigned int bits){
+    return (int64_t)floor(value * (float)(1 << bits) + 0.5f);
+}
 
-#endif
+/*
+ * Depth, 1/w and interpolated attributes on a scanline, at the column of the reference vertex the gradients
+ * were set up from. Fragments get row + ddx * (x - x0), with row = v0 + ddy * (y - y0) on absolute pixel
+ * coordinates, so their values don't depend on the region being drawn or on where a scanline starts.
+*/
+typedef struct PlaneRow{
+    float x0;
+    float z, w;
+    float attributes[ATTRIBUTES_SIZE];
+} PlaneRow;
+
+RASTER_INLINE void init_plane_row(PlaneRow *row, const er_VertexOutput *reference, const er_FragInput *input, int y, int varyings){
+
+    int k;
+    float offset_y = y - reference->position[VAR_Y];
+    row->x0 = reference->position[VAR_X];
+    row->z = reference->position[VAR_Z] + input->dz_dy * offset_y;
+    row->w = reference->position[VAR_W] + input->dw_dy * offset_y;
+    for(k = 0; k < varyings; k++){
+        row->attributes[k] = reference->attributes[k] + input->ddy[k] * offset_y;
+    }
+
+}
+
+/*
+ * Rasterizer specialized for a number of interpolated attributes, chosen for each program by er_varying_attributes
+ * and er_varying_interpolation.
+*/
+typedef struct RasterizerVariant{
+    int varying_attributes;
+    void (*draw_point_sprite)(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y);
+    void (*draw_point)(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y);
+    void (*draw_line)(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y);
+    void (*setup_polygon)(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face, er_FragInput *setup);
+    void (*draw_triangle)(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y);
+    void (*draw_polygon)(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y);
+} RasterizerVariant;
+
+const RasterizerVariant* select_rasterizer(int varying_attributes);
+
+void draw_point_sprite(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y);
+
+void draw_point(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y);
+
+void setup_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face, er_FragInput *setup);
+
+void draw_triangle(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y);
 
+void draw_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y);
+
+er_Bool half_space_fits(er_Context *ctx);
+
+void draw_polygon_half_space(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y, int varyings);
+
+void shade_span(er_Context *ctx, er_FragSpan *span, int varyings);
+
+void shade_fragment_span(er_Context *ctx, int y, int x, er_FragInput *input);
+
+void shade_fragment_perspective(er_Context *ctx, int y, int x, er_FragInput *input);
+
+void init_span(er_Context *ctx, er_FragSpan *span, er_FragInput *input);
+
+void set_flat_attributes(er_Context *ctx, er_FragInput *input, er_VertexOutput *vertex);
+
+void draw_line(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y);
+
+#endif
@@ -1,8 +1,11 @@
 #ifndef __TEXTURE_MAPPING__
 #define __TEXTURE_MAPPING__
 
+/* Largest number of probes of anisotropic filtering */
+#define MAX_ANISOTROPY 16
+
 typedef struct Mipmap{
-    float *texels;
+    void *texels;               /* Stored on the internal format of the texture */
     int width;
     int height;
     int depth;
@@ -12,22 +15,26 @@ struct er_Texture{
     er_TextureTargetEnum texture_target;
     er_TextureFormatEnum texture_format;
     int components;
-    int (*wrap_s)(int, int);
-    int (*wrap_t)(int, int);
-    int (*wrap_r)(int, int);
+    int texel_size;             /* Bytes per texel, 0 on compressed formats */
+    int block_size;             /* Bytes per 4x4 block of compressed formats, 0 otherwise */
+    er_TextureLayoutEnum layout;
+    er_TextureWrapModeEnum wrap_s;
+    er_TextureWrapModeEnum wrap_t;
+    er_TextureWrapModeEnum wrap_r;
     void (*texture_size)(er_Texture *tex, int lod, int *dimension);
     void (*texel_fetch)(er_Texture *tex, int *coord, int lod, float *color);
     void (*texture_lod)(er_Texture *tex, float *coord, float lod, float *color);
     void (*texture_grad)(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color);
     void (*write_texture)(er_Texture *tex, int *coord, int lod, float *color);
+    void (*texture_lod_span)(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]);
+    void (*texture_grad_span)(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float ddx[][ER_SPAN_SIZE], float ddy[][ER_SPAN_SIZE], float color[][ER_SPAN_SIZE]);
     er_TextureFilterEnum magnification_filter;
     er_TextureFilterEnum minification_filter;
+    float max_anisotropy;
     Mipmap **mipmaps;
     int mipmap_stack_size;
     int lod_max_level;
 };
 
-extern er_PointSpriteEnum point_sprite_coord_origin;
-extern er_Bool point_sprite_enable;
 
 #endif
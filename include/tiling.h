@@ -0,0 +1,38 @@
+#ifndef __TILING__
+#define __TILING__
+
+/* Width and height in pixels of the screen tiles used by the binning backend */
+#define TILE_SIZE 64
+#define MAX_THREADS 64
+
+typedef struct TiledPrimitive{
+    er_PrimitiveEnum primitive;
+    er_PolygonFaceEnum face;
+    er_Bool point_sprite;
+    er_VertexOutput vertex[3];
+    er_FragInput setup;             /* Gradients of triangles and polygons, shared by all their tiles */
+    unsigned int polygon_first;     /* Vertices of polygons, stored apart */
+    unsigned int polygon_size;
+} TiledPrimitive;
+
+typedef struct Tile{
+    unsigned int *primitives;
+    unsigned int size;
+    unsigned int capacity;
+} Tile;
+
+void init_tiling(er_Context *ctx);
+
+void quit_tiling(er_Context *ctx);
+
+void submit_point(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face);
+
+void submit_line(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face);
+
+void submit_triangle(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, er_PolygonFaceEnum face);
+
+void submit_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face);
+
+void flush_tiles(er_Context *ctx);
+
+#endif
@@ -14,10 +14,9 @@ struct er_VertexArray{
   struct attribute_array color;
   struct attribute_array tex_coord;
   struct attribute_array fog_coord;
+  struct attribute_array instance;
 };
 
-extern struct er_VertexArray *current_vertex_array;
-
-void vertex_assembly(struct er_VertexArray* vertex_array, struct er_VertexInput *vertex, unsigned int vertex_index);
+void vertex_assembly(struct er_Context *ctx, struct er_VertexArray* vertex_array, struct er_VertexInput *vertex, unsigned int vertex_index);
 
 #endif
@@ -0,0 +1,745 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "eduraster.h"
+
+/*
+* Headless benchmark of the triangle rasterizers. Renders scenes similar to the samples
+* with the scanline and the half-space rasterizers, with the depth test done in the fragment shader
+* or by the library before shading, with per vertex and per pixel shaders or with batch vertex shaders and span fragment shaders, and reports triangles and shaded pixels per second.
+* With "compare" after the number of frames, that frame of each scene is rendered with and without the tiled
+* backend, with the half-space and the fixed point rasterizers instead, and with and without Hi-Z, and the pixels
+* whose color or depth differ are counted.
+*/
+
+/* window dimensions */
+static int window_width = 800, window_height = 600;
+/* color and depth buffers */
+static unsigned int *color_buffer = NULL;
+static float *depth_buffer = NULL;
+/* Library framebuffer, used for the early depth test */
+static er_Framebuffer *framebuffer = NULL;
+static int early_depth = 0;
+/* Copy of the framebuffer rendered on the reference configuration, for the compare mode */
+static unsigned int *reference_color = NULL;
+static float *reference_depth = NULL;
+/* Vertex shaders called with batches of vertices, fragment shaders with spans of fragments */
+static int batch_shaders = 0;
+/* EduRaster programs */
+static er_Program *prog_color = NULL;
+static er_Program *prog_surface = NULL;
+static er_Program *prog_color_batch = NULL;
+static er_Program *prog_surface_batch = NULL;
+static er_Program *prog_instance = NULL;
+static er_Program *prog_instance_batch = NULL;
+static er_VertexArray *va_surface = NULL;
+static er_VertexArray *va_cubes = NULL;
+/* Grid of cubes, drawn with a call per cube or instanced */
+#define CUBES_SIZE 20
+static float cube_vertices[24 * 8];
+static unsigned int cube_indices[36];
+static float cube_offsets[CUBES_SIZE * CUBES_SIZE * 3];
+/* Surface plot mesh */
+#define SURFACE_SIZE 96
+static float *surface_vertices = NULL;
+static unsigned int *surface_indices = NULL;
+static unsigned int surface_indices_size;
+/* Statistics of the current run */
+static unsigned long triangles_count, pixels_count;
+
+/*
+* Free resources and exit program
+*/
+static void quit(){
+    if(color_buffer != NULL){
+        free(color_buffer);
+        color_buffer = NULL;
+    }
+    if(depth_buffer != NULL){
+        free(depth_buffer);
+        depth_buffer = NULL;
+    }
+    if(reference_color != NULL){
+        free(reference_color);
+        reference_color = NULL;
+    }
+    if(reference_depth != NULL){
+        free(reference_depth);
+        reference_depth = NULL;
+    }
+    if(surface_vertices != NULL){
+        free(surface_vertices);
+        surface_vertices = NULL;
+    }
+    if(surface_indices != NULL){
+        free(surface_indices);
+        surface_indices = NULL;
+    }
+    if(prog_color != NULL){
+        er_delete_program(prog_color);
+        prog_color = NULL;
+    }
+    if(prog_surface != NULL){
+        er_delete_program(prog_surface);
+        prog_surface = NULL;
+    }
+    if(prog_color_batch != NULL){
+        er_delete_program(prog_color_batch);
+        prog_color_batch = NULL;
+    }
+    if(prog_surface_batch != NULL){
+        er_delete_program(prog_surface_batch);
+        prog_surface_batch = NULL;
+    }
+    if(prog_instance != NULL){
+        er_delete_program(prog_instance);
+        prog_instance = NULL;
+    }
+    if(prog_instance_batch != NULL){
+        er_delete_program(prog_instance_batch);
+        prog_instance_batch = NULL;
+    }
+    if(va_surface != NULL){
+        er_delete_vertex_array(va_surface);
+        va_surface = NULL;
+    }
+    if(va_cubes != NULL){
+        er_delete_vertex_array(va_cubes);
+        va_cubes = NULL;
+    }
+    if(framebuffer != NULL){
+        er_delete_framebuffer(framebuffer);
+        framebuffer = NULL;
+    }
+    er_quit();
+    exit(0);
+}
+
+/*
+* Clear color and depth buffers
+*/
+static void clear_buffer(){
+    int i;
+    int length = window_width * window_height;
+    for(i = 0; i < length; i++){
+        color_buffer[i] = 0xff000000;
+        depth_buffer[i] = 1.0f;
+    }
+}
+
+static void write_color(int y, int x, float red, float green, float blue){
+    int inv_y = window_height - 1 - y;
+    unsigned char r, g, b;
+    r = uiround(255.0f * clamp(red, 0.0f, 1.0f));
+    g = uiround(255.0f * clamp(green, 0.0f, 1.0f));
+    b = uiround(255.0f * clamp(blue, 0.0f, 1.0f));
+    color_buffer[inv_y * window_width + x] = 255 << 24 | r << 16 | g << 8 | b;
+}
+
+static float read_depth(int y, int x){
+    return depth_buffer[y*window_width + x];
+}
+
+static void write_depth(int y, int x, float depth){
+    depth_buffer[y*window_width + x] = depth;
+}
+
+/*
+* Output of the fragment shaders, written by the library when the early depth test is used
+*/
+static void output_color(int y, int x, er_FragInput* input, float red, float green, float blue){
+    if(early_depth){
+        input->frag_color[VAR_R] = red;
+        input->frag_color[VAR_G] = green;
+        input->frag_color[VAR_B] = blue;
+        input->frag_color[VAR_A] = 1.0f;
+        return;
+    }
+    write_color(y, x, red, green, blue);
+    write_depth(y, x, input->frag_coord[VAR_Z]);
+}
+
+/*
+* Shaders for flat colored geometry.
+*/
+static void vs_color(er_VertexInput* input, er_VertexOutput* output, er_UniVars* vars){
+    multd_mat4_vec4(vars->modelview_projection, input->position, output->position);
+    output->attributes[0] = input->color[VAR_R];
+    output->attributes[1] = input->color[VAR_G];
+    output->attributes[2] = input->color[VAR_B];
+    output->attributes[3] = input->tex_coord[VAR_S];
+    output->attributes[4] = input->tex_coord[VAR_T];
+}
+
+static void vs_color_batch(er_VertexBatchInput* input, er_VertexBatchOutput* output, er_UniVars* vars){
+    unsigned int i;
+    float (*mvp)[4] = vars->modelview_projection;
+    for(i = 0; i < input->size; i++){
+        float x = input->position[VAR_X][i], y = input->position[VAR_Y][i], z = input->position[VAR_Z][i], w = input->position[VAR_W][i];
+        output->position[VAR_X][i] = mvp[0][0] * x + mvp[0][1] * y + mvp[0][2] * z + mvp[0][3] * w;
+        output->position[VAR_Y][i] = mvp[1][0] * x + mvp[1][1] * y + mvp[1][2] * z + mvp[1][3] * w;
+        output->position[VAR_Z][i] = mvp[2][0] * x + mvp[2][1] * y + mvp[2][2] * z + mvp[2][3] * w;
+        output->position[VAR_W][i] = mvp[3][0] * x + mvp[3][1] * y + mvp[3][2] * z + mvp[3][3] * w;
+        output->attributes[0][i] = input->color[VAR_R][i];
+        output->attributes[1][i] = input->color[VAR_G][i];
+        output->attributes[2][i] = input->color[VAR_B][i];
+        output->attributes[3][i] = input->tex_coord[VAR_S][i];
+        output->attributes[4][i] = input->tex_coord[VAR_T][i];
+    }
+}
+
+/*
+* Shaders for instanced cubes, the instance array holds the offset of each cube.
+*/
+static void vs_instance(er_VertexInput* input, er_VertexOutput* output, er_UniVars* vars){
+    float *offset = vars->instance_attributes;
+    vec4 position = {input->position[VAR_X] + offset[VAR_X], input->position[VAR_Y] + offset[VAR_Y], input->position[VAR_Z] + offset[VAR_Z], 1.0f};
+    multd_mat4_vec4(vars->modelview_projection, position, output->position);
+    output->attributes[0] = input->color[VAR_R];
+    output->attributes[1] = input->color[VAR_G];
+    output->attributes[2] = input->color[VAR_B];
+    output->attributes[3] = input->tex_coord[VAR_S];
+    output->attributes[4] = input->tex_coord[VAR_T];
+}
+
+static void vs_instance_batch(er_VertexBatchInput* input, er_VertexBatchOutput* output, er_UniVars* vars){
+    unsigned int i;
+    float (*mvp)[4] = vars->modelview_projection;
+    float *offset = vars->instance_attributes;
+    for(i = 0; i < input->size; i++){
+        float x = input->position[VAR_X][i] + offset[VAR_X], y = input->position[VAR_Y][i] + offset[VAR_Y], z = input->position[VAR_Z][i] + offset[VAR_Z];
+        output->position[VAR_X][i] = mvp[0][0] * x + mvp[0][1] * y + mvp[0][2] * z + mvp[0][3];
+        output->position[VAR_Y][i] = mvp[1][0] * x + mvp[1][1] * y + mvp[1][2] * z + mvp[1][3];
+        output->position[VAR_Z][i] = mvp[2][0] * x + mvp[2][1] * y + mvp[2][2] * z + mvp[2][3];
+        output->position[VAR_W][i] = mvp[3][0] * x + mvp[3][1] * y + mvp[3][2] * z + mvp[3][3];
+        output->attributes[0][i] = input->color[VAR_R][i];
+        output->attributes[1][i] = input->color[VAR_G][i];
+        output->attributes[2][i] = input->color[VAR_B][i];
+        output->attributes[3][i] = input->tex_coord[VAR_S][i];
+        output->attributes[4][i] = input->tex_coord[VAR_T][i];
+    }
+}
+
+static void hd_color(er_VertexOutput* vertex){
+    int k;
+    vertex->position[VAR_X] = vertex->position[VAR_X] / vertex->position[VAR_W];
+    vertex->position[VAR_Y] = vertex->position[VAR_Y] / vertex->position[VAR_W];
+    vertex->position[VAR_Z] = vertex->position[VAR_Z] / vertex->position[VAR_W];
+    for(k = 0; k < 5; k++){
+        vertex->attributes[k] = vertex->attributes[k] / vertex->position[VAR_W];
+    }
+    vertex->position[VAR_W] = 1.0f / vertex->position[VAR_W];
+}
+
+static void fs_color(int y, int x, er_FragInput* input, er_UniVars* vars){
+    pixels_count++;
+    if(!early_depth && input->frag_coord[VAR_Z] >= read_depth(y, x)){
+        return;
+    }
+    float w = 1.0f / input->frag_coord[VAR_W];
+    float s = input->attributes[3] * w;
+    float t = input->attributes[4] * w;
+    float checker = ( ((int)floor(8.0f * s) + (int)floor(8.0f * t)) & 1 ) ? 1.0f: 0.6f;
+    output_color(y, x, input, checker * input->attributes[0] * w, checker * input->attributes[1] * w, checker * input->attributes[2] * w);
+}
+
+static void fs_color_span(er_FragSpan* span, er_UniVars* vars){
+    unsigned int i;
+    pixels_count += __builtin_popcount(span->mask);
+    for(i = 0; i < span->size; i++){
+        float w = 1.0f / span->w[i];
+        float s = span->attributes[3][i] * w;
+        float t = span->attributes[4][i] * w;
+        float checker = ( ((int)floor(8.0f * s) + (int)floor(8.0f * t)) & 1 ) ? 1.0f: 0.6f;
+        span->color[VAR_R][i] = checker * span->attributes[0][i] * w;
+        span->color[VAR_G][i] = checker * span->attributes[1][i] * w;
+        span->color[VAR_B][i] = checker * span->attributes[2][i] * w;
+        span->color[VAR_A][i] = 1.0f;
+    }
+}
+
+/*
+* Shaders for the surface plot, per pixel diffuse lighting.
+*/
+static void vs_surface(er_VertexInput* input, er_VertexOutput* output, er_UniVars* vars){
+    vec3 normal;
+    multd_mat4_vec4(vars->modelview_projection, input->position, output->position);
+    multd_mat3_vec3(vars->normal, input->normal, normal);
+    output->attributes[0] = normal[VAR_X];
+    output->attributes[1] = normal[VAR_Y];
+    output->attributes[2] = normal[VAR_Z];
+    output->attributes[3] = input->position[VAR_Z];
+}
+
+static void vs_surface_batch(er_VertexBatchInput* input, er_VertexBatchOutput* output, er_UniVars* vars){
+    unsigned int i;
+    float (*mvp)[4] = vars->modelview_projection;
+    float (*nm)[3] = vars->normal;
+    for(i = 0; i < input->size; i++){
+        float x = input->position[VAR_X][i], y = input->position[VAR_Y][i], z = input->position[VAR_Z][i], w = input->position[VAR_W][i];
+        float nx = input->normal[VAR_X][i], ny = input->normal[VAR_Y][i], nz = input->normal[VAR_Z][i];
+        output->position[VAR_X][i] = mvp[0][0] * x + mvp[0][1] * y + mvp[0][2] * z + mvp[0][3] * w;
+        output->position[VAR_Y][i] = mvp[1][0] * x + mvp[1][1] * y + mvp[1][2] * z + mvp[1][3] * w;
+        output->position[VAR_Z][i] = mvp[2][0] * x + mvp[2][1] * y + mvp[2][2] * z + mvp[2][3] * w;
+        output->position[VAR_W][i] = mvp[3][0] * x + mvp[3][1] * y + mvp[3][2] * z + mvp[3][3] * w;
+        output->attributes[0][i] = nm[0][0] * nx + nm[0][1] * ny + nm[0][2] * nz;
+        output->attributes[1][i] = nm[1][0] * nx + nm[1][1] * ny + nm[1][2] * nz;
+        output->attributes[2][i] = nm[2][0] * nx + nm[2][1] * ny + nm[2][2] * nz;
+        output->attributes[3][i] = z;
+    }
+}
+
+static void hd_surface(er_VertexOutput* vertex){
+    int k;
+    vertex->position[VAR_X] = vertex->position[VAR_X] / vertex->position[VAR_W];
+    vertex->position[VAR_Y] = vertex->position[VAR_Y] / vertex->position[VAR_W];
+    vertex->position[VAR_Z] = vertex->position[VAR_Z] / vertex->position[VAR_W];
+    for(k = 0; k < 4; k++){
+        vertex->attributes[k] = vertex->attributes[k] / vertex->position[VAR_W];
+    }
+    vertex->position[VAR_W] = 1.0f / vertex->position[VAR_W];
+}
+
+static void fs_surface(int y, int x, er_FragInput* input, er_UniVars* vars){
+    pixels_count++;
+    if(!early_depth && input->frag_coord[VAR_Z] >= read_depth(y, x)){
+        return;
+    }
+    float w = 1.0f / input->frag_coord[VAR_W];
+    vec3 normal = {input->attributes[0] * w, input->attributes[1] * w, input->attributes[2] * w};
+    normalize_vec3(normal);
+    float diffuse = fabs(0.577f * (normal[VAR_X] + normal[VAR_Y] + normal[VAR_Z]));
+    float height = 0.5f + 0.5f * input->attributes[3] * w;
+    output_color(y, x, input, 0.1f + diffuse * height, 0.1f + diffuse * 0.5f, 0.1f + diffuse * (1.0f - height));
+}
+
+static void fs_surface_span(er_FragSpan* span, er_UniVars* vars){
+    unsigned int i;
+    pixels_count += __builtin_popcount(span->mask);
+    for(i = 0; i < span->size; i++){
+        float w = 1.0f / span->w[i];
+        vec3 normal = {span->attributes[0][i] * w, span->attributes[1][i] * w, span->attributes[2][i] * w};
+        normalize_vec3(normal);
+        float diffuse = fabs(0.577f * (normal[VAR_X] + normal[VAR_Y] + normal[VAR_Z]));
+        float height = 0.5f + 0.5f * span->attributes[3][i] * w;
+        span->color[VAR_R][i] = 0.1f + diffuse * height;
+        span->color[VAR_G][i] = 0.1f + diffuse * 0.5f;
+        span->color[VAR_B][i] = 0.1f + diffuse * (1.0f - height);
+        span->color[VAR_A][i] = 1.0f;
+    }
+}
+
+/*
+* Build mesh of the surface z = sin(x) * cos(y)
+*/
+static void build_surface(){
+    int i, j;
+    surface_vertices = (float*)malloc(SURFACE_SIZE * SURFACE_SIZE * 6 * sizeof(float));
+    surface_indices_size = (SURFACE_SIZE - 1) * (SURFACE_SIZE - 1) * 6;
+    surface_indices = (unsigned int*)malloc(surface_indices_size * sizeof(unsigned int));
+    if(surface_vertices == NULL || surface_indices == NULL){
+        fprintf(stderr, "Unable to allocate surface mesh. Out of memory\n");
+        quit();
+    }
+    for(i = 0; i < SURFACE_SIZE; i++){
+        for(j = 0; j < SURFACE_SIZE; j++){
+            float *v = &surface_vertices[(i * SURFACE_SIZE + j) * 6];
+            float x = -M_PI + 2.0f * M_PI * j / (SURFACE_SIZE - 1);
+            float y = -M_PI + 2.0f * M_PI * i / (SURFACE_SIZE - 1);
+            v[0] = x;
+            v[1] = y;
+            v[2] = sin(x) * cos(y);
+            v[3] = -cos(x) * cos(y);
+            v[4] = sin(x) * sin(y);
+            v[5] = 1.0f;
+        }
+    }
+    unsigned int *index = surface_indices;
+    for(i = 0; i < SURFACE_SIZE - 1; i++){
+        for(j = 0; j < SURFACE_SIZE - 1; j++){
+            *index++ = i * SURFACE_SIZE + j;
+            *index++ = i * SURFACE_SIZE + j + 1;
+            *index++ = (i + 1) * SURFACE_SIZE + j + 1;
+            *index++ = i * SURFACE_SIZE + j;
+            *index++ = (i + 1) * SURFACE_SIZE + j + 1;
+            *index++ = (i + 1) * SURFACE_SIZE + j;
+        }
+    }
+}
+
+/*
+* Build mesh of a cube with a color per face, and the offsets of the grid of cubes
+*/
+static void build_cubes(){
+    static const float corners[6][4][3] = {
+        {{1, -1, 1}, {1, -1, -1}, {1, 1, -1}, {1, 1, 1}},
+        {{-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}},
+        {{-1, 1, 1}, {1, 1, 1}, {1, 1, -1}, {-1, 1, -1}},
+        {{-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}},
+        {{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}},
+        {{1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}}
+    };
+    static const float tex_coords[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+    int face, corner, i, j;
+    for(face = 0; face < 6; face++){
+        for(corner = 0; corner < 4; corner++){
+            float *vertex = &cube_vertices[(face * 4 + corner) * 8];
+            vertex[0] = 0.3f * corners[face][corner][0];
+            vertex[1] = 0.3f * corners[face][corner][1];
+            vertex[2] = 0.3f * corners[face][corner][2];
+            vertex[3] = 0.4f + 0.1f * face;
+            vertex[4] = 1.0f - 0.1f * face;
+            vertex[5] = 0.6f;
+            vertex[6] = tex_coords[corner][0];
+            vertex[7] = tex_coords[corner][1];
+        }
+        cube_indices[face * 6 + 0] = face * 4 + 0;
+        cube_indices[face * 6 + 1] = face * 4 + 1;
+        cube_indices[face * 6 + 2] = face * 4 + 2;
+        cube_indices[face * 6 + 3] = face * 4 + 0;
+        cube_indices[face * 6 + 4] = face * 4 + 2;
+        cube_indices[face * 6 + 5] = face * 4 + 3;
+    }
+    for(i = 0; i < CUBES_SIZE; i++){
+        for(j = 0; j < CUBES_SIZE; j++){
+            float *offset = &cube_offsets[(i * CUBES_SIZE + j) * 3];
+            offset[0] = j - 0.5f * (CUBES_SIZE - 1);
+            offset[1] = i - 0.5f * (CUBES_SIZE - 1);
+            offset[2] = 0.5f * sin(0.7f * i) * cos(0.4f * j);
+        }
+    }
+}
+
+/*
+* Scenes
+*/
+static void draw_triangles(int frame){
+    int i;
+    er_use_program(batch_shaders ? prog_color_batch: prog_color);
+    er_matrix_mode(ER_PROJECTION);
+    er_load_identity();
+    er_orthographic(-5.0f, 5.0f, -5.0f, 5.0f, 2.0f, 8.0f);
+    er_matrix_mode(ER_MODELVIEW);
+    er_load_identity();
+    er_rotate_z(3.0f * frame);
+    er_begin(ER_TRIANGLES);
+    for(i = 0; i < 8; i++){
+        float z = -3.0f - 0.25f * i;
+        er_color3f(1.0f, 0.0f, 0.0f);
+        er_tex_coord2f(0.0f, 0.0f);
+        er_vertex3f( -3.0f + 0.2f * i, -2.0f, z);
+        er_color3f(0.0f, 0.0f, 1.0f);
+        er_tex_coord2f(1.0f, 0.0f);
+        er_vertex3f( 2.5f, -1.0f + 0.2f * i, z);
+        er_color3f(0.0f, 1.0f, 0.0f);
+        er_tex_coord2f(0.5f, 1.0f);
+        er_vertex3f( 0.0f, 3.0f - 0.2f * i, z);
+    }
+    er_end();
+    triangles_count += 8;
+}
+
+static void draw_face(vec3 v0, vec3 v1, vec3 v2, vec3 v3){
+    er_tex_coord2f(0.0f, 0.0f);
+    er_vertex3fv(v0);
+    er_tex_coord2f(1.0f, 0.0f);
+    er_vertex3fv(v1);
+    er_tex_coord2f(1.0f, 1.0f);
+    er_vertex3fv(v2);
+    er_tex_coord2f(0.0f, 0.0f);
+    er_vertex3fv(v0);
+    er_tex_coord2f(1.0f, 1.0f);
+    er_vertex3fv(v2);
+    er_tex_coord2f(0.0f, 1.0f);
+    er_vertex3fv(v3);
+}
+
+static void draw_cube(int frame){
+    float size = 1.5f;
+    vec3 LBF = {-size, -size, size};
+    vec3 RBF = {size, -size, size};
+    vec3 RTF = {size, size, size};
+    vec3 LTF = {-size, size, size};
+    vec3 LBB = {-size, -size, -size};
+    vec3 RBB = {size, -size, -size};
+    vec3 RTB = {size, size, -size};
+    vec3 LTB = {-size, size, -size};
+    er_use_program(batch_shaders ? prog_color_batch: prog_color);
+    er_matrix_mode(ER_PROJECTION);
+    er_load_identity();
+    er_perspective(60.0f, (float)window_width / window_height, 1.0f, 50.0f);
+    er_matrix_mode(ER_MODELVIEW);
+    er_load_identity();
+    er_look_at(5.0f * sin(0.05f * frame), 2.5f, 5.0f * cos(0.05f * frame), 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    er_color3f(1.0f, 0.8f, 0.6f);
+    er_begin(ER_TRIANGLES);
+    draw_face(RBF, RBB, RTB, RTF);
+    draw_face(LBB, LBF, LTF, LTB);
+    draw_face(LTF, RTF, RTB, LTB);
+    draw_face(LBB, RBB, RBF, LBF);
+    draw_face(LBF, RBF, RTF, LTF);
+    draw_face(RBB, LBB, LTB, RTB);
+    er_end();
+    triangles_count += 12;
+}
+
+static void draw_surface(int frame){
+    er_use_program(batch_shaders ? prog_surface_batch: prog_surface);
+    er_use_vertex_array(va_surface);
+    er_matrix_mode(ER_PROJECTION);
+    er_load_identity();
+    er_perspective(60.0f, (float)window_width / window_height, 0.5f, 50.0f);
+    er_matrix_mode(ER_MODELVIEW);
+    er_load_identity();
+    er_look_at(7.0f * sin(0.05f * frame), 7.0f * cos(0.05f * frame), 4.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    er_draw_elements(ER_TRIANGLES, surface_indices_size, surface_indices);
+    triangles_count += surface_indices_size / 3;
+}
+
+static void cubes_camera(int frame){
+    er_use_vertex_array(va_cubes);
+    er_matrix_mode(ER_PROJECTION);
+    er_load_identity();
+    er_perspective(60.0f, (float)window_width / window_height, 0.5f, 80.0f);
+    er_matrix_mode(ER_MODELVIEW);
+    er_load_identity();
+    er_look_at(18.0f * sin(0.05f * frame), 18.0f * cos(0.05f * frame), 12.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+static void draw_cube_calls(int frame){
+    int i;
+    er_use_program(batch_shaders ? prog_color_batch: prog_color);
+    cubes_camera(frame);
+    for(i = 0; i < CUBES_SIZE * CUBES_SIZE; i++){
+        er_push_matrix();
+        er_translate(cube_offsets[3 * i], cube_offsets[3 * i + 1], cube_offsets[3 * i + 2]);
+        er_draw_elements(ER_TRIANGLES, 36, cube_indices);
+        er_pop_matrix();
+    }
+    triangles_count += CUBES_SIZE * CUBES_SIZE * 12;
+}
+
+static void draw_cube_instances(int frame){
+    er_use_program(batch_shaders ? prog_instance_batch: prog_instance);
+    cubes_camera(frame);
+    er_draw_elements_instanced(ER_TRIANGLES, 36, cube_indices, CUBES_SIZE * CUBES_SIZE);
+    triangles_count += CUBES_SIZE * CUBES_SIZE * 12;
+}
+
+static void run(const char *scene_name, void (*scene)(int), int frames){
+    int i, mode;
+    for(mode = 0; mode < 6; mode++){
+        er_enable(ER_HALF_SPACE_RASTERIZATION, (mode & 1) ? ER_TRUE: ER_FALSE);
+        early_depth = (mode >= 2);
+        batch_shaders = (mode >= 4);
+        er_enable(ER_GUARD_BAND_CLIPPING, batch_shaders ? ER_TRUE: ER_FALSE);
+        er_bind_framebuffer(early_depth ? framebuffer: NULL);
+        er_enable(ER_DEPTH_TEST, early_depth ? ER_TRUE: ER_FALSE);
+        triangles_count = 0;
+        pixels_count = 0;
+        er_reset_statistics();
+        clock_t start = clock();
+        for(i = 0; i < frames; i++){
+            if(early_depth){
+                er_clear(ER_COLOR_AND_DEPTH_BUFFER);
+            }else{
+                clear_buffer();
+            }
+            scene(i);
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if(seconds <= 0.0){
+            seconds = 1e-6;
+        }
+        printf("%-16s %-11s %-13s %8.3f ms/frame %12.0f triangles/s %8.2f Mpixels/s\n", scene_name, (mode & 1) ? "half-space": "scanline",
+               batch_shaders ? "batched": (early_depth ? "early depth": "shader depth"), 1000.0 * seconds / frames, triangles_count / seconds, pixels_count / seconds * 1e-6);
+        if(early_depth){
+            er_Statistics stats;
+            er_get_statistics(&stats);
+            printf("%-16s Hi-Z rejected %lu triangles and %lu blocks per frame\n", "", stats.hiz_rejected_triangles / frames, stats.hiz_rejected_blocks / frames);
+            printf("%-16s Vertex cache %lu hits and %lu misses per frame\n", "", stats.vertex_cache_hits / frames, stats.vertex_cache_misses / frames);
+            printf("%-16s Culled %lu back faces, %lu degenerate and %lu empty triangles per frame\n", "", stats.culled_back_faces / frames,
+                   stats.culled_degenerate_triangles / frames, stats.culled_empty_triangles / frames);
+            if(batch_shaders){
+                printf("%-16s Guard band accepted %lu triangles per frame\n", "", stats.guard_band_triangles / frames);
+            }
+        }
+    }
+}
+
+/*
+* Render a frame of the scene on the library framebuffer, keep it as the reference or count the
+* pixels whose color or depth differ from it.
+*/
+static void render_frame(void (*scene)(int), int frame, int reference, int *color_mismatches, int *depth_mismatches){
+    int i;
+    int length = window_width * window_height;
+    unsigned int *color;
+    float *depth;
+    er_clear(ER_COLOR_AND_DEPTH_BUFFER);
+    scene(frame);
+    er_framebuffer_ptr(framebuffer, ER_COLOR_ATTACHMENT, (void**)&color);
+    er_framebuffer_ptr(framebuffer, ER_DEPTH_ATTACHMENT, (void**)&depth);
+    if(reference){
+        memcpy(reference_color, color, length * sizeof(unsigned int));
+        memcpy(reference_depth, depth, length * sizeof(float));
+        return;
+    }
+    *color_mismatches = 0;
+    *depth_mismatches = 0;
+    for(i = 0; i < length; i++){
+        *color_mismatches += (color[i] != reference_color[i]);
+        *depth_mismatches += (depth[i] != reference_depth[i]);
+    }
+}
+
+/*
+* Render a frame of the scene with and without the tiled backend, and with the half-space and the fixed
+* point rasterizers. Both pairs must give the same pixels, whatever shaders are used.
+*/
+static void compare(const char *scene_name, void (*scene)(int), int frame){
+    int mode, color_mismatches, depth_mismatches;
+    er_bind_framebuffer(framebuffer);
+    er_enable(ER_DEPTH_TEST, ER_TRUE);
+    early_depth = 1;
+    for(mode = 0; mode < 4; mode++){
+        er_enable(ER_HALF_SPACE_RASTERIZATION, (mode & 1) ? ER_TRUE: ER_FALSE);
+        batch_shaders = (mode >= 2);
+        er_enable(ER_GUARD_BAND_CLIPPING, batch_shaders ? ER_TRUE: ER_FALSE);
+        er_enable(ER_TILED_RASTERIZATION, ER_FALSE);
+        render_frame(scene, frame, 1, NULL, NULL);
+        er_enable(ER_TILED_RASTERIZATION, ER_TRUE);
+        render_frame(scene, frame, 0, &color_mismatches, &depth_mismatches);
+        er_enable(ER_TILED_RASTERIZATION, ER_FALSE);
+        printf("%-16s %-11s %-13s tiled vs untiled: %d color and %d depth mismatches\n", scene_name, (mode & 1) ? "half-space": "scanline",
+               batch_shaders ? "batched": "per pixel", color_mismatches, depth_mismatches);
+    }
+    for(mode = 0; mode < 2; mode++){
+        batch_shaders = mode;
+        er_enable(ER_GUARD_BAND_CLIPPING, batch_shaders ? ER_TRUE: ER_FALSE);
+        er_enable(ER_HALF_SPACE_RASTERIZATION, ER_FALSE);
+        er_enable(ER_FIXED_POINT_RASTERIZATION, ER_TRUE);
+        render_frame(scene, frame, 1, NULL, NULL);
+        er_enable(ER_FIXED_POINT_RASTERIZATION, ER_FALSE);
+        er_enable(ER_HALF_SPACE_RASTERIZATION, ER_TRUE);
+        render_frame(scene, frame, 0, &color_mismatches, &depth_mismatches);
+        er_enable(ER_HALF_SPACE_RASTERIZATION, ER_FALSE);
+        printf("%-16s %-11s %-13s half-space vs fixed point: %d color and %d depth mismatches\n", scene_name, "",
+               batch_shaders ? "batched": "per pixel", color_mismatches, depth_mismatches);
+    }
+    for(mode = 0; mode < 4; mode++){
+        er_enable(ER_HALF_SPACE_RASTERIZATION, (mode & 1) ? ER_TRUE: ER_FALSE);
+        batch_shaders = (mode >= 2);
+        er_enable(ER_GUARD_BAND_CLIPPING, batch_shaders ? ER_TRUE: ER_FALSE);
+        er_enable(ER_HIERARCHICAL_DEPTH_TEST, ER_FALSE);
+        render_frame(scene, frame, 1, NULL, NULL);
+        er_enable(ER_HIERARCHICAL_DEPTH_TEST, ER_TRUE);
+        render_frame(scene, frame, 0, &color_mismatches, &depth_mismatches);
+        printf("%-16s %-11s %-13s Hi-Z vs no Hi-Z: %d color and %d depth mismatches\n", scene_name, (mode & 1) ? "half-space": "scanline",
+               batch_shaders ? "batched": "per pixel", color_mismatches, depth_mismatches);
+    }
+    er_enable(ER_HALF_SPACE_RASTERIZATION, ER_FALSE);
+}
+
+int main(int argc, char *argv[]){
+    int frames = (argc > 1) ? atoi(argv[1]) : 100;
+    if(frames <= 0){
+        frames = 100;
+    }
+    color_buffer = (unsigned int*)malloc(window_width * window_height * sizeof(unsigned int));
+    depth_buffer = (float*)malloc(window_width * window_height * sizeof(float));
+    if(color_buffer == NULL || depth_buffer == NULL){
+        fprintf(stderr, "Unable to allocate buffers. Out of memory\n");
+        quit();
+    }
+    build_surface();
+    build_cubes();
+    /* EduRaster initialization */
+    if(er_init() != ER_NO_ERROR){
+        fprintf(stderr, "Unable to init eduraster\n");
+        quit();
+    }
+    er_viewport(0, 0, window_width, window_height);
+    framebuffer = er_create_framebuffer(window_width, window_height);
+    if(framebuffer == NULL){
+        fprintf(stderr, "Unable to create framebuffer\n");
+        quit();
+    }
+    er_clear_color(0.0f, 0.0f, 0.0f, 1.0f);
+    prog_color = er_create_program();
+    prog_surface = er_create_program();
+    prog_color_batch = er_create_program();
+    prog_surface_batch = er_create_program();
+    prog_instance = er_create_program();
+    prog_instance_batch = er_create_program();
+    va_surface = er_create_vertex_array();
+    va_cubes = er_create_vertex_array();
+    if(prog_color == NULL || prog_surface == NULL || prog_color_batch == NULL || prog_surface_batch == NULL ||
+       prog_instance == NULL || prog_instance_batch == NULL || va_surface == NULL || va_cubes == NULL){
+        fprintf(stderr, "Unable to create eduraster objects\n");
+        quit();
+    }
+    er_varying_attributes(prog_color, 5);
+    er_load_vertex_shader(prog_color, vs_color);
+    er_load_homogeneous_division(prog_color, hd_color);
+    er_load_fragment_shader(prog_color, fs_color);
+    er_varying_attributes(prog_surface, 4);
+    er_load_vertex_shader(prog_surface, vs_surface);
+    er_load_homogeneous_division(prog_surface, hd_surface);
+    er_load_fragment_shader(prog_surface, fs_surface);
+    er_varying_attributes(prog_color_batch, 5);
+    er_load_vertex_batch_shader(prog_color_batch, vs_color_batch);
+    er_load_homogeneous_division(prog_color_batch, hd_color);
+    er_load_fragment_span_shader(prog_color_batch, fs_color_span);
+    er_varying_attributes(prog_surface_batch, 4);
+    er_load_vertex_batch_shader(prog_surface_batch, vs_surface_batch);
+    er_load_homogeneous_division(prog_surface_batch, hd_surface);
+    er_load_fragment_span_shader(prog_surface_batch, fs_surface_span);
+    er_varying_attributes(prog_instance, 5);
+    er_load_vertex_shader(prog_instance, vs_instance);
+    er_load_homogeneous_division(prog_instance, hd_color);
+    er_load_fragment_shader(prog_instance, fs_color);
+    er_varying_attributes(prog_instance_batch, 5);
+    er_load_vertex_batch_shader(prog_instance_batch, vs_instance_batch);
+    er_load_homogeneous_division(prog_instance_batch, hd_color);
+    er_load_fragment_span_shader(prog_instance_batch, fs_color_span);
+    er_vertex_pointer(va_cubes, 8, 3, cube_vertices);
+    er_color_pointer(va_cubes, 8, 3, cube_vertices + 3);
+    er_tex_coord_pointer(va_cubes, 8, 2, cube_vertices + 6);
+    er_instance_pointer(va_cubes, 3, cube_offsets);
+    er_enable_attribute_array(va_cubes, ER_COLOR_ARRAY, ER_TRUE);
+    er_enable_attribute_array(va_cubes, ER_TEX_COORD_ARRAY, ER_TRUE);
+    er_enable_attribute_array(va_cubes, ER_INSTANCE_ARRAY, ER_TRUE);
+    er_vertex_pointer(va_surface, 6, 3, surface_vertices);
+    er_normal_pointer(va_surface, 6, surface_vertices + 3);
+    er_enable_attribute_array(va_surface, ER_NORMAL_ARRAY, ER_TRUE);
+
+    if(argc > 2 && strcmp(argv[2], "compare") == 0){
+        reference_color = (unsigned int*)malloc(window_width * window_height * sizeof(unsigned int));
+        reference_depth = (float*)malloc(window_width * window_height * sizeof(float));
+        if(reference_color == NULL || reference_depth == NULL){
+            fprintf(stderr, "Unable to allocate buffers. Out of memory\n");
+            quit();
+        }
+        er_thread_count(4);
+        printf("Viewport %dx%d, frame %d of each scene\n", window_width, window_height, frames);
+        compare("Single triangle", draw_triangles, frames);
+        compare("Texture cube", draw_cube, frames);
+        compare("Surface plot", draw_surface, frames);
+        compare("Cube draw calls", draw_cube_calls, frames);
+        compare("Cube instances", draw_cube_instances, frames);
+        quit();
+    }
+
+    printf("Viewport %dx%d, %d frames per test\n", window_width, window_height, frames);
+    run("Single triangle", draw_triangles, frames);
+    run("Texture cube", draw_cube, frames);
+    run("Surface plot", draw_surface, frames);
+    run("Cube draw calls", draw_cube_calls, frames);
+    run("Cube instances", draw_cube_instances, frames);
+
+    quit();
+    return 0;
+}
@@ -7,7 +7,7 @@ SETLOCAL
 set SDL_HEADER_PATH=..\external\SDL2-2.0.14\i686-w64-mingw32\include\SDL2
 set SDL_LIB_PATH=..\external\SDL2-2.0.14\i686-w64-mingw32\lib
 set SDL_RUNTIME_PATH=..\external\SDL2-2.0.14-win32-x86
-set LINK_LIBS=-leduraster -lmingw32 -lSDL2main -lSDL2 -lm
+set LINK_LIBS=-leduraster -lmingw32 -lSDL2main -lSDL2 -lm -lpthread
 
 echo EduRaster lib
 
@@ -41,6 +41,18 @@ echo Tunnel Effect
 
 gcc -I..\include -I%SDL_HEADER_PATH% -L. -L%SDL_LIB_PATH% tunnel.c -o tunnel  %LINK_LIBS% -O2
 
+echo Rasterizer Benchmark
+
+gcc -I..\include -L. benchmark.c -o benchmark -leduraster -lm -lpthread -O2
+
+echo Texture Benchmark
+
+gcc -I..\include -L. texture_benchmark.c -o texture_benchmark -leduraster -lm -lpthread -O2
+
+echo Sampler Benchmark
+
+gcc -I..\include -L. sampler_benchmark.c -o sampler_benchmark -leduraster -lm -lpthread -O2
+
 echo Copying SDL.dll
 
 copy %SDL_RUNTIME_PATH%\SDL2.dll
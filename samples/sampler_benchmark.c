@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "eduraster.h"
+
+/*
+* Headless benchmark of the samplers. Each of the 36 combinations of texture target, magnification
+* and minification filter samples a fixed set of random coordinates and derivatives, from magnified
+* to minified footprints, with er_texture_grad, and reports samples per second.
+*/
+
+/* Samples of each test, generated before timing */
+#define SAMPLES 65536
+/* Textures small enough for the caches, the samplers are measured and not the memory */
+#define TEXTURE_SIZE 256
+#define CUBEMAP_SIZE 128
+
+static er_TextureTargetEnum targets[] = {ER_TEXTURE_1D, ER_TEXTURE_2D, ER_TEXTURE_CUBE_MAP};
+static const char *target_names[] = {"1D", "2D", "Cubemap"};
+static er_TextureFilterEnum magnification_filters[] = {ER_NEAREST, ER_LINEAR};
+static const char *magnification_names[] = {"NEAREST", "LINEAR"};
+static er_TextureFilterEnum minification_filters[] = {ER_NEAREST, ER_LINEAR, ER_NEAREST_MIPMAP_NEAREST, ER_LINEAR_MIPMAP_NEAREST,
+                                                      ER_NEAREST_MIPMAP_LINEAR, ER_LINEAR_MIPMAP_LINEAR};
+static const char *minification_names[] = {"NEAREST", "LINEAR", "NEAREST_MIPMAP_NEAREST", "LINEAR_MIPMAP_NEAREST",
+                                           "NEAREST_MIPMAP_LINEAR", "LINEAR_MIPMAP_LINEAR"};
+static er_TextureFormatEnum formats[] = {ER_RGBA32F, ER_RGBA8};
+static const char *format_names[] = {"RGBA32F", "RGBA8"};
+
+static float coords[SAMPLES][3], ddx[SAMPLES][3], ddy[SAMPLES][3];
+
+static float random_float(float low, float high){
+    return low + (high - low) * (float)rand() / RAND_MAX;
+}
+
+/*
+ * Coordinates over 3 repetitions of the texture, derivatives of 1/4 to 64 texels.
+*/
+static void generate_samples(er_TextureTargetEnum target){
+
+    int i, c;
+    float size = (target == ER_TEXTURE_CUBE_MAP) ? CUBEMAP_SIZE: TEXTURE_SIZE;
+    srand(1);
+    for(i = 0; i < SAMPLES; i++){
+        float length = powf(2.0f, random_float(-2.0f, 6.0f)) / size;
+        for(c = 0; c < 3; c++){
+            coords[i][c] = (target == ER_TEXTURE_CUBE_MAP) ? random_float(-1.0f, 1.0f): random_float(-1.0f, 2.0f);
+            ddx[i][c] = length * random_float(-1.0f, 1.0f);
+            ddy[i][c] = length * random_float(-1.0f, 1.0f);
+        }
+    }
+
+}
+
+static er_Texture* create_texture(er_TextureTargetEnum target, er_TextureFormatEnum format, float *data){
+
+    er_Texture *tex = NULL;
+    er_StatusEnum status;
+    if(target == ER_TEXTURE_1D){
+        status = er_create_texture1D(&tex, TEXTURE_SIZE, format);
+    }else if(target == ER_TEXTURE_2D){
+        status = er_create_texture2D(&tex, TEXTURE_SIZE, TEXTURE_SIZE, format);
+    }else{
+        status = er_create_texture_cubemap(&tex, CUBEMAP_SIZE, format);
+    }
+    if(status != ER_NO_ERROR){
+        return NULL;
+    }
+    if(target == ER_TEXTURE_CUBE_MAP){
+        int face;
+        for(face = 0; face < 6; face++){
+            er_texture_image(tex, ER_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, data + face * CUBEMAP_SIZE * CUBEMAP_SIZE);
+        }
+    }else{
+        er_texture_image(tex, target, 0, data);
+    }
+    if(er_generate_mipmaps(tex) != ER_NO_ERROR){
+        er_delete_texture(tex);
+        return NULL;
+    }
+    er_texture_wrap_mode(tex, ER_WRAP_S, ER_REPEAT);
+    er_texture_wrap_mode(tex, ER_WRAP_T, ER_REPEAT);
+    return tex;
+
+}
+
+static void run(er_Texture *tex, int rounds, const char *target_name, const char *format_name, int mag, int min){
+
+    int i, r;
+    float sum = 0.0f;
+    er_texture_filtering(tex, ER_MAGNIFICATION_FILTER, magnification_filters[mag]);
+    er_texture_filtering(tex, ER_MINIFICATION_FILTER, minification_filters[min]);
+    clock_t start = clock();
+    for(r = 0; r < rounds; r++){
+        for(i = 0; i < SAMPLES; i++){
+            vec4 color;
+            er_texture_grad(tex, coords[i], ddx[i], ddy[i], color);
+            sum += color[0];
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if(seconds <= 0.0){
+        seconds = 1e-6;
+    }
+    /* The sum keeps the samples from being optimized away */
+    printf("%-8s %-8s %-8s %-23s %8.2f Msamples/s %s\n", target_name, format_name, magnification_names[mag], minification_names[min],
+           (double)SAMPLES * rounds / seconds * 1e-6, (sum < 0.0f) ? "!": "");
+
+}
+
+int main(int argc, char *argv[]){
+
+    int rounds = (argc > 1) ? atoi(argv[1]) : 20;
+    if(rounds <= 0){
+        rounds = 20;
+    }
+    float *data = (float*)malloc(TEXTURE_SIZE * TEXTURE_SIZE * 4 * sizeof(float));
+    if(data == NULL){
+        fprintf(stderr, "Unable to allocate texture data. Out of memory\n");
+        return 1;
+    }
+    int i;
+    srand(1);
+    for(i = 0; i < TEXTURE_SIZE * TEXTURE_SIZE * 4; i++){
+        data[i] = (float)rand() / RAND_MAX;
+    }
+
+    printf("%d samples per test, %d rounds, repeat wrap mode\n", SAMPLES, rounds);
+    printf("%-8s %-8s %-8s %-23s\n", "Target", "Format", "Mag", "Min");
+    int t, f, mag, min;
+    for(t = 0; t < 3; t++){
+        generate_samples(targets[t]);
+        for(f = 0; f < 2; f++){
+            er_Texture *tex = create_texture(targets[t], formats[f], data);
+            if(tex == NULL){
+                fprintf(stderr, "Unable to create texture\n");
+                return 1;
+            }
+            for(mag = 0; mag < 2; mag++){
+                for(min = 0; min < 6; min++){
+                    run(tex, rounds, target_names[t], format_names[f], mag, min);
+                }
+            }
+            er_delete_texture(tex);
+        }
+    }
+    free(data);
+    return 0;
+
+}
@@ -248,19 +248,7 @@ static void vs_cube(struct er_VertexInput *input, struct er_VertexOutput *output
 }
 
 /*
-* Homogeneous division for texture mapped cube.
-*/
-static void hd_cube(struct er_VertexOutput *vertex){
-    vertex->position[VAR_X] = vertex->position[VAR_X] / vertex->position[VAR_W];
-    vertex->position[VAR_Y] = vertex->position[VAR_Y] / vertex->position[VAR_W];
-    vertex->position[VAR_Z] = vertex->position[VAR_Z] / vertex->position[VAR_W];
-    vertex->attributes[0] = vertex->attributes[0] / vertex->position[VAR_W];
-    vertex->attributes[1] = vertex->attributes[1] / vertex->position[VAR_W];
-    vertex->position[VAR_W] = 1.0f / vertex->position[VAR_W];
-}
-
-/*
-* Fragment shader for texture mapped cube.
+* Fragment shader for texture mapped cube. Texture coordinates are perspective correct (ER_PERSPECTIVE_CORRECTION).
 */
 static void fs_cube(int y, int x, struct er_FragInput *input, struct er_UniVars *vars){
 
@@ -270,8 +258,8 @@ static void fs_cube(int y, int x, struct er_FragInput *input, struct er_UniVars
     struct er_Texture* tex = vars->uniform_texture[0];
     vec2 tex_coord;
     vec4 tex_color;
-    tex_coord[VAR_S] = input->attributes[0] / input->frag_coord[VAR_W];
-    tex_coord[VAR_T] = input->attributes[1] / input->frag_coord[VAR_W];
+    tex_coord[VAR_S] = input->attributes[0];
+    tex_coord[VAR_T] = input->attributes[1];
     er_texture_lod(tex, tex_coord, 0.0f, tex_color);
 
     write_color(y, x, tex_color[0], tex_color[1], tex_color[2], 1.0f);
@@ -279,7 +267,7 @@ static void fs_cube(int y, int x, struct er_FragInput *input, struct er_UniVars
 }
 
 /*
-* Fragment shader for texture mapped cube. Calculation of perspective correct derivatives for trilinear filtering.
+* Fragment shader for texture mapped cube. Trilinear filtering with the derivatives given by the library.
 */
 static void fs_cube_grad(int y, int x, struct er_FragInput *input, struct er_UniVars *vars){
     
@@ -290,16 +278,9 @@ static void fs_cube_grad(int y, int x, struct er_FragInput *input, struct er_Uni
     struct er_Texture *tex = vars->uniform_texture[0];
     vec2 tex_coord;
     vec4 tex_color;
-    tex_coord[VAR_S] = input->attributes[0] / input->frag_coord[VAR_W];
-    tex_coord[VAR_T] = input->attributes[1] / input->frag_coord[VAR_W];
-
-    vec2 ddx, ddy;
-    float one_over_w2 = 1.0f / (input->frag_coord[VAR_W] * input->frag_coord[VAR_W]);
-    ddx[VAR_S] = (input->ddx[0] * input->frag_coord[VAR_W] - input->attributes[0] * input->dw_dx) * one_over_w2;
-    ddx[VAR_T] = (input->ddx[1] * input->frag_coord[VAR_W] - input->attributes[1] * input->dw_dx) * one_over_w2;
-    ddy[VAR_S] = (input->ddy[0] * input->frag_coord[VAR_W] - input->attributes[0] * input->dw_dy) * one_over_w2;
-    ddy[VAR_T] = (input->ddy[1] * input->frag_coord[VAR_W] - input->attributes[1] * input->dw_dy) * one_over_w2;
-    er_texture_grad(tex, tex_coord, ddx, ddy, tex_color);
+    tex_coord[VAR_S] = input->attributes[0];
+    tex_coord[VAR_T] = input->attributes[1];
+    er_texture_grad(tex, tex_coord, input->ddx, input->ddy, tex_color);
 
     write_color(y, x, tex_color[0], tex_color[1], tex_color[2], 1.0f);
     write_depth(y, x, input->frag_coord[VAR_Z]);
@@ -339,7 +320,7 @@ static void setup(){
         fprintf(stderr, "Unable to load image %s. Error: %s\n", SDL_GetError());
         quit();
     }
-    er_StatusEnum status = er_create_texture2D(&tex, image->w, image->h, ER_RGB32F);
+    er_StatusEnum status = er_create_texture2D(&tex, image->w, image->h, ER_RGBA8);
     if(status != ER_NO_ERROR || tex == NULL){
         fprintf(stderr, "Unable to create texture\n");
         quit();
@@ -352,10 +333,9 @@ static void setup(){
     SDL_PixelFormat *format = image->format;
     SDL_LockSurface(image);
     unsigned char *src_data = image->pixels;
-    float *dst_data = NULL;
-    status = er_texture_ptr(tex, ER_TEXTURE_2D, 0, &dst_data);
-    if(status != ER_NO_ERROR || dst_data == NULL){
-        fprintf(stderr, "Unable to retrieve pointer to texture pixels\n");
+    float *dst_data = (float*)malloc(image->w * image->h * 4 * sizeof(float));
+    if(dst_data == NULL){
+        fprintf(stderr, "Unable to allocate texture pixels. Out of memory\n");
         quit();
     }
     int i, j;
@@ -365,13 +345,21 @@ static void setup(){
         for(j = 0; j < image->w; j++){
             memcpy(&src_color, &src_data[(image->h-1-i)*image->pitch+j*format->BytesPerPixel], format->BytesPerPixel);
             SDL_GetRGB(src_color, format, &r, &g, &b);
-            dst_data[i*image->w*3+j*3] = (float)r / 255.0f;
-            dst_data[i*image->w*3+j*3+1] = (float)g / 255.0f;
-            dst_data[i*image->w*3+j*3+2] = (float)b / 255.0f;
+            dst_data[i*image->w*4+j*4] = (float)r / 255.0f;
+            dst_data[i*image->w*4+j*4+1] = (float)g / 255.0f;
+            dst_data[i*image->w*4+j*4+2] = (float)b / 255.0f;
+            dst_data[i*image->w*4+j*4+3] = 1.0f;
         }
     }
     SDL_UnlockSurface(image);
     SDL_FreeSurface(image);
+    /* Texels are stored as 8 bit RGBA */
+    status = er_texture_image(tex, ER_TEXTURE_2D, 0, dst_data);
+    free(dst_data);
+    if(status != ER_NO_ERROR){
+        fprintf(stderr, "Unable to copy texture pixels\n");
+        quit();
+    }
     /* Generate mipmaps */
     if(er_generate_mipmaps(tex) != ER_NO_ERROR){
         fprintf(stderr, "Unable to generate mipmaps\n");
@@ -386,12 +374,13 @@ static void setup(){
     er_use_program(prog);
     er_varying_attributes(prog, 2);
     er_load_vertex_shader(prog, vs_cube);
-    er_load_homogeneous_division(prog, hd_cube);
     er_load_fragment_shader(prog, fs_cube);
     er_uniform_texture_ptr(prog, 0, tex);
     /* Enable backface culling */
     er_cull_face(ER_BACK);
     er_enable(ER_CULL_FACE, ER_TRUE);
+    /* Homogeneous division and perspective correct texture coordinates done by the library */
+    er_enable(ER_PERSPECTIVE_CORRECTION, ER_TRUE);
 
 }
 
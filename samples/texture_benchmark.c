@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "eduraster.h"
+
+/*
+* Headless benchmark of texture sampling. Fills a screen with trilinear samples of a large texture
+* mapped on quads rotated 0, 30 and 90 degrees and on a tunnel like the one of the tunnel sample,
+* for each texel layout, and reports samples per second. Compressed formats only have the tiled layout.
+* Each test runs with a call per sample and with spans of ER_SPAN_SIZE samples (er_texture_grad_span).
+* Without access to cache counters, the cache behaviour of each layout is estimated by timing the quads
+* again with a texture small enough to stay on cache, at the same texels per pixel: the ratio of both
+* times is the cost of the misses of the large texture.
+*/
+
+/* Screen filled with samples */
+static int screen_width = 640, screen_height = 480;
+/* Texture larger than the caches, and one that fits on them */
+#define TEXTURE_SIZE 2048
+#define CACHED_TEXTURE_SIZE 256
+/* Formats and layouts compared */
+static er_TextureFormatEnum formats[] = {ER_RGBA32F, ER_RGBA8, ER_BC1, ER_BC3};
+static const char *format_names[] = {"RGBA32F", "RGBA8", "BC1", "BC3"};
+static er_TextureLayoutEnum layouts[] = {ER_ROW_MAJOR, ER_TILED_4X4, ER_MORTON_ORDER};
+static const char *layout_names[] = {"row major", "tiled 4x4", "morton"};
+static const char *scene_names[] = {"Quad 0 deg", "Quad 30 deg", "Quad 90 deg", "Tunnel"};
+
+/*
+ * Texture coordinates and derivatives of a pixel. Quads are minified by 1.5, the tunnel maps
+ * the angle and the inverse of the distance to the center.
+*/
+static void map_pixel(int scene, int size, int x, int y, float *coord, float *ddx, float *ddy){
+
+    if(scene < 3){
+        float angle = (scene == 0) ? 0.0f: (scene == 1) ? M_PI / 6.0f: M_PI / 2.0f;
+        float scale = 1.5f / size;
+        float c = cos(angle) * scale, s = sin(angle) * scale;
+        coord[0] = x * c - y * s;
+        coord[1] = x * s + y * c;
+        ddx[0] = c;
+        ddx[1] = s;
+        ddy[0] = -s;
+        ddy[1] = c;
+    }else{
+        float px = x - 0.5f * screen_width + 0.5f, py = y - 0.5f * screen_height + 0.5f;
+        float r2 = px * px + py * py, r = sqrt(r2);
+        coord[0] = atan2(py, px) / (2.0f * M_PI);
+        coord[1] = 32.0f / r;
+        ddx[0] = -py / (r2 * 2.0f * M_PI);
+        ddy[0] = px / (r2 * 2.0f * M_PI);
+        ddx[1] = -32.0f * px / (r2 * r);
+        ddy[1] = -32.0f * py / (r2 * r);
+    }
+
+}
+
+static er_Texture* create_texture(er_TextureFormatEnum format, er_TextureLayoutEnum layout, int size, float *data){
+
+    er_Texture *tex = NULL;
+    if(er_create_texture2D(&tex, size, size, format) != ER_NO_ERROR){
+        return NULL;
+    }
+    if(er_texture_layout(tex, layout) != ER_NO_ERROR || er_texture_image(tex, ER_TEXTURE_2D, 0, data) != ER_NO_ERROR ||
+       er_generate_mipmaps(tex) != ER_NO_ERROR){
+        er_delete_texture(tex);
+        return NULL;
+    }
+    er_texture_filtering(tex, ER_MAGNIFICATION_FILTER, ER_LINEAR);
+    er_texture_filtering(tex, ER_MINIFICATION_FILTER, ER_LINEAR_MIPMAP_LINEAR);
+    er_texture_wrap_mode(tex, ER_WRAP_S, ER_REPEAT);
+    er_texture_wrap_mode(tex, ER_WRAP_T, ER_REPEAT);
+    return tex;
+
+}
+
+/*
+ * Milliseconds per frame of a test, the sum of the samples keeps them from being optimized away.
+*/
+static double time_samples(er_Texture *tex, int size, int scene, int frames, er_Bool span, float *sum){
+
+    int i, x, y, k;
+    clock_t start = clock();
+    for(i = 0; i < frames; i++){
+        for(y = 0; y < screen_height; y++){
+            if(span){
+                for(x = 0; x < screen_width; x += ER_SPAN_SIZE){
+                    float coord[2][ER_SPAN_SIZE], ddx[2][ER_SPAN_SIZE], ddy[2][ER_SPAN_SIZE], color[4][ER_SPAN_SIZE];
+                    for(k = 0; k < ER_SPAN_SIZE; k++){
+                        float lane_coord[2], lane_ddx[2], lane_ddy[2];
+                        map_pixel(scene, size, x + k, y, lane_coord, lane_ddx, lane_ddy);
+                        coord[0][k] = lane_coord[0];
+                        coord[1][k] = lane_coord[1];
+                        ddx[0][k] = lane_ddx[0];
+                        ddx[1][k] = lane_ddx[1];
+                        ddy[0][k] = lane_ddy[0];
+                        ddy[1][k] = lane_ddy[1];
+                    }
+                    er_texture_grad_span(tex, ER_SPAN_SIZE, coord, ddx, ddy, color);
+                    for(k = 0; k < ER_SPAN_SIZE; k++){
+                        *sum += color[0][k];
+                    }
+                }
+                continue;
+            }
+            for(x = 0; x < screen_width; x++){
+                float coord[2], ddx[2], ddy[2];
+                vec4 color;
+                map_pixel(scene, size, x, y, coord, ddx, ddy);
+                er_texture_grad(tex, coord, ddx, ddy, color);
+                *sum += color[0];
+            }
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if(seconds <= 0.0){
+        seconds = 1e-6;
+    }
+    return 1000.0 * seconds / frames;
+
+}
+
+static void run(er_Texture *tex, int scene, int frames, const char *format_name, const char *layout_name, er_Bool span){
+
+    float sum = 0.0f;
+    double ms = time_samples(tex, TEXTURE_SIZE, scene, frames, span, &sum);
+    printf("%-12s %-8s %-10s %-6s %8.3f ms/frame %8.2f Msamples/s %s\n", scene_names[scene], format_name, layout_name, span ? "span": "single",
+           ms, (double)screen_width * screen_height / ms * 1e-3, (sum < 0.0f) ? "!": "");
+
+}
+
+/*
+ * Working set proxy of a layout: time of the large texture over the one of the cached texture, on spans.
+*/
+static void run_cache_penalty(er_Texture *tex, er_Texture *cached, int scene, int frames, const char *format_name, const char *layout_name){
+
+    float sum = 0.0f;
+    double ms = time_samples(tex, TEXTURE_SIZE, scene, frames, ER_TRUE, &sum);
+    double cached_ms = time_samples(cached, CACHED_TEXTURE_SIZE, scene, frames, ER_TRUE, &sum);
+    printf("%-12s %-8s %-10s %8.3f ms/frame %8.3f ms/frame cached %6.2fx %s\n", scene_names[scene], format_name, layout_name,
+           ms, cached_ms, ms / cached_ms, (sum < 0.0f) ? "!": "");
+
+}
+
+int main(int argc, char *argv[]){
+
+    int frames = (argc > 1) ? atoi(argv[1]) : 10;
+    if(frames <= 0){
+        frames = 10;
+    }
+    float *data = (float*)malloc(TEXTURE_SIZE * TEXTURE_SIZE * 4 * sizeof(float));
+    if(data == NULL){
+        fprintf(stderr, "Unable to allocate texture data. Out of memory\n");
+        return 1;
+    }
+    int i;
+    srand(1);
+    for(i = 0; i < TEXTURE_SIZE * TEXTURE_SIZE * 4; i++){
+        data[i] = (float)rand() / RAND_MAX;
+    }
+
+    printf("Texture %dx%d, %dx%d samples, %d frames per test\n", TEXTURE_SIZE, TEXTURE_SIZE, screen_width, screen_height, frames);
+    int f, l, scene;
+    for(f = 0; f < 4; f++){
+        er_Texture *textures[3];
+        int created = 0;
+        for(l = 0; l < 3; l++){
+            textures[l] = create_texture(formats[f], layouts[l], TEXTURE_SIZE, data);
+            created += (textures[l] != NULL);
+        }
+        if(created == 0){
+            fprintf(stderr, "Unable to create texture\n");
+            return 1;
+        }
+        for(scene = 0; scene < 4; scene++){
+            for(l = 0; l < 3; l++){
+                if(textures[l] != NULL){
+                    run(textures[l], scene, frames, format_names[f], layout_names[l], ER_FALSE);
+                    run(textures[l], scene, frames, format_names[f], layout_names[l], ER_TRUE);
+                }
+            }
+        }
+        for(l = 0; l < 3; l++){
+            if(textures[l] != NULL){
+                er_delete_texture(textures[l]);
+            }
+        }
+    }
+
+    printf("\nTime with the %dx%d texture over time with a %dx%d texture on cache, same texels per pixel\n",
+           TEXTURE_SIZE, TEXTURE_SIZE, CACHED_TEXTURE_SIZE, CACHED_TEXTURE_SIZE);
+    for(f = 0; f < 4; f++){
+        for(l = 0; l < 3; l++){
+            er_Texture *tex = create_texture(formats[f], layouts[l], TEXTURE_SIZE, data);
+            er_Texture *cached = create_texture(formats[f], layouts[l], CACHED_TEXTURE_SIZE, data);
+            if(tex != NULL && cached != NULL){
+                for(scene = 0; scene < 3; scene++){
+                    run_cache_penalty(tex, cached, scene, frames, format_names[f], layout_names[l]);
+                }
+            }
+            if(tex != NULL){
+                er_delete_texture(tex);
+            }
+            if(cached != NULL){
+                er_delete_texture(cached);
+            }
+        }
+    }
+    free(data);
+    return 0;
+
+}
@@ -1,4 +1,16 @@
+#include <string.h>
 #include "pipeline.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Outcodes of the guard band */
+#define OUTSIDE_LEFT_BAND 512
+#define OUTSIDE_RIGHT_BAND 256
+#define OUTSIDE_BOTTOM_BAND 128
+#define OUTSIDE_TOP_BAND 64
+#define OUTSIDE_BAND (OUTSIDE_LEFT_BAND | OUTSIDE_RIGHT_BAND | OUTSIDE_BOTTOM_BAND | OUTSIDE_TOP_BAND)
+#define OUTSIDE_DEPTH (OUTSIDE_NEAR_PLANE | OUTSIDE_FAR_PLANE)
 
 #define OUTSIDE_LEFT_PLANE 32
 #define OUTSIDE_RIGHT_PLANE 16
@@ -13,6 +25,13 @@
 #define IS_OUTSIDE_TOP(vertex) ( vertex->position[VAR_Y] > vertex->position[VAR_W] )
 #define IS_OUTSIDE_NEAR(vertex) ( vertex->position[VAR_Z] > vertex->position[VAR_W] )
 #define IS_OUTSIDE_FAR(vertex) ( vertex->position[VAR_Z] < -vertex->position[VAR_W] )
+#define IS_OUTSIDE_LEFT_BAND(vertex) ( vertex->position[VAR_X] < -GUARD_BAND_SCALE * vertex->position[VAR_W] )
+#define IS_OUTSIDE_RIGHT_BAND(vertex) ( vertex->position[VAR_X] > GUARD_BAND_SCALE * vertex->position[VAR_W] )
+#define IS_OUTSIDE_BOTTOM_BAND(vertex) ( vertex->position[VAR_Y] < -GUARD_BAND_SCALE * vertex->position[VAR_W] )
+#define IS_OUTSIDE_TOP_BAND(vertex) ( vertex->position[VAR_Y] > GUARD_BAND_SCALE * vertex->position[VAR_W] )
+
+/* Margin in pixels added to the bounding box of triangles culled before clipping, for the rounding of window coordinates */
+#define CULL_MARGIN 0.0625f
 
 #define CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size) { \
 if(output_size < 3){ \
@@ -34,6 +53,12 @@ static float ndc_top[]    = { 0.0f,  1.0f,  0.0f, -1.0f};
 static float ndc_near[]   = { 0.0f,  0.0f,  1.0f, -1.0f};
 static float ndc_far[]    = { 0.0f,  0.0f, -1.0f, -1.0f};
 
+// Guard band planes
+static float band_left[]   = {-1.0f,  0.0f,  0.0f, -GUARD_BAND_SCALE};
+static float band_right[]  = { 1.0f,  0.0f,  0.0f, -GUARD_BAND_SCALE};
+static float band_bottom[] = { 0.0f, -1.0f,  0.0f, -GUARD_BAND_SCALE};
+static float band_top[]    = { 0.0f,  1.0f,  0.0f, -GUARD_BAND_SCALE};
+
 int calculate_outcode(er_VertexOutput *vertex){
 
     int outcode = 0;
@@ -56,34 +81,149 @@ int calculate_outcode(er_VertexOutput *vertex){
     if( IS_OUTSIDE_FAR(vertex) ){
         outcode = outcode | OUTSIDE_FAR_PLANE;
     }
+    if( IS_OUTSIDE_LEFT_BAND(vertex) ){
+        outcode = outcode | OUTSIDE_LEFT_BAND;
+    }
+    if( IS_OUTSIDE_RIGHT_BAND(vertex) ){
+        outcode = outcode | OUTSIDE_RIGHT_BAND;
+    }
+    if( IS_OUTSIDE_BOTTOM_BAND(vertex) ){
+        outcode = outcode | OUTSIDE_BOTTOM_BAND;
+    }
+    if( IS_OUTSIDE_TOP_BAND(vertex) ){
+        outcode = outcode | OUTSIDE_TOP_BAND;
+    }
     return outcode;
 
 }
 
-static unsigned int add_new_vertex(er_VertexOutput *vertex0, er_VertexOutput *vertex1, float t){
+/*
+ * Outcodes of a batch of vertices, positions stored as one array per component.
+*/
+#ifdef __SSE2__
+void calculate_outcodes(float position[4][ER_VERTEX_BATCH_SIZE], unsigned int *outcodes, unsigned int size){
+
+    unsigned int i;
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 band = _mm_set1_ps(GUARD_BAND_SCALE);
+
+    for(i = 0; i < size; i += 4){
+        __m128 x = _mm_load_ps(&position[VAR_X][i]);
+        __m128 y = _mm_load_ps(&position[VAR_Y][i]);
+        __m128 z = _mm_load_ps(&position[VAR_Z][i]);
+        __m128 w = _mm_load_ps(&position[VAR_W][i]);
+        __m128 neg_w = _mm_xor_ps(w, sign);
+        __m128 band_w = _mm_mul_ps(w, band);
+        __m128 neg_band_w = _mm_xor_ps(band_w, sign);
+        __m128i outcode = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(x, neg_w)), _mm_set1_epi32(OUTSIDE_LEFT_PLANE));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(x, w)), _mm_set1_epi32(OUTSIDE_RIGHT_PLANE)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(y, neg_w)), _mm_set1_epi32(OUTSIDE_BOTTOM_PLANE)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(y, w)), _mm_set1_epi32(OUTSIDE_TOP_PLANE)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(z, w)), _mm_set1_epi32(OUTSIDE_NEAR_PLANE)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(z, neg_w)), _mm_set1_epi32(OUTSIDE_FAR_PLANE)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(x, neg_band_w)), _mm_set1_epi32(OUTSIDE_LEFT_BAND)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(x, band_w)), _mm_set1_epi32(OUTSIDE_RIGHT_BAND)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(y, neg_band_w)), _mm_set1_epi32(OUTSIDE_BOTTOM_BAND)));
+        outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(y, band_w)), _mm_set1_epi32(OUTSIDE_TOP_BAND)));
+        _mm_storeu_si128((__m128i*)&outcodes[i], outcode);
+    }
+
+}
+#else
+void calculate_outcodes(float position[4][ER_VERTEX_BATCH_SIZE], unsigned int *outcodes, unsigned int size){
+
+    unsigned int i;
+
+    for(i = 0; i < size; i++){
+        float x = position[VAR_X][i], y = position[VAR_Y][i], z = position[VAR_Z][i], w = position[VAR_W][i];
+        float band_w = GUARD_BAND_SCALE * w;
+        outcodes[i] = (x < -w ? OUTSIDE_LEFT_PLANE: 0) | (x > w ? OUTSIDE_RIGHT_PLANE: 0) |
+                      (y < -w ? OUTSIDE_BOTTOM_PLANE: 0) | (y > w ? OUTSIDE_TOP_PLANE: 0) |
+                      (z > w ? OUTSIDE_NEAR_PLANE: 0) | (z < -w ? OUTSIDE_FAR_PLANE: 0) |
+                      (x < -band_w ? OUTSIDE_LEFT_BAND: 0) | (x > band_w ? OUTSIDE_RIGHT_BAND: 0) |
+                      (y < -band_w ? OUTSIDE_BOTTOM_BAND: 0) | (y > band_w ? OUTSIDE_TOP_BAND: 0);
+    }
+
+}
+#endif
+
+static unsigned int add_new_vertex(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, float t){
 
-    unsigned int new_index = output_buffer_size++;
-    output_buffer[new_index].processed = ER_FALSE;
-    er_VertexOutput *new_vertex = &(output_buffer[new_index].vertex);
+    unsigned int new_index = ctx->output_buffer_size++;
+    ctx->output_buffer[new_index].processed = ER_FALSE;
+    er_VertexOutput *new_vertex = &(ctx->output_buffer[new_index].vertex);
 
     new_vertex->position[VAR_X] = vertex0->position[VAR_X] + t * ( vertex1->position[VAR_X] - vertex0->position[VAR_X] );
     new_vertex->position[VAR_Y] = vertex0->position[VAR_Y] + t * ( vertex1->position[VAR_Y] - vertex0->position[VAR_Y] );
     new_vertex->position[VAR_Z] = vertex0->position[VAR_Z] + t * ( vertex1->position[VAR_Z] - vertex0->position[VAR_Z] );
     new_vertex->position[VAR_W] = vertex0->position[VAR_W] + t * ( vertex1->position[VAR_W] - vertex0->position[VAR_W] );
     new_vertex->point_size = vertex0->point_size + t * ( vertex1->point_size - vertex0->point_size );
+    /* Noperspective attributes are linear on screen, their parameter is the one of the projected edge */
+    float screen_t = t * vertex1->position[VAR_W] / new_vertex->position[VAR_W];
     int k;
-    for(k = 0; k < current_program->varying_attributes; k++){
-        new_vertex->attributes[k] = vertex0->attributes[k] + t * ( vertex1->attributes[k] - vertex0->attributes[k] );
+    for(k = 0; k < ctx->current_program->interpolated_attributes; k++){
+        float s = (ctx->current_program->interpolation[k] == ER_NOPERSPECTIVE) ? screen_t: t;
+        new_vertex->attributes[k] = vertex0->attributes[k] + s * ( vertex1->attributes[k] - vertex0->attributes[k] );
     }
+    /* Flat attributes are the same on both vertices */
+    for(; k < ctx->current_program->varying_attributes; k++){
+        new_vertex->attributes[k] = vertex0->attributes[k];
+    }
+
+    return new_index;
+
+}
 
+/*
+ * Flat attributes take the values of the provoking vertex, the first one of the primitive. Other vertices
+ * of the primitive with different values are replaced by copies, so any vertex of the clipped polygon
+ * holds them and interpolation between vertices keeps them constant.
+*/
+static unsigned int provoking_copy(er_Context *ctx, unsigned int provoking_index, unsigned int vertex_index){
+
+    er_Program *program = ctx->current_program;
+    er_VertexOutput *provoking = &(ctx->output_buffer[provoking_index].vertex);
+    int k;
+
+    for(k = 0; k < program->varying_attributes; k++){
+        if(program->interpolation[k] == ER_FLAT && ctx->output_buffer[vertex_index].vertex.attributes[k] != provoking->attributes[k]){
+            break;
+        }
+    }
+    if(k == program->varying_attributes){
+        return vertex_index;
+    }
+    unsigned int new_index = ctx->output_buffer_size++;
+    ctx->output_buffer[new_index] = ctx->output_buffer[vertex_index];
+    ctx->output_buffer[new_index].processed = ER_FALSE;
+    for(; k < program->varying_attributes; k++){
+        if(program->interpolation[k] == ER_FLAT){
+            ctx->output_buffer[new_index].vertex.attributes[k] = provoking->attributes[k];
+        }
+    }
     return new_index;
 
 }
 
-int clip_point(unsigned int input_index){
+/*
+ * The rasterizer takes the flat attributes that follow the interpolated ones from the first vertex, the
+ * provoking one of unclipped primitives. Copies are only needed on clipped primitives, and when flat
+ * attributes are interpolated between other ones.
+*/
+static er_Bool provoking_copies(er_Context *ctx, int clipped){
 
-    if( !output_buffer[input_index].outcode){
-        output_indices[output_indices_size++] = input_index;
+    er_Program *program = ctx->current_program;
+    if(program->flat_attributes == 0){
+        return ER_FALSE;
+    }
+    return (clipped || program->interpolated_flat_attributes > 0) ? ER_TRUE: ER_FALSE;
+
+}
+
+int clip_point(er_Context *ctx, unsigned int input_index){
+
+    if( !ctx->output_buffer[input_index].outcode){
+        ctx->output_indices[ctx->output_indices_size++] = input_index;
         return PRIMITIVE_VISIBLE;
     }
     return PRIMITIVE_NO_VISIBLE;
@@ -124,22 +264,26 @@ static int clip_LB(float denom, float num, float *tE, float *tL){
 }
 
 /* Liang-Barsky algorithm for clipping lines */
-int clip_line(unsigned int vertex0_index, unsigned int vertex1_index){
+int clip_line(er_Context *ctx, unsigned int vertex0_index, unsigned int vertex1_index){
 
     int outcode0, outcode1;
-    outcode0 = output_buffer[vertex0_index].outcode;
-    outcode1 = output_buffer[vertex1_index].outcode;
+    outcode0 = ctx->output_buffer[vertex0_index].outcode;
+    outcode1 = ctx->output_buffer[vertex1_index].outcode;
 
+    if(outcode0 & outcode1){
+        return PRIMITIVE_NO_VISIBLE;
+    }
+    if(provoking_copies(ctx, outcode0 | outcode1) == ER_TRUE){
+        vertex1_index = provoking_copy(ctx, vertex0_index, vertex1_index);
+    }
     if( !( outcode0 | outcode1)){
-        output_indices[output_indices_size++] = vertex0_index;
-        output_indices[output_indices_size++] = vertex1_index;
+        ctx->output_indices[ctx->output_indices_size++] = vertex0_index;
+        ctx->output_indices[ctx->output_indices_size++] = vertex1_index;
         return PRIMITIVE_TRIVIALLY_ACCEPTED;
-    }else if(outcode0 & outcode1){
-        return PRIMITIVE_NO_VISIBLE;
     }
 
-    er_VertexOutput* vertex0 = &(output_buffer[vertex0_index].vertex);
-    er_VertexOutput* vertex1 = &(output_buffer[vertex1_index].vertex);
+    er_VertexOutput* vertex0 = &(ctx->output_buffer[vertex0_index].vertex);
+    er_VertexOutput* vertex1 = &(ctx->output_buffer[vertex1_index].vertex);
 
     float delta_x, delta_y, delta_z, delta_w;
     delta_x = vertex1->position[VAR_X] - vertex0->position[VAR_X];
@@ -160,13 +304,13 @@ int clip_line(unsigned int vertex0_index, unsigned int vertex1_index){
                         if( clip_LB( delta_z + delta_w, - vertex0->position[VAR_Z] - vertex0->position[VAR_W] , &t_E, &t_L) == PRIMITIVE_VISIBLE ){ /* Intersect with far plane*/
 
                             if(t_L < 1.0f){
-                                end_index = add_new_vertex(vertex0, vertex1, t_L);
+                                end_index = add_new_vertex(ctx, vertex0, vertex1, t_L);
                             }
                             if(t_E > 0.0f){
-                                start_index = add_new_vertex(vertex0, vertex1, t_E);
+                                start_index = add_new_vertex(ctx, vertex0, vertex1, t_E);
                             }
-                            output_indices[output_indices_size++] = start_index;
-                            output_indices[output_indices_size++] = end_index;
+                            ctx->output_indices[ctx->output_indices_size++] = start_index;
+                            ctx->output_indices[ctx->output_indices_size++] = end_index;
 
                             return PRIMITIVE_VISIBLE;
 
@@ -181,40 +325,81 @@ int clip_line(unsigned int vertex0_index, unsigned int vertex1_index){
 
 }
 
+/*
+ * Start a new batch of triangles, vertices generated by clipping on previous batches are no longer valid.
+*/
+void reset_clip_cache(er_Context *ctx){
+
+    ctx->clip_cache_generation++;
+    if(ctx->clip_cache_generation == 0){
+        memset(ctx->clip_cache, 0, sizeof(ctx->clip_cache));
+        ctx->clip_cache_generation = 1;
+    }
+
+}
+
+/*
+ * Intersection of an edge with a plane. The vertex is shared by the triangles of the batch that
+ * have the same edge, and always interpolated from the lowest index so it doesn't depend on the
+ * direction the edge is traversed.
+*/
+static unsigned int clip_vertex(er_Context *ctx, unsigned int plane_id, unsigned int index0, float distance0, unsigned int index1, float distance1){
+
+    if(index0 > index1){
+        unsigned int index = index0;
+        float distance = distance0;
+        index0 = index1;
+        distance0 = distance1;
+        index1 = index;
+        distance1 = distance;
+    }
+
+    ClipCacheRegister *entry = &ctx->clip_cache[ (index0 * 31 + index1 * 7 + plane_id) & (CLIP_CACHE_SIZE - 1) ];
+    if(entry->generation == ctx->clip_cache_generation && entry->vertex0_index == index0 && entry->vertex1_index == index1 && entry->plane == plane_id){
+        return entry->output_index;
+    }
+
+    float t = distance0 / (distance0 - distance1);
+    unsigned int new_index = add_new_vertex(ctx, &(ctx->output_buffer[index0].vertex), &(ctx->output_buffer[index1].vertex), t);
+    entry->vertex0_index = index0;
+    entry->vertex1_index = index1;
+    entry->plane = plane_id;
+    entry->output_index = new_index;
+    entry->generation = ctx->clip_cache_generation;
+    return new_index;
+
+}
+
 /*
  * Clip a n-polygon against the given half space.
  */
-static void clip_polygon(float *plane, unsigned int *input, unsigned int *output, unsigned int input_size, unsigned int *output_size){
+static void clip_polygon(er_Context *ctx, float *plane, unsigned int plane_id, unsigned int *input, unsigned int *output, unsigned int input_size, unsigned int *output_size){
 
-    unsigned int i, polygon_size;
-    float distance0, distance1, t;
-    er_VertexOutput *vertex0;
-    er_VertexOutput *vertex1;
+    unsigned int i, polygon_size, index0, index1;
+    float distance0, distance1;
 
     polygon_size = 0;
-    vertex0 = &(output_buffer[ input[input_size - 1] ].vertex);
-    distance0 = dot_vec4(plane, vertex0->position);
+    index0 = input[input_size - 1];
+    distance0 = dot_vec4(plane, ctx->output_buffer[index0].vertex.position);
 
     for(i = 0; i < input_size; i++){
 
-        vertex1 = &(output_buffer[ input[i] ].vertex);
-        distance1 = dot_vec4(plane, vertex1->position);
+        index1 = input[i];
+        distance1 = dot_vec4(plane, ctx->output_buffer[index1].vertex.position);
 
         if(distance1 <= 0.0f){
             if(distance0 > 0.0f){
                 /* Add a new interpolated vertex as start point */
-                t = distance0 / (distance0 - distance1);
-                output[polygon_size++] = add_new_vertex(vertex0, vertex1, t);
+                output[polygon_size++] = clip_vertex(ctx, plane_id, index0, distance0, index1, distance1);
             }
             /* Add end point */
-            output[polygon_size++] = input[i];
+            output[polygon_size++] = index1;
         }else if(distance0 <= 0.0f){
             /* Add a new interpolated vertex as end point */
-            t = distance0 / (distance0 - distance1);
-            output[polygon_size++] = add_new_vertex(vertex0, vertex1, t);
+            output[polygon_size++] = clip_vertex(ctx, plane_id, index0, distance0, index1, distance1);
         }
 
-        vertex0 = vertex1;
+        index0 = index1;
         distance0 = distance1;
 
     }
@@ -223,30 +408,138 @@ static void clip_polygon(float *plane, unsigned int *input, unsigned int *output
 
 }
 
+/*
+ * Window coordinates of a vertex that is in front of the eye, as computed after clipping.
+*/
+static void window_position(er_Context *ctx, er_VertexOutput *vertex, float *x, float *y){
+
+    float inv_w = 1.0f;
+    if(homogeneous_division_enabled(ctx) == ER_TRUE){
+        inv_w = 1.0f / vertex->position[VAR_W];
+    }
+    *x = - 0.5f + ( ctx->window_width - 0.001f) * ( vertex->position[VAR_X] * inv_w + 1.0f ) / 2.0f;
+    *y = - 0.5f + ( ctx->window_height - 0.001f) * ( vertex->position[VAR_Y] * inv_w + 1.0f ) / 2.0f;
+
+}
+
+/*
+ * Margin of the bounding box of culled triangles. The fixed point and half-space rasterizers snap vertices
+ * to the nearest subpixel, which moves them by up to half a subpixel.
+*/
+static float cull_margin(er_Context *ctx){
+
+    if(ctx->fixed_point_enable == ER_TRUE || ctx->half_space_enable == ER_TRUE){
+        return max(CULL_MARGIN, 0.5f / (float)(1 << ctx->subpixel_bits));
+    }
+    return CULL_MARGIN;
+
+}
+
+/*
+ * Cull a triangle before clipping when its vertices are in front of the eye: back faces,
+ * and filled triangles with zero area or whose bounding box doesn't contain any pixel center.
+ * The bounding box is grown by cull_margin so that snapping of vertices can't hide a covered pixel.
+*/
+int cull_triangle(er_Context *ctx, unsigned int vertex0_index, unsigned int vertex1_index, unsigned int vertex2_index){
+
+    er_VertexOutput *vertex0 = &(ctx->output_buffer[vertex0_index].vertex);
+    er_VertexOutput *vertex1 = &(ctx->output_buffer[vertex1_index].vertex);
+    er_VertexOutput *vertex2 = &(ctx->output_buffer[vertex2_index].vertex);
+
+    if(homogeneous_division_enabled(ctx) == ER_TRUE &&
+       (vertex0->position[VAR_W] <= 0.0f || vertex1->position[VAR_W] <= 0.0f || vertex2->position[VAR_W] <= 0.0f)){
+        return PRIMITIVE_VISIBLE;
+    }
+
+    float x0, y0, x1, y1, x2, y2;
+    window_position(ctx, vertex0, &x0, &y0);
+    window_position(ctx, vertex1, &x1, &y1);
+    window_position(ctx, vertex2, &x2, &y2);
+
+    /* Back face culling, with the same face determination done after clipping */
+    float triangle_area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    if(ctx->cull_face_enable == ER_TRUE){
+        er_PolygonOrientationEnum orientation = (triangle_area >= 0.0f) ? ER_COUNTER_CLOCK_WISE: ER_CLOCK_WISE;
+        er_PolygonFaceEnum face = (orientation == ctx->front_face_orientation) ? ER_FRONT: ER_BACK;
+        if(face == ctx->cull_face){
+            add_statistic(&ctx->statistics.culled_back_faces, 1);
+            return PRIMITIVE_NO_VISIBLE;
+        }
+    }
+
+    /* Lines and points of wireframe modes are drawn even if the triangle doesn't cover any pixel */
+    if(ctx->front_face_mode != ER_FILL || ctx->back_face_mode != ER_FILL){
+        return PRIMITIVE_VISIBLE;
+    }
+    if(triangle_area == 0.0f){
+        add_statistic(&ctx->statistics.culled_degenerate_triangles, 1);
+        return PRIMITIVE_NO_VISIBLE;
+    }
+    float margin = cull_margin(ctx);
+    float min_x = min(x0, min(x1, x2)) - margin;
+    float max_x = max(x0, max(x1, x2)) + margin;
+    float min_y = min(y0, min(y1, y2)) - margin;
+    float max_y = max(y0, max(y1, y2)) + margin;
+    if(ceil(min_x) > floor(max_x) || ceil(min_y) > floor(max_y)){
+        add_statistic(&ctx->statistics.culled_empty_triangles, 1);
+        return PRIMITIVE_NO_VISIBLE;
+    }
+    return PRIMITIVE_VISIBLE;
+
+}
+
 /* 
  * Algorithm for clipping a triangle in homogeneous coordinates.
  * Based on Sutherland-Hodgman algorithm.
 */
-int clip_triangle(unsigned int vertex0_index, unsigned int vertex1_index, unsigned int vertex2_index){
+int clip_triangle(er_Context *ctx, unsigned int vertex0_index, unsigned int vertex1_index, unsigned int vertex2_index){
 
     int outcode0, outcode1, outcode2;
-    outcode0 = output_buffer[vertex0_index].outcode;
-    outcode1 = output_buffer[vertex1_index].outcode;
-    outcode2 = output_buffer[vertex2_index].outcode;
+    outcode0 = ctx->output_buffer[vertex0_index].outcode;
+    outcode1 = ctx->output_buffer[vertex1_index].outcode;
+    outcode2 = ctx->output_buffer[vertex2_index].outcode;
     int triangle_mask = outcode0 | outcode1 | outcode2;
 
+    if(outcode0 & outcode1 & outcode2){ /* Test if the three points are on the same half space */
+        return PRIMITIVE_NO_VISIBLE;
+    }
+    /* Edges and points of wireframe modes are drawn with their own first vertex */
+    er_Bool filled = (ctx->front_face_mode == ER_FILL && ctx->back_face_mode == ER_FILL) ? ER_TRUE: ER_FALSE;
+    int clipped = (ctx->guard_band_enable == ER_TRUE && filled == ER_TRUE) ? (triangle_mask & (OUTSIDE_BAND | OUTSIDE_DEPTH)): triangle_mask;
+    if(provoking_copies(ctx, clipped || filled == ER_FALSE) == ER_TRUE){
+        vertex1_index = provoking_copy(ctx, vertex0_index, vertex1_index);
+        vertex2_index = provoking_copy(ctx, vertex0_index, vertex2_index);
+    }
     if( !triangle_mask ){ /* Test if the three points are wholly inside */
-        output_indices[output_indices_size++] = vertex0_index;
-        output_indices[output_indices_size++] = vertex1_index;
-        output_indices[output_indices_size++] = vertex2_index;
+        ctx->output_indices[ctx->output_indices_size++] = vertex0_index;
+        ctx->output_indices[ctx->output_indices_size++] = vertex1_index;
+        ctx->output_indices[ctx->output_indices_size++] = vertex2_index;
+        ctx->output_polygon_sizes[ctx->output_polygons_size++] = 3;
         return PRIMITIVE_TRIVIALLY_ACCEPTED;
-    }else if(outcode0 & outcode1 & outcode2){ /* Test if the three points are on the same half space */
-        return PRIMITIVE_NO_VISIBLE;
+    }
+
+    /* 
+     * With the guard band, sides of the viewport are clipped by the rasterizer when drawing filled
+     * triangles. Only triangles crossing the band or the depth planes go through clipping,
+     * and their sides are clipped against the band.
+    */
+    float *left = ndc_left, *right = ndc_right, *bottom = ndc_bottom, *top = ndc_top;
+    if(ctx->guard_band_enable == ER_TRUE && ctx->front_face_mode == ER_FILL && ctx->back_face_mode == ER_FILL){
+        if( !(triangle_mask & (OUTSIDE_BAND | OUTSIDE_DEPTH)) ){
+            ctx->output_indices[ctx->output_indices_size++] = vertex0_index;
+            ctx->output_indices[ctx->output_indices_size++] = vertex1_index;
+            ctx->output_indices[ctx->output_indices_size++] = vertex2_index;
+            ctx->output_polygon_sizes[ctx->output_polygons_size++] = 3;
+            add_statistic(&ctx->statistics.guard_band_triangles, 1);
+            return PRIMITIVE_TRIVIALLY_ACCEPTED;
+        }
+        triangle_mask = ((triangle_mask & OUTSIDE_BAND) >> 4) | (triangle_mask & OUTSIDE_DEPTH);
+        left = band_left; right = band_right; bottom = band_bottom; top = band_top;
     }
 
     unsigned int input_size, output_size;
-    unsigned int buffer0[9];
-    unsigned int buffer1[9];
+    unsigned int buffer0[MAX_POLYGON_SIZE];
+    unsigned int buffer1[MAX_POLYGON_SIZE];
     unsigned int* input;
     unsigned int* output;
     unsigned int* aux;
@@ -262,47 +555,46 @@ int clip_triangle(unsigned int vertex0_index, unsigned int vertex1_index, unsign
 
     /* Clip against left plane */
     if(triangle_mask & OUTSIDE_LEFT_PLANE){
-        clip_polygon(ndc_left, input, output, input_size, &output_size);
+        clip_polygon(ctx, left, OUTSIDE_LEFT_PLANE, input, output, input_size, &output_size);
         CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size);
     }
 
     /* Clip against right plane */
     if(triangle_mask & OUTSIDE_RIGHT_PLANE){
-        clip_polygon(ndc_right, input, output, input_size, &output_size);
+        clip_polygon(ctx, right, OUTSIDE_RIGHT_PLANE, input, output, input_size, &output_size);
         CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size);
     }
 
     /* Clip against bottom plane */
     if(triangle_mask & OUTSIDE_BOTTOM_PLANE){
-        clip_polygon(ndc_bottom, input, output, input_size, &output_size);
+        clip_polygon(ctx, bottom, OUTSIDE_BOTTOM_PLANE, input, output, input_size, &output_size);
         CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size);
     }
 
     /* Clip against top plane */
     if(triangle_mask & OUTSIDE_TOP_PLANE){
-        clip_polygon(ndc_top, input, output, input_size, &output_size);
+        clip_polygon(ctx, top, OUTSIDE_TOP_PLANE, input, output, input_size, &output_size);
         CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size);
     }
 
     /* Clip against near plane */
     if(triangle_mask & OUTSIDE_NEAR_PLANE){
-        clip_polygon(ndc_near, input, output, input_size, &output_size);
+        clip_polygon(ctx, ndc_near, OUTSIDE_NEAR_PLANE, input, output, input_size, &output_size);
         CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size);
     }
 
     /* Clip against far plane */
     if(triangle_mask & OUTSIDE_FAR_PLANE){
-        clip_polygon(ndc_far, input, output, input_size, &output_size);
+        clip_polygon(ctx, ndc_far, OUTSIDE_FAR_PLANE, input, output, input_size, &output_size);
         CHECK_SIZE_AND_SWAP(input, output, aux, input_size, output_size);
     }
 
-    /* Triangulate the n-polygon, and writes indices of visible triangles */
+    /* Writes indices of the visible n-polygon, rasterized as a whole */
     unsigned int i = 0;
-    for(i = 1; i < input_size - 1; i++){
-        output_indices[output_indices_size++] = input[0];
-        output_indices[output_indices_size++] = input[i];
-        output_indices[output_indices_size++] = input[i+1];
+    for(i = 0; i < input_size; i++){
+        ctx->output_indices[ctx->output_indices_size++] = input[i];
     }
+    ctx->output_polygon_sizes[ctx->output_polygons_size++] = input_size;
 
     return PRIMITIVE_VISIBLE;
 
@@ -0,0 +1,311 @@
+#include <string.h>
+#include "pipeline.h"
+
+#define HIZ_EPSILON 1e-5f
+
+er_Framebuffer* er_create_framebuffer(unsigned int width, unsigned int height){
+
+    if(width == 0 || height == 0){
+        return NULL;
+    }
+    er_Framebuffer *new_framebuffer = (er_Framebuffer*)malloc(sizeof(er_Framebuffer));
+    if(new_framebuffer == NULL){
+        return NULL;
+    }
+    new_framebuffer->width = width;
+    new_framebuffer->height = height;
+    new_framebuffer->color = (unsigned int*)malloc(width * height * sizeof(unsigned int));
+    new_framebuffer->depth = (float*)malloc(width * height * sizeof(float));
+    new_framebuffer->hiz_width = (width + HIZ_TILE_SIZE - 1) >> HIZ_TILE_BITS;
+    new_framebuffer->hiz_height = (height + HIZ_TILE_SIZE - 1) >> HIZ_TILE_BITS;
+    unsigned int tiles = new_framebuffer->hiz_width * new_framebuffer->hiz_height;
+    new_framebuffer->hiz_min = (float*)malloc(tiles * sizeof(float));
+    new_framebuffer->hiz_max = (float*)malloc(tiles * sizeof(float));
+    /* Depth is undefined until the first clear */
+    new_framebuffer->hiz_writes = (unsigned char*)malloc(tiles * sizeof(unsigned char));
+    if(new_framebuffer->hiz_writes != NULL){
+        memset(new_framebuffer->hiz_writes, HIZ_INVALID, tiles);
+    }
+    new_framebuffer->hiz_direction = 0;
+    if(new_framebuffer->color == NULL || new_framebuffer->depth == NULL || new_framebuffer->hiz_min == NULL ||
+       new_framebuffer->hiz_max == NULL || new_framebuffer->hiz_writes == NULL){
+        er_delete_framebuffer(new_framebuffer);
+        return NULL;
+    }
+    return new_framebuffer;
+
+}
+
+er_StatusEnum er_delete_framebuffer(er_Framebuffer *fb){
+
+    er_Context *ctx = current_context;
+
+    if(fb == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(ctx != NULL && ctx->current_framebuffer == fb){
+        er_bind_framebuffer(NULL);
+    }
+    if(fb->color != NULL){
+        free(fb->color);
+    }
+    if(fb->depth != NULL){
+        free(fb->depth);
+    }
+    if(fb->hiz_min != NULL){
+        free(fb->hiz_min);
+    }
+    if(fb->hiz_max != NULL){
+        free(fb->hiz_max);
+    }
+    if(fb->hiz_writes != NULL){
+        free(fb->hiz_writes);
+    }
+    free(fb);
+    return ER_NO_ERROR;
+
+}
+
+er_StatusEnum er_bind_framebuffer(er_Framebuffer *fb){
+
+    er_Context *ctx = current_context;
+
+    /* Pending tiles are drawn on the previous framebuffer */
+    flush_tiles(ctx);
+    ctx->current_framebuffer = fb;
+    return ER_NO_ERROR;
+
+}
+
+er_StatusEnum er_framebuffer_ptr(er_Framebuffer *fb, er_AttachmentEnum attachment, void **data){
+
+    if(fb == NULL || data == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(attachment == ER_COLOR_ATTACHMENT){
+        *data = fb->color;
+    }else if(attachment == ER_DEPTH_ATTACHMENT){
+        /* The depth can be written through the pointer, Hi-Z data is recomputed */
+        memset(fb->hiz_writes, HIZ_INVALID, fb->hiz_width * fb->hiz_height);
+        *data = fb->depth;
+    }else{
+        return ER_INVALID_ARGUMENT;
+    }
+    return ER_NO_ERROR;
+
+}
+
+void er_clear_color(float r, float g, float b, float a){
+
+    er_Context *ctx = current_context;
+    ctx->clear_color[VAR_R] = r;
+    ctx->clear_color[VAR_G] = g;
+    ctx->clear_color[VAR_B] = b;
+    ctx->clear_color[VAR_A] = a;
+
+}
+
+void er_clear_depth(float depth){
+
+    er_Context *ctx = current_context;
+    ctx->clear_depth = depth;
+
+}
+
+er_StatusEnum er_clear(er_ClearBufferEnum buffer){
+
+    er_Context *ctx = current_context;
+    er_Framebuffer *fb = ctx->current_framebuffer;
+    unsigned int i, length;
+
+    if(fb == NULL){
+        return ER_INVALID_OPERATION;
+    }
+    if(buffer != ER_COLOR_BUFFER && buffer != ER_DEPTH_BUFFER && buffer != ER_COLOR_AND_DEPTH_BUFFER){
+        return ER_INVALID_ARGUMENT;
+    }
+    flush_tiles(ctx);
+    length = fb->width * fb->height;
+    if(buffer == ER_COLOR_BUFFER || buffer == ER_COLOR_AND_DEPTH_BUFFER){
+        unsigned int r = uiround(255.0f * clamp(ctx->clear_color[VAR_R], 0.0f, 1.0f));
+        unsigned int g = uiround(255.0f * clamp(ctx->clear_color[VAR_G], 0.0f, 1.0f));
+        unsigned int b = uiround(255.0f * clamp(ctx->clear_color[VAR_B], 0.0f, 1.0f));
+        unsigned int a = uiround(255.0f * clamp(ctx->clear_color[VAR_A], 0.0f, 1.0f));
+        unsigned int color = a << 24 | r << 16 | g << 8 | b;
+        for(i = 0; i < length; i++){
+            fb->color[i] = color;
+        }
+    }
+    if(buffer == ER_DEPTH_BUFFER || buffer == ER_COLOR_AND_DEPTH_BUFFER){
+        for(i = 0; i < length; i++){
+            fb->depth[i] = ctx->clear_depth;
+        }
+        length = fb->hiz_width * fb->hiz_height;
+        for(i = 0; i < length; i++){
+            fb->hiz_min[i] = ctx->clear_depth;
+            fb->hiz_max[i] = ctx->clear_depth;
+            fb->hiz_writes[i] = 0;
+        }
+    }
+    return ER_NO_ERROR;
+
+}
+
+er_StatusEnum er_depth_func(er_DepthFuncEnum func){
+
+    er_Context *ctx = current_context;
+
+    if(func < ER_NEVER || func > ER_ALWAYS){
+        return ER_INVALID_ARGUMENT;
+    }
+    ctx->depth_func = func;
+    return ER_NO_ERROR;
+
+}
+
+void er_depth_mask(er_Bool enable){
+
+    er_Context *ctx = current_context;
+    ctx->depth_mask = enable;
+
+}
+
+/*
+ * Direction in which depth writes move the stored depth: -1 when it decreases, 1 when it increases.
+*/
+static int hiz_direction(er_DepthFuncEnum func){
+
+    if(func == ER_LESS || func == ER_LEQUAL){
+        return -1;
+    }else if(func == ER_GREATER || func == ER_GEQUAL){
+        return 1;
+    }
+    return 0;
+
+}
+
+/*
+ * Update the attachments used by the rasterizer. Called at the start of every draw call,
+ * fails when the viewport doesn't fit on the bound framebuffer.
+*/
+er_StatusEnum update_framebuffer_state(er_Context *ctx){
+
+    er_Framebuffer *fb = ctx->current_framebuffer;
+
+    if(fb == NULL){
+        ctx->color_buffer = NULL;
+        ctx->depth_buffer = NULL;
+        ctx->hiz_writes = NULL;
+        ctx->buffer_width = 0;
+        ctx->buffer_height = 0;
+        return ER_NO_ERROR;
+    }
+    if(ctx->window_width > fb->width || ctx->window_height > fb->height){
+        ctx->color_buffer = NULL;
+        ctx->depth_buffer = NULL;
+        return ER_INVALID_OPERATION;
+    }
+    ctx->color_buffer = fb->color;
+    ctx->depth_buffer = fb->depth;
+    ctx->buffer_width = fb->width;
+    ctx->buffer_height = fb->height;
+    ctx->hiz_writes = fb->hiz_writes;
+    ctx->hiz_width = fb->hiz_width;
+    /* Stale tile ranges are only conservative for depth functions on the same direction */
+    int direction = hiz_direction(ctx->depth_func);
+    if(ctx->depth_test_enable == ER_TRUE && ctx->depth_mask == ER_TRUE && direction != fb->hiz_direction){
+        memset(fb->hiz_writes, HIZ_INVALID, fb->hiz_width * fb->hiz_height);
+        fb->hiz_direction = direction;
+    }
+    return ER_NO_ERROR;
+
+}
+
+/*
+ * Recompute the depth range of a tile after fragments have been written on it.
+*/
+static void update_hiz_tile(er_Framebuffer *fb, int tile_x, int tile_y){
+
+    int x, y;
+    int start_x = tile_x << HIZ_TILE_BITS;
+    int start_y = tile_y << HIZ_TILE_BITS;
+    int end_x = min(start_x + HIZ_TILE_SIZE, (int)fb->width);
+    int end_y = min(start_y + HIZ_TILE_SIZE, (int)fb->height);
+    float min_depth = fb->depth[start_y * fb->width + start_x];
+    float max_depth = min_depth;
+    for(y = start_y; y < end_y; y++){
+        float *row = &fb->depth[y * fb->width];
+        for(x = start_x; x < end_x; x++){
+            min_depth = min(min_depth, row[x]);
+            max_depth = max(max_depth, row[x]);
+        }
+    }
+    unsigned int tile = tile_y * fb->hiz_width + tile_x;
+    fb->hiz_min[tile] = min_depth;
+    fb->hiz_max[tile] = max_depth;
+    fb->hiz_writes[tile] = 0;
+
+}
+
+static er_Bool hiz_test(er_DepthFuncEnum func, float tile_min, float tile_max, float min_z, float max_z){
+
+    switch(func){
+        case ER_LESS:
+            return min_z >= tile_max ? ER_TRUE: ER_FALSE;
+        case ER_LEQUAL:
+            return min_z > tile_max ? ER_TRUE: ER_FALSE;
+        case ER_GREATER:
+            return max_z <= tile_min ? ER_TRUE: ER_FALSE;
+        case ER_GEQUAL:
+            return max_z < tile_min ? ER_TRUE: ER_FALSE;
+        case ER_NEVER:
+            return ER_TRUE;
+        default:
+            return ER_FALSE;
+    }
+
+}
+
+/*
+ * True when no fragment with depth on [min_z, max_z] can pass the depth test on the tile.
+*/
+er_Bool hiz_reject_tile(er_Context *ctx, int tile_x, int tile_y, float min_z, float max_z){
+
+    er_Framebuffer *fb = ctx->current_framebuffer;
+    unsigned int tile = tile_y * fb->hiz_width + tile_x;
+
+    if(fb->hiz_writes[tile] == HIZ_INVALID){
+        update_hiz_tile(fb, tile_x, tile_y);
+    }
+    /* Margin for the rounding of the depth interpolated by the rasterizer */
+    min_z -= HIZ_EPSILON;
+    max_z += HIZ_EPSILON;
+    if(hiz_test(ctx->depth_func, fb->hiz_min[tile], fb->hiz_max[tile], min_z, max_z) == ER_TRUE){
+        return ER_TRUE;
+    }
+    /* Retry with the exact range when the tile has been written enough */
+    if(fb->hiz_writes[tile] >= HIZ_UPDATE_WRITES){
+        update_hiz_tile(fb, tile_x, tile_y);
+        return hiz_test(ctx->depth_func, fb->hiz_min[tile], fb->hiz_max[tile], min_z, max_z);
+    }
+    return ER_FALSE;
+
+}
+
+/*
+ * True when every tile touched by the pixels on [start_x, end_x] x [start_y, end_y] rejects the depth range.
+*/
+er_Bool hiz_reject_area(er_Context *ctx, int start_x, int end_x, int start_y, int end_y, float min_z, float max_z){
+
+    int tile_x, tile_y;
+
+    for(tile_y = start_y >> HIZ_TILE_BITS; tile_y <= end_y >> HIZ_TILE_BITS; tile_y++){
+        for(tile_x = start_x >> HIZ_TILE_BITS; tile_x <= end_x >> HIZ_TILE_BITS; tile_x++){
+            if(hiz_reject_tile(ctx, tile_x, tile_y, min_z, max_z) == ER_FALSE){
+                return ER_FALSE;
+            }
+        }
+    }
+    return ER_TRUE;
+
+}
@@ -0,0 +1,671 @@
+#include "pipeline.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Half-space rasterization of convex polygons. Vertices are snapped to the grid of 2^subpixel_bits
+ * positions per pixel of the fixed point rasterizer, and every edge gives an exact integer function
+ * of the pixel centers with the same bottom-left fill convention, so both rasterizers cover the
+ * same pixels. Depth and attributes come from the same plane equations as on the scanline
+ * rasterizers (see PlaneRow), evaluated with the same operations, so the fragments are the same too.
+ * Edge functions are evaluated on the corners of 8x8 blocks to reject or accept them as a whole,
+ * then on 2x2 quads of pixels. Coverage, attributes, the early depth test and the span stores work
+ * on the four lanes of a quad at once, with SSE2 when available.
+*/
+
+#define BLOCK_SIZE 8
+
+typedef struct EdgeFunction{
+    int value;      /* Value on the origin of the first block */
+    int step_x;     /* Increment for one pixel in x */
+    int step_y;     /* Increment for one pixel in y */
+    float inverse_step_x;
+} EdgeFunction;
+
+/* Lanes of a quad: 0 = (x, y), 1 = (x + 1, y), 2 = (x, y + 1), 3 = (x + 1, y + 1) */
+#ifdef __SSE2__
+
+typedef __m128i QuadEdge;
+typedef __m128 QuadValue;
+
+static inline QuadEdge quad_edge(int value, int step_x, int step_y){
+    return _mm_add_epi32( _mm_set1_epi32(value), _mm_set_epi32(step_x + step_y, step_y, step_x, 0) );
+}
+
+static inline QuadEdge quad_edge_add(QuadEdge edge, int step){
+    return _mm_add_epi32(edge, _mm_set1_epi32(step));
+}
+
+/* Lanes inside of every edge */
+static inline int quad_coverage(QuadEdge *edge, unsigned int size){
+    unsigned int i;
+    __m128i outside = edge[0];
+    for(i = 1; i < size; i++){
+        outside = _mm_or_si128(outside, edge[i]);
+    }
+    return ~_mm_movemask_ps( _mm_castsi128_ps(outside) ) & 0xF;
+}
+
+static inline QuadValue quad_broadcast(float value){
+    return _mm_set1_ps(value);
+}
+
+/* Distances of the lanes of the quad (x, y) to a reference point */
+static inline QuadValue quad_offset_x(int x, float ref_x){
+    return _mm_sub_ps( _mm_cvtepi32_ps(_mm_set_epi32(x + 1, x, x + 1, x)), _mm_set1_ps(ref_x) );
+}
+
+static inline QuadValue quad_offset_y(int y, float ref_y){
+    return _mm_sub_ps( _mm_cvtepi32_ps(_mm_set_epi32(y + 1, y + 1, y, y)), _mm_set1_ps(ref_y) );
+}
+
+/* value + ddy * dy on the rows of a quad, then row + ddx * dx on its lanes, the order of init_plane_row and the scanline loops */
+static inline QuadValue quad_row(QuadValue value, QuadValue ddy, QuadValue dy){
+    return _mm_add_ps(value, _mm_mul_ps(ddy, dy));
+}
+
+static inline QuadValue quad_evaluate(QuadValue row, QuadValue ddx, QuadValue dx){
+    return _mm_add_ps(row, _mm_mul_ps(ddx, dx));
+}
+
+/* Aligned store of the four lanes */
+static inline void quad_store(float *out, QuadValue value){
+    _mm_store_ps(out, value);
+}
+
+static inline void quad_store_coordinates(int *out_x, int *out_y, int x, int y){
+    _mm_store_si128( (__m128i*)out_x, _mm_set_epi32(x + 1, x, x + 1, x) );
+    _mm_store_si128( (__m128i*)out_y, _mm_set_epi32(y + 1, y + 1, y, y) );
+}
+
+/*
+ * Early depth test of the lanes on mask, with one comparison for the whole quad. Lanes past the
+ * last column or row of the buffer read the stored depth of the quad's first pixel, their result
+ * is masked out.
+*/
+static inline int quad_depth_test(er_Context *ctx, int x, int y, QuadValue z, int mask){
+
+    if(ctx->depth_test_enable == ER_FALSE || ctx->depth_buffer == NULL){
+        return mask;
+    }
+    float *depth = &ctx->depth_buffer[y * ctx->buffer_width + x];
+    int right = (x + 1 < (int)ctx->buffer_width) ? 1: 0;
+    int top = (y + 1 < (int)ctx->buffer_height) ? ctx->buffer_width: 0;
+    __m128 stored = _mm_set_ps(depth[top + right], depth[top], depth[right], depth[0]);
+    __m128 pass;
+    switch(ctx->depth_func){
+        case ER_LESS:
+            pass = _mm_cmplt_ps(z, stored);
+            break;
+        case ER_LEQUAL:
+            pass = _mm_cmple_ps(z, stored);
+            break;
+        case ER_GREATER:
+            pass = _mm_cmpgt_ps(z, stored);
+            break;
+        case ER_GEQUAL:
+            pass = _mm_cmpge_ps(z, stored);
+            break;
+        case ER_EQUAL:
+            pass = _mm_cmpeq_ps(z, stored);
+            break;
+        case ER_NOTEQUAL:
+            pass = _mm_cmpneq_ps(z, stored);
+            break;
+        case ER_ALWAYS:
+            return mask;
+        default:
+            return 0;
+    }
+    return mask & _mm_movemask_ps(pass);
+
+}
+
+#else
+
+typedef struct QuadEdge{
+    int lane[4];
+} QuadEdge;
+
+typedef struct QuadValue{
+    float lane[4];
+} QuadValue;
+
+static inline QuadEdge quad_edge(int value, int step_x, int step_y){
+    QuadEdge edge = {{value, value + step_x, value + step_y, value + step_x + step_y}};
+    return edge;
+}
+
+static inline QuadEdge quad_edge_add(QuadEdge edge, int step){
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        edge.lane[lane] += step;
+    }
+    return edge;
+}
+
+static inline int quad_coverage(QuadEdge *edge, unsigned int size){
+    unsigned int i;
+    int lane, mask = 0;
+    for(lane = 0; lane < 4; lane++){
+        int outside = edge[0].lane[lane];
+        for(i = 1; i < size; i++){
+            outside |= edge[i].lane[lane];
+        }
+        if(outside >= 0){
+            mask |= 1 << lane;
+        }
+    }
+    return mask;
+}
+
+static inline QuadValue quad_broadcast(float value){
+    QuadValue quad = {{value, value, value, value}};
+    return quad;
+}
+
+static inline QuadValue quad_offset_x(int x, float ref_x){
+    QuadValue quad;
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        quad.lane[lane] = (x + (lane & 1)) - ref_x;
+    }
+    return quad;
+}
+
+static inline QuadValue quad_offset_y(int y, float ref_y){
+    QuadValue quad;
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        quad.lane[lane] = (y + (lane >> 1)) - ref_y;
+    }
+    return quad;
+}
+
+static inline QuadValue quad_row(QuadValue value, QuadValue ddy, QuadValue dy){
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        value.lane[lane] += ddy.lane[lane] * dy.lane[lane];
+    }
+    return value;
+}
+
+static inline QuadValue quad_evaluate(QuadValue row, QuadValue ddx, QuadValue dx){
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        row.lane[lane] += ddx.lane[lane] * dx.lane[lane];
+    }
+    return row;
+}
+
+static inline void quad_store(float *out, QuadValue value){
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        out[lane] = value.lane[lane];
+    }
+}
+
+static inline void quad_store_coordinates(int *out_x, int *out_y, int x, int y){
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        out_x[lane] = x + (lane & 1);
+        out_y[lane] = y + (lane >> 1);
+    }
+}
+
+static inline int quad_depth_test(er_Context *ctx, int x, int y, QuadValue z, int mask){
+    int lane;
+    for(lane = 0; lane < 4; lane++){
+        if( (mask & (1 << lane)) && !depth_test(ctx, y + (lane >> 1), x + (lane & 1), z.lane[lane]) ){
+            mask &= ~(1 << lane);
+        }
+    }
+    return mask;
+}
+
+#endif
+
+/*
+ * State of the polygon being drawn. Planes 0 and 1 are z and w, the varying attributes follow,
+ * each one with its value on the first vertex and its gradients broadcast to the lanes of a quad.
+ * Rows hold the planes on the two rows of the current quads, at the column of the first vertex,
+ * stored by lanes too for the fragment shaders.
+*/
+typedef struct HalfSpace{
+    QuadValue plane[ATTRIBUTES_SIZE + 2];
+    QuadValue plane_dx[ATTRIBUTES_SIZE + 2];
+    QuadValue plane_dy[ATTRIBUTES_SIZE + 2];
+    QuadValue row[ATTRIBUTES_SIZE + 2];
+    float row_lanes[ATTRIBUTES_SIZE + 2][4] ER_ALIGNED;
+    float ref_x, ref_y;
+    EdgeFunction edge[MAX_POLYGON_SIZE];
+    int origin_x, origin_y;
+    int start_x, end_x, start_y, end_y;
+    er_Bool span_shader;
+    er_FragInput input;
+    er_FragSpan span;
+} HalfSpace;
+
+static int64_t floor_div(int64_t n, int64_t d){
+
+    int64_t q = n / d;
+    if(n % d < 0){
+        q--;
+    }
+    return q;
+
+}
+
+/*
+ * Edge function of the directed edge (x0, y0) -> (x1, y1) on the grid, positive on its left side,
+ * the inside of a CCW polygon. On pixel centers it is a * x + b * y - threshold, where the threshold
+ * rounds the line so that pixels exactly on it are only inside for left and bottom edges.
+*/
+static void init_edge_function(EdgeFunction *edge, int64_t x0, int64_t y0, int64_t x1, int64_t y1, unsigned int bits, int origin_x, int origin_y){
+
+    int64_t a = y0 - y1;
+    int64_t b = x1 - x0;
+    int64_t c = a * x0 + b * y0;
+    int64_t scale = (int64_t)1 << bits;
+    int64_t threshold;
+
+    if(a == 0 && b == 0){
+        /* Repeated vertex, every pixel is inside */
+        edge->value = 0;
+        edge->step_x = 0;
+        edge->step_y = 0;
+        edge->inverse_step_x = 0.0f;
+        return;
+    }
+    if(y1 < y0 || (y1 == y0 && x1 > x0)){
+        threshold = -floor_div(-c, scale);
+    }else{
+        threshold = floor_div(c, scale) + 1;
+    }
+    edge->value = (int)(a * origin_x + b * origin_y - threshold);
+    edge->step_x = (int)a;
+    edge->step_y = (int)b;
+    edge->inverse_step_x = (a != 0) ? 1.0f / (float)a: 0.0f;
+
+}
+
+/*
+ * Edge functions stay on 32 bits when the area where vertices can be, the window or the guard band
+ * around it with a margin of blocks, fits: |value| <= 2 * width * height * 2^subpixel_bits. The
+ * choice only depends on the context, so every primitive of a draw call uses the same rasterizer.
+*/
+er_Bool half_space_fits(er_Context *ctx){
+
+    int64_t width = ctx->window_width;
+    int64_t height = ctx->window_height;
+    if(ctx->guard_band_enable == ER_TRUE){
+        width = (int64_t)ceil(GUARD_BAND_SCALE * width);
+        height = (int64_t)ceil(GUARD_BAND_SCALE * height);
+    }
+    width += 2 * BLOCK_SIZE;
+    height += 2 * BLOCK_SIZE;
+    return ( ((2 * width * height) << ctx->subpixel_bits) < INT32_MAX ) ? ER_TRUE: ER_FALSE;
+
+}
+
+/*
+ * Minimum and maximum of an edge function over the pixel centers of a block.
+*/
+static void block_bounds(EdgeFunction *edge, int e, int *min_e, int *max_e){
+
+    int dx = edge->step_x * (BLOCK_SIZE - 1);
+    int dy = edge->step_y * (BLOCK_SIZE - 1);
+    *min_e = e + min(dx, 0) + min(dy, 0);
+    *max_e = e + max(dx, 0) + max(dy, 0);
+
+}
+
+/*
+ * Shade one lane of the quad (x, y) when it is on mask, with the interpolators evaluated like on the scanline loops.
+*/
+RASTER_INLINE void shade_lane(er_Context *ctx, HalfSpace *hs, int x, int y, float z, int lane, int mask, int varyings){
+
+    er_FragInput *input = &hs->input;
+    float offset_x;
+    int k;
+
+    if((mask & (1 << lane)) == 0){
+        return;
+    }
+    x += lane & 1;
+    y += lane >> 1;
+    offset_x = x - hs->ref_x;
+    input->frag_coord[VAR_X] = x;
+    input->frag_coord[VAR_Y] = y;
+    input->frag_coord[VAR_Z] = z;
+    input->frag_coord[VAR_W] = hs->row_lanes[1][lane] + input->dw_dx * offset_x;
+    for(k = 0; k < varyings; k++){
+        input->attributes[k] = hs->row_lanes[k + 2][lane] + input->ddx[k] * offset_x;
+    }
+    shade_fragment(ctx, y, x, input);
+
+}
+
+/*
+ * Depth test and shading of the covered lanes of a quad. Span shaders get the quads packed four
+ * by four on a span, flushed when it is full and at the end of the polygon.
+*/
+RASTER_INLINE void shade_quad(er_Context *ctx, HalfSpace *hs, int x, int y, int mask, int varyings){
+
+    QuadValue dx = quad_offset_x(x, hs->ref_x);
+    QuadValue z = quad_evaluate(hs->row[0], hs->plane_dx[0], dx);
+    int k;
+
+    mask = quad_depth_test(ctx, x, y, z, mask);
+    if(mask == 0){
+        return;
+    }
+    if(hs->span_shader == ER_TRUE){
+        er_FragSpan *span = &hs->span;
+        /* Spans gather the quads of one aligned 8x2 block, so they group the same fragments whatever region is drawn */
+        if(span->size > 0 && ((span->x[0] ^ x) & ~(BLOCK_SIZE - 1) || span->y[0] != y)){
+            shade_span(ctx, span, varyings);
+            span->size = 0;
+            span->mask = 0;
+        }
+        int slot = span->size;
+        quad_store_coordinates(&span->x[slot], &span->y[slot], x, y);
+        quad_store(&span->z[slot], z);
+        quad_store(&span->w[slot], quad_evaluate(hs->row[1], hs->plane_dx[1], dx));
+        for(k = 0; k < varyings; k++){
+            quad_store(&span->attributes[k][slot], quad_evaluate(hs->row[k + 2], hs->plane_dx[k + 2], dx));
+        }
+        span->mask |= mask << slot;
+        span->size = slot + 4;
+        if(span->size == ER_SPAN_SIZE){
+            shade_span(ctx, span, varyings);
+            span->size = 0;
+            span->mask = 0;
+        }
+        return;
+    }
+
+    /* Fragment shaders get the interpolators of each covered lane */
+    float lane_z[4] ER_ALIGNED;
+    quad_store(lane_z, z);
+    shade_lane(ctx, hs, x, y, lane_z[0], 0, mask, varyings);
+    shade_lane(ctx, hs, x, y, lane_z[1], 1, mask, varyings);
+    shade_lane(ctx, hs, x, y, lane_z[2], 2, mask, varyings);
+    shade_lane(ctx, hs, x, y, lane_z[3], 3, mask, varyings);
+
+}
+
+/*
+ * Quads with a pixel on the rectangle [first_x, last_x] x [first_y, last_y], masked by the edges
+ * unless the whole rectangle is inside, and by the bounding box. Each row of quads only walks the
+ * columns where every edge can be positive on one of its two rows, estimated with floating point
+ * and a margin of one pixel, the coverage test stays exact.
+*/
+RASTER_INLINE void shade_quads(er_Context *ctx, HalfSpace *hs, int first_x, int last_x, int first_y, int last_y, er_Bool inside, unsigned int size, int varyings){
+
+    QuadEdge edge[MAX_POLYGON_SIZE];
+    QuadValue dy;
+    int row[MAX_POLYGON_SIZE];
+    int quad_x, quad_y, row_first, row_last, mask, row_mask, k;
+    unsigned int i;
+
+    first_x &= ~1;
+    first_y &= ~1;
+    for(quad_y = first_y; quad_y <= last_y; quad_y += 2){
+
+        /* Rows of the quad out of the bounding box */
+        row_mask = 0xF;
+        if(quad_y < hs->start_y){
+            row_mask &= 0xC;
+        }
+        if(quad_y + 1 > hs->end_y){
+            row_mask &= 0x3;
+        }
+        for(i = 0; i < size; i++){
+            row[i] = hs->edge[i].value + (first_x - hs->origin_x) * hs->edge[i].step_x + (quad_y - hs->origin_y) * hs->edge[i].step_y;
+        }
+
+        row_first = first_x;
+        row_last = last_x;
+        if(inside == ER_FALSE){
+            float low = 0.0f, high = (float)(last_x - first_x);
+            for(i = 0; i < size; i++){
+                /* Largest value of the edge on the two rows, on the first column */
+                float value = (float)(row[i] + max(hs->edge[i].step_y, 0));
+                if(hs->edge[i].step_x > 0){
+                    low = max(low, -value * hs->edge[i].inverse_step_x);
+                }else if(hs->edge[i].step_x < 0){
+                    high = min(high, -value * hs->edge[i].inverse_step_x);
+                }else if(value < 0.0f){
+                    high = -2.0f;
+                }
+            }
+            if(low > high + 1.0f){
+                continue;
+            }
+            row_first = first_x + (max((int)low - 1, 0) & ~1);
+            row_last = min(first_x + (int)high + 1, last_x);
+        }
+        for(i = 0; i < size; i++){
+            edge[i] = quad_edge(row[i] + (row_first - first_x) * hs->edge[i].step_x, hs->edge[i].step_x, hs->edge[i].step_y);
+        }
+        dy = quad_offset_y(quad_y, hs->ref_y);
+        for(k = 0; k < varyings + 2; k++){
+            hs->row[k] = quad_row(hs->plane[k], hs->plane_dy[k], dy);
+        }
+        if(hs->span_shader == ER_FALSE){
+            for(k = 1; k < varyings + 2; k++){
+                quad_store(hs->row_lanes[k], hs->row[k]);
+            }
+        }
+
+        for(quad_x = row_first; quad_x <= row_last; quad_x += 2){
+
+            mask = row_mask;
+            if(inside == ER_FALSE){
+                mask &= quad_coverage(edge, size);
+                for(i = 0; i < size; i++){
+                    edge[i] = quad_edge_add(edge[i], 2 * hs->edge[i].step_x);
+                }
+            }
+            /* Pixels out of the bounding box */
+            if(quad_x < hs->start_x){
+                mask &= 0xA;
+            }
+            if(quad_x + 1 > hs->end_x){
+                mask &= 0x5;
+            }
+            if(mask){
+                shade_quad(ctx, hs, quad_x, quad_y, mask, varyings);
+            }
+
+        }
+    }
+
+}
+
+/*
+ * Half-space rasterization of a convex polygon of size vertices given on CCW order, on the region [min_x, max_x] x [min_y, max_y].
+ * Polygons whose bounding box is smaller than a Hi-Z area are walked by quads, larger ones by blocks.
+*/
+RASTER_INLINE void draw_polygon_half_space_variant(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y, int varyings){
+
+    HalfSpace hs;
+    int64_t x[MAX_POLYGON_SIZE], y[MAX_POLYGON_SIZE];
+    int64_t left_x, right_x, bottom_y, top_y, area;
+    int64_t scale = (int64_t)1 << ctx->subpixel_bits;
+    unsigned int i, j, edges;
+    int k;
+
+    /* Snap vertices to the subpixel grid */
+    for(i = 0; i < size; i++){
+        x[i] = snap(vertices[i]->position[VAR_X], ctx->subpixel_bits);
+        y[i] = snap(vertices[i]->position[VAR_Y], ctx->subpixel_bits);
+    }
+
+    /* Vertices of a clipped polygon made collinear or reflex by snapping would cut its edge functions,
+       they are dropped so the edges bound the convex hull of the snapped vertices */
+    edges = size;
+    i = 0;
+    while(edges > 3 && i < edges){
+        unsigned int previous = (i > 0) ? i - 1: edges - 1;
+        unsigned int next = (i + 1 < edges) ? i + 1: 0;
+        if((x[i] - x[previous]) * (y[next] - y[i]) - (y[i] - y[previous]) * (x[next] - x[i]) <= 0){
+            for(j = i; j + 1 < edges; j++){
+                x[j] = x[j + 1];
+                y[j] = y[j + 1];
+            }
+            edges--;
+            i = (i > 0) ? i - 1: 0;
+        }else{
+            i++;
+        }
+    }
+
+    /* Degenerate polygon after snapping, twice its signed area */
+    area = 0;
+    for(i = 0; i < edges; i++){
+        unsigned int next = (i + 1 < edges) ? i + 1: 0;
+        area += x[i] * y[next] - x[next] * y[i];
+    }
+    if(area <= 0){
+        return;
+    }
+
+    /* Bounding box, in pixels, clipped against the region being drawn */
+    left_x = right_x = x[0];
+    bottom_y = top_y = y[0];
+    for(i = 1; i < edges; i++){
+        left_x = min(left_x, x[i]);
+        right_x = max(right_x, x[i]);
+        bottom_y = min(bottom_y, y[i]);
+        top_y = max(top_y, y[i]);
+    }
+    hs.start_x = max((int)-floor_div(-left_x, scale), min_x);
+    hs.end_x = min((int)floor_div(right_x, scale), max_x);
+    hs.start_y = max((int)-floor_div(-bottom_y, scale), min_y);
+    hs.end_y = min((int)floor_div(top_y, scale), max_y);
+    if(hs.start_x > hs.end_x || hs.start_y > hs.end_y){
+        return;
+    }
+
+    /* Edge functions on the origin of the first block */
+    hs.origin_x = hs.start_x & ~(BLOCK_SIZE - 1);
+    hs.origin_y = hs.start_y & ~(BLOCK_SIZE - 1);
+    for(i = 0; i < edges; i++){
+        unsigned int next = (i + 1 < edges) ? i + 1: 0;
+        init_edge_function(&hs.edge[i], x[i], y[i], x[next], y[next], ctx->subpixel_bits, hs.origin_x, hs.origin_y);
+    }
+
+    /* Gradients of the primitive, planes are evaluated relative to the first vertex */
+    hs.input = *setup;
+    hs.span_shader = (ctx->current_program->fragment_span_shader != NULL) ? ER_TRUE: ER_FALSE;
+    if(hs.span_shader == ER_TRUE){
+        init_span(ctx, &hs.span, &hs.input);
+        hs.span.size = 0;
+        hs.span.mask = 0;
+    }
+    hs.ref_x = vertices[0]->position[VAR_X];
+    hs.ref_y = vertices[0]->position[VAR_Y];
+    hs.plane[0] = quad_broadcast(vertices[0]->position[VAR_Z]);
+    hs.plane_dx[0] = quad_broadcast(hs.input.dz_dx);
+    hs.plane_dy[0] = quad_broadcast(hs.input.dz_dy);
+    hs.plane[1] = quad_broadcast(vertices[0]->position[VAR_W]);
+    hs.plane_dx[1] = quad_broadcast(hs.input.dw_dx);
+    hs.plane_dy[1] = quad_broadcast(hs.input.dw_dy);
+    for(k = 0; k < varyings; k++){
+        hs.plane[k + 2] = quad_broadcast(vertices[0]->attributes[k]);
+        hs.plane_dx[k + 2] = quad_broadcast(hs.input.ddx[k]);
+        hs.plane_dy[k + 2] = quad_broadcast(hs.input.ddy[k]);
+    }
+
+    /* Polygons on a single tile have been tested whole by the caller */
+    if(hiz_active(ctx) == ER_FALSE || (hs.origin_x + BLOCK_SIZE > hs.end_x && hs.origin_y + BLOCK_SIZE > hs.end_y)){
+        shade_quads(ctx, &hs, hs.start_x, hs.end_x, hs.start_y, hs.end_y, ER_FALSE, edges, varyings);
+    }else{
+        /* Depth range of the polygon, bounds the depth extrapolated on the blocks */
+        float min_z, max_z;
+        min_z = max_z = vertices[0]->position[VAR_Z];
+        for(i = 1; i < size; i++){
+            min_z = min(min_z, vertices[i]->position[VAR_Z]);
+            max_z = max(max_z, vertices[i]->position[VAR_Z]);
+        }
+        unsigned long rejected_blocks = 0;
+        int block_x, block_y, min_e, max_e;
+        int e[MAX_POLYGON_SIZE];
+
+        for(block_y = hs.origin_y; block_y <= hs.end_y; block_y += BLOCK_SIZE){
+            for(block_x = hs.origin_x; block_x <= hs.end_x; block_x += BLOCK_SIZE){
+
+                /* Trivial reject, the whole block is outside of an edge, and trivial accept */
+                er_Bool inside = ER_TRUE, outside = ER_FALSE;
+                for(i = 0; i < edges; i++){
+                    e[i] = hs.edge[i].value + (block_x - hs.origin_x) * hs.edge[i].step_x + (block_y - hs.origin_y) * hs.edge[i].step_y;
+                    block_bounds(&hs.edge[i], e[i], &min_e, &max_e);
+                    if(max_e < 0){
+                        outside = ER_TRUE;
+                    }
+                    if(min_e < 0){
+                        inside = ER_FALSE;
+                    }
+                }
+                if(outside == ER_TRUE){
+                    continue;
+                }
+                /* Hi-Z, nearest depth of the polygon on the block behind the depth stored on the tile */
+                if(hiz_reject_block(ctx, vertices[0], &hs.input, min_z, max_z, block_x, block_y) == ER_TRUE){
+                    rejected_blocks++;
+                    continue;
+                }
+                shade_quads(ctx, &hs, max(block_x, hs.start_x), min(block_x + BLOCK_SIZE - 1, hs.end_x),
+                            max(block_y, hs.start_y), min(block_y + BLOCK_SIZE - 1, hs.end_y), inside, edges, varyings);
+
+            }
+        }
+        if(rejected_blocks){
+            add_statistic(&ctx->statistics.hiz_rejected_blocks, rejected_blocks);
+        }
+    }
+
+    if(hs.span_shader == ER_TRUE && hs.span.size > 0){
+        shade_span(ctx, &hs.span, varyings);
+    }
+
+}
+
+/*
+ * Instantiation of the half-space rasterizer for a constant number of varying attributes.
+*/
+#define HALF_SPACE_VARIANT(N) \
+static void draw_polygon_half_space_##N(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y){ \
+    draw_polygon_half_space_variant(ctx, vertices, size, setup, min_x, max_x, min_y, max_y, N); \
+}
+
+HALF_SPACE_VARIANT(0)
+HALF_SPACE_VARIANT(2)
+HALF_SPACE_VARIANT(4)
+HALF_SPACE_VARIANT(8)
+HALF_SPACE_VARIANT(16)
+
+void draw_polygon_half_space(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y, int varyings){
+
+    switch(varyings){
+        case 0:
+            draw_polygon_half_space_0(ctx, vertices, size, setup, min_x, max_x, min_y, max_y);
+            break;
+        case 2:
+            draw_polygon_half_space_2(ctx, vertices, size, setup, min_x, max_x, min_y, max_y);
+            break;
+        case 4:
+            draw_polygon_half_space_4(ctx, vertices, size, setup, min_x, max_x, min_y, max_y);
+            break;
+        case 8:
+            draw_polygon_half_space_8(ctx, vertices, size, setup, min_x, max_x, min_y, max_y);
+            break;
+        default:
+            draw_polygon_half_space_16(ctx, vertices, size, setup, min_x, max_x, min_y, max_y);
+            break;
+    }
+
+}
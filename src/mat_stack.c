@@ -1,49 +1,37 @@
 #include "pipeline.h"
 
-static er_MatrixModeEnum matrix_mode;
-
-//Modelview Matrix Stack
-unsigned int mv_stack_counter;
-mat4 mv_stack[MODELVIEW_MATRIX_STACK_SIZE];
-mat4 inv_mv_stack[MODELVIEW_MATRIX_STACK_SIZE];
-mat3 nm_stack[MODELVIEW_MATRIX_STACK_SIZE];
-er_Bool mv_flag[MODELVIEW_MATRIX_STACK_SIZE];
-//Projection matrix stack
-unsigned int proj_stack_counter;
-mat4 proj_stack[PROJECTION_MATRIX_STACK_SIZE];
-mat4 inv_proj_stack[PROJECTION_MATRIX_STACK_SIZE];
-er_Bool proj_flag[PROJECTION_MATRIX_STACK_SIZE];
-//Current Modelview Projection matrix
-mat4 mv_proj_matrix;
-
 er_StatusEnum er_get_matrix(mat4 matrix){
 
+    er_Context *ctx = current_context;
+
     if(matrix == NULL){
         return ER_NULL_POINTER;
     }
-    if(matrix_mode == ER_MODELVIEW){
-        assign_mat4(matrix, mv_stack[mv_stack_counter]);
-    }else if(matrix_mode == ER_PROJECTION){
-        assign_mat4(matrix, proj_stack[proj_stack_counter]);
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        assign_mat4(matrix, ctx->mv_stack[ctx->mv_stack_counter]);
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        assign_mat4(matrix, ctx->proj_stack[ctx->proj_stack_counter]);
     }
     return ER_NO_ERROR;
 }
 
 er_StatusEnum er_push_matrix(){
 
-    if(matrix_mode == ER_MODELVIEW){
-        if(mv_stack_counter < MODELVIEW_MATRIX_STACK_SIZE - 1){
-            assign_mat4(mv_stack[mv_stack_counter+1], mv_stack[mv_stack_counter]);
-            mv_flag[mv_stack_counter+1] = ER_TRUE;
-            mv_stack_counter++;
+    er_Context *ctx = current_context;
+
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        if(ctx->mv_stack_counter < MODELVIEW_MATRIX_STACK_SIZE - 1){
+            assign_mat4(ctx->mv_stack[ctx->mv_stack_counter+1], ctx->mv_stack[ctx->mv_stack_counter]);
+            ctx->mv_flag[ctx->mv_stack_counter+1] = ER_TRUE;
+            ctx->mv_stack_counter++;
         }else{
             return ER_STACK_OVERFLOW;        
         }
-    }else if(matrix_mode == ER_PROJECTION){
-        if(proj_stack_counter < PROJECTION_MATRIX_STACK_SIZE - 1){
-            assign_mat4(proj_stack[proj_stack_counter+1], proj_stack[proj_stack_counter]);
-            proj_flag[proj_stack_counter+1] = ER_TRUE;
-            proj_stack_counter++;
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        if(ctx->proj_stack_counter < PROJECTION_MATRIX_STACK_SIZE - 1){
+            assign_mat4(ctx->proj_stack[ctx->proj_stack_counter+1], ctx->proj_stack[ctx->proj_stack_counter]);
+            ctx->proj_flag[ctx->proj_stack_counter+1] = ER_TRUE;
+            ctx->proj_stack_counter++;
         }else{
             return ER_STACK_OVERFLOW;
         }
@@ -53,17 +41,19 @@ er_StatusEnum er_push_matrix(){
 
 er_StatusEnum er_pop_matrix(){
 
-    if(matrix_mode == ER_MODELVIEW){
-        if(mv_stack_counter > 0){
-            mv_flag[mv_stack_counter] = ER_TRUE;
-            mv_stack_counter--;
+    er_Context *ctx = current_context;
+
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        if(ctx->mv_stack_counter > 0){
+            ctx->mv_flag[ctx->mv_stack_counter] = ER_TRUE;
+            ctx->mv_stack_counter--;
         }else{
             return ER_STACK_UNDERFLOW;
         }
-    }else if(matrix_mode == ER_PROJECTION){
-        if(proj_stack_counter > 0){
-            proj_flag[proj_stack_counter] = ER_TRUE;
-            proj_stack_counter--;
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        if(ctx->proj_stack_counter > 0){
+            ctx->proj_flag[ctx->proj_stack_counter] = ER_TRUE;
+            ctx->proj_stack_counter--;
         }else{
             return ER_STACK_UNDERFLOW;
         }
@@ -73,19 +63,22 @@ er_StatusEnum er_pop_matrix(){
 
 void er_load_identity(){
 
-    if(matrix_mode == ER_MODELVIEW){
-        identity_mat4(mv_stack[mv_stack_counter]);
-        mv_flag[mv_stack_counter] = ER_TRUE;
-    }else if(matrix_mode == ER_PROJECTION){
-        identity_mat4(proj_stack[proj_stack_counter]);
-        proj_flag[proj_stack_counter] = ER_TRUE;
+    er_Context *ctx = current_context;
+
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        identity_mat4(ctx->mv_stack[ctx->mv_stack_counter]);
+        ctx->mv_flag[ctx->mv_stack_counter] = ER_TRUE;
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        identity_mat4(ctx->proj_stack[ctx->proj_stack_counter]);
+        ctx->proj_flag[ctx->proj_stack_counter] = ER_TRUE;
     }
 
 }
 
 er_StatusEnum er_matrix_mode(er_MatrixModeEnum mode){
+    er_Context *ctx = current_context;
     if(mode == ER_MODELVIEW || mode == ER_PROJECTION){
-        matrix_mode = mode;
+        ctx->matrix_mode = mode;
     }else{
         return ER_INVALID_ARGUMENT;
     }
@@ -94,45 +87,51 @@ er_StatusEnum er_matrix_mode(er_MatrixModeEnum mode){
 
 er_StatusEnum er_multiply_matrix(mat4 matrix){
 
+    er_Context *ctx = current_context;
+
     if(matrix == NULL){
         return ER_NULL_POINTER;
     }
-    if(matrix_mode == ER_MODELVIEW){
-        mult_mat4_mat4(mv_stack[mv_stack_counter], matrix, mv_stack[mv_stack_counter]);
-        mv_flag[mv_stack_counter] = ER_TRUE;
-    }else if(matrix_mode == ER_PROJECTION){
-        mult_mat4_mat4(proj_stack[proj_stack_counter], matrix, proj_stack[proj_stack_counter]);
-        proj_flag[proj_stack_counter] = ER_TRUE;
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        mult_mat4_mat4(ctx->mv_stack[ctx->mv_stack_counter], matrix, ctx->mv_stack[ctx->mv_stack_counter]);
+        ctx->mv_flag[ctx->mv_stack_counter] = ER_TRUE;
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        mult_mat4_mat4(ctx->proj_stack[ctx->proj_stack_counter], matrix, ctx->proj_stack[ctx->proj_stack_counter]);
+        ctx->proj_flag[ctx->proj_stack_counter] = ER_TRUE;
     }
     return ER_NO_ERROR;
 }
 
 er_StatusEnum er_load_matrix_transpose(mat4 matrix){
 
+    er_Context *ctx = current_context;
+
     if(matrix == NULL){
         return ER_NULL_POINTER;
     }
-    if(matrix_mode == ER_MODELVIEW){
-        assignT_mat4( mv_stack[mv_stack_counter], matrix);
-        mv_flag[mv_stack_counter] = ER_TRUE;
-    }else if(matrix_mode == ER_PROJECTION){
-        assignT_mat4( proj_stack[proj_stack_counter] , matrix);
-        proj_flag[proj_stack_counter] = ER_TRUE;
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        assignT_mat4( ctx->mv_stack[ctx->mv_stack_counter], matrix);
+        ctx->mv_flag[ctx->mv_stack_counter] = ER_TRUE;
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        assignT_mat4( ctx->proj_stack[ctx->proj_stack_counter] , matrix);
+        ctx->proj_flag[ctx->proj_stack_counter] = ER_TRUE;
     }
     return ER_NO_ERROR;
 }
 
 er_StatusEnum er_load_matrix(mat4 matrix){
 
+    er_Context *ctx = current_context;
+
     if(matrix == NULL){
         return ER_NULL_POINTER;
     }
-    if(matrix_mode == ER_MODELVIEW){
-        assign_mat4(mv_stack[mv_stack_counter], matrix);
-        mv_flag[mv_stack_counter] = ER_TRUE;
-    }else if(matrix_mode == ER_PROJECTION){
-        assign_mat4(proj_stack[proj_stack_counter] , matrix);
-        proj_flag[proj_stack_counter] = ER_TRUE;
+    if(ctx->matrix_mode == ER_MODELVIEW){
+        assign_mat4(ctx->mv_stack[ctx->mv_stack_counter], matrix);
+        ctx->mv_flag[ctx->mv_stack_counter] = ER_TRUE;
+    }else if(ctx->matrix_mode == ER_PROJECTION){
+        assign_mat4(ctx->proj_stack[ctx->proj_stack_counter] , matrix);
+        ctx->proj_flag[ctx->proj_stack_counter] = ER_TRUE;
     }
     return ER_NO_ERROR;
 }
@@ -215,29 +214,29 @@ void er_look_at(float eye_x, float eye_y, float eye_z, float at_x, float at_y, f
     er_multiply_matrix(matrix_aux);
 }
 
-void update_matrix_data(){
+void update_matrix_data(er_Context *ctx){
 
-    if(mv_flag[mv_stack_counter] == ER_TRUE){
+    if(ctx->mv_flag[ctx->mv_stack_counter] == ER_TRUE){
         /* Calcule matrix inverse */
-        inverse_modeling_mat4(mv_stack[mv_stack_counter], inv_mv_stack[mv_stack_counter]);
+        inverse_modeling_mat4(ctx->mv_stack[ctx->mv_stack_counter], ctx->inv_mv_stack[ctx->mv_stack_counter]);
 
-        float (*inv_mv)[4] = inv_mv_stack[mv_stack_counter];
-        float (*normal_mat)[3] = nm_stack[mv_stack_counter];
+        float (*inv_mv)[4] = ctx->inv_mv_stack[ctx->mv_stack_counter];
+        float (*normal_mat)[3] = ctx->nm_stack[ctx->mv_stack_counter];
         /* Set normal matrix*/
         normal_mat[0][0] = inv_mv[0][0];  normal_mat[0][1] = inv_mv[1][0];  normal_mat[0][2] = inv_mv[2][0];
         normal_mat[1][0] = inv_mv[0][1];  normal_mat[1][1] = inv_mv[1][1];  normal_mat[1][2] = inv_mv[2][1];
         normal_mat[2][0] = inv_mv[0][2];  normal_mat[2][1] = inv_mv[1][2];  normal_mat[2][2] = inv_mv[2][2];
 
-        mv_flag[mv_stack_counter] = ER_FALSE;
+        ctx->mv_flag[ctx->mv_stack_counter] = ER_FALSE;
     }
 
-    if(proj_flag[proj_stack_counter] == ER_TRUE){
+    if(ctx->proj_flag[ctx->proj_stack_counter] == ER_TRUE){
         /* Calcule matrix inverse */
-        inverse_mat4(proj_stack[proj_stack_counter], inv_proj_stack[proj_stack_counter]);
-        proj_flag[proj_stack_counter] = ER_FALSE;
+        inverse_mat4(ctx->proj_stack[ctx->proj_stack_counter], ctx->inv_proj_stack[ctx->proj_stack_counter]);
+        ctx->proj_flag[ctx->proj_stack_counter] = ER_FALSE;
     }
 
     /* Premultiply projection and modelview matrix */
-    multd_mat4_mat4(proj_stack[proj_stack_counter], mv_stack[mv_stack_counter], mv_proj_matrix);
+    multd_mat4_mat4(ctx->proj_stack[ctx->proj_stack_counter], ctx->mv_stack[ctx->mv_stack_counter], ctx->mv_proj_matrix);
 
 }
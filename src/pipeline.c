@@ -1,53 +1,11 @@
+#include <string.h>
 #include "pipeline.h"
 
-#define VERTEX_CACHE_SIZE 32
+//Context bound to the calling thread
+_Thread_local er_Context *current_context = NULL;
 
-typedef struct VertexCacheRegister{
-    int input_index;
-    int output_index;
-} VertexCacheRegister;
-
-//Vertex Cache
-static VertexCacheRegister vertex_cache[VERTEX_CACHE_SIZE];
-
-//Input Buffer
-er_VertexInput *input_buffer = NULL;
-unsigned int input_buffer_size;
-
-//Indices buffer
-unsigned int *input_indices = NULL;
-unsigned int input_indices_size;
-
-//Output Buffer
-OutputBufferRegister *output_buffer = NULL;
-unsigned int output_buffer_size;
-
-//Indices buffer after clipping operation
-unsigned int *output_indices = NULL;
-unsigned int output_indices_size;
-
-//Current vertex state
-vec3 current_normal;
-vec4 current_tex_coord;
-vec4 current_color;
-float current_fog_coord;
-
-//Begin/End calls
-static unsigned int batch_size;
-static void (*be_process_func)();
-
-//Viewport data
-unsigned int window_origin_x, window_origin_y, window_width, window_height;
-
-/* Variables for select front or back face  */
-er_PolygonOrientationEnum front_face_orientation;
-er_PolygonModeEnum front_face_mode;
-er_PolygonModeEnum back_face_mode;
-er_Bool cull_face_enable;
-er_PolygonFaceEnum cull_face;
-
-/* Uniform vars */
-er_UniVars global_variables;
+//Context created by er_init
+static er_Context *default_context = NULL;
 
 /* Error messages */
 const char* status_strings[] = {
@@ -69,106 +27,193 @@ const char* er_status_string(er_StatusEnum status){
     return NULL;
 }
 
-er_StatusEnum er_init(){
+er_StatusEnum er_create_context(er_Context **context){
+
+    if(context == NULL){
+        return ER_NULL_POINTER;
+    }
+    /* Vertex state and viewport start zeroed */
+    er_Context *ctx = (er_Context*)calloc(1, sizeof(er_Context));
+    if(ctx == NULL){
+        return ER_OUT_OF_MEMORY;
+    }
 
     /* Init matrix stack */
     int i;
+    ctx->matrix_mode = ER_MODELVIEW;
     for(i = 0; i < MODELVIEW_MATRIX_STACK_SIZE; i++){
-        identity_mat4(mv_stack[i]);
-        identity_mat4(inv_mv_stack[i]);
-        mv_flag[i] = ER_TRUE;
+        identity_mat4(ctx->mv_stack[i]);
+        identity_mat4(ctx->inv_mv_stack[i]);
+        ctx->mv_flag[i] = ER_TRUE;
     }
-    mv_stack_counter = 0;
+    ctx->mv_stack_counter = 0;
     for(i = 0; i < PROJECTION_MATRIX_STACK_SIZE; i++){
-        identity_mat4(proj_stack[i]);
-        identity_mat4(inv_proj_stack[i]);
-        proj_flag[i] = ER_TRUE;
+        identity_mat4(ctx->proj_stack[i]);
+        identity_mat4(ctx->inv_proj_stack[i]);
+        ctx->proj_flag[i] = ER_TRUE;
     }
-    proj_stack_counter = 0;
+    ctx->proj_stack_counter = 0;
 
     /* Init internal buffers of vertex and indices */
-    input_buffer = (er_VertexInput*)malloc( TRIANGLES_BATCH_SIZE * 3 * sizeof(er_VertexInput));
-    if(input_buffer == NULL){
-        er_quit();
+    ctx->input_buffer = (er_VertexInput*)malloc( TRIANGLES_BATCH_SIZE * 3 * sizeof(er_VertexInput));
+    ctx->input_buffer_size = 0;
+    /* Per triangle, up to 12 vertices generated by clipping and 2 copies with the flat attributes of the provoking vertex */
+    ctx->output_buffer = (OutputBufferRegister*)malloc( (TRIANGLES_BATCH_SIZE * 3 + TRIANGLES_BATCH_SIZE * 14) * sizeof(OutputBufferRegister));
+    ctx->output_buffer_size = 0;
+    ctx->input_indices = (unsigned int*)malloc( TRIANGLES_BATCH_SIZE * 3 * sizeof(unsigned int) );
+    ctx->input_indices_size = 0;
+    ctx->output_indices = (unsigned int*)malloc( (TRIANGLES_BATCH_SIZE * 7 * 3) * sizeof(unsigned int) );
+    ctx->output_indices_size = 0;
+
+    /* Post-transform vertex cache */
+    ctx->vertex_cache = (VertexCacheRegister*)calloc(VERTEX_CACHE_DEFAULT_SIZE, sizeof(VertexCacheRegister));
+    ctx->vertex_cache_size = VERTEX_CACHE_DEFAULT_SIZE;
+    ctx->vertex_cache_policy = ER_CACHE_LRU;
+
+    /* Tiled rasterization settings */
+    init_tiling(ctx);
+
+    if(ctx->input_buffer == NULL || ctx->output_buffer == NULL || ctx->input_indices == NULL || ctx->output_indices == NULL ||
+       ctx->vertex_cache == NULL){
+        er_delete_context(ctx);
         return ER_OUT_OF_MEMORY;
     }
-    input_buffer_size = 0;
-
-    output_buffer = (OutputBufferRegister*)malloc( (TRIANGLES_BATCH_SIZE * 3 + TRIANGLES_BATCH_SIZE * 12) * sizeof(OutputBufferRegister));
-    if(output_buffer == NULL){
-        er_quit();
-        return ER_OUT_OF_MEMORY;
-    }
-    output_buffer_size = 0;
-
-    input_indices = (unsigned int*)malloc( TRIANGLES_BATCH_SIZE * 3 * sizeof(unsigned int) );
-    if(input_indices == NULL){
-        er_quit();
-        return ER_OUT_OF_MEMORY;
-    }
-    input_indices_size = 0;
-
-    output_indices = (unsigned int*)malloc( (TRIANGLES_BATCH_SIZE * 7 * 3) * sizeof(unsigned int) );
-    if(output_indices == NULL){
-        er_quit();
-        return ER_OUT_OF_MEMORY;
-    }
-    output_indices_size = 0;
 
     /* Set current vertex array to null */
-    current_vertex_array = NULL;
+    ctx->current_vertex_array = NULL;
 
     /* Set current program to null */
-    current_program = NULL;
+    ctx->current_program = NULL;
 
     /* Set current process function to null */
-    be_process_func = NULL;
+    ctx->be_process_func = NULL;
+    ctx->be_batch_size = 0;
 
     /* Point sprites settings */
-    point_sprite_coord_origin = ER_POINT_SPRITE_LOWER_LEFT;
-    point_sprite_enable = ER_FALSE;
+    ctx->point_sprite_coord_origin = ER_POINT_SPRITE_LOWER_LEFT;
+    ctx->point_sprite_enable = ER_FALSE;
 
     /* Orientation settings */
-    front_face_orientation = ER_COUNTER_CLOCK_WISE;
-    front_face_mode = ER_FILL;
-    back_face_mode = ER_FILL;
-    cull_face_enable = ER_FALSE;
-    cull_face = ER_BACK;
-
+    ctx->front_face_orientation = ER_COUNTER_CLOCK_WISE;
+    ctx->front_face_mode = ER_FILL;
+    ctx->back_face_mode = ER_FILL;
+    ctx->cull_face_enable = ER_FALSE;
+    ctx->cull_face = ER_BACK;
+
+    /* Rasterization settings */
+    ctx->half_space_enable = ER_FALSE;
+    ctx->guard_band_enable = ER_FALSE;
+    ctx->fixed_point_enable = ER_FALSE;
+    ctx->subpixel_bits = DEFAULT_SUBPIXEL_BITS;
+    ctx->perspective_correction_enable = ER_FALSE;
+
+    /* Framebuffer and depth test settings */
+    ctx->current_framebuffer = NULL;
+    ctx->depth_test_enable = ER_FALSE;
+    ctx->depth_func = ER_LESS;
+    ctx->depth_mask = ER_TRUE;
+    ctx->clear_depth = 1.0f;
+    ctx->hiz_enable = ER_TRUE;
+
+    *context = ctx;
     return ER_NO_ERROR;
 
 }
 
-void er_quit(){
+er_StatusEnum er_delete_context(er_Context *ctx){
 
-    if(input_buffer != NULL){
-        free(input_buffer);
-        input_buffer = NULL;
+    if(ctx == NULL){
+        return ER_NULL_POINTER;
     }
-    if(output_buffer != NULL){
-        free(output_buffer);
-        output_buffer = NULL;
+    if(current_context == ctx){
+        current_context = NULL;
     }
-    if(input_indices != NULL){
-        free(input_indices);
-        input_indices = NULL;
+
+    quit_tiling(ctx);
+
+    if(ctx->input_buffer != NULL){
+        free(ctx->input_buffer);
     }
-    if(output_indices != NULL){
-        free(output_indices);
-        output_indices = NULL;
+    if(ctx->output_buffer != NULL){
+        free(ctx->output_buffer);
+    }
+    if(ctx->input_indices != NULL){
+        free(ctx->input_indices);
+    }
+    if(ctx->output_indices != NULL){
+        free(ctx->output_indices);
+    }
+    if(ctx->vertex_cache != NULL){
+        free(ctx->vertex_cache);
+    }
+    free(ctx);
+    return ER_NO_ERROR;
+
+}
+
+er_StatusEnum er_make_current(er_Context *ctx){
+    current_context = ctx;
+    return ER_NO_ERROR;
+}
+
+er_Context* er_get_current_context(){
+    return current_context;
+}
+
+er_StatusEnum er_init(){
+
+    er_StatusEnum status = er_create_context(&default_context);
+    if(status != ER_NO_ERROR){
+        return status;
+    }
+    current_context = default_context;
+    return ER_NO_ERROR;
+
+}
+
+void er_quit(){
+
+    if(default_context != NULL){
+        er_delete_context(default_context);
+        default_context = NULL;
     }
 
 }
 
 er_StatusEnum er_enable(er_EnableSettingEnum param, er_Bool enable){
 
+    er_Context *ctx = current_context;
+
     switch( param ){
 
         case ER_CULL_FACE:
-            cull_face_enable = enable;
+            ctx->cull_face_enable = enable;
             break;
         case ER_POINT_SPRITES:
-            point_sprite_enable = enable;
+            ctx->point_sprite_enable = enable;
+            break;
+        case ER_HALF_SPACE_RASTERIZATION:
+            ctx->half_space_enable = enable;
+            break;
+        case ER_DEPTH_TEST:
+            ctx->depth_test_enable = enable;
+            break;
+        case ER_HIERARCHICAL_DEPTH_TEST:
+            ctx->hiz_enable = enable;
+            break;
+        case ER_GUARD_BAND_CLIPPING:
+            ctx->guard_band_enable = enable;
+            break;
+        case ER_FIXED_POINT_RASTERIZATION:
+            ctx->fixed_point_enable = enable;
+            break;
+        case ER_PERSPECTIVE_CORRECTION:
+            flush_tiles(ctx);
+            ctx->perspective_correction_enable = enable;
+            break;
+        case ER_TILED_RASTERIZATION:
+            flush_tiles(ctx);
+            ctx->tiling_enable = enable;
             break;
         default:
             return ER_INVALID_ARGUMENT;
@@ -176,10 +221,81 @@ er_StatusEnum er_enable(er_EnableSettingEnum param, er_Bool enable){
     return ER_NO_ERROR;
 }
 
+er_StatusEnum er_get_statistics(er_Statistics *stats){
+
+    er_Context *ctx = current_context;
+
+    if(stats == NULL){
+        return ER_NULL_POINTER;
+    }
+    *stats = ctx->statistics;
+    return ER_NO_ERROR;
+}
+
+void er_reset_statistics(){
+
+    er_Context *ctx = current_context;
+    memset(&ctx->statistics, 0, sizeof(er_Statistics));
+
+}
+
+er_StatusEnum er_thread_count(unsigned int count){
+
+    er_Context *ctx = current_context;
+
+    if(count == 0 || count > MAX_THREADS){
+        return ER_INVALID_ARGUMENT;
+    }
+    ctx->thread_count = count;
+    return ER_NO_ERROR;
+}
+
+er_StatusEnum er_subpixel_bits(unsigned int bits){
+
+    er_Context *ctx = current_context;
+
+    if(bits == 0 || bits > MAX_SUBPIXEL_BITS){
+        return ER_INVALID_ARGUMENT;
+    }
+    ctx->subpixel_bits = bits;
+    return ER_NO_ERROR;
+}
+
+er_StatusEnum er_vertex_cache(unsigned int size, er_VertexCachePolicyEnum policy){
+
+    er_Context *ctx = current_context;
+
+    if(policy != ER_CACHE_FIFO && policy != ER_CACHE_LRU){
+        return ER_INVALID_ARGUMENT;
+    }
+    /* Power of two number of entries, zero disables the cache between batches */
+    if(size != 0 && (size < VERTEX_CACHE_WAYS || size > VERTEX_CACHE_MAX_SIZE || (size & (size - 1)) != 0)){
+        return ER_INVALID_ARGUMENT;
+    }
+    if(size != ctx->vertex_cache_size){
+        VertexCacheRegister *cache = NULL;
+        if(size > 0){
+            cache = (VertexCacheRegister*)calloc(size, sizeof(VertexCacheRegister));
+            if(cache == NULL){
+                return ER_OUT_OF_MEMORY;
+            }
+        }
+        if(ctx->vertex_cache != NULL){
+            free(ctx->vertex_cache);
+        }
+        ctx->vertex_cache = cache;
+        ctx->vertex_cache_size = size;
+    }
+    ctx->vertex_cache_policy = policy;
+    return ER_NO_ERROR;
+}
+
 er_StatusEnum er_point_parameteri(er_PointSpriteEnum param, er_PointSpriteEnum value){
 
+    er_Context *ctx = current_context;
+
     if( param == ER_POINT_SPRITE_COORD_ORIGIN){
-        point_sprite_coord_origin = value;
+        ctx->point_sprite_coord_origin = value;
     }else{
         return ER_INVALID_ARGUMENT;
     }
@@ -187,8 +303,9 @@ er_StatusEnum er_point_parameteri(er_PointSpriteEnum param, er_PointSpriteEnum v
 }
 
 er_StatusEnum er_cull_face(er_PolygonFaceEnum face){
+    er_Context *ctx = current_context;
     if(face == ER_FRONT || face == ER_BACK || face == ER_FRONT_AND_BACK){
-        cull_face = face;
+        ctx->cull_face = face;
     }else{
         return ER_INVALID_ARGUMENT;
     }
@@ -196,8 +313,9 @@ er_StatusEnum er_cull_face(er_PolygonFaceEnum face){
 }
 
 er_StatusEnum er_front_face(er_PolygonOrientationEnum orientation){
+    er_Context *ctx = current_context;
     if(orientation == ER_COUNTER_CLOCK_WISE || orientation == ER_CLOCK_WISE){
-        front_face_orientation = orientation;
+        ctx->front_face_orientation = orientation;
     }else{
         return ER_INVALID_ARGUMENT;
     }
@@ -206,128 +324,360 @@ er_StatusEnum er_front_face(er_PolygonOrientationEnum orientation){
 
 er_StatusEnum er_viewport(unsigned int x, unsigned int y, unsigned int width, unsigned int height){
 
+    er_Context *ctx = current_context;
+
     if(width == 0 || height == 0){
         return ER_INVALID_ARGUMENT;
     }
-    window_origin_x = x;
-    window_origin_y = y;
-    window_width = width;
-    window_height = height;
+    ctx->window_origin_x = x;
+    ctx->window_origin_y = y;
+    ctx->window_width = width;
+    ctx->window_height = height;
     return ER_NO_ERROR;
 }
 
 er_StatusEnum er_polygon_mode(er_PolygonFaceEnum face, er_PolygonModeEnum mode){
 
+    er_Context *ctx = current_context;
+
     if(face == ER_FRONT){
-        front_face_mode = mode;
+        ctx->front_face_mode = mode;
     }else if(face == ER_BACK){
-        back_face_mode = mode;
+        ctx->back_face_mode = mode;
     } else if(face == ER_FRONT_AND_BACK){
-        front_face_mode = mode;
-        back_face_mode = mode;
+        ctx->front_face_mode = mode;
+        ctx->back_face_mode = mode;
     }else{
         return ER_INVALID_ARGUMENT;
     }
     return ER_NO_ERROR;
 }
 
-static void clear_vertex_cache(){
+/* Input indices of the vertices taken from the post-transform cache, until their position is known */
+#define CACHED_VERTEX 0x80000000u
+
+static void clear_batch_cache(er_Context *ctx){
 
     int i;
-    for(i = 0; i < VERTEX_CACHE_SIZE; i++){
-        vertex_cache[i].input_index = -1;
-        vertex_cache[i].output_index = -1;
+    for(i = 0; i < BATCH_CACHE_SIZE; i++){
+        ctx->batch_cache[i].input_index = -1;
+        ctx->batch_cache[i].output_index = -1;
     }
 
 }
 
-static int hit_cache(unsigned int input_index, unsigned int *output_index ){
+static int hit_batch_cache(er_Context *ctx, unsigned int input_index, unsigned int *output_index ){
 
-    unsigned int hash_index = input_index & (VERTEX_CACHE_SIZE - 1);
-    if(vertex_cache[hash_index].input_index == input_index){
-        *output_index = vertex_cache[hash_index].output_index;
+    unsigned int hash_index = input_index & (BATCH_CACHE_SIZE - 1);
+    if(ctx->batch_cache[hash_index].input_index == input_index){
+        *output_index = ctx->batch_cache[hash_index].output_index;
         return ER_TRUE;
     }
     return ER_FALSE;
 }
 
-static void write_cache(unsigned int input_index, unsigned int output_index){
+static void write_batch_cache(er_Context *ctx, unsigned int input_index, unsigned int output_index){
 
-    unsigned int hash_index = input_index & (VERTEX_CACHE_SIZE - 1);
-    vertex_cache[hash_index].input_index = input_index;
-    vertex_cache[hash_index].output_index = output_index;
+    unsigned int hash_index = input_index & (BATCH_CACHE_SIZE - 1);
+    ctx->batch_cache[hash_index].input_index = input_index;
+    ctx->batch_cache[hash_index].output_index = output_index;
 
 }
 
-void reset_buffers_size(){
+/*
+ * Entry of the post-transform cache holding a vertex shaded on the current draw call, or -1.
+*/
+static int hit_vertex_cache(er_Context *ctx, unsigned int input_index){
+
+    unsigned int way, set = (input_index & (ctx->vertex_cache_size / VERTEX_CACHE_WAYS - 1)) * VERTEX_CACHE_WAYS;
+    for(way = set; way < set + VERTEX_CACHE_WAYS; way++){
+        VertexCacheRegister *entry = &ctx->vertex_cache[way];
+        if(entry->input_index == input_index && entry->generation == ctx->vertex_cache_generation){
+            if(ctx->vertex_cache_policy == ER_CACHE_LRU){
+                entry->tick = ctx->vertex_cache_tick++;
+            }
+            return way;
+        }
+    }
+    return -1;
 
-    input_buffer_size = 0;
-    output_buffer_size = 0;
-    input_indices_size = 0;
-    output_indices_size = 0;
+}
+
+/*
+ * Keep a shaded vertex on the post-transform cache, replacing an entry of a previous draw call
+ * or the oldest entry of the set.
+*/
+static void write_vertex_cache(er_Context *ctx, unsigned int input_index, OutputBufferRegister *output){
+
+    unsigned int way, set = (input_index & (ctx->vertex_cache_size / VERTEX_CACHE_WAYS - 1)) * VERTEX_CACHE_WAYS;
+    VertexCacheRegister *victim = &ctx->vertex_cache[set];
+    for(way = set; way < set + VERTEX_CACHE_WAYS; way++){
+        VertexCacheRegister *entry = &ctx->vertex_cache[way];
+        if(entry->generation != ctx->vertex_cache_generation || entry->input_index == input_index){
+            victim = entry;
+            break;
+        }
+        if(entry->tick < victim->tick){
+            victim = entry;
+        }
+    }
+    victim->input_index = input_index;
+    victim->generation = ctx->vertex_cache_generation;
+    victim->tick = ctx->vertex_cache_tick++;
+    victim->outcode = output->outcode;
+    victim->vertex = output->vertex;
 
 }
 
-void update_uniform_vars(){
+void reset_buffers_size(er_Context *ctx){
+
+    ctx->input_buffer_size = 0;
+    ctx->output_buffer_size = 0;
+    ctx->input_indices_size = 0;
+    ctx->output_indices_size = 0;
+    ctx->output_polygons_size = 0;
+    ctx->cached_vertices_size = 0;
+
+}
+
+void update_uniform_vars(er_Context *ctx){
+
+    ctx->global_variables.modelview = ctx->mv_stack[ctx->mv_stack_counter];
+    ctx->global_variables.modelview_inverse = ctx->inv_mv_stack[ctx->mv_stack_counter];
+    ctx->global_variables.normal = ctx->nm_stack[ctx->mv_stack_counter];
+    ctx->global_variables.projection = ctx->proj_stack[ctx->proj_stack_counter];
+    ctx->global_variables.projection_inverse = ctx->inv_proj_stack[ctx->proj_stack_counter];
+    ctx->global_variables.modelview_projection = ctx->mv_proj_matrix;
+    ctx->global_variables.origin_x = ctx->window_origin_x;
+    ctx->global_variables.origin_y = ctx->window_origin_y;
+    ctx->global_variables.width =ctx->window_width;
+    ctx->global_variables.height = ctx->window_height;
+    ctx->global_variables.uniform_integer = ctx->current_program->uniform_integer;
+    ctx->global_variables.uniform_float = ctx->current_program->uniform_float;
+    ctx->global_variables.uniform_ptr = ctx->current_program->uniform_ptr;
+    ctx->global_variables.uniform_texture = ctx->current_program->uniform_texture;
+    ctx->global_variables.instance_id = 0;
+    ctx->global_variables.instance_attributes = NULL;
+
+}
+
+/*
+ * Process function and batch size of a primitive type. Strips, fans and loops are assembled
+ * into lists of lines or triangles.
+*/
+static er_Bool primitive_batch(er_PrimitiveEnum primitive, void (**process_func)(er_Context*), unsigned int *batch_size){
+
+    switch(primitive){
+        case ER_POINTS:
+            *process_func = process_points;
+            *batch_size = POINTS_BATCH_SIZE;
+            break;
+        case ER_LINES:
+        case ER_LINE_STRIP:
+        case ER_LINE_LOOP:
+            *process_func = process_lines;
+            *batch_size = LINES_BATCH_SIZE * 2;
+            break;
+        case ER_TRIANGLES:
+        case ER_TRIANGLE_STRIP:
+        case ER_TRIANGLE_FAN:
+            *process_func = process_triangles;
+            *batch_size = TRIANGLES_BATCH_SIZE * 3;
+            break;
+        default:
+            return ER_FALSE;
+    }
+    return ER_TRUE;
+
+}
+
+/*
+ * Number of vertices of the list of primitives assembled from count vertices.
+*/
+static unsigned int assembled_size(er_PrimitiveEnum primitive, unsigned int count){
+
+    switch(primitive){
+        case ER_LINE_STRIP:
+            return count >= 2 ? 2 * (count - 1): 0;
+        case ER_LINE_LOOP:
+            return count >= 2 ? 2 * count: 0;
+        case ER_TRIANGLE_STRIP:
+        case ER_TRIANGLE_FAN:
+            return count >= 3 ? 3 * (count - 2): 0;
+        default:
+            return count;
+    }
+
+}
+
+/*
+ * Position on the vertex stream of the vertex i of the assembled list of primitives.
+ * Odd triangles of a strip swap their first two vertices to keep the winding of the strip.
+*/
+static unsigned int assembled_vertex(er_PrimitiveEnum primitive, unsigned int i, unsigned int count){
+
+    unsigned int primitive_index, corner;
+
+    switch(primitive){
+        case ER_LINE_STRIP:
+            return i / 2 + (i & 1);
+        case ER_LINE_LOOP:
+            return (i / 2 + (i & 1)) % count;
+        case ER_TRIANGLE_STRIP:
+            primitive_index = i / 3;
+            corner = i % 3;
+            if((primitive_index & 1) && corner < 2){
+                corner = 1 - corner;
+            }
+            return primitive_index + corner;
+        case ER_TRIANGLE_FAN:
+            primitive_index = i / 3;
+            corner = i % 3;
+            return corner == 0 ? 0: primitive_index + corner;
+        default:
+            return i;
+    }
+
+}
+
+/*
+ * Add the indices of the primitives completed by a new vertex of a begin/end block.
+*/
+static void assemble_vertex(er_Context *ctx, unsigned int slot){
+
+    unsigned int n = ctx->be_vertex_count++;
+    unsigned int *indices = ctx->input_indices;
+
+    switch(ctx->be_primitive){
+        case ER_LINE_STRIP:
+        case ER_LINE_LOOP:
+            if(n >= 1){
+                indices[ctx->input_indices_size++] = ctx->be_previous[1];
+                indices[ctx->input_indices_size++] = slot;
+            }
+            break;
+        case ER_TRIANGLE_STRIP:
+            if(n >= 2){
+                indices[ctx->input_indices_size++] = ctx->be_previous[n & 1];
+                indices[ctx->input_indices_size++] = ctx->be_previous[1 - (n & 1)];
+                indices[ctx->input_indices_size++] = slot;
+            }
+            break;
+        case ER_TRIANGLE_FAN:
+            if(n >= 2){
+                indices[ctx->input_indices_size++] = ctx->be_first;
+                indices[ctx->input_indices_size++] = ctx->be_previous[1];
+                indices[ctx->input_indices_size++] = slot;
+            }
+            break;
+        default:
+            indices[ctx->input_indices_size++] = slot;
+            break;
+    }
+    if(n == 0){
+        ctx->be_first = slot;
+    }
+    ctx->be_previous[0] = ctx->be_previous[1];
+    ctx->be_previous[1] = slot;
+
+}
+
+/*
+ * Process the primitives of a begin/end block. Strips, fans and loops keep on the input buffer
+ * only the vertices shared with the next primitives: the last one for line strips, the first and
+ * the last ones for loops and fans, and the last two for triangle strips.
+*/
+static void process_begin_end_batch(er_Context *ctx){
+
+    er_VertexInput shared[2];
+    unsigned int slots[2], size = 0, i;
 
-    global_variables.modelview = mv_stack[mv_stack_counter];
-    global_variables.modelview_inverse = inv_mv_stack[mv_stack_counter];
-    global_variables.normal = nm_stack[mv_stack_counter];
-    global_variables.projection = proj_stack[proj_stack_counter];
-    global_variables.projection_inverse = inv_proj_stack[proj_stack_counter];
-    global_variables.modelview_projection = mv_proj_matrix;
-    global_variables.origin_x = window_origin_x;
-    global_variables.origin_y = window_origin_y;
-    global_variables.width =window_width;
-    global_variables.height = window_height;
-    global_variables.uniform_integer = current_program->uniform_integer;
-    global_variables.uniform_float = current_program->uniform_float;
-    global_variables.uniform_ptr = current_program->uniform_ptr;
-    global_variables.uniform_texture = current_program->uniform_texture;
+    switch(ctx->be_primitive){
+        case ER_LINE_STRIP:
+            slots[size++] = ctx->be_previous[1];
+            break;
+        case ER_LINE_LOOP:
+        case ER_TRIANGLE_FAN:
+            slots[size++] = ctx->be_first;
+            slots[size++] = ctx->be_previous[1];
+            break;
+        case ER_TRIANGLE_STRIP:
+            slots[size++] = ctx->be_previous[0];
+            slots[size++] = ctx->be_previous[1];
+            break;
+        default:
+            break;
+    }
+    for(i = 0; i < size; i++){
+        shared[i] = ctx->input_buffer[slots[i]];
+    }
+    ctx->be_process_func(ctx);
+    if(size == 0){
+        return;
+    }
+    for(i = 0; i < size; i++){
+        ctx->input_buffer[i] = shared[i];
+    }
+    ctx->input_buffer_size = size;
+    ctx->be_first = 0;
+    ctx->be_previous[0] = 0;
+    ctx->be_previous[1] = size - 1;
 
 }
 
 er_StatusEnum er_begin(er_PrimitiveEnum primitive){
+    er_Context *ctx = current_context;
+    if(ctx == NULL){
+        return ER_INVALID_OPERATION;
+    }
+    if(update_framebuffer_state(ctx) != ER_NO_ERROR){
+        return ER_INVALID_OPERATION;
+    }
     //Update matrix data
-    update_matrix_data();
+    update_matrix_data(ctx);
     //Reset internal buffers size
-    reset_buffers_size();
+    reset_buffers_size(ctx);
     //Update global state
-    update_uniform_vars();
-    if(primitive == ER_POINTS){
-        be_process_func = process_points;
-        batch_size = POINTS_BATCH_SIZE;
-    }else if(primitive == ER_LINES){
-        be_process_func = process_lines;
-        batch_size = LINES_BATCH_SIZE * 2;
-    }else if(primitive == ER_TRIANGLES){
-        be_process_func = process_triangles;
-        batch_size = TRIANGLES_BATCH_SIZE * 3;
-    }else{
-        be_process_func = NULL;
+    update_uniform_vars(ctx);
+    if(primitive_batch(primitive, &ctx->be_process_func, &ctx->be_batch_size) == ER_FALSE){
+        ctx->be_process_func = NULL;
         return ER_INVALID_ARGUMENT;
     }
+    ctx->be_primitive = primitive;
+    ctx->be_vertex_count = 0;
+    ctx->be_first = 0;
+    ctx->be_previous[0] = 0;
+    ctx->be_previous[1] = 0;
     return ER_NO_ERROR;
 }
 
 void er_end(){
-    if(be_process_func != NULL && input_buffer_size > 0){
-        be_process_func();
+    er_Context *ctx = current_context;
+    /* Closing line of a loop */
+    if(ctx->be_process_func != NULL && ctx->be_primitive == ER_LINE_LOOP && ctx->be_vertex_count >= 2){
+        ctx->input_indices[ctx->input_indices_size++] = ctx->be_previous[1];
+        ctx->input_indices[ctx->input_indices_size++] = ctx->be_first;
     }
-    be_process_func = NULL;
+    if(ctx->be_process_func != NULL && ctx->input_indices_size > 0){
+        ctx->be_process_func(ctx);
+    }
+    flush_tiles(ctx);
+    ctx->be_process_func = NULL;
 }
 
 void er_normal3f(float nx, float ny, float nz){
-    current_normal[VAR_X] = nx;
-    current_normal[VAR_Y] = ny;
-    current_normal[VAR_Z] = nz;
+    er_Context *ctx = current_context;
+    ctx->current_normal[VAR_X] = nx;
+    ctx->current_normal[VAR_Y] = ny;
+    ctx->current_normal[VAR_Z] = nz;
 }
 
 er_StatusEnum er_normal3fv(float *normal){
+    er_Context *ctx = current_context;
     if(normal != NULL){
-        current_normal[VAR_X] = normal[VAR_X];
-        current_normal[VAR_Y] = normal[VAR_Y];
-        current_normal[VAR_Z] = normal[VAR_Z];
+        ctx->current_normal[VAR_X] = normal[VAR_X];
+        ctx->current_normal[VAR_Y] = normal[VAR_Y];
+        ctx->current_normal[VAR_Z] = normal[VAR_Z];
     }else{
         return ER_NULL_POINTER;
     }
@@ -335,18 +685,20 @@ er_StatusEnum er_normal3fv(float *normal){
 }
 
 void er_color3f(float r, float g, float b){
-    current_color[VAR_R] = r;
-    current_color[VAR_G] = g;
-    current_color[VAR_B] = b;
-    current_color[VAR_A] = 1.0f;
+    er_Context *ctx = current_context;
+    ctx->current_color[VAR_R] = r;
+    ctx->current_color[VAR_G] = g;
+    ctx->current_color[VAR_B] = b;
+    ctx->current_color[VAR_A] = 1.0f;
 }
 
 er_StatusEnum er_color3fv(float *color){
+    er_Context *ctx = current_context;
     if(color != NULL){
-        current_color[VAR_R] = color[VAR_R];
-        current_color[VAR_G] = color[VAR_G];
-        current_color[VAR_B] = color[VAR_B];
-        current_color[VAR_A] = 1.0f;
+        ctx->current_color[VAR_R] = color[VAR_R];
+        ctx->current_color[VAR_G] = color[VAR_G];
+        ctx->current_color[VAR_B] = color[VAR_B];
+        ctx->current_color[VAR_A] = 1.0f;
     }else{
         return ER_NULL_POINTER;
     }
@@ -354,18 +706,20 @@ er_StatusEnum er_color3fv(float *color){
 }
 
 void er_color4f(float r, float g, float b, float a){
-    current_color[VAR_R] = r;
-    current_color[VAR_G] = g;
-    current_color[VAR_B] = b;
-    current_color[VAR_A] = a;
+    er_Context *ctx = current_context;
+    ctx->current_color[VAR_R] = r;
+    ctx->current_color[VAR_G] = g;
+    ctx->current_color[VAR_B] = b;
+    ctx->current_color[VAR_A] = a;
 }
 
 er_StatusEnum er_color4fv(float *color){
+    er_Context *ctx = current_context;
     if(color != NULL){
-        current_color[VAR_R] = color[VAR_R];
-        current_color[VAR_G] = color[VAR_G];
-        current_color[VAR_B] = color[VAR_B];
-        current_color[VAR_A] = color[VAR_A];
+        ctx->current_color[VAR_R] = color[VAR_R];
+        ctx->current_color[VAR_G] = color[VAR_G];
+        ctx->current_color[VAR_B] = color[VAR_B];
+        ctx->current_color[VAR_A] = color[VAR_A];
     }else{
         return ER_NULL_POINTER;
     }
@@ -373,18 +727,20 @@ er_StatusEnum er_color4fv(float *color){
 }
 
 void er_tex_coord1f(float s){
-    current_tex_coord[VAR_S] = s;
-    current_tex_coord[VAR_T] = 0.0f;
-    current_tex_coord[VAR_P] = 0.0f;
-    current_tex_coord[VAR_Q] = 1.0f;
+    er_Context *ctx = current_context;
+    ctx->current_tex_coord[VAR_S] = s;
+    ctx->current_tex_coord[VAR_T] = 0.0f;
+    ctx->current_tex_coord[VAR_P] = 0.0f;
+    ctx->current_tex_coord[VAR_Q] = 1.0f;
 }
 
 er_StatusEnum er_tex_coord1fv(float *tex_coord){
+    er_Context *ctx = current_context;
     if(tex_coord != NULL){
-        current_tex_coord[VAR_S] = tex_coord[VAR_S];
-        current_tex_coord[VAR_T] = 0.0f;
-        current_tex_coord[VAR_P] = 0.0f;
-        current_tex_coord[VAR_Q] = 1.0f;
+        ctx->current_tex_coord[VAR_S] = tex_coord[VAR_S];
+        ctx->current_tex_coord[VAR_T] = 0.0f;
+        ctx->current_tex_coord[VAR_P] = 0.0f;
+        ctx->current_tex_coord[VAR_Q] = 1.0f;
     }else{
         return ER_NULL_POINTER;
     }
@@ -392,18 +748,20 @@ er_StatusEnum er_tex_coord1fv(float *tex_coord){
 }
 
 void er_tex_coord2f(float s, float t){
-    current_tex_coord[VAR_S] = s;
-    current_tex_coord[VAR_T] = t;
-    current_tex_coord[VAR_P] = 0.0f;
-    current_tex_coord[VAR_Q] = 1.0f;
+    er_Context *ctx = current_context;
+    ctx->current_tex_coord[VAR_S] = s;
+    ctx->current_tex_coord[VAR_T] = t;
+    ctx->current_tex_coord[VAR_P] = 0.0f;
+    ctx->current_tex_coord[VAR_Q] = 1.0f;
 }
 
 er_StatusEnum er_tex_coord2fv(float *tex_coord){
+    er_Context *ctx = current_context;
     if(tex_coord != NULL){
-        current_tex_coord[VAR_S] = tex_coord[VAR_S];
-        current_tex_coord[VAR_T] = tex_coord[VAR_T];
-        current_tex_coord[VAR_P] = 0.0f;
-        current_tex_coord[VAR_Q] = 1.0f;
+        ctx->current_tex_coord[VAR_S] = tex_coord[VAR_S];
+        ctx->current_tex_coord[VAR_T] = tex_coord[VAR_T];
+        ctx->current_tex_coord[VAR_P] = 0.0f;
+        ctx->current_tex_coord[VAR_Q] = 1.0f;
     }else{
         return ER_NULL_POINTER;
     }
@@ -411,18 +769,20 @@ er_StatusEnum er_tex_coord2fv(float *tex_coord){
 }
 
 void er_tex_coord3f(float s, float t, float r){
-    current_tex_coord[VAR_S] = s;
-    current_tex_coord[VAR_T] = t;
-    current_tex_coord[VAR_P] = r;
-    current_tex_coord[VAR_Q] = 1.0f;
+    er_Context *ctx = current_context;
+    ctx->current_tex_coord[VAR_S] = s;
+    ctx->current_tex_coord[VAR_T] = t;
+    ctx->current_tex_coord[VAR_P] = r;
+    ctx->current_tex_coord[VAR_Q] = 1.0f;
 }
 
 er_StatusEnum er_tex_coord3fv(float *tex_coord){
+    er_Context *ctx = current_context;
     if(tex_coord != NULL){
-        current_tex_coord[VAR_S] = tex_coord[VAR_S];
-        current_tex_coord[VAR_T] = tex_coord[VAR_T];
-        current_tex_coord[VAR_P] = tex_coord[VAR_P];
-        current_tex_coord[VAR_Q] = 1.0f;
+        ctx->current_tex_coord[VAR_S] = tex_coord[VAR_S];
+        ctx->current_tex_coord[VAR_T] = tex_coord[VAR_T];
+        ctx->current_tex_coord[VAR_P] = tex_coord[VAR_P];
+        ctx->current_tex_coord[VAR_Q] = 1.0f;
     }else{
         return ER_NULL_POINTER;
     }
@@ -430,18 +790,20 @@ er_StatusEnum er_tex_coord3fv(float *tex_coord){
 }
 
 void er_tex_coord4f(float s, float t, float r, float q){
-    current_tex_coord[VAR_S] = s;
-    current_tex_coord[VAR_T] = t;
-    current_tex_coord[VAR_P] = r;
-    current_tex_coord[VAR_Q] = q;
+    er_Context *ctx = current_context;
+    ctx->current_tex_coord[VAR_S] = s;
+    ctx->current_tex_coord[VAR_T] = t;
+    ctx->current_tex_coord[VAR_P] = r;
+    ctx->current_tex_coord[VAR_Q] = q;
 }
 
 er_StatusEnum er_tex_coord4fv(float *tex_coord){
+    er_Context *ctx = current_context;
     if(tex_coord != NULL){
-        current_tex_coord[VAR_S] = tex_coord[VAR_S];
-        current_tex_coord[VAR_T] = tex_coord[VAR_T];
-        current_tex_coord[VAR_P] = tex_coord[VAR_P];
-        current_tex_coord[VAR_Q] = tex_coord[VAR_Q];
+        ctx->current_tex_coord[VAR_S] = tex_coord[VAR_S];
+        ctx->current_tex_coord[VAR_T] = tex_coord[VAR_T];
+        ctx->current_tex_coord[VAR_P] = tex_coord[VAR_P];
+        ctx->current_tex_coord[VAR_Q] = tex_coord[VAR_Q];
     }else{
         return ER_NULL_POINTER;
     }
@@ -449,12 +811,14 @@ er_StatusEnum er_tex_coord4fv(float *tex_coord){
 }
 
 void er_fog_coordf(float fog_coord){
-    current_fog_coord = fog_coord;
+    er_Context *ctx = current_context;
+    ctx->current_fog_coord = fog_coord;
 }
 
 er_StatusEnum er_fog_coordfv(float *fog_coord){
+    er_Context *ctx = current_context;
     if(fog_coord != NULL){
-        current_fog_coord = *fog_coord;
+        ctx->current_fog_coord = *fog_coord;
     }else{
         return ER_NULL_POINTER;
     }
@@ -489,7 +853,9 @@ er_StatusEnum er_vertex3fv(float *point){
 
 void er_vertex4f(float x, float y, float z, float w){
 
-    if(be_process_func == NULL) {
+    er_Context *ctx = current_context;
+
+    if(ctx->be_process_func == NULL) {
         return;
     }
 
@@ -497,31 +863,31 @@ void er_vertex4f(float x, float y, float z, float w){
     unsigned int output_index;
 
     /* Get index of new vertex on input buffer*/
-    output_index = input_buffer_size++;
-    /* Add index to array of indices */
-    input_indices[input_indices_size++] = output_index;
+    output_index = ctx->input_buffer_size++;
+    /* Add indices of the primitives completed by the vertex */
+    assemble_vertex(ctx, output_index);
     /* Add new vertex to input buffer */
-    vertex = &input_buffer[output_index];
+    vertex = &ctx->input_buffer[output_index];
     vertex->position[VAR_X] = x;
     vertex->position[VAR_Y] = y;
     vertex->position[VAR_Z] = z;
     vertex->position[VAR_W] = w;
-    vertex->color[VAR_R] = current_color[VAR_R];
-    vertex->color[VAR_G] = current_color[VAR_G];
-    vertex->color[VAR_B] = current_color[VAR_B];
-    vertex->color[VAR_A] = current_color[VAR_A];
-    vertex->normal[VAR_X] = current_normal[VAR_X];
-    vertex->normal[VAR_Y] = current_normal[VAR_Y];
-    vertex->normal[VAR_Z] = current_normal[VAR_Z];
-    vertex->tex_coord[VAR_S] = current_tex_coord[VAR_S];
-    vertex->tex_coord[VAR_T] = current_tex_coord[VAR_T];
-    vertex->tex_coord[VAR_P] = current_tex_coord[VAR_P];
-    vertex->tex_coord[VAR_Q] = current_tex_coord[VAR_Q];
-    vertex->fog_coord = current_fog_coord;
+    vertex->color[VAR_R] = ctx->current_color[VAR_R];
+    vertex->color[VAR_G] = ctx->current_color[VAR_G];
+    vertex->color[VAR_B] = ctx->current_color[VAR_B];
+    vertex->color[VAR_A] = ctx->current_color[VAR_A];
+    vertex->normal[VAR_X] = ctx->current_normal[VAR_X];
+    vertex->normal[VAR_Y] = ctx->current_normal[VAR_Y];
+    vertex->normal[VAR_Z] = ctx->current_normal[VAR_Z];
+    vertex->tex_coord[VAR_S] = ctx->current_tex_coord[VAR_S];
+    vertex->tex_coord[VAR_T] = ctx->current_tex_coord[VAR_T];
+    vertex->tex_coord[VAR_P] = ctx->current_tex_coord[VAR_P];
+    vertex->tex_coord[VAR_Q] = ctx->current_tex_coord[VAR_Q];
+    vertex->fog_coord = ctx->current_fog_coord;
 
     /* Verify batch size and process geometry */
-    if(input_buffer_size >= batch_size){
-        be_process_func();
+    if(ctx->input_buffer_size >= ctx->be_batch_size || ctx->input_indices_size >= ctx->be_batch_size){
+        process_begin_end_batch(ctx);
     }
 
 }
@@ -535,362 +901,578 @@ er_StatusEnum er_vertex4fv(float *point){
     return ER_NO_ERROR;
 }
 
+/*
+ * Fill the input buffer with the vertices [begin, end) of the list of primitives assembled from the count indices.
+ * Vertices repeated on the batch are assembled once, vertices found on the post-transform cache aren't shaded
+ * again and go after the input vertices.
+*/
+static void assemble_indexed_batch(er_Context *ctx, er_PrimitiveEnum primitive, unsigned int *index, unsigned int count,
+                                   unsigned int begin, unsigned int end, unsigned long *hits){
+
+    unsigned int i, element, output_index;
+    int entry;
+
+    clear_batch_cache(ctx);
+    for(i = begin; i < end; i++){
+        element = index[assembled_vertex(primitive, i, count)];
+        if(hit_batch_cache(ctx, element, &output_index) == ER_TRUE){
+            (*hits)++;
+        }else if(ctx->vertex_cache_size > 0 && (entry = hit_vertex_cache(ctx, element)) >= 0){
+            output_index = CACHED_VERTEX | ctx->cached_vertices_size;
+            ctx->cached_vertices[ctx->cached_vertices_size++] = entry;
+            write_batch_cache(ctx, element, output_index);
+            (*hits)++;
+        }else{
+            output_index = ctx->input_buffer_size++;
+            vertex_assembly(ctx, ctx->current_vertex_array, &ctx->input_buffer[output_index], element);
+            ctx->input_elements[output_index] = element;
+            write_batch_cache(ctx, element, output_index);
+        }
+        ctx->input_indices[ctx->input_indices_size++] = output_index;
+    }
+    if(ctx->cached_vertices_size > 0){
+        for(i = 0; i < ctx->input_indices_size; i++){
+            if(ctx->input_indices[i] & CACHED_VERTEX){
+                ctx->input_indices[i] = ctx->input_buffer_size + (ctx->input_indices[i] & ~CACHED_VERTEX);
+            }
+        }
+    }
+
+}
+
+/*
+ * Fill the input buffer with the vertices [begin, end) of the list of primitives assembled from count vertices,
+ * vertices shared by the primitives of the batch are assembled once.
+*/
+static void assemble_array_batch(er_Context *ctx, er_PrimitiveEnum primitive, unsigned int first, unsigned int count,
+                                 unsigned int begin, unsigned int end){
+
+    unsigned int i, element, output_index;
+
+    clear_batch_cache(ctx);
+    for(i = begin; i < end; i++){
+        element = first + assembled_vertex(primitive, i, count);
+        if(hit_batch_cache(ctx, element, &output_index) == ER_FALSE){
+            output_index = ctx->input_buffer_size++;
+            vertex_assembly(ctx, ctx->current_vertex_array, &ctx->input_buffer[output_index], element);
+            write_batch_cache(ctx, element, output_index);
+        }
+        ctx->input_indices[ctx->input_indices_size++] = output_index;
+    }
+
+}
+
+/*
+ * Instance seen by the vertex shader, with its row of the instance array.
+*/
+static void update_instance_vars(er_Context *ctx, unsigned int instance){
+
+    struct attribute_array *instance_array = &ctx->current_vertex_array->instance;
+    ctx->global_variables.instance_id = instance;
+    if(instance_array->enabled == ER_TRUE && instance_array->pointer != NULL){
+        ctx->global_variables.instance_attributes = instance_array->pointer + instance * instance_array->stride;
+    }else{
+        ctx->global_variables.instance_attributes = NULL;
+    }
+
+}
+
+/*
+ * Process the primitives of the input buffer once per instance. The assembled vertices
+ * are kept on the input buffer between instances.
+*/
+static void process_instances(er_Context *ctx, void (*process_func)(er_Context*), unsigned int instance_count){
+
+    unsigned int instance;
+    unsigned int input_buffer_size = ctx->input_buffer_size;
+    unsigned int input_indices_size = ctx->input_indices_size;
+    unsigned int cached_vertices_size = ctx->cached_vertices_size;
+
+    for(instance = 0; instance < instance_count; instance++){
+        update_instance_vars(ctx, instance);
+        ctx->input_buffer_size = input_buffer_size;
+        ctx->input_indices_size = input_indices_size;
+        ctx->cached_vertices_size = cached_vertices_size;
+        process_func(ctx);
+    }
+
+}
+
 er_StatusEnum er_draw_elements(er_PrimitiveEnum primitive, unsigned int indices_size, unsigned int *index){
+    return er_draw_elements_instanced(primitive, indices_size, index, 1);
+}
 
-    if(current_program == NULL){
+er_StatusEnum er_draw_elements_instanced(er_PrimitiveEnum primitive, unsigned int indices_size, unsigned int *index, unsigned int instance_count){
+
+    er_Context *ctx = current_context;
+    if(ctx == NULL){
+        return ER_INVALID_OPERATION;
+    }
+
+    if(ctx->current_program == NULL){
         return ER_NO_PROGRAM_SET;
     }
-    if(current_vertex_array == NULL){
+    if(update_framebuffer_state(ctx) != ER_NO_ERROR){
+        return ER_INVALID_OPERATION;
+    }
+    if(ctx->current_vertex_array == NULL){
         return ER_NO_VERTEX_ARRAY_SET;
     }
-    if(indices_size == 0){
+    if(indices_size == 0 || instance_count == 0){
         return ER_INVALID_ARGUMENT;
     }
     if(index == NULL){
         return ER_INVALID_ARGUMENT;
     }
-    if(primitive != ER_POINTS && primitive != ER_LINES && primitive != ER_TRIANGLES){
+
+    unsigned int b, begin, end, batch_number, batch_size, size, instance;
+    void (*process_func)(er_Context*) = NULL;
+
+    if(primitive_batch(primitive, &process_func, &batch_size) == ER_FALSE){
         return ER_INVALID_ARGUMENT;
     }
 
-    update_matrix_data();
-    update_uniform_vars();
-    reset_buffers_size();
-    be_process_func = NULL;
-
-    unsigned int output_index, i, b, begin, end, batch_number, batch_size;
-    void (*process_func)(void) = NULL;
-
-    if(primitive == ER_POINTS){
-        batch_size = POINTS_BATCH_SIZE;
-        process_func = process_points;
-    }else if(primitive == ER_LINES){
-        batch_size = LINES_BATCH_SIZE * 2;
-        process_func = process_lines;
-    }else if(primitive == ER_TRIANGLES){
-        batch_size = TRIANGLES_BATCH_SIZE * 3;
-        process_func = process_triangles;
-    }
-
-    batch_number = indices_size / batch_size;
-
-    for(b = 0; b < batch_number; b++){
-        /* Clear cache */
-        clear_vertex_cache();
-        /* Fill input buffer with vertex data */
-        begin = b * batch_size;
-        end = begin + batch_size;
-        for(i = begin; i < end; i++){
-            if(hit_cache(index[i], &output_index) == ER_FALSE){
-                output_index = input_buffer_size++;
-                vertex_assembly(current_vertex_array, &input_buffer[output_index], index[i]);
-                write_cache(index[i], output_index);
+    update_matrix_data(ctx);
+    update_uniform_vars(ctx);
+    reset_buffers_size(ctx);
+    ctx->be_process_func = NULL;
+
+    unsigned long hits = 0;
+
+    /* Batches hold whole primitives of the assembled list */
+    size = assembled_size(primitive, indices_size);
+    batch_number = size / batch_size;
+
+    if(size <= batch_size){
+        /* The mesh fits on one batch, it's assembled once for all the instances */
+        ctx->vertex_cache_generation++;
+        assemble_indexed_batch(ctx, primitive, index, indices_size, 0, size, &hits);
+        process_instances(ctx, process_func, instance_count);
+        reset_buffers_size(ctx);
+        hits *= instance_count;
+    }else{
+        /* Shaded vertices are shared by the batches of each instance */
+        ctx->vertex_cache_write = (ctx->vertex_cache_size > 0) ? ER_TRUE: ER_FALSE;
+        for(instance = 0; instance < instance_count; instance++){
+            update_instance_vars(ctx, instance);
+            ctx->vertex_cache_generation++;
+            for(b = 0; b < batch_number; b++){
+                /* Fill input buffer with vertex data */
+                begin = b * batch_size;
+                end = begin + batch_size;
+                assemble_indexed_batch(ctx, primitive, index, indices_size, begin, end, &hits);
+                /* Process batch of primitives */
+                process_func(ctx);
             }
-            input_indices[input_indices_size++] = output_index;
-        }
-        /* Process batch of primitives */
-        process_func();
-    }
-
-    if(indices_size > batch_number * batch_size){
-        /* Clear cache */
-        clear_vertex_cache();
-        /* Fill input buffer with vertex data */
-        begin = batch_number * batch_size;
-        end = indices_size;
-        for(i = begin; i < end; i++){
-            if(hit_cache(index[i], &output_index) == ER_FALSE){
-                output_index = input_buffer_size++;
-                vertex_assembly(current_vertex_array, &input_buffer[output_index], index[i]);
-                write_cache(index[i], output_index);
+            if(size > batch_number * batch_size){
+                /* Fill input buffer with vertex data */
+                begin = batch_number * batch_size;
+                end = size;
+                assemble_indexed_batch(ctx, primitive, index, indices_size, begin, end, &hits);
+                /* Process batch of primitives */
+                process_func(ctx);
             }
-            input_indices[input_indices_size++] = output_index;
         }
-        /* Process batch of primitives */
-        process_func();
+        ctx->vertex_cache_write = ER_FALSE;
     }
+    add_statistic(&ctx->statistics.vertex_cache_hits, hits);
+    add_statistic(&ctx->statistics.vertex_cache_misses, (unsigned long)size * instance_count - hits);
+
+    /* Rasterize binned primitives */
+    flush_tiles(ctx);
 
     return ER_NO_ERROR;
 
 }
 
 er_StatusEnum er_draw_arrays(er_PrimitiveEnum primitive, unsigned int first, unsigned int count){
+    return er_draw_arrays_instanced(primitive, first, count, 1);
+}
+
+er_StatusEnum er_draw_arrays_instanced(er_PrimitiveEnum primitive, unsigned int first, unsigned int count, unsigned int instance_count){
 
-    if(current_program == NULL){
+    er_Context *ctx = current_context;
+    if(ctx == NULL){
+        return ER_INVALID_OPERATION;
+    }
+
+    if(ctx->current_program == NULL){
         return ER_NO_PROGRAM_SET;
     }
-    if(current_vertex_array == NULL){
-        return ER_INVALID_ARGUMENT;
+    if(update_framebuffer_state(ctx) != ER_NO_ERROR){
+        return ER_INVALID_OPERATION;
     }
-    if(count == 0){
+    if(ctx->current_vertex_array == NULL){
         return ER_INVALID_ARGUMENT;
     }
-    if(primitive != ER_POINTS && primitive != ER_LINES && primitive != ER_TRIANGLES){
+    if(count == 0 || instance_count == 0){
         return ER_INVALID_ARGUMENT;
     }
 
-    update_matrix_data();
-    update_uniform_vars();
-    reset_buffers_size();
-    be_process_func = NULL;
+    unsigned int b, begin, end, batch_number, batch_size, size, instance;
+    void (*process_func)(er_Context*) = NULL;
 
-    unsigned int output_index, i, b, begin, end, batch_number, batch_size;
-    void (*process_func)(void) = NULL;
-
-    if(primitive == ER_POINTS){
-        batch_size = POINTS_BATCH_SIZE;
-        process_func = process_points;
-    }else if(primitive == ER_LINES){
-        batch_size = LINES_BATCH_SIZE * 2;
-        process_func = process_lines;
-    }else if(primitive == ER_TRIANGLES){
-        batch_size = TRIANGLES_BATCH_SIZE * 3;
-        process_func = process_triangles;
+    if(primitive_batch(primitive, &process_func, &batch_size) == ER_FALSE){
+        return ER_INVALID_ARGUMENT;
     }
 
-    batch_number = count / batch_size;
+    update_matrix_data(ctx);
+    update_uniform_vars(ctx);
+    reset_buffers_size(ctx);
+    ctx->be_process_func = NULL;
 
-    for(b = 0; b < batch_number; b++){
-        /* Fill input buffer with vertex data */
-        begin = b * batch_size;
-        end = begin + batch_size;
-        for(i = begin; i < end; i++){
-            output_index = input_buffer_size++;
-            vertex_assembly(current_vertex_array, &input_buffer[output_index], first + i);
-            input_indices[input_indices_size++] = output_index;
-        }
-        /* Process batch of primitives */
-        process_func();
-    }
-
-    if(count > batch_number * batch_size){
-        /* Fill input buffer with vertex data */
-        begin = batch_number * batch_size;
-        end = count;
-        for(i = begin; i < end; i++){
-            output_index = input_buffer_size++;
-            vertex_assembly(current_vertex_array, &input_buffer[output_index], first + i);
-            input_indices[input_indices_size++] = output_index;
+    /* Batches hold whole primitives of the assembled list */
+    size = assembled_size(primitive, count);
+    batch_number = size / batch_size;
+
+    if(size <= batch_size){
+        /* The mesh fits on one batch, it's assembled once for all the instances */
+        assemble_array_batch(ctx, primitive, first, count, 0, size);
+        process_instances(ctx, process_func, instance_count);
+        reset_buffers_size(ctx);
+    }else{
+        for(instance = 0; instance < instance_count; instance++){
+            update_instance_vars(ctx, instance);
+            for(b = 0; b < batch_number; b++){
+                /* Fill input buffer with vertex data */
+                begin = b * batch_size;
+                end = begin + batch_size;
+                assemble_array_batch(ctx, primitive, first, count, begin, end);
+                /* Process batch of primitives */
+                process_func(ctx);
+            }
+            if(size > batch_number * batch_size){
+                /* Fill input buffer with vertex data */
+                begin = batch_number * batch_size;
+                end = size;
+                assemble_array_batch(ctx, primitive, first, count, begin, end);
+                /* Process batch of primitives */
+                process_func(ctx);
+            }
         }
-        /* Process batch of primitives */
-        process_func();
     }
+
+    /* Rasterize binned primitives */
+    flush_tiles(ctx);
+
     return ER_NO_ERROR;
 }
 
-void post_clipping_operations(er_VertexOutput *vertex){
-
-    /* Homogeneous division  */
-    if(current_program->homogeneous_division != NULL){
-        current_program->homogeneous_division(vertex);
+void post_clipping_operations(er_Context *ctx, er_VertexOutput *vertex){
+
+    int k;
+    /* Homogeneous division, done by the library for perspective correct interpolation */
+    if(ctx->perspective_correction_enable == ER_TRUE){
+        float one_over_w = 1.0f / vertex->position[VAR_W];
+        vertex->position[VAR_X] *= one_over_w;
+        vertex->position[VAR_Y] *= one_over_w;
+        vertex->position[VAR_Z] *= one_over_w;
+        for(k = 0; k < ctx->current_program->interpolated_attributes; k++){
+            if(ctx->current_program->interpolation[k] == ER_SMOOTH){
+                vertex->attributes[k] *= one_over_w;
+            }
+        }
+        vertex->position[VAR_W] = one_over_w;
+    }else if(ctx->current_program->homogeneous_division != NULL){
+        ctx->current_program->homogeneous_division(vertex);
     }
 
     /* Window to viewport transformation, and conversion of additional parameters */
-    vertex->position[VAR_X] = - 0.5f + ( window_width - 0.001f) * ( vertex->position[VAR_X] + 1.0f ) / 2.0f;
-    vertex->position[VAR_Y] = - 0.5f + ( window_height - 0.001f) * ( vertex->position[VAR_Y] + 1.0f ) / 2.0f;
+    vertex->position[VAR_X] = - 0.5f + ( ctx->window_width - 0.001f) * ( vertex->position[VAR_X] + 1.0f ) / 2.0f;
+    vertex->position[VAR_Y] = - 0.5f + ( ctx->window_height - 0.001f) * ( vertex->position[VAR_Y] + 1.0f ) / 2.0f;
     vertex->position[VAR_Z] = ( -vertex->position[VAR_Z] + 1.0f) / 2.0f;
 
+    /* Attributes interpolated by the rasterizer variant beyond the ones of the program */
+    for(k = ctx->current_program->varying_attributes; k < ctx->current_program->rasterizer->varying_attributes; k++){
+        vertex->attributes[k] = 0.0f;
+    }
+
+}
+
+/*
+ * Run the vertex shader on the input buffer, in groups of ER_VERTEX_BATCH_SIZE vertices
+ * transposed to arrays when the program has a batch vertex shader, and compute the outcodes of each group.
+ * Vertices found on the post-transform cache are copied after the shaded ones.
+*/
+static void process_vertices(er_Context *ctx){
+
+    er_VertexBatchInput batch_input;
+    er_VertexBatchOutput batch_output;
+    unsigned int outcodes[ER_VERTEX_BATCH_SIZE];
+    unsigned int begin, i, size;
+    int k, varyings = ctx->current_program->varying_attributes;
+
+    for(begin = 0; begin < ctx->input_buffer_size; begin += ER_VERTEX_BATCH_SIZE){
+        size = min(ER_VERTEX_BATCH_SIZE, ctx->input_buffer_size - begin);
+        er_VertexInput *input = &ctx->input_buffer[begin];
+        OutputBufferRegister *output = &ctx->output_buffer[begin];
+        if(ctx->current_program->vertex_batch_shader != NULL){
+            for(i = 0; i < size; i++){
+                for(k = 0; k < 4; k++){
+                    batch_input.position[k][i] = input[i].position[k];
+                    batch_input.color[k][i] = input[i].color[k];
+                    batch_input.tex_coord[k][i] = input[i].tex_coord[k];
+                }
+                for(k = 0; k < 3; k++){
+                    batch_input.normal[k][i] = input[i].normal[k];
+                }
+                batch_input.fog_coord[i] = input[i].fog_coord;
+            }
+            batch_input.size = size;
+            ctx->current_program->vertex_batch_shader(&batch_input, &batch_output, &ctx->global_variables);
+            for(i = 0; i < size; i++){
+                for(k = 0; k < 4; k++){
+                    output[i].vertex.position[k] = batch_output.position[k][i];
+                }
+                for(k = 0; k < varyings; k++){
+                    output[i].vertex.attributes[k] = batch_output.attributes[k][i];
+                }
+                output[i].vertex.point_size = batch_output.point_size[i];
+            }
+        }else{
+            for(i = 0; i < size; i++){
+                ctx->current_program->vertex_shader(&input[i], &output[i].vertex, &ctx->global_variables);
+                for(k = 0; k < 4; k++){
+                    batch_output.position[k][i] = output[i].vertex.position[k];
+                }
+            }
+        }
+        calculate_outcodes(batch_output.position, outcodes, size);
+        for(i = 0; i < size; i++){
+            output[i].outcode = outcodes[i];
+            output[i].processed = ER_FALSE;
+        }
+    }
+
+    /* Vertices taken from the post-transform cache follow the shaded ones */
+    for(i = 0; i < ctx->cached_vertices_size; i++){
+        VertexCacheRegister *entry = &ctx->vertex_cache[ctx->cached_vertices[i]];
+        OutputBufferRegister *output = &ctx->output_buffer[ctx->input_buffer_size + i];
+        output->vertex = entry->vertex;
+        output->outcode = entry->outcode;
+        output->processed = ER_FALSE;
+    }
+    /* Shaded vertices are kept for the next batches of the draw call */
+    if(ctx->vertex_cache_write == ER_TRUE){
+        for(i = 0; i < ctx->input_buffer_size; i++){
+            write_vertex_cache(ctx, ctx->input_elements[i], &ctx->output_buffer[i]);
+        }
+    }
+    ctx->output_buffer_size = ctx->input_buffer_size + ctx->cached_vertices_size;
+
 }
 
-void process_points(){
+void process_points(er_Context *ctx){
 
     unsigned int i;
 
     /* Vertex Pipeline and outcodes */
-    for(i = 0; i < input_buffer_size; i++){
-        current_program->vertex_shader(&input_buffer[i], &(output_buffer[i].vertex), &global_variables);
-        output_buffer[i].outcode = calculate_outcode(&(output_buffer[i].vertex));
-        output_buffer[i].processed = ER_FALSE;
-    }
-    output_buffer_size = input_buffer_size;
+    process_vertices(ctx);
 
     /* Clipping */
-    for(i = 0; i < input_indices_size; i++){
-        clip_point(input_indices[i]);
+    for(i = 0; i < ctx->input_indices_size; i++){
+        clip_point(ctx, ctx->input_indices[i]);
     }
-    if(output_indices_size == 0){
-        reset_buffers_size();
+    if(ctx->output_indices_size == 0){
+        reset_buffers_size(ctx);
         return;
     }
 
     /* Homogeneous Division, Window to viewport transformation, and depth conversion */
-    for(i = 0; i < output_indices_size; i++){
-        if(output_buffer[ output_indices[i] ].processed == ER_FALSE){
-            post_clipping_operations( &(output_buffer[ output_indices[i] ].vertex) );
-            output_buffer[ output_indices[i] ].processed = ER_TRUE;
+    for(i = 0; i < ctx->output_indices_size; i++){
+        if(ctx->output_buffer[ ctx->output_indices[i] ].processed == ER_FALSE){
+            post_clipping_operations(ctx,  &(ctx->output_buffer[ ctx->output_indices[i] ].vertex) );
+            ctx->output_buffer[ ctx->output_indices[i] ].processed = ER_TRUE;
         }
     }
 
     /* Rasterize Points */
-    if(point_sprite_enable == ER_TRUE){
-        for(i = 0; i < output_indices_size; i++){
-            draw_point_sprite(&(output_buffer[output_indices[i]].vertex), ER_FRONT);
-        }
-    }else{
-        for(i = 0; i < output_indices_size; i++){
-            draw_point(&(output_buffer[output_indices[i]].vertex), ER_FRONT);
-        }
+    for(i = 0; i < ctx->output_indices_size; i++){
+        submit_point(ctx, &(ctx->output_buffer[ctx->output_indices[i]].vertex), ER_FRONT);
     }
 
-    reset_buffers_size();
+    reset_buffers_size(ctx);
 
 }
 
-void process_lines(){
+void process_lines(er_Context *ctx){
 
     unsigned int i, size;
 
     /* Vertex Pipeline and outcodes */
-    for(i = 0; i < input_buffer_size; i++){
-        current_program->vertex_shader(&input_buffer[i], &(output_buffer[i].vertex), &global_variables );
-        output_buffer[i].outcode = calculate_outcode(&(output_buffer[i].vertex));
-        output_buffer[i].processed = ER_FALSE;
-    }
-    output_buffer_size = input_buffer_size;
+    process_vertices(ctx);
 
     /* Clipping */
-    size = input_indices_size / 2 * 2;
+    size = ctx->input_indices_size / 2 * 2;
     for(i = 0; i < size; i+=2){
-        clip_line(input_indices[i], input_indices[i+1]);
+        clip_line(ctx, ctx->input_indices[i], ctx->input_indices[i+1]);
     }
-    if(output_indices_size == 0){
-        reset_buffers_size();
+    if(ctx->output_indices_size == 0){
+        reset_buffers_size(ctx);
         return;
     }
 
     /* Homogeneous Division, Window to viewport transformation, and depth conversion */
-    size = output_indices_size / 2 * 2;
+    size = ctx->output_indices_size / 2 * 2;
     for(i = 0; i < size; i++){
-        if(output_buffer[ output_indices[i] ].processed == ER_FALSE){
-            post_clipping_operations( &(output_buffer[ output_indices[i] ].vertex) );
-            output_buffer[ output_indices[i] ].processed = ER_TRUE;
+        if(ctx->output_buffer[ ctx->output_indices[i] ].processed == ER_FALSE){
+            post_clipping_operations(ctx,  &(ctx->output_buffer[ ctx->output_indices[i] ].vertex) );
+            ctx->output_buffer[ ctx->output_indices[i] ].processed = ER_TRUE;
         }
     }
 
     /* Rasterize lines */
     for(i = 0; i < size; i+=2){
-        draw_line(&(output_buffer[ output_indices[i] ].vertex), &(output_buffer[ output_indices[i+1] ].vertex), ER_FRONT);
+        submit_line(ctx, &(ctx->output_buffer[ ctx->output_indices[i] ].vertex), &(ctx->output_buffer[ ctx->output_indices[i+1] ].vertex), ER_FRONT);
     }
 
-    reset_buffers_size();
+    reset_buffers_size(ctx);
 
 }
 
-void process_triangles(){
+/*
+ * Face of a polygon from its signed area on window coordinates.
+*/
+static er_PolygonFaceEnum polygon_face(er_Context *ctx, float area, er_PolygonOrientationEnum *orientation){
 
-    unsigned int i, size;
-
-    /* Vertex Pipeline and outcodes */
-    for(i = 0; i < input_buffer_size; i++){
-        current_program->vertex_shader(&input_buffer[i], &(output_buffer[i].vertex), &global_variables);
-        output_buffer[i].outcode = calculate_outcode(&(output_buffer[i].vertex));
-        output_buffer[i].processed = ER_FALSE;
+    if(area >= 0.0f){
+        *orientation = ER_COUNTER_CLOCK_WISE;
+    }else{
+        *orientation = ER_CLOCK_WISE;
     }
-    output_buffer_size = input_buffer_size;
+    return (*orientation == ctx->front_face_orientation) ? ER_FRONT: ER_BACK;
 
-    /* Clipping */
-    size = input_indices_size / 3 * 3;
-    for(i = 0; i < size; i+=3){
-        clip_triangle(input_indices[i], input_indices[i+1], input_indices[i+2]);
+}
+
+static void process_triangle(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2){
+
+    er_PolygonOrientationEnum orientation;
+    er_PolygonFaceEnum face;
+
+    /* Polygon orientation and face determination */
+    float triangle_area = (vertex1->position[VAR_X] - vertex0->position[VAR_X]) * (vertex2->position[VAR_Y] - vertex0->position[VAR_Y]) - 
+    (vertex2->position[VAR_X] - vertex0->position[VAR_X]) * (vertex1->position[VAR_Y] - vertex0->position[VAR_Y]);
+    face = polygon_face(ctx, triangle_area, &orientation);
+
+    /* Backface culling */
+    if(ctx->cull_face_enable == ER_TRUE && face == ctx->cull_face){
+        return;
     }
-    if(output_indices_size == 0){
-        reset_buffers_size();
+
+    /* Polygon mode */
+    er_PolygonModeEnum mode = (face == ER_FRONT) ? ctx->front_face_mode: ctx->back_face_mode;
+    if(mode == ER_LINE){
+        submit_line(ctx, vertex0, vertex1, face);
+        submit_line(ctx, vertex1, vertex2, face);
+        submit_line(ctx, vertex2, vertex0, face);
+        return;
+    }else if(mode == ER_POINT){
+        submit_point(ctx, vertex0, face);
+        submit_point(ctx, vertex1, face);
+        submit_point(ctx, vertex2, face);
         return;
     }
 
-    /* Homogeneous Division, Window to viewport transformation, and depth conversion */
-    size = output_indices_size / 3 * 3;
+    /* Raster triangle, the provoking vertex stays first */
+    if( orientation == ER_COUNTER_CLOCK_WISE){
+        submit_triangle(ctx, vertex0, vertex1, vertex2, face);
+    }else{
+        submit_triangle(ctx, vertex0, vertex2, vertex1, face);
+    }
+
+}
+
+/*
+ * Convex polygon created by clipping a triangle. Filled polygons are rasterized as a whole,
+ * wireframe and point modes draw the triangles of a fan as before clipping.
+*/
+static void process_polygon(er_Context *ctx, unsigned int *indices, unsigned int size){
+
+    er_VertexOutput *vertices[MAX_POLYGON_SIZE];
+    er_PolygonOrientationEnum orientation;
+    er_PolygonFaceEnum face;
+    unsigned int i;
+
     for(i = 0; i < size; i++){
-        if(output_buffer[ output_indices[i] ].processed == ER_FALSE){
-            post_clipping_operations( &(output_buffer[ output_indices[i] ].vertex) );
-            output_buffer[ output_indices[i] ].processed = ER_TRUE;
-        }
+        vertices[i] = &(ctx->output_buffer[ indices[i] ].vertex);
     }
-    er_VertexOutput *vertex0;
-    er_VertexOutput *vertex1;
-    er_VertexOutput *vertex2;
-    float triangle_area = 0.0f;
-    unsigned int orientation, face;
 
-    for(i = 0; i < size; i+=3){
+    /* Signed area, as the sum of the areas of the fan */
+    float area = 0.0f;
+    float x0 = vertices[0]->position[VAR_X], y0 = vertices[0]->position[VAR_Y];
+    for(i = 1; i < size - 1; i++){
+        area += (vertices[i]->position[VAR_X] - x0) * (vertices[i+1]->position[VAR_Y] - y0) -
+                (vertices[i+1]->position[VAR_X] - x0) * (vertices[i]->position[VAR_Y] - y0);
+    }
+    face = polygon_face(ctx, area, &orientation);
 
-        vertex0 = &(output_buffer[ output_indices[i] ].vertex);
-        vertex1 = &(output_buffer[ output_indices[i+1] ].vertex);
-        vertex2 = &(output_buffer[ output_indices[i+2] ].vertex);
+    er_PolygonModeEnum mode = (face == ER_FRONT) ? ctx->front_face_mode: ctx->back_face_mode;
+    if(mode != ER_FILL){
+        for(i = 1; i < size - 1; i++){
+            process_triangle(ctx, vertices[0], vertices[i], vertices[i+1]);
+        }
+        return;
+    }
 
-        /* Polygon orientation and face determination */
-        triangle_area = (vertex1->position[VAR_X] - vertex0->position[VAR_X]) * (vertex2->position[VAR_Y] - vertex0->position[VAR_Y]) - 
-        (vertex2->position[VAR_X] - vertex0->position[VAR_X]) * (vertex1->position[VAR_Y] - vertex0->position[VAR_Y]);
+    /* Backface culling */
+    if(ctx->cull_face_enable == ER_TRUE && face == ctx->cull_face){
+        return;
+    }
 
-        if(triangle_area >= 0.0f){
-            orientation = ER_COUNTER_CLOCK_WISE;
-            if( front_face_orientation == ER_COUNTER_CLOCK_WISE){
-                face = ER_FRONT;
-            }else{
-                face = ER_BACK;
-            }
-        }else{
-            orientation = ER_CLOCK_WISE;
-            if( front_face_orientation == ER_CLOCK_WISE){
-                face = ER_FRONT;
-            }else{
-                face = ER_BACK;
-            }
+    /* Raster polygon on CCW order */
+    if(orientation == ER_CLOCK_WISE){
+        for(i = 0; i < size / 2; i++){
+            er_VertexOutput *vertex = vertices[i];
+            vertices[i] = vertices[size - 1 - i];
+            vertices[size - 1 - i] = vertex;
         }
+    }
+    submit_polygon(ctx, vertices, size, face);
+
+}
+
+void process_triangles(er_Context *ctx){
+
+    unsigned int i, size;
+
+    /* Vertex Pipeline and outcodes */
+    process_vertices(ctx);
 
-        /* Backface culling */
-        if(cull_face_enable == ER_TRUE && face == cull_face){
-            continue;
+    /* Clipping */
+    size = ctx->input_indices_size / 3 * 3;
+    reset_clip_cache(ctx);
+    for(i = 0; i < size; i+=3){
+        if(cull_triangle(ctx, ctx->input_indices[i], ctx->input_indices[i+1], ctx->input_indices[i+2]) == PRIMITIVE_VISIBLE){
+            clip_triangle(ctx, ctx->input_indices[i], ctx->input_indices[i+1], ctx->input_indices[i+2]);
         }
+    }
+    if(ctx->output_indices_size == 0){
+        reset_buffers_size(ctx);
+        return;
+    }
 
-        /* Polygon mode */
-        if(face == ER_FRONT ){
-            if( front_face_mode == ER_LINE){
-                draw_line(vertex0, vertex1, face);
-                draw_line(vertex1, vertex2, face);
-                draw_line(vertex2, vertex0, face);
-                continue;
-            }else if(front_face_mode == ER_POINT){
-                if(point_sprite_enable == ER_TRUE){
-                    draw_point_sprite(vertex0, face);
-                    draw_point_sprite(vertex1, face);
-                    draw_point_sprite(vertex2, face);
-                }else{
-                    draw_point(vertex0, face);
-                    draw_point(vertex1, face);
-                    draw_point(vertex2, face);
-                }
-                continue;
-            }
-        }else if(face == ER_BACK ){
-            if( back_face_mode == ER_LINE){
-                draw_line(vertex0, vertex1, face);
-                draw_line(vertex1, vertex2, face);
-                draw_line(vertex2, vertex0, face);
-                continue;
-            }else if(back_face_mode == ER_POINT){
-                if(point_sprite_enable == ER_TRUE){
-                    draw_point_sprite(vertex0, face);
-                    draw_point_sprite(vertex1, face);
-                    draw_point_sprite(vertex2, face);
-                }else{
-                    draw_point(vertex0, face);
-                    draw_point(vertex1, face);
-                    draw_point(vertex2, face);
-                }
-                continue;
-            }
+    /* Homogeneous Division, Window to viewport transformation, and depth conversion */
+    size = ctx->output_indices_size;
+    for(i = 0; i < size; i++){
+        if(ctx->output_buffer[ ctx->output_indices[i] ].processed == ER_FALSE){
+            post_clipping_operations(ctx,  &(ctx->output_buffer[ ctx->output_indices[i] ].vertex) );
+            ctx->output_buffer[ ctx->output_indices[i] ].processed = ER_TRUE;
         }
+    }
 
-        /* Raster triangle  */
-        if( orientation == ER_COUNTER_CLOCK_WISE){
-            draw_triangle(vertex0, vertex1, vertex2, face);
+    /* Triangles and polygons resulting from clipping */
+    unsigned int first = 0;
+    for(i = 0; i < ctx->output_polygons_size; i++){
+        size = ctx->output_polygon_sizes[i];
+        if(size == 3){
+            process_triangle(ctx, &(ctx->output_buffer[ ctx->output_indices[first] ].vertex), &(ctx->output_buffer[ ctx->output_indices[first+1] ].vertex),
+                             &(ctx->output_buffer[ ctx->output_indices[first+2] ].vertex));
         }else{
-            draw_triangle(vertex2, vertex1, vertex0, face);
+            process_polygon(ctx, &ctx->output_indices[first], size);
         }
-
+        first += size;
     }
 
-    reset_buffers_size();
+    reset_buffers_size(ctx);
 
 }
@@ -1,14 +1,45 @@
 #include "pipeline.h"
 
-er_Program *current_program;
+/*
+ * Flat attributes after the last interpolated one are left out of the rasterizer loops,
+ * which are specialized for the number of interpolated attributes.
+*/
+static void update_interpolation(er_Program *p){
+
+    int k;
+    p->interpolated_attributes = 0;
+    p->flat_attributes = 0;
+    p->interpolated_flat_attributes = 0;
+    for(k = 0; k < p->varying_attributes; k++){
+        if(p->interpolation[k] == ER_FLAT){
+            p->flat_attributes++;
+        }else{
+            p->interpolated_attributes = k + 1;
+        }
+    }
+    for(k = 0; k < p->interpolated_attributes; k++){
+        if(p->interpolation[k] == ER_FLAT){
+            p->interpolated_flat_attributes++;
+        }
+    }
+    p->rasterizer = select_rasterizer(p->interpolated_attributes);
+
+}
 
 er_Program* er_create_program(){
   
     er_Program *new_program = (er_Program*)malloc(sizeof(er_Program));
     if(new_program != NULL) {
+        int k;
+        for(k = 0; k < ATTRIBUTES_SIZE; k++){
+            new_program->interpolation[k] = ER_SMOOTH;
+        }
         new_program->varying_attributes = 0;
+        update_interpolation(new_program);
         new_program->vertex_shader = NULL;
+        new_program->vertex_batch_shader = NULL;
         new_program->fragment_shader = NULL;
+        new_program->fragment_span_shader = NULL;
         new_program->homogeneous_division = NULL;
     }
     return new_program;
@@ -25,10 +56,12 @@ er_StatusEnum er_delete_program(er_Program *p){
 
 er_StatusEnum er_use_program(er_Program *p){
 
+    er_Context *ctx = current_context;
+
     if(p == NULL){
         return ER_NULL_POINTER;
     }
-    current_program = p;
+    ctx->current_program = p;
     return ER_NO_ERROR;
 }
 
@@ -71,7 +104,26 @@ er_StatusEnum er_varying_attributes(er_Program *p, int number){
     if(p == NULL){
         return ER_NULL_POINTER;
     }
+    if(number < 0 || number > ATTRIBUTES_SIZE){
+        return ER_INVALID_ARGUMENT;
+    }
     p->varying_attributes = number;
+    update_interpolation(p);
+    return ER_NO_ERROR;
+}
+
+er_StatusEnum er_varying_interpolation(er_Program *p, unsigned int index, er_InterpolationEnum interpolation){
+    if(p == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(index >= ATTRIBUTES_SIZE){
+        return ER_INVALID_ARGUMENT;
+    }
+    if(interpolation != ER_SMOOTH && interpolation != ER_NOPERSPECTIVE && interpolation != ER_FLAT){
+        return ER_INVALID_ARGUMENT;
+    }
+    p->interpolation[index] = interpolation;
+    update_interpolation(p);
     return ER_NO_ERROR;
 }
 
@@ -87,6 +139,18 @@ er_StatusEnum er_load_fragment_shader(er_Program *p, void (*fragment_shader)(int
     return ER_NO_ERROR;
 }
 
+er_StatusEnum er_load_fragment_span_shader(er_Program *p, void (*fragment_span_shader)(er_FragSpan*, er_UniVars*)){
+
+    if(p == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(fragment_span_shader == NULL){
+        return ER_NULL_POINTER;
+    }
+    p->fragment_span_shader = fragment_span_shader;
+    return ER_NO_ERROR;
+}
+
 er_StatusEnum er_load_vertex_shader(er_Program *p, void (*vertex_shader)(er_VertexInput*, er_VertexOutput*, er_UniVars*) ){
 
     if(p == NULL){
@@ -99,6 +163,18 @@ er_StatusEnum er_load_vertex_shader(er_Program *p, void (*vertex_shader)(er_Vert
     return ER_NO_ERROR;
 }
 
+er_StatusEnum er_load_vertex_batch_shader(er_Program *p, void (*vertex_batch_shader)(er_VertexBatchInput*, er_VertexBatchOutput*, er_UniVars*) ){
+
+    if(p == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(vertex_batch_shader == NULL){
+        return ER_NULL_POINTER;
+    }
+    p->vertex_batch_shader = vertex_batch_shader;
+    return ER_NO_ERROR;
+}
+
 er_StatusEnum er_load_homogeneous_division(er_Program *p, void (*homogeneous_division)(er_VertexOutput*) ){
 
     if(p == NULL){
@@ -1,14 +1,421 @@
+#include <string.h>
 #include "pipeline.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef struct Edge{
-    float x, z, w;
-    float attributes[ATTRIBUTES_SIZE];
-    float attributes_step[ATTRIBUTES_SIZE];
-    float step_x, step_z, step_w;
+    er_VertexOutput *bottom;
+    float x, step_x;
     int start_y, end_y;
 } Edge;
 
-void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face){
+/* Tile columns of a primitive whose Hi-Z decisions are kept by the scanline rasterizers, the next ones are always shaded */
+#define HIZ_BAND_TILES 128
+
+/*
+ * Hi-Z decisions of the tiles crossed by a primitive on the band of HIZ_TILE_SIZE scanlines being drawn,
+ * each tile is tested once per band.
+*/
+typedef struct HizBand{
+    er_VertexOutput *reference;
+    float min_z, max_z;
+    int band_y, first_tile, tiles;
+    unsigned char state[HIZ_BAND_TILES];
+    unsigned long rejected_blocks;
+} HizBand;
+
+/*
+ * Perspective correction. The rasterizer interpolates a/w and 1/w linearly on screen, each fragment
+ * gets a = (a/w) * w, and by the quotient rule its derivatives d(a)/dx = (d(a/w)/dx - a * d(1/w)/dx) * w.
+ * The corrected values go to their own er_FragInput, the interpolated ones are left as they are.
+*/
+static void perspective_attributes(er_Program *program, er_FragInput *input, er_FragInput *corrected, float w){
+
+    int k;
+    for(k = 0; k < program->varying_attributes; k++){
+        if(k >= program->interpolated_attributes || program->interpolation[k] != ER_SMOOTH){
+            corrected->attributes[k] = input->attributes[k];
+            corrected->ddx[k] = input->ddx[k];
+            corrected->ddy[k] = input->ddy[k];
+            continue;
+        }
+        corrected->attributes[k] = input->attributes[k] * w;
+        corrected->ddx[k] = (input->ddx[k] - corrected->attributes[k] * input->dw_dx) * w;
+        corrected->ddy[k] = (input->ddy[k] - corrected->attributes[k] * input->dw_dy) * w;
+    }
+
+}
+
+/*
+ * Copy of the interpolators that don't change along a primitive.
+*/
+static void init_corrected_input(er_FragInput *input, er_FragInput *corrected){
+
+    corrected->dz_dx = input->dz_dx;
+    corrected->dz_dy = input->dz_dy;
+    corrected->dw_dx = input->dw_dx;
+    corrected->dw_dy = input->dw_dy;
+    corrected->point_coord[VAR_X] = input->point_coord[VAR_X];
+    corrected->point_coord[VAR_Y] = input->point_coord[VAR_Y];
+    corrected->point_size = input->point_size;
+    corrected->front_facing = input->front_facing;
+
+}
+
+/*
+ * Run the fragment shader on a perspective corrected copy of the interpolators.
+*/
+void shade_fragment_perspective(er_Context *ctx, int y, int x, er_FragInput *input){
+
+    er_FragInput corrected;
+
+    init_corrected_input(input, &corrected);
+    corrected.frag_coord[VAR_X] = input->frag_coord[VAR_X];
+    corrected.frag_coord[VAR_Y] = input->frag_coord[VAR_Y];
+    corrected.frag_coord[VAR_Z] = input->frag_coord[VAR_Z];
+    corrected.frag_coord[VAR_W] = input->frag_coord[VAR_W];
+    perspective_attributes(ctx->current_program, input, &corrected, 1.0f / input->frag_coord[VAR_W]);
+    run_fragment_shader(ctx, y, x, &corrected);
+
+}
+
+/* Fragments of a scanline corrected together */
+#define PERSPECTIVE_LANES 4
+
+/*
+ * Perspective correction of the fragments [start_x, end_x] of the scanline y for per pixel fragment shaders.
+ * The interpolators are evaluated from row like on shade_scanline, and the reciprocals of 1/w, attributes and
+ * derivatives of PERSPECTIVE_LANES fragments are computed at once.
+*/
+static void shade_scanline_perspective(er_Context *ctx, int y, int start_x, int end_x, const PlaneRow *row, er_FragInput *input, int varyings){
+
+    er_Program *program = ctx->current_program;
+    float z[PERSPECTIVE_LANES], w[PERSPECTIVE_LANES] ER_ALIGNED;
+    float attributes[ATTRIBUTES_SIZE][PERSPECTIVE_LANES] ER_ALIGNED;
+    float ddx[ATTRIBUTES_SIZE][PERSPECTIVE_LANES] ER_ALIGNED;
+    float ddy[ATTRIBUTES_SIZE][PERSPECTIVE_LANES] ER_ALIGNED;
+    er_FragInput corrected;
+    int x, i, k, lanes;
+    float offset_x;
+
+    init_corrected_input(input, &corrected);
+    /* Attributes after the ones of the rasterizer variant are flat */
+    for(k = varyings; k < program->varying_attributes; k++){
+        corrected.attributes[k] = input->attributes[k];
+        corrected.ddx[k] = input->ddx[k];
+        corrected.ddy[k] = input->ddy[k];
+    }
+    corrected.frag_coord[VAR_Y] = y;
+    for(x = start_x; x <= end_x; x += PERSPECTIVE_LANES){
+        lanes = min(PERSPECTIVE_LANES, end_x - x + 1);
+        for(i = 0; i < PERSPECTIVE_LANES; i++){
+            /* Lanes past the end of the scanline get a harmless 1/w */
+            if(i >= lanes){
+                w[i] = 1.0f;
+                for(k = 0; k < varyings; k++){
+                    attributes[k][i] = 0.0f;
+                }
+                continue;
+            }
+            offset_x = (x + i) - row->x0;
+            z[i] = row->z + input->dz_dx * offset_x;
+            w[i] = row->w + input->dw_dx * offset_x;
+            for(k = 0; k < varyings; k++){
+                attributes[k][i] = row->attributes[k] + input->ddx[k] * offset_x;
+            }
+        }
+#ifdef __SSE2__
+        __m128 rw = _mm_div_ps(_mm_set1_ps(1.0f), _mm_load_ps(w));
+        for(k = 0; k < varyings; k++){
+            if(k >= program->interpolated_attributes || program->interpolation[k] != ER_SMOOTH){
+                _mm_store_ps(ddx[k], _mm_set1_ps(input->ddx[k]));
+                _mm_store_ps(ddy[k], _mm_set1_ps(input->ddy[k]));
+                continue;
+            }
+            __m128 a = _mm_mul_ps(_mm_load_ps(attributes[k]), rw);
+            _mm_store_ps(attributes[k], a);
+            _mm_store_ps(ddx[k], _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(input->ddx[k]), _mm_mul_ps(a, _mm_set1_ps(input->dw_dx))), rw));
+            _mm_store_ps(ddy[k], _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(input->ddy[k]), _mm_mul_ps(a, _mm_set1_ps(input->dw_dy))), rw));
+        }
+#else
+        for(i = 0; i < PERSPECTIVE_LANES; i++){
+            float rw = 1.0f / w[i];
+            for(k = 0; k < varyings; k++){
+                if(k >= program->interpolated_attributes || program->interpolation[k] != ER_SMOOTH){
+                    ddx[k][i] = input->ddx[k];
+                    ddy[k][i] = input->ddy[k];
+                    continue;
+                }
+                attributes[k][i] *= rw;
+                ddx[k][i] = (input->ddx[k] - attributes[k][i] * input->dw_dx) * rw;
+                ddy[k][i] = (input->ddy[k] - attributes[k][i] * input->dw_dy) * rw;
+            }
+        }
+#endif
+        for(i = 0; i < lanes; i++){
+            if(depth_test(ctx, y, x + i, z[i])){
+                corrected.frag_coord[VAR_X] = x + i;
+                corrected.frag_coord[VAR_Z] = z[i];
+                corrected.frag_coord[VAR_W] = w[i];
+                for(k = 0; k < varyings; k++){
+                    corrected.attributes[k] = attributes[k][i];
+                    corrected.ddx[k] = ddx[k][i];
+                    corrected.ddy[k] = ddy[k][i];
+                }
+                run_fragment_shader(ctx, y, x + i, &corrected);
+            }
+        }
+    }
+
+}
+
+/*
+ * Perspective correction of the attributes of every lane of a span, derivatives are the ones of
+ * its first covered fragment.
+*/
+static void perspective_span(er_Program *program, er_FragSpan *span, int varyings){
+
+    float w[ER_SPAN_SIZE] ER_ALIGNED;
+    unsigned int i;
+    int k;
+
+#ifdef __SSE2__
+    /* Lanes past the size of the span may hold anything, they get 1/w = 1 */
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128i lane = _mm_set_epi32(3, 2, 1, 0);
+    __m128i size = _mm_set1_epi32(span->size);
+    for(i = 0; i < span->size; i += 4){
+        __m128 valid = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(i), lane), size));
+        __m128 span_w = _mm_or_ps(_mm_and_ps(valid, _mm_load_ps(&span->w[i])), _mm_andnot_ps(valid, one));
+        _mm_store_ps(&w[i], _mm_div_ps(one, span_w));
+    }
+    for(k = 0; k < varyings; k++){
+        if(program->interpolation[k] != ER_SMOOTH){
+            continue;
+        }
+        for(i = 0; i < span->size; i += 4){
+            _mm_store_ps(&span->attributes[k][i], _mm_mul_ps(_mm_load_ps(&span->attributes[k][i]), _mm_load_ps(&w[i])));
+        }
+    }
+#else
+    for(i = 0; i < span->size; i++){
+        w[i] = 1.0f / span->w[i];
+    }
+    for(k = 0; k < varyings; k++){
+        if(program->interpolation[k] != ER_SMOOTH){
+            continue;
+        }
+        for(i = 0; i < span->size; i++){
+            span->attributes[k][i] *= w[i];
+        }
+    }
+#endif
+#if defined(__GNUC__)
+    i = __builtin_ctz(span->mask);
+#else
+    for(i = 0; i < ER_SPAN_SIZE - 1 && (span->mask & (1u << i)) == 0; i++);
+#endif
+    for(k = 0; k < varyings; k++){
+        if(program->interpolation[k] != ER_SMOOTH){
+            continue;
+        }
+        span->ddx[k] = (span->ddx[k] - span->attributes[k][i] * span->dw_dx) * w[i];
+        span->ddy[k] = (span->ddy[k] - span->attributes[k][i] * span->dw_dy) * w[i];
+    }
+
+}
+
+/*
+ * Call the span shader and write the fragments it didn't discard on the bound framebuffer.
+ * Programs without span shader get one call of the fragment shader per fragment. Perspective
+ * correction covers the first varyings attributes, the ones interpolated by the rasterizer variant.
+*/
+void shade_span(er_Context *ctx, er_FragSpan *span, int varyings){
+
+    unsigned int i, mask;
+    int k;
+    er_FragInput input;
+
+    if(ctx->current_program->fragment_span_shader == NULL){
+        input.front_facing = span->front_facing;
+        input.dz_dx = span->dz_dx;
+        input.dz_dy = span->dz_dy;
+        input.dw_dx = span->dw_dx;
+        input.dw_dy = span->dw_dy;
+        input.point_coord[VAR_X] = span->point_coord[VAR_X];
+        input.point_coord[VAR_Y] = span->point_coord[VAR_Y];
+        input.point_size = span->point_size;
+        for(k = 0; k < ctx->current_program->varying_attributes; k++){
+            input.ddx[k] = span->ddx[k];
+            input.ddy[k] = span->ddy[k];
+        }
+        for(i = 0, mask = span->mask; mask; i++, mask >>= 1){
+            if(mask & 1){
+                input.frag_coord[VAR_X] = span->x[i];
+                input.frag_coord[VAR_Y] = span->y[i];
+                input.frag_coord[VAR_Z] = span->z[i];
+                input.frag_coord[VAR_W] = span->w[i];
+                for(k = 0; k < ctx->current_program->varying_attributes; k++){
+                    input.attributes[k] = span->attributes[k][i];
+                }
+                shade_fragment(ctx, span->y[i], span->x[i], &input);
+            }
+        }
+        return;
+    }
+    if(ctx->perspective_correction_enable == ER_TRUE){
+        /* Derivatives of the primitive are kept for the next spans */
+        float ddx[ATTRIBUTES_SIZE], ddy[ATTRIBUTES_SIZE];
+        for(k = 0; k < varyings; k++){
+            ddx[k] = span->ddx[k];
+            ddy[k] = span->ddy[k];
+        }
+        perspective_span(ctx->current_program, span, varyings);
+        ctx->current_program->fragment_span_shader(span, &ctx->global_variables);
+        for(k = 0; k < varyings; k++){
+            span->ddx[k] = ddx[k];
+            span->ddy[k] = ddy[k];
+        }
+    }else{
+        ctx->current_program->fragment_span_shader(span, &ctx->global_variables);
+    }
+    if(ctx->current_framebuffer == NULL){
+        return;
+    }
+    for(i = 0, mask = span->mask; mask; i++, mask >>= 1){
+        if(mask & 1){
+            write_fragment(ctx, span->y[i], span->x[i], span->color[VAR_R][i], span->color[VAR_G][i], span->color[VAR_B][i], span->color[VAR_A][i], span->z[i]);
+        }
+    }
+
+}
+
+/*
+ * Span of one fragment, for programs that only have a span shader.
+*/
+void shade_fragment_span(er_Context *ctx, int y, int x, er_FragInput *input){
+
+    er_FragSpan span;
+    int k;
+
+    span.x[0] = x;
+    span.y[0] = y;
+    span.z[0] = input->frag_coord[VAR_Z];
+    span.w[0] = input->frag_coord[VAR_W];
+    for(k = 0; k < ctx->current_program->varying_attributes; k++){
+        span.attributes[k][0] = input->attributes[k];
+        span.ddx[k] = input->ddx[k];
+        span.ddy[k] = input->ddy[k];
+    }
+    span.dz_dx = input->dz_dx;
+    span.dz_dy = input->dz_dy;
+    span.dw_dx = input->dw_dx;
+    span.dw_dy = input->dw_dy;
+    span.point_coord[VAR_X] = input->point_coord[VAR_X];
+    span.point_coord[VAR_Y] = input->point_coord[VAR_Y];
+    span.point_size = input->point_size;
+    span.front_facing = input->front_facing;
+    span.size = 1;
+    span.mask = 1;
+    shade_span(ctx, &span, ctx->current_program->interpolated_attributes);
+
+}
+
+/*
+ * Span setup from the gradients of a triangle.
+*/
+void init_span(er_Context *ctx, er_FragSpan *span, er_FragInput *input){
+
+    int i, k;
+    for(k = 0; k < ctx->current_program->varying_attributes; k++){
+        span->ddx[k] = input->ddx[k];
+        span->ddy[k] = input->ddy[k];
+    }
+    /* Flat attributes past the interpolated ones keep their lanes for the whole primitive */
+    for(k = ctx->current_program->interpolated_attributes; k < ctx->current_program->varying_attributes; k++){
+        for(i = 0; i < ER_SPAN_SIZE; i++){
+            span->attributes[k][i] = input->attributes[k];
+        }
+    }
+    span->dz_dx = input->dz_dx;
+    span->dz_dy = input->dz_dy;
+    span->dw_dx = input->dw_dx;
+    span->dw_dy = input->dw_dy;
+    span->point_coord[VAR_X] = 0.0f;
+    span->point_coord[VAR_Y] = 0.0f;
+    span->point_size = 0.0f;
+    span->front_facing = input->front_facing;
+
+}
+
+/*
+ * Flat attributes that follow the last interpolated one are left out of the rasterizer loops,
+ * they take the values of the provoking vertex and have null derivatives.
+*/
+void set_flat_attributes(er_Context *ctx, er_FragInput *input, er_VertexOutput *vertex){
+
+    int k;
+    for(k = ctx->current_program->interpolated_attributes; k < ctx->current_program->varying_attributes; k++){
+        input->attributes[k] = vertex->attributes[k];
+        input->ddx[k] = 0.0f;
+        input->ddy[k] = 0.0f;
+    }
+
+}
+
+/*
+ * Lines have no screen space gradients, their derivatives are zero like those of points.
+*/
+RASTER_INLINE void clear_derivatives(er_FragInput *input, int varyings){
+
+    int k;
+    for(k = 0; k < varyings; k++){
+        input->ddx[k] = 0.0f;
+        input->ddy[k] = 0.0f;
+    }
+    input->dz_dx = 0.0f;
+    input->dz_dy = 0.0f;
+    input->dw_dx = 0.0f;
+    input->dw_dy = 0.0f;
+
+}
+
+/*
+ * Shade the pixels [start_x, end_x] of a scanline in spans of ER_SPAN_SIZE fragments,
+ * with the interpolators evaluated from row.
+*/
+RASTER_INLINE void scanline_spans(er_Context *ctx, er_FragSpan *span, int y, int start_x, int end_x, const PlaneRow *row, er_FragInput *input, int varyings){
+
+    int x, next_x, i, k;
+    float offset_x;
+
+    /* Spans start at absolute multiples of ER_SPAN_SIZE, so they group the same fragments whatever region is drawn */
+    for(x = start_x; x <= end_x; x = next_x){
+        next_x = (x & ~(ER_SPAN_SIZE - 1)) + ER_SPAN_SIZE;
+        span->size = min(end_x + 1, next_x) - x;
+        span->mask = 0;
+        for(i = 0; i < (int)span->size; i++){
+            offset_x = (x + i) - row->x0;
+            span->x[i] = x + i;
+            span->y[i] = y;
+            span->z[i] = row->z + input->dz_dx * offset_x;
+            span->w[i] = row->w + input->dw_dx * offset_x;
+            for(k = 0; k < varyings; k++){
+                span->attributes[k][i] = row->attributes[k] + input->ddx[k] * offset_x;
+            }
+            if(depth_test(ctx, y, x + i, span->z[i])){
+                span->mask |= 1 << i;
+            }
+        }
+        if(span->mask){
+            shade_span(ctx, span, varyings);
+        }
+    }
+
+}
+
+RASTER_INLINE void draw_point_sprite_variant(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     float half_size = 0.5f * vertex->point_size;
     int start_x, end_x;
@@ -16,28 +423,33 @@ void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face){
     int i,j;
 
     start_x = (int)ceil( vertex->position[VAR_X] - half_size );
-    if(start_x < (int)window_origin_x){
-        start_x = window_origin_x;
+    if(start_x < (int)ctx->window_origin_x){
+        start_x = ctx->window_origin_x;
     }
     end_x = (int)ceil( vertex->position[VAR_X] + half_size ) - 1;
-    if(end_x >= (int)window_width){
-        end_x = window_width - 1;
+    if(end_x >= (int)ctx->window_width){
+        end_x = ctx->window_width - 1;
     }
     start_y = (int)ceil( vertex->position[VAR_Y] - half_size );
-    if(start_y < (int)window_origin_y){
-        start_y = window_origin_y;
+    if(start_y < (int)ctx->window_origin_y){
+        start_y = ctx->window_origin_y;
     }
     end_y = (int)ceil( vertex->position[VAR_Y] + half_size ) - 1;
-    if(end_y >= (int)window_height){
-        end_y = window_height - 1;
+    if(end_y >= (int)ctx->window_height){
+        end_y = ctx->window_height - 1;
     }
+    start_x = max(start_x, min_x);
+    end_x = min(end_x, max_x);
+    start_y = max(start_y, min_y);
+    end_y = min(end_y, max_y);
 
     er_FragInput input;
     input.frag_coord[VAR_Z] = vertex->position[VAR_Z];
     input.frag_coord[VAR_W] = vertex->position[VAR_W];
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex);
     int k;
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         input.attributes[k] = vertex->attributes[k];
         input.ddx[k] = 0.0f;
         input.ddy[k] = 0.0f;
@@ -49,7 +461,7 @@ void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face){
     input.point_size = vertex->point_size;
     float one_over_size = 1.0f / vertex->point_size;
 
-    if(point_sprite_coord_origin == ER_POINT_SPRITE_LOWER_LEFT){
+    if(ctx->point_sprite_coord_origin == ER_POINT_SPRITE_LOWER_LEFT){
 
         for(i = start_y; i <= end_y; i++){
             input.frag_coord[VAR_Y] = i;
@@ -57,7 +469,9 @@ void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face){
             for(j = start_x; j <= end_x; j++){
                 input.frag_coord[VAR_X] = j;
                 input.point_coord[VAR_X] = 0.5f + ( j - vertex->position[VAR_X]) *one_over_size;
-                current_program->fragment_shader(i, j, &input, &global_variables);
+                if(depth_test(ctx, i, j, input.frag_coord[VAR_Z])){
+                    shade_fragment(ctx, i, j, &input);
+                }
             }
         }
 
@@ -69,7 +483,9 @@ void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face){
             for(j = start_x; j <= end_x; j++){
                 input.frag_coord[VAR_X] = j;
                 input.point_coord[VAR_X] = 0.5f + ( j - vertex->position[VAR_X]) * one_over_size;
-                current_program->fragment_shader(i, j, &input, &global_variables);
+                if(depth_test(ctx, i, j, input.frag_coord[VAR_Z])){
+                    shade_fragment(ctx, i, j, &input);
+                }
             }
         }
 
@@ -77,7 +493,7 @@ void draw_point_sprite(er_VertexOutput *vertex, er_PolygonFaceEnum face){
 
 }
 
-void draw_point(er_VertexOutput *vertex, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_point_variant(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     float half_size = vertex->point_size / 2.0f;
     int start_x, end_x;
@@ -85,28 +501,33 @@ void draw_point(er_VertexOutput *vertex, er_PolygonFaceEnum face){
     int i,j;
 
     start_x = (int)ceil( vertex->position[VAR_X] - half_size );
-    if(start_x < (int)window_origin_x){
-        start_x = window_origin_x;
+    if(start_x < (int)ctx->window_origin_x){
+        start_x = ctx->window_origin_x;
     }
     end_x = (int)ceil( vertex->position[VAR_X] + half_size ) - 1;
-    if(end_x >= (int)window_width){
-        end_x = window_width - 1;
+    if(end_x >= (int)ctx->window_width){
+        end_x = ctx->window_width - 1;
     }
     start_y = (int)ceil( vertex->position[VAR_Y] - half_size );
-    if(start_y < (int)window_origin_y){
-        start_y = window_origin_y;
+    if(start_y < (int)ctx->window_origin_y){
+        start_y = ctx->window_origin_y;
     }
     end_y = (int)ceil( vertex->position[VAR_Y] + half_size ) - 1;
-    if(end_y >= (int)window_height){
-        end_y = window_height - 1;
+    if(end_y >= (int)ctx->window_height){
+        end_y = ctx->window_height - 1;
     }
+    start_x = max(start_x, min_x);
+    end_x = min(end_x, max_x);
+    start_y = max(start_y, min_y);
+    end_y = min(end_y, max_y);
 
     er_FragInput input;
     input.frag_coord[VAR_Z] = vertex->position[VAR_Z];
     input.frag_coord[VAR_W] = vertex->position[VAR_W];
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex);
     int k;
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         input.attributes[k] = vertex->attributes[k];
         input.ddx[k] = 0.0f;
         input.ddy[k] = 0.0f;
@@ -120,21 +541,104 @@ void draw_point(er_VertexOutput *vertex, er_PolygonFaceEnum face){
         input.frag_coord[VAR_Y] = i;
         for(j = start_x; j <= end_x;j++){
             input.frag_coord[VAR_X] = j;
-            current_program->fragment_shader(i, j, &input, &global_variables);
+            if(depth_test(ctx, i, j, input.frag_coord[VAR_Z])){
+                shade_fragment(ctx, i, j, &input);
+            }
         }
     }
 
 }
 
-static void draw_vertical_negative(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+/*
+ * Lines visit the pixels from major0 to major1, excluded, on their major axis. Range of them that can fall on the
+ * region being drawn, from first to end, excluded, with two pixels of margin on the minor axis for the rounding of
+ * the midpoint walk. Returns ER_FALSE when the line misses the region.
+*/
+static er_Bool line_region(float major_position, float minor_position, float slope, int minor, int step, int major0, int major1,
+                           int min_major, int max_major, int min_minor, int max_minor, int *first, int *end){
+
+    float low = min_major, high = max_major, bound0, bound1;
+    int last;
+
+    if(slope != 0.0f){
+        bound0 = major_position + (min_minor - 2 - minor_position) / slope;
+        bound1 = major_position + (max_minor + 2 - minor_position) / slope;
+        low = max(low, min(bound0, bound1));
+        high = min(high, max(bound0, bound1));
+    }else if(minor < min_minor || minor > max_minor){
+        return ER_FALSE;
+    }
+    if(low > high){
+        return ER_FALSE;
+    }
+    if(step > 0){
+        *first = max(major0, (int)ceil(low));
+        last = min(major1 - 1, (int)floor(high));
+        *end = last + 1;
+    }else{
+        *first = min(major0, (int)floor(high));
+        last = max(major1 + 1, (int)ceil(low));
+        *end = last - 1;
+    }
+    return ((last - *first) * step >= 0) ? ER_TRUE: ER_FALSE;
+
+}
+
+/*
+ * Diagonal moves of the midpoint walk over its next steps, taken at once to start a line on the region being drawn.
+ * mid changes by straight or by diagonal on each step, and a diagonal step is taken while sign * mid is positive,
+ * or not negative when inclusive. Once in the window [-diagonal, straight) of sign * mid the count is a quotient,
+ * before it the walk only takes one kind of steps.
+*/
+static int diagonal_steps(float mid, float straight, float diagonal, float sign, er_Bool inclusive, int steps){
+
+    double g = sign * mid, a = sign * straight, b = -sign * diagonal;
+    double count;
+
+    if(inclusive == ER_TRUE){
+        count = floor((g + a * steps + b) / (a + b));
+    }else{
+        count = ceil((g + a * (steps - 1)) / (a + b));
+    }
+    return (int)max(0.0, min(count, (double)steps));
+
+}
+
+/*
+ * Parameter of the pixel (x, y) along a line, from its projection on absolute coordinates.
+ * Every region the line is drawn on gets the same value for a pixel.
+*/
+static float line_parameter(er_VertexOutput *vertex0, vec2 p1p0, float square_length, int x, int y){
+
+    vec2 prp0;
+    prp0[VAR_X] = x - vertex0->position[VAR_X];
+    prp0[VAR_Y] = y - vertex0->position[VAR_Y];
+    return dot_vec2(prp0, p1p0) / square_length;
+
+}
+
+/*
+ * Line fragments are only shaded when they fall on the region [min_x, max_x] x [min_y, max_y] being rasterized.
+*/
+static void shade_line_fragment(er_Context *ctx, int y, int x, er_FragInput *input, int min_x, int max_x, int min_y, int max_y){
+
+    if(x >= min_x && x <= max_x && y >= min_y && y <= max_y && depth_test(ctx, y, x, input->frag_coord[VAR_Z])){
+        shade_fragment(ctx, y, x, input);
+    }
+
+}
+
+RASTER_INLINE void draw_vertical_negative(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_S, t;
+    float t;
     int k;
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy;
     int x0, y0, y1;
@@ -143,9 +647,14 @@ static void draw_vertical_negative(er_VertexOutput *vertex0, er_VertexOutput *ve
     y1 = uiround( vertex1->position[VAR_Y] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_Y], vertex0->position[VAR_X], 0.0f, x0, -1, y0, y1, min_y, max_y, min_x, max_x, &first, &y1) == ER_FALSE){
+        return;
+    }
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -156,49 +665,50 @@ static void draw_vertical_negative(er_VertexOutput *vertex0, er_VertexOutput *ve
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_S = -p1p0[VAR_Y] / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     int i, j = x0;
-    for(i = y0 - 1; i > y1; i--){
-        t += t_S;
+    for(i = min(y0 - 1, first); i > y1; i--){
         input.frag_coord[VAR_X] = j;
         input.frag_coord[VAR_Y] = i;
+        t = line_parameter(vertex0, p1p0, square_length, j, i);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
-        current_program->fragment_shader(i, j, &input, &global_variables);
+        shade_line_fragment(ctx, i, j, &input, min_x, max_x, min_y, max_y);
     }
 
 }
 
-static void draw_vertical_positive(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_vertical_positive(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_N, t;
+    float t;
     int k;
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy;
     int x0, y0, y1;
@@ -207,9 +717,14 @@ static void draw_vertical_positive(er_VertexOutput *vertex0, er_VertexOutput *ve
     y1 = uiround( vertex1->position[VAR_Y] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_Y], vertex0->position[VAR_X], 0.0f, x0, 1, y0, y1, min_y, max_y, min_x, max_x, &first, &y1) == ER_FALSE){
+        return;
+    }
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -220,49 +735,50 @@ static void draw_vertical_positive(er_VertexOutput *vertex0, er_VertexOutput *ve
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_N = p1p0[VAR_Y] / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     int i, j = x0;
-    for(i = y0 + 1; i < y1; i++){
-        t += t_N;
+    for(i = max(y0 + 1, first); i < y1; i++){
         input.frag_coord[VAR_X] = j;
         input.frag_coord[VAR_Y] = i;
+        t = line_parameter(vertex0, p1p0, square_length, j, i);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
-        current_program->fragment_shader(i, j, &input, &global_variables);
+        shade_line_fragment(ctx, i, j, &input, min_x, max_x, min_y, max_y);
     }
 
 }
 
-static void draw_horizontal_negative(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_horizontal_negative(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_W, t;
+    float t;
     int k;
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy;
     int x0, y0, x1;
@@ -271,9 +787,14 @@ static void draw_horizontal_negative(er_VertexOutput *vertex0, er_VertexOutput *
     x1 = uiround( vertex1->position[VAR_X] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_X], vertex0->position[VAR_Y], 0.0f, y0, -1, x0, x1, min_x, max_x, min_y, max_y, &first, &x1) == ER_FALSE){
+        return;
+    }
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -284,49 +805,50 @@ static void draw_horizontal_negative(er_VertexOutput *vertex0, er_VertexOutput *
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_W = -p1p0[VAR_X] / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     int i, j = y0;
-    for(i = x0 - 1; i > x1; i--){
-        t += t_W;
+    for(i = min(x0 - 1, first); i > x1; i--){
         input.frag_coord[VAR_X] = i;
         input.frag_coord[VAR_Y] = j;
+        t = line_parameter(vertex0, p1p0, square_length, i, j);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
-        current_program->fragment_shader(j, i, &input, &global_variables);
+        shade_line_fragment(ctx, j, i, &input, min_x, max_x, min_y, max_y);
     }
 
 }
 
-static void draw_horizontal_positive(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_horizontal_positive(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_E, t;
+    float t;
     int k;
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy;
     int x0, y0, x1;
@@ -335,9 +857,14 @@ static void draw_horizontal_positive(er_VertexOutput *vertex0, er_VertexOutput *
     x1 = uiround( vertex1->position[VAR_X] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_X], vertex0->position[VAR_Y], 0.0f, y0, 1, x0, x1, min_x, max_x, min_y, max_y, &first, &x1) == ER_FALSE){
+        return;
+    }
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -348,36 +875,35 @@ static void draw_horizontal_positive(er_VertexOutput *vertex0, er_VertexOutput *
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_E = p1p0[VAR_X] / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     int i, j = y0;
-    for(i = x0 + 1; i < x1; i++){
-        t += t_E;
+    for(i = max(x0 + 1, first); i < x1; i++){
         input.frag_coord[VAR_X] = i;
         input.frag_coord[VAR_Y] = j;
+        t = line_parameter(vertex0, p1p0, square_length, i, j);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
-        current_program->fragment_shader(j, i, &input, &global_variables);
+        shade_line_fragment(ctx, j, i, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -385,16 +911,18 @@ static void draw_horizontal_positive(er_VertexOutput *vertex0, er_VertexOutput *
 /*
  * Midpoint line algorithm, Octant 6
  */
-static void draw_line_case6(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case6(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_S, t_SW, t;
+    float t;
     int k;
 
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, y1;
@@ -403,10 +931,15 @@ static void draw_line_case6(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     y1 = uiround( vertex1->position[VAR_Y] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_Y], vertex0->position[VAR_X], dx / dy, x0, -1, y0, y1, min_y, max_y, min_x, max_x, &first, &y1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -417,48 +950,52 @@ static void draw_line_case6(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_S = -p1p0[VAR_Y] / square_length;
-    t_SW = (-p1p0[VAR_X] - p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue - dy + 2 * dx;
     float increment_S = 2 * dx;
     float increment_SW = 2 * (-dy + dx);
     int i,j = x0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = (y0 - 1) - first;
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_S, increment_SW, -1.0f, ER_FALSE, steps);
+        j -= diagonal;
+        mid += (steps - diagonal) * increment_S + diagonal * increment_SW;
+    }
 
-    for(i = y0 - 1; i > y1; i--){
+    for(i = min(y0 - 1, first); i > y1; i--){
         if(mid >= 0){
             mid += increment_S;
-            t += t_S;
         }else{
             mid += increment_SW;
-            t += t_SW;
             j--;
         }
+        t = line_parameter(vertex0, p1p0, square_length, j, i);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = j;
         input.frag_coord[VAR_Y] = i;
-        current_program->fragment_shader(i, j, &input, &global_variables);
+        shade_line_fragment(ctx, i, j, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -466,16 +1003,18 @@ static void draw_line_case6(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octant 7
  */
-static void draw_line_case7(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case7(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_S, t_SE, t;
+    float t;
     int k;
 
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, y1;
@@ -484,10 +1023,15 @@ static void draw_line_case7(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     y1 = uiround( vertex1->position[VAR_Y] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_Y], vertex0->position[VAR_X], dx / dy, x0, -1, y0, y1, min_y, max_y, min_x, max_x, &first, &y1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -498,48 +1042,52 @@ static void draw_line_case7(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_S = -p1p0[VAR_Y] / square_length;
-    t_SE = (p1p0[VAR_X] - p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue + dy + 2 * dx;
     float increment_S = 2 * dx;
     float increment_SE = 2 * (dy + dx);
     int i,j = x0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = (y0 - 1) - first;
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_S, increment_SE, 1.0f, ER_TRUE, steps);
+        j += diagonal;
+        mid += (steps - diagonal) * increment_S + diagonal * increment_SE;
+    }
 
-    for(i = y0 - 1; i > y1; i--){
+    for(i = min(y0 - 1, first); i > y1; i--){
         if(mid >= 0){
             mid += increment_SE;
-            t += t_SE;
             j++;
         }else{
             mid += increment_S;
-            t += t_S;
         }
+        t = line_parameter(vertex0, p1p0, square_length, j, i);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = j;
         input.frag_coord[VAR_Y] = i;
-        current_program->fragment_shader(i, j, &input, &global_variables);
+        shade_line_fragment(ctx, i, j, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -547,16 +1095,18 @@ static void draw_line_case7(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octant 8
  */
-static void draw_line_case8(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case8(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_E, t_SE, t;
+    float t;
     int k;
 
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, x1;
@@ -565,10 +1115,15 @@ static void draw_line_case8(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     x1 = uiround( vertex1->position[VAR_X] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_X], vertex0->position[VAR_Y], dy / dx, y0, 1, x0, x1, min_x, max_x, min_y, max_y, &first, &x1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -579,48 +1134,52 @@ static void draw_line_case8(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_E = p1p0[VAR_X] / square_length;
-    t_SE = (p1p0[VAR_X] - p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue + 2 * dy + dx;
     float increment_E = 2 * dy;
     float increment_SE = 2 * (dy + dx);
     int i,j = y0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = first - (x0 + 1);
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_E, increment_SE, -1.0f, ER_TRUE, steps);
+        j -= diagonal;
+        mid += (steps - diagonal) * increment_E + diagonal * increment_SE;
+    }
 
-    for(i = x0 + 1; i < x1; i++){
+    for(i = max(x0 + 1, first); i < x1; i++){
         if(mid > 0){
             mid += increment_E;
-            t += t_E;
         }else{
             j--;
             mid += increment_SE;
-            t += t_SE;
         }
+        t = line_parameter(vertex0, p1p0, square_length, i, j);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = i;
         input.frag_coord[VAR_Y] = j;
-        current_program->fragment_shader(j, i, &input, &global_variables);
+        shade_line_fragment(ctx, j, i, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -628,16 +1187,18 @@ static void draw_line_case8(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octant 3
  */
-static void draw_line_case3(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case3(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_N, t_NW, t;
+    float t;
     int k;
 
     /* Fragment settings */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, y1;
@@ -646,10 +1207,15 @@ static void draw_line_case3(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     y1 = uiround( vertex1->position[VAR_Y] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_Y], vertex0->position[VAR_X], dx / dy, x0, 1, y0, y1, min_y, max_y, min_x, max_x, &first, &y1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -660,48 +1226,52 @@ static void draw_line_case3(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_N = p1p0[VAR_Y] / square_length;
-    t_NW = (-p1p0[VAR_X] + p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue -  dy - 2*dx;
     float increment_N = -2 * dx;
     float increment_NW = -2 * (dy + dx);
     int i,j = x0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = first - (y0 + 1);
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_N, increment_NW, 1.0f, ER_FALSE, steps);
+        j -= diagonal;
+        mid += (steps - diagonal) * increment_N + diagonal * increment_NW;
+    }
 
-    for(i = y0+1; i < y1; i++){
+    for(i = max(y0 + 1, first); i < y1; i++){
         if(mid > 0){
             j--;
             mid += increment_NW;
-            t += t_NW;
         }else{
             mid += increment_N;
-            t += t_N;
         }
+        t = line_parameter(vertex0, p1p0, square_length, j, i);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = j;
         input.frag_coord[VAR_Y] = i;
-        current_program->fragment_shader(i, j, &input, &global_variables);
+        shade_line_fragment(ctx, i, j, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -709,16 +1279,18 @@ static void draw_line_case3(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octant 2
  */
-static void draw_line_case2(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case2(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_N, t_NE, t;
+    float t;
     int k;
 
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, y1;
@@ -727,10 +1299,15 @@ static void draw_line_case2(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     y1 = uiround( vertex1->position[VAR_Y] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_Y], vertex0->position[VAR_X], dx / dy, x0, 1, y0, y1, min_y, max_y, min_x, max_x, &first, &y1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -741,48 +1318,52 @@ static void draw_line_case2(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_N = p1p0[VAR_Y] / square_length;
-    t_NE = (p1p0[VAR_X] + p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue + dy - 2 * dx;
     float increment_N = -2 * dx;
     float increment_NE = 2 * (dy - dx);
     int i,j = x0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = first - (y0 + 1);
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_N, increment_NE, -1.0f, ER_TRUE, steps);
+        j += diagonal;
+        mid += (steps - diagonal) * increment_N + diagonal * increment_NE;
+    }
 
-    for(i = y0+1; i < y1; i++){
+    for(i = max(y0 + 1, first); i < y1; i++){
         if(mid > 0){
             mid += increment_N;
-            t += t_N;
         }else{
             j++;
             mid += increment_NE;
-            t += t_NE;
         }
+        t = line_parameter(vertex0, p1p0, square_length, j, i);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = j;
         input.frag_coord[VAR_Y] = i;
-        current_program->fragment_shader(i, j,&input, &global_variables);
+        shade_line_fragment(ctx, i, j, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -790,16 +1371,18 @@ static void draw_line_case2(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octact 5
  */
-static void draw_line_case5(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case5(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_W, t_SW, t;
+    float t;
     int k;
 
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, x1;
@@ -808,10 +1391,15 @@ static void draw_line_case5(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     x1 = uiround( vertex1->position[VAR_X] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_X], vertex0->position[VAR_Y], dy / dx, y0, -1, x0, x1, min_x, max_x, min_y, max_y, &first, &x1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -822,48 +1410,52 @@ static void draw_line_case5(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_W = -p1p0[VAR_X] / square_length;
-    t_SW = (-p1p0[VAR_X] - p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue - 2 * dy + dx;
     float increment_W = -2 * dy;
     float increment_SW = 2 * (-dy + dx);
     int i, j = y0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = (x0 - 1) - first;
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_W, increment_SW, 1.0f, ER_TRUE, steps);
+        j -= diagonal;
+        mid += (steps - diagonal) * increment_W + diagonal * increment_SW;
+    }
 
-    for(i = x0 - 1; i > x1; i--){
+    for(i = min(x0 - 1, first); i > x1; i--){
         if(mid >= 0){
             j--;
             mid += increment_SW;
-            t += t_SW;
         }else{
             mid += increment_W;
-            t += t_W;
         }
+        t = line_parameter(vertex0, p1p0, square_length, i, j);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = i;
         input.frag_coord[VAR_Y] = j;
-        current_program->fragment_shader(j, i, &input, &global_variables);
+        shade_line_fragment(ctx, j, i, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -871,16 +1463,18 @@ static void draw_line_case5(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octact 4
  */
-static void draw_line_case4(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case4(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_W, t_NW, t;
+    float t;
     int k;
 
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, x1;
@@ -889,10 +1483,15 @@ static void draw_line_case4(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     x1 = uiround( vertex1->position[VAR_X] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_X], vertex0->position[VAR_Y], dy / dx, y0, -1, x0, x1, min_x, max_x, min_y, max_y, &first, &x1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -903,48 +1502,52 @@ static void draw_line_case4(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_W = -p1p0[VAR_X] / square_length;
-    t_NW = (-p1p0[VAR_X] + p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue - 2 * dy - dx;
     float increment_W = -2 * dy;
     float increment_NW = -2 * (dy + dx);
     int i, j = y0;
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = (x0 - 1) - first;
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_W, increment_NW, -1.0f, ER_FALSE, steps);
+        j += diagonal;
+        mid += (steps - diagonal) * increment_W + diagonal * increment_NW;
+    }
 
-    for(i = x0-1; i > x1; i--){
+    for(i = min(x0 - 1, first); i > x1; i--){
         if(mid >= 0){
             mid += increment_W;
-            t += t_W;
         }else{
             j++;
             mid += increment_NW;
-            t += t_NW;
         }
+        t = line_parameter(vertex0, p1p0, square_length, i, j);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = i;
         input.frag_coord[VAR_Y] = j;
-        current_program->fragment_shader(j, i, &input, &global_variables);
+        shade_line_fragment(ctx, j, i, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -952,15 +1555,17 @@ static void draw_line_case4(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Midpoint line algorithm, Octant 1
  */
-static void draw_line_case1(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_case1(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     er_FragInput input;
     float delta_z, delta_w;
     float delta[ATTRIBUTES_SIZE];
-    float t_E, t_NE, t;
+    float t;
     int k;
     /* Front facing flag */
     input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, &input, vertex0);
+    clear_derivatives(&input, varyings);
     /* Calculate endpoints, deltas and residue */
     float dx, dy, residue;
     int x0, y0, x1;
@@ -969,10 +1574,15 @@ static void draw_line_case1(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     x1 = uiround( vertex1->position[VAR_X] );
     dx = vertex1->position[VAR_X] - vertex0->position[VAR_X]; 
     dy = vertex1->position[VAR_Y] - vertex0->position[VAR_Y];
+    /* Steps of the line on the region being drawn */
+    int first;
+    if(line_region(vertex0->position[VAR_X], vertex0->position[VAR_Y], dy / dx, y0, 1, x0, x1, min_x, max_x, min_y, max_y, &first, &x1) == ER_FALSE){
+        return;
+    }
     residue = 2.0f*(dy * ( x0 - vertex0->position[VAR_X]) - dx * (y0 - vertex0->position[VAR_Y]));
     delta_z = vertex1->position[VAR_Z] - vertex0->position[VAR_Z];
     delta_w = vertex1->position[VAR_W] - vertex0->position[VAR_W];
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         delta[k] = vertex1->attributes[k] - vertex0->attributes[k];
     }
     /* Calculate interpolation parameters */
@@ -983,47 +1593,52 @@ static void draw_line_case1(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
     prp0[VAR_Y] = y0 - vertex0->position[VAR_Y];
     float square_length = dot_vec2(p1p0, p1p0);
     t = dot_vec2(prp0, p1p0) / square_length;
-    t_E = p1p0[VAR_X] / square_length;
-    t_NE = (p1p0[VAR_X] + p1p0[VAR_Y]) / square_length;
     if(t > 0.0f){
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
     }else{
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z];
         input.frag_coord[VAR_W] = vertex0->position[VAR_W];
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k];
         }
     }
     /* Write first point */
     input.frag_coord[VAR_X] = x0;
     input.frag_coord[VAR_Y] = y0;
-    current_program->fragment_shader(y0, x0, &input, &global_variables);
+    shade_line_fragment(ctx, y0, x0, &input, min_x, max_x, min_y, max_y);
 
     float mid = residue + 2 * dy - dx;
     float increment_E = 2 * dy;
     float increment_NE = 2 * (dy - dx);
     int i, j = y0;
-    for(i = x0 + 1; i < x1; i++){
+    /* Steps before the region being drawn, the walk resumes on the first one inside */
+    int steps = first - (x0 + 1);
+    if(steps > 0){
+        int diagonal = diagonal_steps(mid, increment_E, increment_NE, 1.0f, ER_FALSE, steps);
+        j += diagonal;
+        mid += (steps - diagonal) * increment_E + diagonal * increment_NE;
+    }
+
+    for(i = max(x0 + 1, first); i < x1; i++){
         if(mid > 0){
             j++;
             mid += increment_NE;
-            t += t_NE;
         }else{
             mid += increment_E;
-            t += t_E;
         }
+        t = line_parameter(vertex0, p1p0, square_length, i, j);
         input.frag_coord[VAR_Z] = vertex0->position[VAR_Z] + t * delta_z;
         input.frag_coord[VAR_W] = vertex0->position[VAR_W] + t * delta_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
+        for(k = 0; k < varyings; k++){
             input.attributes[k] = vertex0->attributes[k] + t * delta[k];
         }
         input.frag_coord[VAR_X] = i;
         input.frag_coord[VAR_Y] = j;
-        current_program->fragment_shader(j, i, &input, &global_variables);
+        shade_line_fragment(ctx, j, i, &input, min_x, max_x, min_y, max_y);
     }
 
 }
@@ -1031,7 +1646,7 @@ static void draw_line_case1(er_VertexOutput *vertex0, er_VertexOutput *vertex1,
 /*
  * Rasterization of lines.
 */
-void draw_line(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_line_variant(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y, int varyings){
 
     int x0, y0, x1, y1;
     x0 = uiround(vertex0->position[VAR_X]);
@@ -1044,97 +1659,209 @@ void draw_line(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFac
     if(x0 < x1){
         if(y0 < y1){ /* First Cuadrant */
             if(dy > dx){
-                draw_line_case2(vertex0, vertex1, face);
+                draw_line_case2(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }else{
-                draw_line_case1(vertex0, vertex1, face);
+                draw_line_case1(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }
         }else if(y0 > y1){ /* Fourth Cuadrant */
             if(dy > dx){
-                draw_line_case7(vertex0, vertex1, face);
+                draw_line_case7(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }else{
-                draw_line_case8(vertex0, vertex1, face);
+                draw_line_case8(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }
         }else{
-            draw_horizontal_positive(vertex0, vertex1, face);
+            draw_horizontal_positive(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
         }
     }else if(x0 > x1){
         if(y0 < y1){ /* Second Cuadrant */
             if(dy > dx){
-                draw_line_case3(vertex0, vertex1, face);
+                draw_line_case3(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }else{
-                draw_line_case4(vertex0, vertex1, face);
+                draw_line_case4(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }
         }else if(y0 > y1){ /* Third Cuadrant */
             if(dy > dx){
-                draw_line_case6(vertex0, vertex1, face);
+                draw_line_case6(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }else{
-                draw_line_case5(vertex0, vertex1, face);
+                draw_line_case5(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
             }
         }else{
-            draw_horizontal_negative(vertex0, vertex1, face);
+            draw_horizontal_negative(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
         }
     }else if(y0 < y1){
-        draw_vertical_positive(vertex0, vertex1, face);
+        draw_vertical_positive(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
     }else if(y0 > y1){
-        draw_vertical_negative(vertex0, vertex1, face);
+        draw_vertical_negative(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, varyings);
     }
 
 }
 
-static void init_left_edge(Edge *t_edge, er_VertexOutput *bottom, er_VertexOutput *top){
+/*
+ * Edges start on their first scanline at or above first_y. Their x on a scanline is evaluated from the
+ * bottom vertex by position_edges, not accumulated, so a row gets the same one whatever region is drawn.
+*/
+static void init_edge(Edge *t_edge, er_VertexOutput *bottom, er_VertexOutput *top, int first_y){
 
-    int start_y = ceil(bottom->position[VAR_Y]);
-    int end_y = (int)ceil(top->position[VAR_Y]) - 1;
-    float prestep_y = start_y - bottom->position[VAR_Y];
-    float y_range = top->position[VAR_Y] - bottom->position[VAR_Y];
-    float x_range = top->position[VAR_X] - bottom->position[VAR_X];
-    float step_x = x_range / y_range;
-    t_edge->start_y = start_y;
-    t_edge->end_y = end_y;
-    t_edge->step_x = step_x;
-    t_edge->x = bottom->position[VAR_X] + step_x * prestep_y;
+    t_edge->bottom = bottom;
+    t_edge->start_y = max((int)ceil(bottom->position[VAR_Y]), first_y);
+    t_edge->end_y = (int)ceil(top->position[VAR_Y]) - 1;
+    t_edge->step_x = (top->position[VAR_X] - bottom->position[VAR_X]) / (top->position[VAR_Y] - bottom->position[VAR_Y]);
 
-    t_edge->step_z = (top->position[VAR_Z] - bottom->position[VAR_Z]) / y_range;
-    t_edge->z = bottom->position[VAR_Z] + t_edge->step_z * prestep_y;
+}
 
-    t_edge->step_w = (top->position[VAR_W] - bottom->position[VAR_W]) / y_range;
-    t_edge->w = bottom->position[VAR_W] + t_edge->step_w * prestep_y;
+/*
+ * Shade the fragments on [start_x, end_x] of the scanline y, with the interpolators evaluated from row.
+ * Depth is tested before the other interpolators are evaluated.
+*/
+RASTER_INLINE void shade_scanline(er_Context *ctx, int y, int start_x, int end_x, const PlaneRow *row, er_FragInput *input, er_FragSpan *span, er_Bool span_shader, int varyings){
 
-    int k;
-    for(k = 0; k < current_program->varying_attributes; k++){
-        t_edge->attributes_step[k] = (top->attributes[k] - bottom->attributes[k]) / y_range;
-        t_edge->attributes[k] = bottom->attributes[k] + t_edge->attributes_step[k] * prestep_y;
+    int x, k;
+    float offset_x, z;
+
+    if(span_shader == ER_TRUE){
+        scanline_spans(ctx, span, y, start_x, end_x, row, input, varyings);
+        return;
+    }
+    if(ctx->perspective_correction_enable == ER_TRUE && ctx->current_program->fragment_shader != NULL){
+        shade_scanline_perspective(ctx, y, start_x, end_x, row, input, varyings);
+        return;
+    }
+    for(x = start_x; x <= end_x; x++){
+        offset_x = x - row->x0;
+        z = row->z + input->dz_dx * offset_x;
+        if(depth_test(ctx, y, x, z)){
+            input->frag_coord[VAR_X] = x;
+            input->frag_coord[VAR_Y] = y;
+            input->frag_coord[VAR_Z] = z;
+            input->frag_coord[VAR_W] = row->w + input->dw_dx * offset_x;
+            for(k = 0; k < varyings; k++){
+                input->attributes[k] = row->attributes[k] + input->ddx[k] * offset_x;
+            }
+            shade_fragment(ctx, y, x, input);
+        }
     }
 
 }
 
-static void init_right_edge(Edge *t_edge, er_VertexOutput *bottom, er_VertexOutput *top){
+/*
+ * Depth range and tile columns of a polygon drawn on the region [min_x, max_x] x [min_y, max_y], for the Hi-Z tests
+ * of its blocks. False when the polygon lies on a single tile, already tested by hiz_reject_polygon.
+*/
+static er_Bool init_hiz_band(HizBand *hiz, er_VertexOutput **vertices, unsigned int size, int min_x, int max_x, int min_y, int max_y){
+
+    float min_x_pos, max_x_pos, min_y_pos, max_y_pos;
+    int last_tile, first_row, last_row;
+    unsigned int i;
+
+    hiz->reference = vertices[0];
+    hiz->min_z = hiz->max_z = vertices[0]->position[VAR_Z];
+    min_x_pos = max_x_pos = vertices[0]->position[VAR_X];
+    min_y_pos = max_y_pos = vertices[0]->position[VAR_Y];
+    for(i = 1; i < size; i++){
+        hiz->min_z = min(hiz->min_z, vertices[i]->position[VAR_Z]);
+        hiz->max_z = max(hiz->max_z, vertices[i]->position[VAR_Z]);
+        min_x_pos = min(min_x_pos, vertices[i]->position[VAR_X]);
+        max_x_pos = max(max_x_pos, vertices[i]->position[VAR_X]);
+        min_y_pos = min(min_y_pos, vertices[i]->position[VAR_Y]);
+        max_y_pos = max(max_y_pos, vertices[i]->position[VAR_Y]);
+    }
+    hiz->first_tile = max((int)floor(min_x_pos), min_x) >> HIZ_TILE_BITS;
+    last_tile = min((int)ceil(max_x_pos), max_x) >> HIZ_TILE_BITS;
+    first_row = max((int)floor(min_y_pos), min_y) >> HIZ_TILE_BITS;
+    last_row = min((int)ceil(max_y_pos), max_y) >> HIZ_TILE_BITS;
+    if(last_tile < hiz->first_tile || (last_tile == hiz->first_tile && last_row <= first_row)){
+        return ER_FALSE;
+    }
+    hiz->tiles = min(last_tile - hiz->first_tile + 1, HIZ_BAND_TILES);
+    hiz->band_y = -1;
+    hiz->rejected_blocks = 0;
+    return ER_TRUE;
+
+}
 
-    int start_y = ceil(bottom->position[VAR_Y]);
-    int end_y = (int)ceil(top->position[VAR_Y]) - 1;
-    float prestep_y = start_y - bottom->position[VAR_Y];
-    float y_range = top->position[VAR_Y] - bottom->position[VAR_Y];
-    float x_range = top->position[VAR_X] - bottom->position[VAR_X];
-    float step_x = x_range / y_range;
-    t_edge->start_y = start_y;
-    t_edge->end_y = end_y;
-    t_edge->step_x = step_x;
-    t_edge->x = bottom->position[VAR_X] + step_x * prestep_y;
+/*
+ * Shade the fragments on [start_x, end_x] of the scanline y, skipping the tiles where Hi-Z rejects the primitive.
+ * Runs of shaded tiles are passed whole to shade_scanline, so spans keep their alignment.
+*/
+RASTER_INLINE void shade_scanline_hiz(er_Context *ctx, HizBand *hiz, int y, int start_x, int end_x, const PlaneRow *row, er_FragInput *input, er_FragSpan *span, er_Bool span_shader, int varyings){
+
+    int x, next_x, tile, run_x;
+
+    if(hiz == NULL){
+        shade_scanline(ctx, y, start_x, end_x, row, input, span, span_shader, varyings);
+        return;
+    }
+    /* Tiles are tested again on each band of scanlines, state 0 untested, 1 shaded, 2 rejected */
+    if((y & ~(HIZ_TILE_SIZE - 1)) != hiz->band_y){
+        hiz->band_y = y & ~(HIZ_TILE_SIZE - 1);
+        memset(hiz->state, 0, hiz->tiles);
+    }
+    run_x = start_x;
+    for(x = start_x; x <= end_x; x = next_x){
+        next_x = (x & ~(HIZ_TILE_SIZE - 1)) + HIZ_TILE_SIZE;
+        tile = (x >> HIZ_TILE_BITS) - hiz->first_tile;
+        if(tile < 0 || tile >= hiz->tiles){
+            continue;
+        }
+        if(hiz->state[tile] == 0){
+            hiz->state[tile] = 1;
+            if(hiz_reject_block(ctx, hiz->reference, input, hiz->min_z, hiz->max_z, x & ~(HIZ_TILE_SIZE - 1), hiz->band_y) == ER_TRUE){
+                hiz->state[tile] = 2;
+                hiz->rejected_blocks++;
+            }
+        }
+        if(hiz->state[tile] == 2){
+            if(run_x < x){
+                shade_scanline(ctx, y, run_x, x - 1, row, input, span, span_shader, varyings);
+            }
+            run_x = next_x;
+        }
+    }
+    if(run_x <= end_x){
+        shade_scanline(ctx, y, run_x, end_x, row, input, span, span_shader, varyings);
+    }
 
 }
 
 /*
- * Scan line conversion of a triangle given on CCW order. Generic interpolation of parameters.
- * Sampling on pixel centers, with subpixel precision and consistent bottom-left fill convention.
+ * Shade the fragments of the scanline y between the left and right edges, gradients are set up from reference.
 */
-void draw_triangle(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, er_PolygonFaceEnum face){
+RASTER_INLINE void draw_scanline(er_Context *ctx, Edge *left, Edge *right, int y, int min_x, int max_x, er_Bool scissor_x, er_VertexOutput *reference, er_FragInput *input, er_FragSpan *span, er_Bool span_shader, HizBand *hiz, int varyings){
 
-    Edge bottom_to_top, bottom_to_middle, middle_to_top;
-    Edge *left0, *right0;
-    Edge *left1, *right1;
-    er_FragInput input;
+    int start_x, end_x;
+    PlaneRow row;
+
+    start_x = ceil(left->x);
+    end_x = (int)ceil(right->x) - 1;
+    /* Scissor to the region being drawn, vertices may lie on the guard band or outside of the tile */
+    if(scissor_x == ER_TRUE){
+        start_x = max(start_x, min_x);
+        end_x = min(end_x, max_x);
+    }
+    if(start_x > end_x){
+        return;
+    }
+    init_plane_row(&row, reference, input, y, varyings);
+    shade_scanline_hiz(ctx, hiz, y, start_x, end_x, &row, input, span, span_shader, varyings);
+
+}
+
+/*
+ * x of the left and right edges on the scanline y.
+*/
+RASTER_INLINE void position_edges(Edge *left, Edge *right, int y){
+
+    left->x = left->bottom->position[VAR_X] + left->step_x * (y - left->bottom->position[VAR_Y]);
+    right->x = right->bottom->position[VAR_X] + right->step_x * (y - right->bottom->position[VAR_Y]);
+
+}
 
-    /* Calculate gradients */
+/*
+ * Screen space gradients of depth, 1/w and varying attributes of a triangle.
+*/
+RASTER_INLINE void triangle_gradients_variant(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, er_FragInput *input, int varyings){
+
+    int k;
     float dx10, dx20, dy10, dy20, dattrib10, dattrib20, a, b, one_over_c;
     dx10 = vertex1->position[VAR_X] - vertex0->position[VAR_X];
     dx20 = vertex2->position[VAR_X] - vertex0->position[VAR_X];
@@ -1146,27 +1873,289 @@ void draw_triangle(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_Vertex
     dattrib20 = vertex2->position[VAR_Z] - vertex0->position[VAR_Z];
     a = dy10 * dattrib20 - dy20 * dattrib10;
     b = dx20 * dattrib10 - dx10 * dattrib20;
-    input.dz_dx = -a * one_over_c;
-    input.dz_dy = -b * one_over_c;
+    input->dz_dx = -a * one_over_c;
+    input->dz_dy = -b * one_over_c;
     /* 1/W Gradients */
     dattrib10 = vertex1->position[VAR_W] - vertex0->position[VAR_W];
     dattrib20 = vertex2->position[VAR_W] - vertex0->position[VAR_W];
     a = dy10 * dattrib20 - dy20 * dattrib10;
     b = dx20 * dattrib10 - dx10 * dattrib20;
-    input.dw_dx = -a * one_over_c;
-    input.dw_dy = -b * one_over_c;
+    input->dw_dx = -a * one_over_c;
+    input->dw_dy = -b * one_over_c;
     /* Gradients of varying attributes */
-    int k;
-    for(k = 0; k < current_program->varying_attributes; k++){
+    for(k = 0; k < varyings; k++){
         dattrib10 = vertex1->attributes[k] - vertex0->attributes[k];
         dattrib20 = vertex2->attributes[k] - vertex0->attributes[k];
         a = dy10 * dattrib20 - dy20 * dattrib10;
         b = dx20 * dattrib10 - dx10 * dattrib20;
-        input.ddx[k] = -a * one_over_c;
-        input.ddy[k] = -b * one_over_c;
+        input->ddx[k] = -a * one_over_c;
+        input->ddy[k] = -b * one_over_c;
+    }
+
+}
+
+/*
+ * Hi-Z test of a whole polygon, against the tiles touched by its bounding box on the region [min_x, max_x] x [min_y, max_y].
+*/
+static er_Bool hiz_reject_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, int min_x, int max_x, int min_y, int max_y){
+
+    int start_x, end_x, start_y, end_y;
+    float min_x_pos, max_x_pos, min_y_pos, max_y_pos, min_z, max_z;
+    unsigned int i;
+
+    min_x_pos = max_x_pos = vertices[0]->position[VAR_X];
+    min_y_pos = max_y_pos = vertices[0]->position[VAR_Y];
+    min_z = max_z = vertices[0]->position[VAR_Z];
+    for(i = 1; i < size; i++){
+        min_x_pos = min(min_x_pos, vertices[i]->position[VAR_X]);
+        max_x_pos = max(max_x_pos, vertices[i]->position[VAR_X]);
+        min_y_pos = min(min_y_pos, vertices[i]->position[VAR_Y]);
+        max_y_pos = max(max_y_pos, vertices[i]->position[VAR_Y]);
+        min_z = min(min_z, vertices[i]->position[VAR_Z]);
+        max_z = max(max_z, vertices[i]->position[VAR_Z]);
+    }
+    start_x = max((int)floor(min_x_pos), min_x);
+    end_x = min((int)ceil(max_x_pos), max_x);
+    start_y = max((int)floor(min_y_pos), min_y);
+    end_y = min((int)ceil(max_y_pos), max_y);
+    if(start_x > end_x || start_y > end_y){
+        return ER_FALSE;
+    }
+    return hiz_reject_area(ctx, start_x, end_x, start_y, end_y, min_z, max_z);
+
+}
+
+/*
+ * Gradients of the plane of a convex polygon, from the largest triangle of the fan.
+*/
+RASTER_INLINE void polygon_gradients_variant(er_VertexOutput **vertices, unsigned int size, er_FragInput *input, int varyings){
+
+    unsigned int i, base = 1;
+    float area, max_area = -1.0f;
+    float x0 = vertices[0]->position[VAR_X], y0 = vertices[0]->position[VAR_Y];
+
+    for(i = 1; i < size - 1; i++){
+        area = (vertices[i]->position[VAR_X] - x0) * (vertices[i+1]->position[VAR_Y] - y0) -
+               (vertices[i+1]->position[VAR_X] - x0) * (vertices[i]->position[VAR_Y] - y0);
+        if(area > max_area){
+            max_area = area;
+            base = i;
+        }
+    }
+    triangle_gradients_variant(vertices[0], vertices[base], vertices[base+1], input, varyings);
+
+}
+
+/*
+ * Gradients, front facing flag and flat attributes of a triangle or a polygon. They are computed once per
+ * primitive and shared by every region it is drawn on, the screen tiles it is binned to when tiling.
+*/
+RASTER_INLINE void setup_polygon_variant(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face, er_FragInput *setup, int varyings){
+
+    polygon_gradients_variant(vertices, size, setup, varyings);
+    setup->front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
+    set_flat_attributes(ctx, setup, vertices[0]);
+
+}
+
+/*
+ * Fixed point edge of the scanline rasterizer. Vertices are snapped to a grid of 2^subpixel_bits
+ * positions per pixel, and the first pixel center on the right of the edge is computed exactly
+ * on every scanline as the ceiling of a fraction, stepped with an integer quotient and remainder.
+ * Edges shared by two polygons give the same pixels on both of them.
+*/
+typedef struct FixedEdge{
+    int64_t x0, y0, dx, dy;     /* Snapped bottom vertex and extent */
+    int64_t quotient;           /* First pixel center on the right of the edge */
+    int64_t remainder;          /* quotient * denominator - numerator, on [0, denominator) */
+    int64_t denominator;
+    int64_t step_quotient, step_remainder;
+    int end_y;
+} FixedEdge;
+
+static int64_t ceil_div(int64_t n, int64_t d){
+
+    int64_t q = n / d;
+    if(n % d > 0){
+        q++;
+    }
+    return q;
+
+}
+
+/* Index of the first scanline at or above a snapped y coordinate */
+static int fixed_ceil(int64_t value, unsigned int bits){
+
+    return (int)ceil_div(value, (int64_t)1 << bits);
+
+}
+
+/*
+ * Edge from bottom to top, positioned on the scanline y.
+*/
+static void init_fixed_edge(er_Context *ctx, FixedEdge *edge, er_VertexOutput *bottom, er_VertexOutput *top, int y){
+
+    unsigned int bits = ctx->subpixel_bits;
+    edge->x0 = snap(bottom->position[VAR_X], bits);
+    edge->y0 = snap(bottom->position[VAR_Y], bits);
+    edge->dx = snap(top->position[VAR_X], bits) - edge->x0;
+    edge->dy = snap(top->position[VAR_Y], bits) - edge->y0;
+    edge->end_y = fixed_ceil(edge->y0 + edge->dy, bits) - 1;
+    if(edge->dy <= 0){
+        /* Horizontal edges don't have any scanline */
+        edge->end_y = y - 1;
+        return;
+    }
+    /* x on the scanline is x0 + (y - y0) * dx / dy, on pixels it is numerator / denominator */
+    int64_t scale = (int64_t)1 << bits;
+    int64_t numerator = edge->x0 * edge->dy + ((int64_t)y * scale - edge->y0) * edge->dx;
+    edge->denominator = edge->dy * scale;
+    edge->quotient = ceil_div(numerator, edge->denominator);
+    edge->remainder = edge->quotient * edge->denominator - numerator;
+    /* One scanline adds dx * scale to the numerator */
+    int64_t step = edge->dx * scale;
+    edge->step_quotient = step / edge->denominator;
+    edge->step_remainder = step - edge->step_quotient * edge->denominator;
+    if(edge->step_remainder < 0){
+        edge->step_quotient--;
+        edge->step_remainder += edge->denominator;
+    }
+
+}
+
+static void step_fixed_edge(FixedEdge *edge){
+
+    edge->quotient += edge->step_quotient;
+    edge->remainder -= edge->step_remainder;
+    if(edge->remainder < 0){
+        edge->remainder += edge->denominator;
+        edge->quotient++;
+    }
+
+}
+
+/*
+ * Scan line conversion of a convex polygon given on CCW order, with fixed point edges.
+ * Attributes are evaluated from the plane equations on every pixel, so the result doesn't depend
+ * on the region [min_x, max_x] x [min_y, max_y] being drawn, and rows below it are skipped.
+*/
+RASTER_INLINE void draw_polygon_fixed(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y, int varyings){
+
+    FixedEdge left, right;
+    er_FragInput input;
+    unsigned int i, bottom, top, left_index, right_index, next;
+
+    input = *setup;
+    /* Fragments are shaded on spans when the program has a span shader */
+    er_FragSpan span;
+    er_Bool span_shader = (ctx->current_program->fragment_span_shader != NULL) ? ER_TRUE: ER_FALSE;
+    if(span_shader == ER_TRUE){
+        init_span(ctx, &span, &input);
+    }
+    /* Tiles behind the depth buffer are skipped, their decisions are kept for a band of scanlines */
+    HizBand band, *hiz = NULL;
+    if(hiz_active(ctx) == ER_TRUE && init_hiz_band(&band, vertices, size, min_x, max_x, min_y, max_y) == ER_TRUE){
+        hiz = &band;
+    }
+
+    /* Bottom and top vertices, on the snapped grid */
+    int64_t bottom_y, top_y, vertex_y;
+    bottom = 0;
+    top = 0;
+    bottom_y = top_y = snap(vertices[0]->position[VAR_Y], ctx->subpixel_bits);
+    for(i = 1; i < size; i++){
+        vertex_y = snap(vertices[i]->position[VAR_Y], ctx->subpixel_bits);
+        if(vertex_y < bottom_y){
+            bottom = i;
+            bottom_y = vertex_y;
+        }
+        if(vertex_y > top_y){
+            top = i;
+            top_y = vertex_y;
+        }
+    }
+
+    /* On CCW order, the right chain goes forward from the bottom vertex and the left chain backwards */
+    int y = max(fixed_ceil(bottom_y, ctx->subpixel_bits), min_y);
+    int end_y = min(fixed_ceil(top_y, ctx->subpixel_bits) - 1, max_y);
+    int start_x, end_x;
+    PlaneRow row;
+    left_index = bottom;
+    right_index = bottom;
+    left.end_y = y - 1;
+    right.end_y = y - 1;
+    for(; y <= end_y; y++){
+        /* Move to the next edges, horizontal ones don't have any scanline */
+        while(y > left.end_y && left_index != top){
+            next = (left_index + size - 1) % size;
+            init_fixed_edge(ctx, &left, vertices[left_index], vertices[next], y);
+            left_index = next;
+        }
+        while(y > right.end_y && right_index != top){
+            next = (right_index + 1) % size;
+            init_fixed_edge(ctx, &right, vertices[right_index], vertices[next], y);
+            right_index = next;
+        }
+        start_x = (int)max(left.quotient, (int64_t)min_x);
+        end_x = (int)min(right.quotient - 1, (int64_t)max_x);
+        if(start_x <= end_x){
+            init_plane_row(&row, vertices[0], &input, y, varyings);
+            shade_scanline_hiz(ctx, hiz, y, start_x, end_x, &row, &input, &span, span_shader, varyings);
+        }
+        step_fixed_edge(&left);
+        step_fixed_edge(&right);
+    }
+    if(hiz != NULL && hiz->rejected_blocks){
+        add_statistic(&ctx->statistics.hiz_rejected_blocks, hiz->rejected_blocks);
+    }
+
+}
+
+/*
+ * Scan line conversion of a triangle given on CCW order. Generic interpolation of parameters.
+ * Sampling on pixel centers, with subpixel precision and consistent bottom-left fill convention.
+ * Only scanlines on [min_y, max_y] are shaded, the ones below are skipped.
+*/
+RASTER_INLINE void draw_triangle_variant(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y, int varyings){
+
+    Edge bottom_to_top, bottom_to_middle, middle_to_top;
+    Edge *left0, *right0;
+    Edge *left1, *right1;
+    er_FragInput input;
+
+    /* Triangle behind the depth stored on every tile it touches */
+    er_VertexOutput *vertices[3] = {vertex0, vertex1, vertex2};
+    if(hiz_active(ctx) == ER_TRUE && hiz_reject_polygon(ctx, vertices, 3, min_x, max_x, min_y, max_y) == ER_TRUE){
+        add_statistic(&ctx->statistics.hiz_rejected_triangles, 1);
+        return;
+    }
+
+    /* Half-space edges are exact on the grid of the fixed point edges, which take over when they don't fit */
+    if(ctx->half_space_enable == ER_TRUE && half_space_fits(ctx) == ER_TRUE){
+        draw_polygon_half_space(ctx, vertices, 3, setup, min_x, max_x, min_y, max_y, varyings);
+        return;
+    }
+
+    if(ctx->fixed_point_enable == ER_TRUE || ctx->half_space_enable == ER_TRUE){
+        draw_polygon_fixed(ctx, vertices, 3, setup, min_x, max_x, min_y, max_y, varyings);
+        return;
+    }
+
+    /* Gradients shared by every region the triangle is drawn on */
+    input = *setup;
+    /* Fragments are shaded on spans when the program has a span shader */
+    er_FragSpan span;
+    er_Bool span_shader = (ctx->current_program->fragment_span_shader != NULL) ? ER_TRUE: ER_FALSE;
+    if(span_shader == ER_TRUE){
+        init_span(ctx, &span, &input);
+    }
+    /* Columns out of the region only come from the guard band, or from tiles narrower than the window */
+    er_Bool scissor_x = (ctx->guard_band_enable == ER_TRUE || min_x > 0 || max_x < (int)ctx->window_width - 1) ? ER_TRUE: ER_FALSE;
+    /* Tiles behind the depth buffer are skipped, their decisions are kept for a band of scanlines */
+    HizBand band, *hiz = NULL;
+    if(hiz_active(ctx) == ER_TRUE && init_hiz_band(&band, vertices, 3, min_x, max_x, min_y, max_y) == ER_TRUE){
+        hiz = &band;
     }
-    /* Front facing flag */
-    input.front_facing = (face == ER_FRONT) ? ER_TRUE: ER_FALSE;
 
     /* Edges setup */
     float y0, y1, y2;
@@ -1176,114 +2165,239 @@ void draw_triangle(er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_Vertex
 
     if(y0 < y1){
         if(y1 < y2){
-            init_left_edge(&bottom_to_top, vertex0, vertex2);
-            init_right_edge(&bottom_to_middle, vertex0, vertex1);
-            init_right_edge(&middle_to_top, vertex1, vertex2);
+            init_edge(&bottom_to_top, vertex0, vertex2, min_y);
+            init_edge(&bottom_to_middle, vertex0, vertex1, min_y);
+            init_edge(&middle_to_top, vertex1, vertex2, min_y);
             left0 = &bottom_to_top; right0 = &bottom_to_middle;
             left1 = &bottom_to_top; right1 = &middle_to_top;
         }else{
             if(y0 < y2){
-                init_left_edge(&bottom_to_middle, vertex0, vertex2);
-                init_left_edge(&middle_to_top, vertex2, vertex1);
-                init_right_edge(&bottom_to_top, vertex0, vertex1);
+                init_edge(&bottom_to_middle, vertex0, vertex2, min_y);
+                init_edge(&middle_to_top, vertex2, vertex1, min_y);
+                init_edge(&bottom_to_top, vertex0, vertex1, min_y);
                 left0 = &bottom_to_middle; right0 = &bottom_to_top;
                 left1 = &middle_to_top; right1 = &bottom_to_top;
             }else{
-                init_left_edge(&bottom_to_top, vertex2, vertex1);
-                init_right_edge(&bottom_to_middle, vertex2, vertex0);
-                init_right_edge(&middle_to_top, vertex0, vertex1);
+                init_edge(&bottom_to_top, vertex2, vertex1, min_y);
+                init_edge(&bottom_to_middle, vertex2, vertex0, min_y);
+                init_edge(&middle_to_top, vertex0, vertex1, min_y);
                 left0 = &bottom_to_top; right0 = &bottom_to_middle;
                 left1 = &bottom_to_top; right1 = &middle_to_top;
             }
         }
     }else{
         if(y0 < y2){
-            init_left_edge(&bottom_to_middle, vertex1, vertex0);
-            init_left_edge(&middle_to_top, vertex0, vertex2);
-            init_right_edge(&bottom_to_top, vertex1, vertex2);
+            init_edge(&bottom_to_middle, vertex1, vertex0, min_y);
+            init_edge(&middle_to_top, vertex0, vertex2, min_y);
+            init_edge(&bottom_to_top, vertex1, vertex2, min_y);
             left0 = &bottom_to_middle; right0 = &bottom_to_top;
             left1 = &middle_to_top; right1 = &bottom_to_top;
         }else{
             if(y1 < y2){
-                init_left_edge(&bottom_to_top, vertex1, vertex0);
-                init_right_edge(&middle_to_top, vertex2, vertex0);
-                init_right_edge(&bottom_to_middle, vertex1, vertex2);
+                init_edge(&bottom_to_top, vertex1, vertex0, min_y);
+                init_edge(&middle_to_top, vertex2, vertex0, min_y);
+                init_edge(&bottom_to_middle, vertex1, vertex2, min_y);
                 left0 = &bottom_to_top; right0 = &bottom_to_middle;
                 left1 = &bottom_to_top; right1 = &middle_to_top;
             }else{
-                init_left_edge(&bottom_to_middle, vertex2, vertex1);
-                init_left_edge(&middle_to_top, vertex1, vertex0);
-                init_right_edge(&bottom_to_top, vertex2, vertex0);
+                init_edge(&bottom_to_middle, vertex2, vertex1, min_y);
+                init_edge(&middle_to_top, vertex1, vertex0, min_y);
+                init_edge(&bottom_to_top, vertex2, vertex0, min_y);
                 left0 = &bottom_to_middle; right0 = &bottom_to_top;
                 left1 = &middle_to_top; right1 = &bottom_to_top;
             }
         }
     }
 
-    int y, x, start_x, end_x;
-    float prestep_x;
+    int y;
     for(y = bottom_to_middle.start_y; y <= bottom_to_middle.end_y; y++){
-        start_x = ceil(left0->x);
-        end_x = (int)ceil(right0->x) - 1;
-        prestep_x = start_x - left0->x;
-        /* Prestep interpolators for scanline */
-        input.frag_coord[VAR_Z] = left0->z + input.dz_dx * prestep_x;
-        input.frag_coord[VAR_W] = left0->w + input.dw_dx * prestep_x;
-        for(k = 0; k < current_program->varying_attributes; k++){
-            input.attributes[k] = left0->attributes[k] + input.ddx[k] * prestep_x;
-        }
-        /* Scan line interpolation*/
-        for(x = start_x; x <= end_x; x++){
-            input.frag_coord[VAR_X] = x;
-            input.frag_coord[VAR_Y] = y;
-            current_program->fragment_shader(y, x, &input, &global_variables);
-            input.frag_coord[VAR_Z] += input.dz_dx;
-            input.frag_coord[VAR_W] += input.dw_dx;
-            for(k = 0; k < current_program->varying_attributes; k++){
-                input.attributes[k] += input.ddx[k];
-            }
+        if(y > max_y){
+            break;
         }
-        /* Step along left edge */
-        left0->x += left0->step_x;
-        left0->z += left0->step_z;
-        left0->w += left0->step_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
-            left0->attributes[k] += left0->attributes_step[k];
-        }
-        /* Step along right edge */
-        right0->x += right0->step_x;
+        position_edges(left0, right0, y);
+        draw_scanline(ctx, left0, right0, y, min_x, max_x, scissor_x, vertex0, &input, &span, span_shader, hiz, varyings);
     }
 
     for(y = middle_to_top.start_y; y <= middle_to_top.end_y; y++){
-        start_x = ceil(left1->x);
-        end_x = (int)ceil(right1->x) - 1;
-        prestep_x = start_x - left1->x;
-        /* Prestep interpolators for scanline */
-        input.frag_coord[VAR_Z] = left1->z + input.dz_dx * prestep_x;
-        input.frag_coord[VAR_W] = left1->w + input.dw_dx * prestep_x;
-        for(k = 0; k < current_program->varying_attributes; k++){
-            input.attributes[k] = left1->attributes[k] + input.ddx[k] * prestep_x;
-        }
-        /* Scan line interpolation*/
-        for(x = start_x; x <= end_x; x++){
-            input.frag_coord[VAR_X] = x;
-            input.frag_coord[VAR_Y] = y;
-            current_program->fragment_shader(y, x, &input, &global_variables);
-            input.frag_coord[VAR_Z] += input.dz_dx;
-            input.frag_coord[VAR_W] += input.dw_dx;
-            for(k = 0; k < current_program->varying_attributes; k++){
-                input.attributes[k] += input.ddx[k];
-            }
+        if(y > max_y){
+            break;
+        }
+        position_edges(left1, right1, y);
+        draw_scanline(ctx, left1, right1, y, min_x, max_x, scissor_x, vertex0, &input, &span, span_shader, hiz, varyings);
+    }
+    if(hiz != NULL && hiz->rejected_blocks){
+        add_statistic(&ctx->statistics.hiz_rejected_blocks, hiz->rejected_blocks);
+    }
+
+}
+
+/*
+ * Scan line conversion of a convex polygon given on CCW order, made by clipping a triangle.
+ * Gradients are set up once for the whole polygon and the scanlines are walked between a left
+ * and a right chain of edges, both going from the bottom vertex to the top one.
+*/
+RASTER_INLINE void draw_polygon_variant(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y, int varyings){
+
+    Edge left = {0}, right = {0};
+    er_FragInput input;
+    unsigned int i, bottom, top, left_index, right_index, next;
+
+    /* Polygon behind the depth stored on every tile it touches */
+    if(hiz_active(ctx) == ER_TRUE && hiz_reject_polygon(ctx, vertices, size, min_x, max_x, min_y, max_y) == ER_TRUE){
+        add_statistic(&ctx->statistics.hiz_rejected_triangles, 1);
+        return;
+    }
+
+    /* One bounding box and one edge function per side, with the setup shared by the whole polygon */
+    if(ctx->half_space_enable == ER_TRUE && half_space_fits(ctx) == ER_TRUE){
+        draw_polygon_half_space(ctx, vertices, size, setup, min_x, max_x, min_y, max_y, varyings);
+        return;
+    }
+
+    if(ctx->fixed_point_enable == ER_TRUE || ctx->half_space_enable == ER_TRUE){
+        draw_polygon_fixed(ctx, vertices, size, setup, min_x, max_x, min_y, max_y, varyings);
+        return;
+    }
+
+    input = *setup;
+    /* Fragments are shaded on spans when the program has a span shader */
+    er_FragSpan span;
+    er_Bool span_shader = (ctx->current_program->fragment_span_shader != NULL) ? ER_TRUE: ER_FALSE;
+    if(span_shader == ER_TRUE){
+        init_span(ctx, &span, &input);
+    }
+    /* Columns out of the region only come from the guard band, or from tiles narrower than the window */
+    er_Bool scissor_x = (ctx->guard_band_enable == ER_TRUE || min_x > 0 || max_x < (int)ctx->window_width - 1) ? ER_TRUE: ER_FALSE;
+    /* Tiles behind the depth buffer are skipped, their decisions are kept for a band of scanlines */
+    HizBand band, *hiz = NULL;
+    if(hiz_active(ctx) == ER_TRUE && init_hiz_band(&band, vertices, size, min_x, max_x, min_y, max_y) == ER_TRUE){
+        hiz = &band;
+    }
+
+    /* Bottom and top vertices */
+    bottom = 0;
+    top = 0;
+    for(i = 1; i < size; i++){
+        if(vertices[i]->position[VAR_Y] < vertices[bottom]->position[VAR_Y]){
+            bottom = i;
+        }
+        if(vertices[i]->position[VAR_Y] > vertices[top]->position[VAR_Y]){
+            top = i;
+        }
+    }
+
+    /* On CCW order, the right chain goes forward from the bottom vertex and the left chain backwards */
+    int y = max((int)ceil(vertices[bottom]->position[VAR_Y]), min_y);
+    int end_y = (int)ceil(vertices[top]->position[VAR_Y]) - 1;
+    left_index = bottom;
+    right_index = bottom;
+    left.end_y = y - 1;
+    right.end_y = y - 1;
+    for(; y <= end_y; y++){
+        if(y > max_y){
+            break;
         }
-        /* Step along left edge */
-        left1->x += left1->step_x;
-        left1->z += left1->step_z;
-        left1->w += left1->step_w;
-        for(k = 0; k < current_program->varying_attributes; k++){
-            left1->attributes[k] += left1->attributes_step[k];
+        /* Move to the next edges, horizontal ones don't have any scanline */
+        while(y > left.end_y && left_index != top){
+            next = (left_index + size - 1) % size;
+            init_edge(&left, vertices[left_index], vertices[next], y);
+            left_index = next;
         }
-        /* Step along right edge */
-        right1->x += right1->step_x;
+        while(y > right.end_y && right_index != top){
+            next = (right_index + 1) % size;
+            init_edge(&right, vertices[right_index], vertices[next], y);
+            right_index = next;
+        }
+        position_edges(&left, &right, y);
+        draw_scanline(ctx, &left, &right, y, min_x, max_x, scissor_x, vertices[0], &input, &span, span_shader, hiz, varyings);
+    }
+    if(hiz != NULL && hiz->rejected_blocks){
+        add_statistic(&ctx->statistics.hiz_rejected_blocks, hiz->rejected_blocks);
+    }
+
+}
+
+/*
+ * Rasterizer variants, loops over the varying attributes have a constant trip count and get unrolled.
+ * Programs with fewer varyings use the next variant, their vertices have the extra attributes zeroed.
+*/
+#define RASTERIZER_VARIANT(N) \
+static void draw_point_sprite_##N(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y){ \
+    draw_point_sprite_variant(ctx, vertex, face, min_x, max_x, min_y, max_y, N); \
+} \
+static void draw_point_##N(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y){ \
+    draw_point_variant(ctx, vertex, face, min_x, max_x, min_y, max_y, N); \
+} \
+static void draw_line_##N(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y){ \
+    draw_line_variant(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y, N); \
+} \
+static void setup_polygon_##N(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face, er_FragInput *setup){ \
+    setup_polygon_variant(ctx, vertices, size, face, setup, N); \
+} \
+static void draw_triangle_##N(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y){ \
+    draw_triangle_variant(ctx, vertex0, vertex1, vertex2, setup, min_x, max_x, min_y, max_y, N); \
+} \
+static void draw_polygon_##N(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y){ \
+    draw_polygon_variant(ctx, vertices, size, setup, min_x, max_x, min_y, max_y, N); \
+} \
+static const RasterizerVariant rasterizer_##N = {N, draw_point_sprite_##N, draw_point_##N, draw_line_##N, setup_polygon_##N, draw_triangle_##N, draw_polygon_##N};
+
+RASTERIZER_VARIANT(0)
+RASTERIZER_VARIANT(2)
+RASTERIZER_VARIANT(4)
+RASTERIZER_VARIANT(8)
+RASTERIZER_VARIANT(16)
+
+/*
+ * Smallest variant that holds the varying attributes of a program.
+*/
+const RasterizerVariant* select_rasterizer(int varying_attributes){
+
+    if(varying_attributes <= 0){
+        return &rasterizer_0;
+    }else if(varying_attributes <= 2){
+        return &rasterizer_2;
+    }else if(varying_attributes <= 4){
+        return &rasterizer_4;
+    }else if(varying_attributes <= 8){
+        return &rasterizer_8;
     }
+    return &rasterizer_16;
+
+}
+
+void draw_point_sprite(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y){
+
+    ctx->current_program->rasterizer->draw_point_sprite(ctx, vertex, face, min_x, max_x, min_y, max_y);
+
+}
+
+void draw_point(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y){
+
+    ctx->current_program->rasterizer->draw_point(ctx, vertex, face, min_x, max_x, min_y, max_y);
+
+}
+
+void draw_line(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face, int min_x, int max_x, int min_y, int max_y){
+
+    ctx->current_program->rasterizer->draw_line(ctx, vertex0, vertex1, face, min_x, max_x, min_y, max_y);
+
+}
+
+void setup_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face, er_FragInput *setup){
+
+    ctx->current_program->rasterizer->setup_polygon(ctx, vertices, size, face, setup);
+
+}
+
+void draw_triangle(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y){
+
+    ctx->current_program->rasterizer->draw_triangle(ctx, vertex0, vertex1, vertex2, setup, min_x, max_x, min_y, max_y);
+
+}
+
+void draw_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, const er_FragInput *setup, int min_x, int max_x, int min_y, int max_y){
+
+    ctx->current_program->rasterizer->draw_polygon(ctx, vertices, size, setup, min_x, max_x, min_y, max_y);
 
 }
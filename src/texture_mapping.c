@@ -1,7 +1,14 @@
 #include "pipeline.h"
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
 
-#define LOG2_DOT_2 1.386294361
-#define LOG2 0.693147181
 #define POSITIVE_X 0
 #define NEGATIVE_X 1
 #define POSITIVE_Y 2
@@ -14,526 +21,849 @@ typedef struct Cubemap_uv{
     float u_sign, v_sign;
     int cubemap_face;
     int u_index, v_index, max_axis_index;
-    int (*wrap_u)(int, int);
-    int (*wrap_v)(int, int);
+    er_TextureWrapModeEnum wrap_u;
+    er_TextureWrapModeEnum wrap_v;
 } Cubemap_uv;
 
-er_PointSpriteEnum point_sprite_coord_origin;
-er_Bool point_sprite_enable;
-
-static int repeat(int coord, int dimension){
-    return coord & (dimension - 1);
-}
-
-static int clamp_to_edge(int coord, int dimension){
-    return clamp(coord, 0, dimension - 1);
-}
+/*
+ * The samplers are written once with the filters, wrap modes and number of components as parameters,
+ * and instantiated after the cubemap samplers (see SAMPLER_FILTERS).
+*/
+#if defined(__GNUC__)
+#define SAMPLER_INLINE static inline __attribute__((always_inline))
+#else
+#define SAMPLER_INLINE static inline
+#endif
 
-void er_texture_size(er_Texture *tex, int lod, int *dimension){
-    tex->texture_size(tex, lod, dimension);
+/* Wrap of a texel coordinate, both modes are computed so that the wrap modes of cubemap faces select without branches */
+SAMPLER_INLINE int wrap_texel(int coord, int dimension, er_TextureWrapModeEnum wrap){
+    int repeated = coord & (dimension - 1);
+    int clamped = clamp(coord, 0, dimension - 1);
+    return (wrap == ER_REPEAT) ? repeated: clamped;
 }
 
-void er_texel_fetch(er_Texture *tex, int *coord, int lod, float *color){
-    tex->texel_fetch(tex, coord, lod, color);
+/* Largest integer not greater than x, without the call to floor */
+SAMPLER_INLINE int floor_texel(float x){
+    int i = (int)x;
+    return i - (x < i);
 }
 
-void er_texture_lod(er_Texture *tex, float *coord, float lod, float *color){
-    tex->texture_lod(tex, coord, lod, color);
-}
+/*
+ * Base 2 logarithm from the exponent bits of x and a polynomial of its mantissa in [1, 2), exact on
+ * powers of two and continuous between them, with an error under 1.2e-4. Denormals are flushed to
+ * the smallest normal number, their logarithm is -126 at most.
+*/
+static inline float fast_log2(float x){
 
-void er_texture_grad(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-    tex->texture_grad(tex, coord, ddx, ddy, color);
-}
+    if(!(x > 0.0f)){
+        /* Same as log on zero, negative numbers and NaN */
+        return (x == 0.0f) ? -INFINITY: NAN;
+    }
+    if(x < FLT_MIN){
+        x = FLT_MIN;
+    }
+    union{ float f; uint32_t i; } bits = {x};
+    float exponent = (float)((int)(bits.i >> 23) - 127);
+    bits.i = (bits.i & 0x007FFFFF) | 0x3F800000;
+    float t = bits.f - 1.0f;
+    return exponent + t * (1.4387254f + t * (-0.6777823f + t * (0.3211865f + t * -0.0821296f)));
 
-void er_write_texture(er_Texture *tex, int *coord, int lod, float *color){
-    tex->write_texture(tex, coord, lod, color);
 }
 
-static void texture1D_size(er_Texture *tex, int lod, int *dimension){
-    dimension[0] = tex->mipmaps[lod]->width;
+/*
+ * Packed formats store texels on 8 bit unsigned normalized or half float components, or on
+ * compressed blocks, they are decoded to floats by the samplers.
+*/
+static int packed_format(er_Texture *tex){
+    return tex->texel_size != tex->components * (int)sizeof(float);
 }
 
-static void write_texture1D(er_Texture *tex, int *coord, int lod, float *color){
+static float half_to_float(uint16_t value){
 
-    float *texels = tex->mipmaps[lod]->texels;
-    int components = tex->components;
-    int c;
-    for(c = 0; c < components; c++){
-        texels[coord[VAR_S]*components + c] = color[c];
+    /* Exponent rebiased by a product with 2^112, which also normalizes denormals */
+    uint32_t bits = (uint32_t)(value & 0x7fff) << 13;
+    float result;
+    memcpy(&result, &bits, sizeof(float));
+    result *= 5.192296858534828e33f;
+    memcpy(&bits, &result, sizeof(float));
+    if((value & 0x7c00) == 0x7c00){
+        bits |= 0x7f800000;
     }
+    bits |= (uint32_t)(value & 0x8000) << 16;
+    memcpy(&result, &bits, sizeof(float));
+    return result;
 
 }
 
-static void texture1D_texel_fetch(er_Texture *tex, int *coord, int lod, float *color){
+static uint16_t float_to_half(float value){
 
-    float *texels = tex->mipmaps[lod]->texels;
-    int components = tex->components;
-    int c;
-    for(c = 0; c < components; c++){
-        color[c] = texels[coord[VAR_S]*components + c];
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7fffffff;
+    if(bits >= 0x7f800000){
+        /* Infinity and NaN */
+        return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200: 0);
+    }
+    if(bits >= 0x477ff000){
+        /* Rounds over the largest half */
+        return sign | 0x7c00;
     }
+    if(bits < 0x38800000){
+        /* Denormals, the sum with 0.5 rounds the mantissa to units of 2^-24 */
+        float denormal;
+        memcpy(&denormal, &bits, sizeof(float));
+        denormal += 0.5f;
+        memcpy(&bits, &denormal, sizeof(float));
+        return sign | (uint16_t)(bits - 0x3f000000);
+    }
+    /* Rebias the exponent and round the mantissa to nearest even */
+    bits += 0xc8000fff + ((bits >> 13) & 1);
+    return sign | (uint16_t)(bits >> 13);
 
 }
 
-static void sample_tex1D_nearest(float *texels, int width, int components, float u, int (*wrap_u)(int, int), float *color){
+/*
+ * Compressed formats store blocks of 4x4 texels on the order of the tiled layout. Blocks are
+ * decoded whole to a small cache per thread, so the texels of a footprint are decoded once.
+*/
+#define BLOCK_CACHE_BITS 5
 
-    float mu;
-    int ru;
+typedef struct DecodedBlock{
+    const uint8_t *block;
+    unsigned int generation;
+    float texels[16][4];
+} DecodedBlock;
 
-    //Map to texel coordinates
-    mu = -0.5 + u * width;
-    ru = iround(mu);
-    ru = wrap_u(ru, width);
+static _Thread_local DecodedBlock block_cache[1 << BLOCK_CACHE_BITS];
 
-    int c;
-    for(c = 0; c < components; c++){
-        color[c] = texels[ru*components + c];
-    }
+/* Increased on every write of compressed texels, invalidates the caches of all the threads */
+static unsigned int block_generation = 1;
 
+static void invalidate_blocks(void){
+    __atomic_fetch_add(&block_generation, 1, __ATOMIC_RELAXED);
 }
 
-static void sample_tex1D_linear(float *texels, int width, int components, float u, int (*wrap_u)(int, int), float *color){
+static uint16_t pack_565(const float *color){
 
-    float mu;
-    int u0, u1;
-    float alpha;
+    unsigned int r = uiround(31.0f * clamp(color[0], 0.0f, 1.0f));
+    unsigned int g = uiround(63.0f * clamp(color[1], 0.0f, 1.0f));
+    unsigned int b = uiround(31.0f * clamp(color[2], 0.0f, 1.0f));
+    return (uint16_t)((r << 11) | (g << 5) | b);
 
-    //Map to texel coordinates
-    mu = -0.5 + u * width;
-    u0 = (int)floor(mu);
-    alpha = mu - u0;
-    u0 = wrap_u(u0, width);
-    u1 = wrap_u(u0+1, width);
+}
+
+/*
+ * Colors of a color block. The third color is the average and the fourth transparent black when
+ * three colors are used, which BC1 selects with c0 <= c1.
+*/
+static void color_palette(uint16_t c0, uint16_t c1, er_Bool four_colors, float palette[4][4]){
 
     int c;
-    for(c = 0; c < components; c++){
-        color[c] = lerp( texels[u0*components + c], texels[u1*components + c], alpha);
+    palette[0][0] = ((c0 >> 11) & 31) * (1.0f / 31.0f);
+    palette[0][1] = ((c0 >> 5) & 63) * (1.0f / 63.0f);
+    palette[0][2] = (c0 & 31) * (1.0f / 31.0f);
+    palette[1][0] = ((c1 >> 11) & 31) * (1.0f / 31.0f);
+    palette[1][1] = ((c1 >> 5) & 63) * (1.0f / 63.0f);
+    palette[1][2] = (c1 & 31) * (1.0f / 31.0f);
+    for(c = 0; c < 3; c++){
+        if(four_colors){
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) * (1.0f / 3.0f);
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) * (1.0f / 3.0f);
+        }else{
+            palette[2][c] = 0.5f * (palette[0][c] + palette[1][c]);
+            palette[3][c] = 0.0f;
+        }
     }
+    palette[0][3] = palette[1][3] = palette[2][3] = 1.0f;
+    palette[3][3] = four_colors ? 1.0f: 0.0f;
 
 }
 
-static float calculate_texture1D_lod_level(er_Texture *tex, float *ddx, float *ddy){
-    float lod_level;
-    int max_dimension = tex->mipmaps[0]->width;
-    float max_derivative = max( ddx[VAR_S], ddy[VAR_S]);
-    lod_level = log( max_derivative * max_dimension ) / LOG2;
-    if(isnan(lod_level)){
-        lod_level = tex->lod_max_level;
+/*
+ * Values of a BC4 block: 8 interpolated values with a0 > a1, or 6 and the ends of the range.
+*/
+static void value_palette(uint8_t a0, uint8_t a1, float palette[8]){
+
+    int i;
+    palette[0] = a0 * (1.0f / 255.0f);
+    palette[1] = a1 * (1.0f / 255.0f);
+    if(a0 > a1){
+        for(i = 2; i < 8; i++){
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) * (1.0f / (7.0f * 255.0f));
+        }
+    }else{
+        for(i = 2; i < 6; i++){
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) * (1.0f / (5.0f * 255.0f));
+        }
+        palette[6] = 0.0f;
+        palette[7] = 1.0f;
     }
-    return lod_level;
+
 }
 
+static void decode_color_block(const uint8_t *block, er_Bool bc1, float texels[16][4]){
 
-static void texture1D_lod_mag_linear_min_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-}
+    uint16_t c0 = block[0] | (block[1] << 8);
+    uint16_t c1 = block[2] | (block[3] << 8);
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+    float palette[4][4];
+    color_palette(c0, c1, !bc1 || c0 > c1, palette);
+    int i;
+    for(i = 0; i < 16; i++){
+        memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4 * sizeof(float));
+    }
 
-static void texture1D_lod_mag_nearest_min_nearest(er_Texture *tex, float *coord, float lod_level, float *color){Mipmap *mip = tex->mipmaps[0];
-    sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
 }
 
-static void texture1D_lod_mag_linear_min_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
+static void decode_value_block(const uint8_t *block, int component, float texels[16][4]){
 
-    Mipmap *mip = tex->mipmaps[0];
-    if(lod_level <= 0){
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    uint64_t indices = 0;
+    int i;
+    for(i = 7; i > 1; i--){
+        indices = (indices << 8) | block[i];
+    }
+    float palette[8];
+    value_palette(block[0], block[1], palette);
+    for(i = 0; i < 16; i++){
+        texels[i][component] = palette[(indices >> (3 * i)) & 7];
     }
 
 }
 
-static void texture1D_lod_mag_nearest_min_linear(er_Texture *tex, float *coord, float lod_level, float *color){
+static void decode_block(er_TextureFormatEnum format, const uint8_t *block, float texels[16][4]){
 
-    Mipmap *mip = tex->mipmaps[0];
-    if(lod_level <= 0){
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    switch(format){
+        case ER_BC1:
+            decode_color_block(block, ER_TRUE, texels);
+            break;
+        case ER_BC3:
+            decode_color_block(block + 8, ER_FALSE, texels);
+            decode_value_block(block, 3, texels);
+            break;
+        case ER_BC4:
+            decode_value_block(block, 0, texels);
+            break;
+        default:
+            decode_value_block(block, 0, texels);
+            decode_value_block(block + 8, 1, texels);
+            break;
     }
 
 }
 
-static void texture1D_lod_mag_linear_min_linear_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_linear(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_linear(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+/*
+ * Indices of the nearest colors of the palette, transparent texels take the fourth one. Returns the squared error.
+*/
+static float color_indices(float texels[16][4], er_Bool *transparent, float palette[4][4], int colors, uint32_t *indices){
+
+    float error = 0.0f;
+    int i, j;
+    *indices = 0;
+    for(i = 0; i < 16; i++){
+        int best = 3;
+        if(!transparent[i]){
+            float best_distance = 0.0f;
+            for(j = 0; j < colors; j++){
+                float dr = texels[i][0] - palette[j][0];
+                float dg = texels[i][1] - palette[j][1];
+                float db = texels[i][2] - palette[j][2];
+                float distance = dr * dr + dg * dg + db * db;
+                if(j == 0 || distance < best_distance){
+                    best = j;
+                    best_distance = distance;
+                }
+            }
+            error += best_distance;
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+        *indices |= (uint32_t)best << (2 * i);
     }
+    return error;
 
 }
 
-static void texture1D_lod_mag_linear_min_nearest_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
+/*
+ * Color block with endpoints on the principal axis of the colors, refined once by least squares on the chosen indices.
+ * On BC1 texels with alpha under 0.5 are encoded as transparent.
+*/
+static void encode_color_block(float texels[16][4], er_Bool bc1, uint8_t *block){
+
+    er_Bool transparent[16];
+    er_Bool three_colors = ER_FALSE;
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    int i, j, c, opaque = 0;
+    for(i = 0; i < 16; i++){
+        transparent[i] = bc1 && texels[i][3] < 0.5f;
+        if(transparent[i]){
+            three_colors = ER_TRUE;
+            continue;
+        }
+        for(c = 0; c < 3; c++){
+            mean[c] += clamp(texels[i][c], 0.0f, 1.0f);
+        }
+        opaque++;
+    }
+    uint16_t best_c0 = 0, best_c1 = 0;
+    uint32_t best_indices = 0xffffffff;
+    if(opaque > 0){
+        float covariance[3][3] = {{0.0f}};
+        for(c = 0; c < 3; c++){
+            mean[c] /= opaque;
+        }
+        for(i = 0; i < 16; i++){
+            if(transparent[i]){
+                continue;
+            }
+            for(c = 0; c < 3; c++){
+                for(j = 0; j < 3; j++){
+                    covariance[c][j] += (clamp(texels[i][c], 0.0f, 1.0f) - mean[c]) * (clamp(texels[i][j], 0.0f, 1.0f) - mean[j]);
+                }
+            }
+        }
+        /* Power iteration from the column of the largest variance */
+        int largest = 0;
+        for(c = 1; c < 3; c++){
+            if(covariance[c][c] > covariance[largest][largest]){
+                largest = c;
+            }
+        }
+        float axis[3] = {covariance[0][largest], covariance[1][largest], covariance[2][largest]};
+        int iteration;
+        for(iteration = 0; iteration < 8; iteration++){
+            float next[3], length = 0.0f;
+            for(c = 0; c < 3; c++){
+                next[c] = covariance[c][0] * axis[0] + covariance[c][1] * axis[1] + covariance[c][2] * axis[2];
+                length += next[c] * next[c];
+            }
+            if(length < 1e-20f){
+                break;
+            }
+            length = 1.0f / sqrtf(length);
+            for(c = 0; c < 3; c++){
+                axis[c] = next[c] * length;
+            }
+        }
+        float length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        length = (length > 1e-20f) ? 1.0f / sqrtf(length): 0.0f;
+        float lowest = 0.0f, highest = 0.0f;
+        for(i = 0; i < 16; i++){
+            if(transparent[i]){
+                continue;
+            }
+            float projection = 0.0f;
+            for(c = 0; c < 3; c++){
+                projection += (clamp(texels[i][c], 0.0f, 1.0f) - mean[c]) * axis[c] * length;
+            }
+            lowest = min(lowest, projection);
+            highest = max(highest, projection);
+        }
+        float ends[2][3];
+        for(c = 0; c < 3; c++){
+            ends[0][c] = mean[c] + axis[c] * length * highest;
+            ends[1][c] = mean[c] + axis[c] * length * lowest;
+        }
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_nearest(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_nearest(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+        float best_error = 0.0f;
+        for(iteration = 0; iteration < 2; iteration++){
+            uint16_t c0 = pack_565(ends[0]), c1 = pack_565(ends[1]);
+            /* BC1 reads c0 > c1 as four colors */
+            if(three_colors ? c0 > c1: c0 < c1){
+                uint16_t swap = c0;
+                c0 = c1;
+                c1 = swap;
+            }
+            er_Bool four_colors = !bc1 || c0 > c1;
+            float palette[4][4];
+            uint32_t indices;
+            color_palette(c0, c1, four_colors, palette);
+            float error = color_indices(texels, transparent, palette, four_colors ? 4: 3, &indices);
+            if(iteration == 0 || error < best_error){
+                best_error = error;
+                best_c0 = c0;
+                best_c1 = c1;
+                best_indices = indices;
+            }
+            /* Endpoints that minimize the error of the indices */
+            float weight[4] = {1.0f, 0.0f, four_colors ? 2.0f / 3.0f: 0.5f, 1.0f / 3.0f};
+            float a = 0.0f, b = 0.0f, d = 0.0f, x0[3] = {0.0f, 0.0f, 0.0f}, x1[3] = {0.0f, 0.0f, 0.0f};
+            for(i = 0; i < 16; i++){
+                if(transparent[i]){
+                    continue;
+                }
+                float w = weight[(indices >> (2 * i)) & 3];
+                a += w * w;
+                b += w * (1.0f - w);
+                d += (1.0f - w) * (1.0f - w);
+                for(c = 0; c < 3; c++){
+                    x0[c] += w * texels[i][c];
+                    x1[c] += (1.0f - w) * texels[i][c];
+                }
+            }
+            float determinant = a * d - b * b;
+            if(fabsf(determinant) < 1e-6f){
+                break;
+            }
+            determinant = 1.0f / determinant;
+            for(c = 0; c < 3; c++){
+                ends[0][c] = (d * x0[c] - b * x1[c]) * determinant;
+                ends[1][c] = (a * x1[c] - b * x0[c]) * determinant;
+            }
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    }
+    block[0] = best_c0 & 0xff;
+    block[1] = best_c0 >> 8;
+    block[2] = best_c1 & 0xff;
+    block[3] = best_c1 >> 8;
+    for(i = 0; i < 4; i++){
+        block[4 + i] = (best_indices >> (8 * i)) & 0xff;
     }
 
 }
 
-static void texture1D_lod_mag_linear_min_linear_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+/*
+ * BC4 block between the smallest and largest values of a component.
+*/
+static void encode_value_block(float texels[16][4], int component, uint8_t *block){
+
+    float lowest = 1.0f, highest = 0.0f;
+    int i, j;
+    for(i = 0; i < 16; i++){
+        float value = clamp(texels[i][component], 0.0f, 1.0f);
+        lowest = min(lowest, value);
+        highest = max(highest, value);
+    }
+    block[0] = (uint8_t)uiround(255.0f * highest);
+    block[1] = (uint8_t)uiround(255.0f * lowest);
+    float palette[8];
+    value_palette(block[0], block[1], palette);
+    uint64_t indices = 0;
+    for(i = 0; i < 16; i++){
+        float value = clamp(texels[i][component], 0.0f, 1.0f);
+        int best = 0;
+        for(j = 1; j < 8; j++){
+            if(fabsf(value - palette[j]) < fabsf(value - palette[best])){
+                best = j;
+            }
+        }
+        indices |= (uint64_t)best << (3 * i);
+    }
+    for(i = 2; i < 8; i++){
+        block[i] = indices & 0xff;
+        indices >>= 8;
     }
 
 }
 
-static void texture1D_lod_mag_linear_min_nearest_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
+static void encode_block(er_TextureFormatEnum format, float texels[16][4], uint8_t *block){
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    switch(format){
+        case ER_BC1:
+            encode_color_block(texels, ER_TRUE, block);
+            break;
+        case ER_BC3:
+            encode_value_block(texels, 3, block);
+            encode_color_block(texels, ER_FALSE, block + 8);
+            break;
+        case ER_BC4:
+            encode_value_block(texels, 0, block);
+            break;
+        default:
+            encode_value_block(texels, 0, block);
+            encode_value_block(texels, 1, block + 8);
+            break;
     }
 
 }
 
-static void texture1D_lod_mag_nearest_min_linear_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_linear(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_linear(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+/*
+ * Encode a level of w x h texels given as row major floats. Blocks over the edges repeat the last texels.
+*/
+static void encode_texels(er_Texture *tex, void *blocks, int w, int h, float *data){
+
+    float texels[16][4];
+    int blocks_w = (w + 3) >> 2, blocks_h = (h + 3) >> 2;
+    int bs, bt, i, c;
+    for(bt = 0; bt < blocks_h; bt++){
+        for(bs = 0; bs < blocks_w; bs++){
+            for(i = 0; i < 16; i++){
+                int s = min((bs << 2) + (i & 3), w - 1);
+                int t = min((bt << 2) + (i >> 2), h - 1);
+                texels[i][1] = texels[i][2] = 0.0f;
+                texels[i][3] = 1.0f;
+                for(c = 0; c < tex->components; c++){
+                    texels[i][c] = data[(t * w + s) * tex->components + c];
+                }
+            }
+            encode_block(tex->texture_format, texels, (uint8_t*)blocks + (bt * blocks_w + bs) * tex->block_size);
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
     }
+    invalidate_blocks();
 
 }
 
-static void texture1D_lod_mag_nearest_min_nearest_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
+/*
+ * Decoded texels of a block, from the cache of the thread.
+*/
+static inline float* decoded_block(er_Texture *tex, void *texels, int block){
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_nearest(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_nearest(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    const uint8_t *data = (uint8_t*)texels + block * tex->block_size;
+    uint32_t key = (uint32_t)((uintptr_t)data >> 3);
+    DecodedBlock *entry = &block_cache[(key * 2654435761u) >> (32 - BLOCK_CACHE_BITS)];
+    unsigned int generation = __atomic_load_n(&block_generation, __ATOMIC_RELAXED);
+    if(entry->block != data || entry->generation != generation){
+        decode_block(tex->texture_format, data, entry->texels);
+        entry->block = data;
+        entry->generation = generation;
     }
+    return entry->texels[0];
 
 }
 
-static void texture1D_lod_mag_nearest_min_linear_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
+#ifdef __SSE2__
+/*
+ * RGBA8 or RGBA16F texel decoded on a register, 8 bit components are left on [0, 255].
+*/
+static inline __m128 load_rgba(er_TextureFormatEnum format, void *texels, int index){
+
+    if(format == ER_RGBA8){
+        int32_t packed;
+        memcpy(&packed, (uint8_t*)texels + index * 4, 4);
+        __m128i zero = _mm_setzero_si128();
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero));
+    }
+#ifdef __F16C__
+    return _mm_cvtph_ps(_mm_loadl_epi64((__m128i*)((uint16_t*)texels + index * 4)));
+#else
+    /* Same steps as half_to_float on the four components */
+    __m128i half = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)((uint16_t*)texels + index * 4)), _mm_setzero_si128());
+    __m128i magnitude = _mm_and_si128(half, _mm_set1_epi32(0x7fff));
+    __m128i special = _mm_and_si128(_mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7bff)), _mm_set1_epi32(0x7f800000));
+    __m128 result = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)), _mm_set1_ps(5.192296858534828e33f));
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+    return _mm_or_ps(result, _mm_castsi128_ps(_mm_or_si128(special, sign)));
+#endif
+
+}
+#endif
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+/*
+ * Decode the texel at index to floats, color must hold 4 floats for RGBA formats.
+*/
+static inline void load_texel(er_Texture *tex, void *texels, int index, float *color){
+
+    int c;
+    switch(tex->texture_format){
+        case ER_RGBA8:
+        {
+#ifdef __SSE2__
+            _mm_storeu_ps(color, _mm_mul_ps(load_rgba(tex->texture_format, texels, index), _mm_set1_ps(1.0f / 255.0f)));
+#else
+            uint8_t *data = (uint8_t*)texels + index * 4;
+            for(c = 0; c < 4; c++){
+                color[c] = data[c] * (1.0f / 255.0f);
+            }
+#endif
+            break;
+        }
+        case ER_RG8:
+        case ER_R8:
+        {
+            uint8_t *data = (uint8_t*)texels + index * tex->components;
+            for(c = 0; c < tex->components; c++){
+                color[c] = data[c] * (1.0f / 255.0f);
+            }
+            break;
+        }
+        case ER_RGBA16F:
+        {
+#ifdef __SSE2__
+            _mm_storeu_ps(color, load_rgba(tex->texture_format, texels, index));
+#else
+            uint16_t *data = (uint16_t*)texels + index * 4;
+            for(c = 0; c < 4; c++){
+                color[c] = half_to_float(data[c]);
+            }
+#endif
+            break;
+        }
+        case ER_RG16F:
+        case ER_R16F:
+        {
+            uint16_t *data = (uint16_t*)texels + index * tex->components;
+            for(c = 0; c < tex->components; c++){
+                color[c] = half_to_float(data[c]);
+            }
+            break;
+        }
+        case ER_BC1:
+        case ER_BC3:
+        case ER_BC4:
+        case ER_BC5:
+        {
+            /* Index of the block and of the texel inside it */
+            float *data = decoded_block(tex, texels, index >> 4) + (index & 15) * 4;
+            for(c = 0; c < tex->components; c++){
+                color[c] = data[c];
+            }
+            break;
+        }
+        default:
+        {
+            float *data = (float*)texels + index * tex->components;
+            for(c = 0; c < tex->components; c++){
+                color[c] = data[c];
+            }
+            break;
+        }
     }
 
 }
 
-static void texture1D_lod_mag_nearest_min_nearest_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
+static inline void store_texel(er_Texture *tex, void *texels, int index, float *color){
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    int c;
+    switch(tex->texture_format){
+        case ER_RGBA8:
+        case ER_RG8:
+        case ER_R8:
+        {
+            uint8_t *data = (uint8_t*)texels + index * tex->components;
+            for(c = 0; c < tex->components; c++){
+                data[c] = (uint8_t)(clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+            break;
+        }
+        case ER_RGBA16F:
+        case ER_RG16F:
+        case ER_R16F:
+        {
+            uint16_t *data = (uint16_t*)texels + index * tex->components;
+            for(c = 0; c < tex->components; c++){
+                data[c] = float_to_half(color[c]);
+            }
+            break;
+        }
+        case ER_BC1:
+        case ER_BC3:
+        case ER_BC4:
+        case ER_BC5:
+        {
+            /* The whole block is encoded again */
+            float block[16][4];
+            uint8_t *data = (uint8_t*)texels + (index >> 4) * tex->block_size;
+            decode_block(tex->texture_format, data, block);
+            for(c = 0; c < tex->components; c++){
+                block[index & 15][c] = color[c];
+            }
+            encode_block(tex->texture_format, block, data);
+            invalidate_blocks();
+            break;
+        }
+        default:
+        {
+            float *data = (float*)texels + index * tex->components;
+            for(c = 0; c < tex->components; c++){
+                data[c] = color[c];
+            }
+            break;
+        }
     }
 
 }
 
+/*
+ * Spread the low 16 bits of a coordinate on the even bits.
+*/
+static inline uint32_t spread_bits(uint32_t x){
+
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
 
-static void texture1D_grad_mag_linear_min_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
 }
 
-static void texture1D_grad_mag_nearest_min_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+/*
+ * Morton order index inside squares of the smallest dimension, which follow each other along the largest one.
+*/
+static inline int morton_index(int w, int h, int s, int t){
+
+    int size = min(w, h);
+    int square = (w > h) ? s / size: t / size;
+    return square * size * size + (int)(spread_bits(s & (size - 1)) | (spread_bits(t & (size - 1)) << 1));
+
 }
 
-static void texture1D_grad_mag_linear_min_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * Position of the texel (s, t) of a level of size w x h on its storage.
+*/
+static inline int texel_index(er_TextureLayoutEnum layout, int w, int h, int s, int t){
 
-    Mipmap *mip = tex->mipmaps[0];
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    if(layout == ER_TILED_4X4){
+        return ( ((t >> 2) * ((w + 3) >> 2) + (s >> 2)) << 4 ) + ((t & 3) << 2) + (s & 3);
+    }else if(layout == ER_MORTON_ORDER){
+        return morton_index(w, h, s, t);
     }
+    return t * w + s;
 
 }
 
-static void texture1D_grad_mag_nearest_min_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-  
-    Mipmap *mip = tex->mipmaps[0];
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+/*
+ * Indices of the 2x2 footprint of bilinear filtering, in the order (u0, v0), (u0, v1), (u1, v0), (u1, v1).
+*/
+static inline void footprint_indices(er_Texture *tex, int w, int h, int u0, int u1, int v0, int v1, int *index){
+
+    if(tex->layout == ER_MORTON_ORDER && w == h){
+        /* Each coordinate is spread once */
+        uint32_t s0 = spread_bits(u0), s1 = spread_bits(u1);
+        uint32_t t0 = spread_bits(v0) << 1, t1 = spread_bits(v1) << 1;
+        index[0] = s0 | t0;
+        index[1] = s0 | t1;
+        index[2] = s1 | t0;
+        index[3] = s1 | t1;
+    }else if(tex->layout == ER_ROW_MAJOR){
+        index[0] = v0 * w + u0;
+        index[1] = v1 * w + u0;
+        index[2] = v0 * w + u1;
+        index[3] = v1 * w + u1;
     }else{
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+        index[0] = texel_index(tex->layout, w, h, u0, v0);
+        index[1] = texel_index(tex->layout, w, h, u0, v1);
+        index[2] = texel_index(tex->layout, w, h, u1, v0);
+        index[3] = texel_index(tex->layout, w, h, u1, v1);
     }
 
 }
 
-static void texture1D_grad_mag_linear_min_linear_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * Bytes of a 2D level or cubemap face, tiles and blocks are completed over the edges.
+*/
+static inline int level_size(er_Texture *tex, er_TextureLayoutEnum layout, int w, int h){
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_linear(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_linear(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    if(tex->block_size > 0){
+        return ((w + 3) >> 2) * ((h + 3) >> 2) * tex->block_size;
+    }else if(layout == ER_TILED_4X4){
+        return ((w + 3) >> 2) * ((h + 3) >> 2) * 16 * tex->texel_size;
     }
+    return w * h * tex->texel_size;
 
 }
 
-static void texture1D_grad_mag_linear_min_nearest_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * First texel of a face of a cubemap level.
+*/
+static inline void* face_texels(er_Texture *tex, Mipmap *mip, int face){
+    return (uint8_t*)mip->texels + face * level_size(tex, tex->layout, mip->width, mip->height);
+}
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_nearest(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_nearest(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }
+void er_texture_size(er_Texture *tex, int lod, int *dimension){
+    tex->texture_size(tex, lod, dimension);
+}
 
+void er_texel_fetch(er_Texture *tex, int *coord, int lod, float *color){
+    tex->texel_fetch(tex, coord, lod, color);
 }
 
-static void texture1D_grad_mag_linear_min_linear_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+void er_texture_lod(er_Texture *tex, float *coord, float lod, float *color){
+    tex->texture_lod(tex, coord, lod, color);
+}
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }
+void er_texture_grad(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+    tex->texture_grad(tex, coord, ddx, ddy, color);
+}
 
+void er_write_texture(er_Texture *tex, int *coord, int lod, float *color){
+    tex->write_texture(tex, coord, lod, color);
 }
 
-static void texture1D_grad_mag_linear_min_nearest_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+void er_texture_lod_span(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]){
+    tex->texture_lod_span(tex, min(lanes, ER_SPAN_SIZE), coord, lod, color);
+}
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }
+void er_texture_grad_span(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float ddx[][ER_SPAN_SIZE], float ddy[][ER_SPAN_SIZE], float color[][ER_SPAN_SIZE]){
+    tex->texture_grad_span(tex, min(lanes, ER_SPAN_SIZE), coord, ddx, ddy, color);
+}
 
+static void texture1D_size(er_Texture *tex, int lod, int *dimension){
+    dimension[0] = tex->mipmaps[lod]->width;
 }
 
-static void texture1D_grad_mag_nearest_min_linear_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+static void write_texture1D(er_Texture *tex, int *coord, int lod, float *color){
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_linear(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_linear(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }
+    store_texel(tex, tex->mipmaps[lod]->texels, coord[VAR_S], color);
 
 }
 
-static void texture1D_grad_mag_nearest_min_nearest_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+static void texture1D_texel_fetch(er_Texture *tex, int *coord, int lod, float *color){
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex1D_nearest(lower_mip->texels, lower_mip->width, tex->components, coord[VAR_S], tex->wrap_s, lower_color);
-        sample_tex1D_nearest(upper_mip->texels, upper_mip->width, tex->components, coord[VAR_S], tex->wrap_s, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }
+    load_texel(tex, tex->mipmaps[lod]->texels, coord[VAR_S], color);
 
 }
 
-static void texture1D_grad_mag_nearest_min_linear_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+SAMPLER_INLINE void sample_tex1D_nearest(er_Texture *tex, void *texels, int width, float u, er_TextureWrapModeEnum wrap_u, int components, float *color){
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    float mu;
+    int ru, c;
+
+    //Map to texel coordinates
+    mu = -0.5f + u * width;
+    ru = iround(mu);
+    ru = wrap_texel(ru, width, wrap_u);
+
+    if(packed_format(tex)){
+        load_texel(tex, texels, ru, color);
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_linear(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+        float *data = (float*)texels;
+        for(c = 0; c < components; c++){
+            color[c] = data[ru*components + c];
+        }
     }
 
 }
 
-static void texture1D_grad_mag_nearest_min_nearest_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+SAMPLER_INLINE void sample_tex1D_linear(er_Texture *tex, void *texels, int width, float u, er_TextureWrapModeEnum wrap_u, int components, float *color){
 
-    float lod_level = calculate_texture1D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+    float mu;
+    int u0, u1;
+    float alpha;
+
+    //Map to texel coordinates
+    mu = -0.5f + u * width;
+    u0 = floor_texel(mu);
+    alpha = mu - u0;
+    u0 = wrap_texel(u0, width, wrap_u);
+    u1 = wrap_texel(u0+1, width, wrap_u);
+
+    int c;
+    if(packed_format(tex)){
+        vec4 texel0, texel1;
+        load_texel(tex, texels, u0, texel0);
+        load_texel(tex, texels, u1, texel1);
+        for(c = 0; c < components; c++){
+            color[c] = lerp( texel0[c], texel1[c], alpha);
+        }
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex1D_nearest(mip->texels, mip->width, tex->components, coord[VAR_S], tex->wrap_s, color);
+        float *data = (float*)texels;
+        for(c = 0; c < components; c++){
+            color[c] = lerp( data[u0*components + c], data[u1*components + c], alpha);
+        }
     }
 
 }
 
+static float calculate_texture1D_lod_level(er_Texture *tex, float *ddx, float *ddy){
+    float lod_level;
+    int max_dimension = tex->mipmaps[0]->width;
+    float max_derivative = max( ddx[VAR_S], ddy[VAR_S]);
+    lod_level = fast_log2( max_derivative * max_dimension );
+    if(isnan(lod_level)){
+        lod_level = tex->lod_max_level;
+    }
+    return lod_level;
+}
+
 static void texture2D_size(er_Texture *tex, int lod, int* dimension){
     dimension[0] = tex->mipmaps[lod]->width;
     dimension[1] = tex->mipmaps[lod]->height;
@@ -541,50 +871,47 @@ static void texture2D_size(er_Texture *tex, int lod, int* dimension){
 
 static void write_texture2D(er_Texture *tex, int *coord, int lod, float *color){
 
-    float *texels = tex->mipmaps[lod]->texels;
     int width = tex->mipmaps[lod]->width;
-    int components = tex->components;
-    int c;
-    for(c = 0; c < components; c++){
-        texels[coord[VAR_T]*width*components + coord[VAR_S]*components + c] = color[c];
-    }
+    int height = tex->mipmaps[lod]->height;
+    store_texel(tex, tex->mipmaps[lod]->texels, texel_index(tex->layout, width, height, coord[VAR_S], coord[VAR_T]), color);
 
 }
 
 static void texture2D_texel_fetch(er_Texture *tex, int *coord, int lod, float *color){
 
-    float *texels = tex->mipmaps[lod]->texels;
     int width = tex->mipmaps[lod]->width;
-    int components = tex->components;
-    int c;
-    for(c = 0; c < components; c++){
-        color[c] = texels[coord[VAR_T]*width*components + coord[VAR_S]*components + c];
-    }
+    int height = tex->mipmaps[lod]->height;
+    load_texel(tex, tex->mipmaps[lod]->texels, texel_index(tex->layout, width, height, coord[VAR_S], coord[VAR_T]), color);
 
 }
 
-static void sample_tex2D_nearest(float *texels, int w, int h, int components, float u, float v, int (*wrap_u)(int, int), int (*wrap_v)(int, int), float *color){
+SAMPLER_INLINE void sample_tex2D_nearest(er_Texture *tex, void *texels, int w, int h, float u, float v, er_TextureWrapModeEnum wrap_u, er_TextureWrapModeEnum wrap_v, int components, float *color){
 
     float mu, mv;
     int ru, rv;
 
     //Map to texel coordinates
-    mu = -0.5 + u * w;
+    mu = -0.5f + u * w;
     ru = iround(mu);
-    ru = wrap_u(ru, w);
+    ru = wrap_texel(ru, w, wrap_u);
 
-    mv = -0.5 + v * h;
+    mv = -0.5f + v * h;
     rv = iround(mv);
-    rv = wrap_v(rv, h);
+    rv = wrap_texel(rv, h, wrap_v);
 
-    int c;
-    for(c = 0; c < components; c++){
-        color[c] = texels[rv*w*components + ru*components + c];
+    int c, index = texel_index(tex->layout, w, h, ru, rv);
+    if(packed_format(tex)){
+        load_texel(tex, texels, index, color);
+    }else{
+        float *data = (float*)texels;
+        for(c = 0; c < components; c++){
+            color[c] = data[index*components + c];
+        }
     }
 
 }
 
-static void sample_tex2D_bilinear(float *texels, int w, int h, int components, float u, float v, int (*wrap_u)(int, int), int (*wrap_v)(int, int), float *color){
+SAMPLER_INLINE void sample_tex2D_bilinear(er_Texture *tex, void *texels, int w, int h, float u, float v, er_TextureWrapModeEnum wrap_u, er_TextureWrapModeEnum wrap_v, int components, float *color){
 
     float mu, mv;
     float value1, value2;
@@ -592,447 +919,398 @@ static void sample_tex2D_bilinear(float *texels, int w, int h, int components, f
     float alpha, betha;
 
     //Map to texel coordinates
-    mu = -0.5 + u * w;
-    u0 = (int)floor(mu);
+    mu = -0.5f + u * w;
+    u0 = floor_texel(mu);
     alpha = mu - u0;
-    u0 = wrap_u(u0, w);
-    u1 = wrap_u(u0+1, w);
+    u0 = wrap_texel(u0, w, wrap_u);
+    u1 = wrap_texel(u0+1, w, wrap_u);
 
-    mv = -0.5 + v * h;
-    v0 = (int)floor(mv);
+    mv = -0.5f + v * h;
+    v0 = floor_texel(mv);
     betha = mv - v0;
-    v0 = wrap_v(v0, h);
-    v1 = wrap_v(v0+1, h);
+    v0 = wrap_texel(v0, h, wrap_v);
+    v1 = wrap_texel(v0+1, h, wrap_v);
 
-    int c;
-    for(c = 0; c < components; c++){
-        value1 = lerp( texels[v0*w*components + u0*components + c], texels[v1*w*components + u0*components + c], betha);
-        value2 = lerp( texels[v0*w*components + u1*components + c], texels[v1*w*components + u1*components + c], betha);
-        color[c] = lerp(value1, value2, alpha);
-    }
+    int index[4];
+    footprint_indices(tex, w, h, u0, u1, v0, v1, index);
 
-}
+    int c;
+#ifdef __SSE2__
+    if(components == 4 && (tex->texture_format == ER_RGBA8 || tex->texture_format == ER_RGBA16F)){
+        /* Filtering of the 4 components at once, 8 bit texels are normalized after it */
+        __m128 texel00 = load_rgba(tex->texture_format, texels, index[0]);
+        __m128 texel01 = load_rgba(tex->texture_format, texels, index[1]);
+        __m128 texel10 = load_rgba(tex->texture_format, texels, index[2]);
+        __m128 texel11 = load_rgba(tex->texture_format, texels, index[3]);
+        __m128 weight_v = _mm_set1_ps(betha);
+        __m128 column0 = _mm_add_ps(texel00, _mm_mul_ps(weight_v, _mm_sub_ps(texel01, texel00)));
+        __m128 column1 = _mm_add_ps(texel10, _mm_mul_ps(weight_v, _mm_sub_ps(texel11, texel10)));
+        __m128 result = _mm_add_ps(column0, _mm_mul_ps(_mm_set1_ps(alpha), _mm_sub_ps(column1, column0)));
+        if(tex->texture_format == ER_RGBA8){
+            result = _mm_mul_ps(result, _mm_set1_ps(1.0f / 255.0f));
+        }
+        _mm_storeu_ps(color, result);
+        return;
+    }
+    if(components == 4 && (tex->block_size > 0 || !packed_format(tex))){
+        /* Float texels, and decoded texels read in place from the cache of blocks */
+        __m128 texel00, texel01, texel10, texel11;
+        if(tex->block_size > 0){
+            texel00 = _mm_loadu_ps(decoded_block(tex, texels, index[0] >> 4) + (index[0] & 15) * 4);
+            texel01 = _mm_loadu_ps(decoded_block(tex, texels, index[1] >> 4) + (index[1] & 15) * 4);
+            texel10 = _mm_loadu_ps(decoded_block(tex, texels, index[2] >> 4) + (index[2] & 15) * 4);
+            texel11 = _mm_loadu_ps(decoded_block(tex, texels, index[3] >> 4) + (index[3] & 15) * 4);
+        }else{
+            texel00 = _mm_loadu_ps((float*)texels + index[0] * 4);
+            texel01 = _mm_loadu_ps((float*)texels + index[1] * 4);
+            texel10 = _mm_loadu_ps((float*)texels + index[2] * 4);
+            texel11 = _mm_loadu_ps((float*)texels + index[3] * 4);
+        }
+        __m128 weight_v = _mm_set1_ps(betha);
+        __m128 column0 = _mm_add_ps(texel00, _mm_mul_ps(weight_v, _mm_sub_ps(texel01, texel00)));
+        __m128 column1 = _mm_add_ps(texel10, _mm_mul_ps(weight_v, _mm_sub_ps(texel11, texel10)));
+        _mm_storeu_ps(color, _mm_add_ps(column0, _mm_mul_ps(_mm_set1_ps(alpha), _mm_sub_ps(column1, column0))));
+        return;
+    }
+#endif
+    if(packed_format(tex)){
+        vec4 texel00, texel01, texel10, texel11;
+        load_texel(tex, texels, index[0], texel00);
+        load_texel(tex, texels, index[1], texel01);
+        load_texel(tex, texels, index[2], texel10);
+        load_texel(tex, texels, index[3], texel11);
+        for(c = 0; c < components; c++){
+            value1 = lerp( texel00[c], texel01[c], betha);
+            value2 = lerp( texel10[c], texel11[c], betha);
+            color[c] = lerp(value1, value2, alpha);
+        }
+    }else{
+        float *data = (float*)texels;
+        for(c = 0; c < components; c++){
+            value1 = lerp( data[index[0]*components + c], data[index[1]*components + c], betha);
+            value2 = lerp( data[index[2]*components + c], data[index[3]*components + c], betha);
+            color[c] = lerp(value1, value2, alpha);
+        }
+    }
+
+}
 
 static float calculate_texture2D_lod_level(er_Texture *tex, float *ddx, float *ddy){
     float lod_level;
     int max_dimension = max(tex->mipmaps[0]->width, tex->mipmaps[0]->height);
     float diameter = max( ddx[VAR_S] * ddx[VAR_S] + ddx[VAR_T] * ddx[VAR_T], ddy[VAR_S] * ddy[VAR_S] + ddy[VAR_T] * ddy[VAR_T] );
-    lod_level = log( diameter * max_dimension * max_dimension ) / LOG2_DOT_2;
+    lod_level = 0.5f * fast_log2( diameter * max_dimension * max_dimension );
     if(isnan(lod_level)){
         lod_level = tex->lod_max_level;
     }
     return lod_level;
 }
 
-static void texture2D_lod_mag_linear_min_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-}
-
-static void texture2D_lod_mag_nearest_min_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-}
-
-static void texture2D_lod_mag_linear_min_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Mipmap *mip = tex->mipmaps[0];
-    if(lod_level <= 0){
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
-
-}
-
-static void texture2D_lod_mag_nearest_min_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Mipmap *mip = tex->mipmaps[0];
-    if(lod_level <= 0){
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+/*
+ * Anisotropic filtering. The longest derivative, of squared length major on a texture of size texels, is
+ * covered by up to max_anisotropy probes, each filtered by texture_lod at the level of its share of the footprint.
+*/
+static void sample_anisotropic(er_Texture *tex, float *coord, int coords, float *axis, float major, float minor, int size, float *color){
+
+    int probes = 1;
+    if(major > minor * tex->max_anisotropy * tex->max_anisotropy){
+        probes = (int)tex->max_anisotropy;
+    }else if(major > minor){
+        probes = min((int)ceilf(sqrtf(major / minor)), (int)tex->max_anisotropy);
+    }
+    float lod_level = 0.5f * fast_log2( major * size * size / (probes * probes) );
+    if(isnan(lod_level)){
+        lod_level = tex->lod_max_level;
     }
-
-}
-
-static void texture2D_lod_mag_linear_min_linear_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_bilinear(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_bilinear(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+    if(probes == 1){
+        /* Isotropic footprint, same level as the filters without anisotropy */
+        tex->texture_lod(tex, coord, lod_level, color);
+        return;
+    }
+    vec4 probe_color, sum = {0.0f, 0.0f, 0.0f, 0.0f};
+    float probe_coord[3];
+    int i, c;
+    for(i = 0; i < probes; i++){
+        float offset = (i + 0.5f) / probes - 0.5f;
+        for(c = 0; c < coords; c++){
+            probe_coord[c] = coord[c] + axis[c] * offset;
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
-
-}
-
-static void texture2D_lod_mag_linear_min_nearest_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_nearest(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_nearest(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
+        tex->texture_lod(tex, probe_coord, lod_level, probe_color);
         for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+            sum[c] += probe_color[c];
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
     }
-
-}
-
-static void texture2D_lod_mag_linear_min_linear_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+    float weight = 1.0f / probes;
+    for(c = 0; c < tex->components; c++){
+        color[c] = sum[c] * weight;
     }
 
 }
 
-static void texture2D_lod_mag_linear_min_nearest_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
+static void texture2D_grad_anisotropic(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+    int max_dimension = max(tex->mipmaps[0]->width, tex->mipmaps[0]->height);
+    float length_x = ddx[VAR_S] * ddx[VAR_S] + ddx[VAR_T] * ddx[VAR_T];
+    float length_y = ddy[VAR_S] * ddy[VAR_S] + ddy[VAR_T] * ddy[VAR_T];
+    if(length_x > length_y){
+        sample_anisotropic(tex, coord, 2, ddx, length_x, length_y, max_dimension, color);
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+        sample_anisotropic(tex, coord, 2, ddy, length_y, length_x, max_dimension, color);
     }
 
 }
 
-static void texture2D_lod_mag_nearest_min_linear_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_bilinear(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_bilinear(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
-
+/*
+ * Samplers of up to ER_SPAN_SIZE lanes with every component on its own array. The generic ones
+ * call the sampler of the texture for each lane.
+*/
+static int texture_coordinates(er_Texture *tex){
+    return (tex->texture_target == ER_TEXTURE_1D) ? 1: (tex->texture_target == ER_TEXTURE_2D) ? 2: 3;
 }
 
-static void texture2D_lod_mag_nearest_min_nearest_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
+/*
+ * Lanes first to last - 1, without levels of detail they are sampled at level 0.
+*/
+static void texture_lod_lanes(er_Texture *tex, unsigned int first, unsigned int last, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]){
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_nearest(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_nearest(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
+    int coords = texture_coordinates(tex);
+    unsigned int i;
+    int c;
+    for(i = first; i < last; i++){
+        vec4 lane_coord, lane_color;
+        for(c = 0; c < coords; c++){
+            lane_coord[c] = coord[c][i];
+        }
+        tex->texture_lod(tex, lane_coord, (lod != NULL) ? lod[i]: 0.0f, lane_color);
         for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+            color[c][i] = lane_color[c];
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
     }
 
 }
 
-static void texture2D_lod_mag_nearest_min_linear_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
-
+static void texture_lod_span_lanes(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]){
+    texture_lod_lanes(tex, 0, lanes, coord, lod, color);
 }
 
-static void texture2D_lod_mag_nearest_min_nearest_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
+static void texture_grad_span_lanes(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float ddx[][ER_SPAN_SIZE], float ddy[][ER_SPAN_SIZE], float color[][ER_SPAN_SIZE]){
 
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+    int coords = texture_coordinates(tex);
+    unsigned int i;
+    int c;
+    for(i = 0; i < lanes; i++){
+        vec4 lane_coord, lane_ddx, lane_ddy, lane_color;
+        for(c = 0; c < coords; c++){
+            lane_coord[c] = coord[c][i];
+            lane_ddx[c] = ddx[c][i];
+            lane_ddy[c] = ddy[c][i];
+        }
+        tex->texture_grad(tex, lane_coord, lane_ddx, lane_ddy, lane_color);
+        for(c = 0; c < tex->components; c++){
+            color[c][i] = lane_color[c];
+        }
     }
 
 }
 
-static void texture2D_grad_mag_linear_min_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-}
-
-static void texture2D_grad_mag_nearest_min_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-    Mipmap *mip = tex->mipmaps[0];
-    sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-}
-
-static void texture2D_grad_mag_linear_min_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+#ifdef __SSE2__
+/*
+ * Wrap of 4 texel coordinates on a level of the given size.
+*/
+static inline __m128i wrap_lanes(er_TextureWrapModeEnum wrap, __m128i coord, int size){
 
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    Mipmap *mip = tex->mipmaps[0];
-    if(lod_level <= 0){
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+    __m128i last = _mm_set1_epi32(size - 1);
+    if(wrap == ER_REPEAT){
+        return _mm_and_si128(coord, last);
     }
+    __m128i over = _mm_cmpgt_epi32(coord, last);
+    coord = _mm_or_si128(_mm_and_si128(over, last), _mm_andnot_si128(over, coord));
+    return _mm_andnot_si128(_mm_cmpgt_epi32(_mm_setzero_si128(), coord), coord);
 
 }
 
-static void texture2D_grad_mag_nearest_min_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * Texel coordinates of the left or lower texels of the footprints of 4 lanes, and their weights.
+*/
+static inline __m128i texel_lanes(__m128 coord, int size, __m128 *weight){
 
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    Mipmap *mip = tex->mipmaps[0];
-    if(lod_level <= 0){
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
+    __m128 mapped = _mm_add_ps(_mm_set1_ps(-0.5f), _mm_mul_ps(coord, _mm_set1_ps((float)size)));
+    __m128i texel = _mm_cvttps_epi32(mapped);
+    /* Truncation rounds up negative values */
+    texel = _mm_add_epi32(texel, _mm_castps_si128(_mm_cmplt_ps(mapped, _mm_cvtepi32_ps(texel))));
+    *weight = _mm_sub_ps(mapped, _mm_cvtepi32_ps(texel));
+    return texel;
 
 }
 
-static void texture2D_grad_mag_linear_min_linear_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_bilinear(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_bilinear(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+/*
+ * Bilinear filtering of lanes first to first+3 on the same level. Addresses, wrap and weights are computed
+ * on registers, the texels of the footprints are gathered and filtered on registers again.
+*/
+static void sample_tex2D_bilinear_lanes(er_Texture *tex, Mipmap *mip, float coord[][ER_SPAN_SIZE], int first, __m128 *color){
+
+    int w = mip->width, h = mip->height;
+    __m128 alpha, betha;
+    __m128i u0 = texel_lanes(_mm_loadu_ps(&coord[VAR_S][first]), w, &alpha);
+    __m128i v0 = texel_lanes(_mm_loadu_ps(&coord[VAR_T][first]), h, &betha);
+    u0 = wrap_lanes(tex->wrap_s, u0, w);
+    __m128i u1 = wrap_lanes(tex->wrap_s, _mm_add_epi32(u0, _mm_set1_epi32(1)), w);
+    v0 = wrap_lanes(tex->wrap_t, v0, h);
+    __m128i v1 = wrap_lanes(tex->wrap_t, _mm_add_epi32(v0, _mm_set1_epi32(1)), h);
+
+    /* Same order of the footprint as footprint_indices */
+    int index[4][4] ER_ALIGNED;
+    if(tex->layout == ER_ROW_MAJOR){
+        __m128i shift = _mm_cvtsi32_si128(__builtin_ctz(w));
+        __m128i row0 = _mm_sll_epi32(v0, shift), row1 = _mm_sll_epi32(v1, shift);
+        _mm_store_si128((__m128i*)index[0], _mm_add_epi32(row0, u0));
+        _mm_store_si128((__m128i*)index[1], _mm_add_epi32(row1, u0));
+        _mm_store_si128((__m128i*)index[2], _mm_add_epi32(row0, u1));
+        _mm_store_si128((__m128i*)index[3], _mm_add_epi32(row1, u1));
+    }else{
+        int s0[4] ER_ALIGNED, s1[4] ER_ALIGNED, t0[4] ER_ALIGNED, t1[4] ER_ALIGNED;
+        _mm_store_si128((__m128i*)s0, u0);
+        _mm_store_si128((__m128i*)s1, u1);
+        _mm_store_si128((__m128i*)t0, v0);
+        _mm_store_si128((__m128i*)t1, v1);
+        int i, lane_index[4];
+        for(i = 0; i < 4; i++){
+            footprint_indices(tex, w, h, s0[i], s1[i], t0[i], t1[i], lane_index);
+            index[0][i] = lane_index[0];
+            index[1][i] = lane_index[1];
+            index[2][i] = lane_index[2];
+            index[3][i] = lane_index[3];
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
     }
 
-}
-
-static void texture2D_grad_mag_linear_min_nearest_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_nearest(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_nearest(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+    /* Gather of the texels with their components on separate registers */
+    float texel[4][4][4] ER_ALIGNED;
+    int k, i, c, components = tex->components;
+    if(components == 4){
+        /* RGBA texels of the 4 lanes transposed, 8 bit texels are normalized after filtering */
+        for(k = 0; k < 4; k++){
+            __m128 lane[4];
+            for(i = 0; i < 4; i++){
+                if(tex->texture_format == ER_RGBA8 || tex->texture_format == ER_RGBA16F){
+                    lane[i] = load_rgba(tex->texture_format, mip->texels, index[k][i]);
+                }else if(tex->block_size > 0){
+                    lane[i] = _mm_loadu_ps(decoded_block(tex, mip->texels, index[k][i] >> 4) + (index[k][i] & 15) * 4);
+                }else{
+                    lane[i] = _mm_loadu_ps((float*)mip->texels + index[k][i] * 4);
+                }
+            }
+            _MM_TRANSPOSE4_PS(lane[0], lane[1], lane[2], lane[3]);
+            for(c = 0; c < 4; c++){
+                _mm_store_ps(texel[k][c], lane[c]);
+            }
+        }
+    }else if(packed_format(tex)){
+        for(i = 0; i < 4; i++){
+            for(k = 0; k < 4; k++){
+                vec4 value;
+                load_texel(tex, mip->texels, index[k][i], value);
+                for(c = 0; c < components; c++){
+                    texel[k][c][i] = value[c];
+                }
+            }
         }
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
-
-}
-
-static void texture2D_grad_mag_linear_min_linear_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
-
-}
-
-static void texture2D_grad_mag_linear_min_nearest_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+        float *data = (float*)mip->texels;
+        for(k = 0; k < 4; k++){
+            for(i = 0; i < 4; i++){
+                float *value = data + index[k][i] * components;
+                for(c = 0; c < components; c++){
+                    texel[k][c][i] = value[c];
+                }
+            }
+        }
     }
-
-}
-
-static void texture2D_grad_mag_nearest_min_linear_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_bilinear(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_bilinear(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+    for(c = 0; c < components; c++){
+        __m128 texel00 = _mm_load_ps(texel[0][c]), texel01 = _mm_load_ps(texel[1][c]);
+        __m128 texel10 = _mm_load_ps(texel[2][c]), texel11 = _mm_load_ps(texel[3][c]);
+        __m128 column0 = _mm_add_ps(texel00, _mm_mul_ps(betha, _mm_sub_ps(texel01, texel00)));
+        __m128 column1 = _mm_add_ps(texel10, _mm_mul_ps(betha, _mm_sub_ps(texel11, texel10)));
+        color[c] = _mm_add_ps(column0, _mm_mul_ps(alpha, _mm_sub_ps(column1, column0)));
+        if(tex->texture_format == ER_RGBA8){
+            color[c] = _mm_mul_ps(color[c], _mm_set1_ps(1.0f / 255.0f));
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
     }
 
 }
 
-static void texture2D_grad_mag_nearest_min_nearest_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * Bilinear or trilinear filtering of 2D lanes. Groups of 4 lanes on the same levels are filtered together,
+ * the others and the last lanes are sampled one by one.
+*/
+static void texture2D_lanes_linear(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]){
 
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        sample_tex2D_nearest(lower_mip->texels, lower_mip->width, lower_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, lower_color);
-        sample_tex2D_nearest(upper_mip->texels, upper_mip->width, upper_mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, upper_color);
-        int c;
+    unsigned int first, i;
+    int c;
+    for(first = 0; first + 4 <= lanes; first += 4){
+        __m128 result[4];
+        if(lod == NULL){
+            sample_tex2D_bilinear_lanes(tex, tex->mipmaps[0], coord, first, result);
+        }else{
+            float lowest = lod[first], highest = lod[first];
+            for(i = first + 1; i < first + 4; i++){
+                lowest = min(lowest, lod[i]);
+                highest = max(highest, lod[i]);
+            }
+            if(highest <= 0){
+                sample_tex2D_bilinear_lanes(tex, tex->mipmaps[0], coord, first, result);
+            }else if(lowest >= tex->lod_max_level){
+                sample_tex2D_bilinear_lanes(tex, tex->mipmaps[tex->lod_max_level], coord, first, result);
+            }else if(lowest > 0 && highest < tex->lod_max_level && (int)lowest == (int)highest){
+                int lower_level = (int)lowest;
+                __m128 upper[4];
+                __m128 lod_blend_factor = _mm_sub_ps(_mm_loadu_ps(&lod[first]), _mm_set1_ps((float)lower_level));
+                sample_tex2D_bilinear_lanes(tex, tex->mipmaps[lower_level], coord, first, result);
+                sample_tex2D_bilinear_lanes(tex, tex->mipmaps[lower_level + 1], coord, first, upper);
+                for(c = 0; c < tex->components; c++){
+                    result[c] = _mm_add_ps(result[c], _mm_mul_ps(lod_blend_factor, _mm_sub_ps(upper[c], result[c])));
+                }
+            }else{
+                texture_lod_lanes(tex, first, first + 4, coord, lod, color);
+                continue;
+            }
+        }
         for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+            _mm_storeu_ps(&color[c][first], result[c]);
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
     }
+    texture_lod_lanes(tex, first, lanes, coord, lod, color);
 
 }
 
-static void texture2D_grad_mag_nearest_min_linear_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/* Non mipmapped filters ignore the level of detail and the derivatives */
+static void texture2D_lod_span_linear(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]){
+    (void)lod;
+    texture2D_lanes_linear(tex, lanes, coord, NULL, color);
+}
 
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_bilinear(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }
+static void texture2D_lod_span_linear_mip_linear(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float *lod, float color[][ER_SPAN_SIZE]){
+    texture2D_lanes_linear(tex, lanes, coord, lod, color);
+}
 
+static void texture2D_grad_span_linear(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float ddx[][ER_SPAN_SIZE], float ddy[][ER_SPAN_SIZE], float color[][ER_SPAN_SIZE]){
+    (void)ddx;
+    (void)ddy;
+    texture2D_lanes_linear(tex, lanes, coord, NULL, color);
 }
 
-static void texture2D_grad_mag_nearest_min_nearest_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+static void texture2D_grad_span_linear_mip_linear(er_Texture *tex, unsigned int lanes, float coord[][ER_SPAN_SIZE], float ddx[][ER_SPAN_SIZE], float ddy[][ER_SPAN_SIZE], float color[][ER_SPAN_SIZE]){
 
-    float lod_level = calculate_texture2D_lod_level(tex, ddx, ddy);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        sample_tex2D_nearest(mip->texels, mip->width, mip->height, tex->components, coord[VAR_S], coord[VAR_T], tex->wrap_s, tex->wrap_t, color);
+    float lod[ER_SPAN_SIZE];
+    unsigned int i;
+    for(i = 0; i < lanes; i++){
+        float lane_ddx[2] = {ddx[VAR_S][i], ddx[VAR_T][i]};
+        float lane_ddy[2] = {ddy[VAR_S][i], ddy[VAR_T][i]};
+        lod[i] = calculate_texture2D_lod_level(tex, lane_ddx, lane_ddy);
     }
+    texture2D_lanes_linear(tex, lanes, coord, lod, color);
 
 }
+#endif
 
 static void texture_cubemap_size(er_Texture *tex, int lod, int *dimension){
 
@@ -1043,33 +1321,15 @@ static void texture_cubemap_size(er_Texture *tex, int lod, int *dimension){
 
 static void texture_cubemap_texel_fetch(er_Texture *tex, int *coord, int lod, float *color){
 
-    float *texels;
-    int cubemap_face = coord[2];
-    int width = tex->mipmaps[lod]->width;
-    int height = tex->mipmaps[lod]->height;
-    int components = tex->components;
-    texels = tex->mipmaps[lod]->texels + cubemap_face * width * height * components;
-
-    int c;
-    for(c = 0; c < components; c++){
-        color[c] = texels[coord[VAR_T]*width*components + coord[VAR_S]*components + c];
-    }
+    Mipmap *mip = tex->mipmaps[lod];
+    load_texel(tex, face_texels(tex, mip, coord[2]), texel_index(tex->layout, mip->width, mip->height, coord[VAR_S], coord[VAR_T]), color);
 
 }
 
 static void write_texture_cubemap(er_Texture *tex, int *coord, int lod, float *color){
 
-    float *texels;
-    int cubemap_face = coord[2];
-    int width = tex->mipmaps[lod]->width;
-    int height = tex->mipmaps[lod]->height;
-    int components = tex->components;
-    texels = tex->mipmaps[lod]->texels + cubemap_face * width * height * components;
-
-    int c;
-    for(c = 0; c < components; c++){
-        texels[coord[VAR_T]*width*components + coord[VAR_S]*components + c] = color[c];
-    }
+    Mipmap *mip = tex->mipmaps[lod];
+    store_texel(tex, face_texels(tex, mip, coord[2]), texel_index(tex->layout, mip->width, mip->height, coord[VAR_S], coord[VAR_T]), color);
 
 }
 
@@ -1100,611 +1360,381 @@ static void calculate_cubemap_uv(er_Texture *tex, float* input_vector, Cubemap_u
         yv_sign = 1.0f;
     }else{
         abs_y = - input_vector[VAR_T];
-        y_index = NEGATIVE_Y;
-        yu_sign = 1.0f;
-        yv_sign = -1.0f;
-    }
-
-    if( input_vector[VAR_P] >= 0.0f ){
-        abs_z = input_vector[VAR_P];
-        z_index = POSITIVE_Z;
-        zu_sign = -1.0f;
-        zv_sign = 1.0f;
-    }else{
-        abs_z = - input_vector[VAR_P];
-        z_index = NEGATIVE_Z;
-        zu_sign = 1.0f;
-        zv_sign = 1.0f;
-    }
-
-    float max_axis = abs_x;
-    output->cubemap_face = x_index;
-    output->u_sign = xu_sign;
-    output->v_sign = xv_sign;
-    output->u_index = VAR_P;
-    output->v_index = VAR_T;
-    output->max_axis_index = VAR_S;
-    output->wrap_u = tex->wrap_r;
-    output->wrap_v = tex->wrap_t;
-
-    if( abs_y > max_axis ){
-        max_axis = abs_y;
-        output->cubemap_face = y_index;
-        output->u_sign = yu_sign;
-        output->v_sign = yv_sign;
-        output->u_index = VAR_S;
-        output->v_index = VAR_P;
-        output->max_axis_index = VAR_T;
-        output->wrap_u = tex->wrap_s;
-        output->wrap_v = tex->wrap_r;
-    }
-    if( abs_z > max_axis ){
-        max_axis = abs_z;
-        output->cubemap_face = z_index;
-        output->u_sign = zu_sign;
-        output->v_sign = zv_sign;
-        output->u_index = VAR_S;
-        output->v_index = VAR_T;
-        output->max_axis_index = VAR_P;
-        output->wrap_u = tex->wrap_s;
-        output->wrap_v = tex->wrap_t;
-    }
-
-    output->u = 0.5f * output->u_sign * input_vector[output->u_index] / max_axis + 0.5f;
-    output->v = 0.5f * output->v_sign * input_vector[output->v_index] / max_axis + 0.5f;
-}
-
-static float calculate_cubemap_lod_level(er_Texture *tex, float* input_vector, float *ddx, float *ddy, Cubemap_uv* output_uv){
-
-    float du_dx, dv_dx, du_dy, dv_dy;
-    int ui = output_uv->u_index;
-    int vi = output_uv->v_index;
-    int mai = output_uv->max_axis_index;
-    float one_over_denom = 1.0f / (2.0f * input_vector[mai] * input_vector[mai]);
-    du_dx = output_uv->u_sign * (ddx[ui] * input_vector[mai] - input_vector[ui] * ddx[mai]) * one_over_denom;
-    du_dy = output_uv->u_sign * (ddy[ui] * input_vector[mai] - input_vector[ui] * ddy[mai]) * one_over_denom;
-    dv_dx = output_uv->v_sign * (ddx[vi] * input_vector[mai] - input_vector[vi] * ddx[mai]) * one_over_denom;
-    dv_dy = output_uv->v_sign * (ddy[vi] * input_vector[mai] - input_vector[vi] * ddy[mai]) * one_over_denom;
-    float lod_level, diameter;
-    diameter = max(du_dx * du_dx + dv_dx * dv_dx, du_dy * du_dy + dv_dy * dv_dy);
-    lod_level = log( diameter * tex->mipmaps[0]->width * tex->mipmaps[0]->width ) / LOG2_DOT_2;
-    if(isnan(lod_level)){
-        lod_level = tex->lod_max_level;
-    }
-    return lod_level;
-}
-
-static void texture_cubemap_lod_mag_linear_min_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    int w = tex->mipmaps[0]->width;
-    int h = tex->mipmaps[0]->height;
-    float *texels = tex->mipmaps[0]->texels + output.cubemap_face * w * h * tex->components;
-    sample_tex2D_bilinear(texels, w, h, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-
-}
-
-static void texture_cubemap_lod_mag_nearest_min_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    int w = tex->mipmaps[0]->width;
-    int h = tex->mipmaps[0]->height;
-    float *texels = tex->mipmaps[0]->texels + output.cubemap_face * w * h * tex->components;
-    sample_tex2D_nearest(texels, w, h, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-
-}
-
-static void texture_cubemap_lod_mag_linear_min_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    Mipmap *mip = tex->mipmaps[0];
-    float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-    if(lod_level == 0){
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_nearest_min_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    Mipmap *mip = tex->mipmaps[0];
-    float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-    if(lod_level == 0){
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_linear_min_linear_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_bilinear(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_bilinear(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_linear_min_nearest_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_nearest(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_nearest(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-          color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_linear_min_linear_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_linear_min_nearest_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_nearest_min_linear_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_bilinear(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_bilinear(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_nearest_min_nearest_mip_linear(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_nearest(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_nearest(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
-
-}
-
-static void texture_cubemap_lod_mag_nearest_min_linear_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        y_index = NEGATIVE_Y;
+        yu_sign = 1.0f;
+        yv_sign = -1.0f;
     }
 
-}
-
-static void texture_cubemap_lod_mag_nearest_min_nearest_mip_nearest(er_Texture *tex, float *coord, float lod_level, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+    if( input_vector[VAR_P] >= 0.0f ){
+        abs_z = input_vector[VAR_P];
+        z_index = POSITIVE_Z;
+        zu_sign = -1.0f;
+        zv_sign = 1.0f;
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        abs_z = - input_vector[VAR_P];
+        z_index = NEGATIVE_Z;
+        zu_sign = 1.0f;
+        zv_sign = 1.0f;
     }
 
-}
-
-static void texture_cubemap_grad_mag_linear_min_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+    float max_axis = abs_x;
+    output->cubemap_face = x_index;
+    output->u_sign = xu_sign;
+    output->v_sign = xv_sign;
+    output->u_index = VAR_P;
+    output->v_index = VAR_T;
+    output->max_axis_index = VAR_S;
+    output->wrap_u = tex->wrap_r;
+    output->wrap_v = tex->wrap_t;
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    int w = tex->mipmaps[0]->width;
-    int h = tex->mipmaps[0]->height;
-    float *texels = tex->mipmaps[0]->texels + output.cubemap_face * w * h * tex->components;
-    sample_tex2D_bilinear(texels, w, h, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+    if( abs_y > max_axis ){
+        max_axis = abs_y;
+        output->cubemap_face = y_index;
+        output->u_sign = yu_sign;
+        output->v_sign = yv_sign;
+        output->u_index = VAR_S;
+        output->v_index = VAR_P;
+        output->max_axis_index = VAR_T;
+        output->wrap_u = tex->wrap_s;
+        output->wrap_v = tex->wrap_r;
+    }
+    if( abs_z > max_axis ){
+        max_axis = abs_z;
+        output->cubemap_face = z_index;
+        output->u_sign = zu_sign;
+        output->v_sign = zv_sign;
+        output->u_index = VAR_S;
+        output->v_index = VAR_T;
+        output->max_axis_index = VAR_P;
+        output->wrap_u = tex->wrap_s;
+        output->wrap_v = tex->wrap_t;
+    }
 
+    output->u = 0.5f * output->u_sign * input_vector[output->u_index] / max_axis + 0.5f;
+    output->v = 0.5f * output->v_sign * input_vector[output->v_index] / max_axis + 0.5f;
 }
 
-static void texture_cubemap_grad_mag_nearest_min_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * Squared lengths of the derivatives of the face coordinates along x and y.
+*/
+static void calculate_cubemap_footprint(float* input_vector, float *ddx, float *ddy, Cubemap_uv* output_uv, float *length_x, float *length_y){
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    int w = tex->mipmaps[0]->width;
-    int h = tex->mipmaps[0]->height;
-    float *texels = tex->mipmaps[0]->texels + output.cubemap_face * w * h * tex->components;
-    sample_tex2D_nearest(texels, w, h, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+    float du_dx, dv_dx, du_dy, dv_dy;
+    int ui = output_uv->u_index;
+    int vi = output_uv->v_index;
+    int mai = output_uv->max_axis_index;
+    float one_over_denom = 1.0f / (2.0f * input_vector[mai] * input_vector[mai]);
+    du_dx = output_uv->u_sign * (ddx[ui] * input_vector[mai] - input_vector[ui] * ddx[mai]) * one_over_denom;
+    du_dy = output_uv->u_sign * (ddy[ui] * input_vector[mai] - input_vector[ui] * ddy[mai]) * one_over_denom;
+    dv_dx = output_uv->v_sign * (ddx[vi] * input_vector[mai] - input_vector[vi] * ddx[mai]) * one_over_denom;
+    dv_dy = output_uv->v_sign * (ddy[vi] * input_vector[mai] - input_vector[vi] * ddy[mai]) * one_over_denom;
+    *length_x = du_dx * du_dx + dv_dx * dv_dx;
+    *length_y = du_dy * du_dy + dv_dy * dv_dy;
 
 }
 
-static void texture_cubemap_grad_mag_linear_min_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+static float calculate_cubemap_lod_level(er_Texture *tex, float* input_vector, float *ddx, float *ddy, Cubemap_uv* output_uv){
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    Mipmap *mip = tex->mipmaps[0];
-    float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-    if(lod_level == 0){
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+    float lod_level, diameter, length_x, length_y;
+    calculate_cubemap_footprint(input_vector, ddx, ddy, output_uv, &length_x, &length_y);
+    diameter = max(length_x, length_y);
+    lod_level = 0.5f * fast_log2( diameter * tex->mipmaps[0]->width * tex->mipmaps[0]->width );
+    if(isnan(lod_level)){
+        lod_level = tex->lod_max_level;
     }
-
+    return lod_level;
 }
 
-static void texture_cubemap_grad_mag_nearest_min_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+typedef void (*LevelSampler)(er_Texture *tex, void *texels, int w, int h, float u, float v, er_TextureWrapModeEnum wrap_u,
+                             er_TextureWrapModeEnum wrap_v, float *color);
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    Mipmap *mip = tex->mipmaps[0];
-    float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-    if(lod_level == 0){
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+/*
+ * Nearest or linear filter of a level, on a face of cubemaps. The samplers of the level are the ones of a variant.
+*/
+SAMPLER_INLINE void sample_level(er_Texture *tex, er_TextureTargetEnum target, er_Bool linear, int level, int face, float u, float v,
+                                 er_TextureWrapModeEnum wrap_u, er_TextureWrapModeEnum wrap_v, LevelSampler nearest, LevelSampler bilinear, float *color){
+
+    Mipmap *mip = tex->mipmaps[level];
+    void *texels = (target == ER_TEXTURE_CUBE_MAP) ? face_texels(tex, mip, face): mip->texels;
+    if(linear){
+        bilinear(tex, texels, mip->width, mip->height, u, v, wrap_u, wrap_v, color);
     }else{
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        nearest(tex, texels, mip->width, mip->height, u, v, wrap_u, wrap_v, color);
     }
 
 }
 
-static void texture_cubemap_grad_mag_linear_min_linear_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+/*
+ * Magnification filter up to level of detail 0, minification and mipmap filters above it.
+*/
+SAMPLER_INLINE void sample_filters(er_Texture *tex, er_TextureTargetEnum target, er_TextureFilterEnum magnification, er_TextureFilterEnum minification,
+                                   int face, float u, float v, er_TextureWrapModeEnum wrap_u, er_TextureWrapModeEnum wrap_v, int components,
+                                   LevelSampler nearest, LevelSampler bilinear, float lod_level, float *color){
+
+    er_Bool mag_linear = (magnification == ER_LINEAR);
+    er_Bool min_linear = (minification == ER_LINEAR || minification == ER_LINEAR_MIPMAP_NEAREST || minification == ER_LINEAR_MIPMAP_LINEAR);
+    er_Bool linear = min_linear;
+    int level = 0;
+    if(minification == ER_LINEAR || minification == ER_NEAREST){
+        if(mag_linear != min_linear && lod_level <= 0){
+            linear = mag_linear;
+        }
+    }else if(lod_level <= 0){
+        linear = mag_linear;
     }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_bilinear(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_bilinear(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+        if(minification == ER_LINEAR_MIPMAP_LINEAR || minification == ER_NEAREST_MIPMAP_LINEAR){
+            int lower_level = (int)lod_level;
+            float lod_blend_factor = lod_level - lower_level;
+            vec4 lower_color;
+            vec4 upper_color;
+            sample_level(tex, target, min_linear, lower_level, face, u, v, wrap_u, wrap_v, nearest, bilinear, lower_color);
+            sample_level(tex, target, min_linear, lower_level + 1, face, u, v, wrap_u, wrap_v, nearest, bilinear, upper_color);
+            int c;
+            for(c = 0; c < components; c++){
+                color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+            }
+            return;
         }
+        level = uiround(lod_level);
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        level = tex->lod_max_level;
     }
+    sample_level(tex, target, linear, level, face, u, v, wrap_u, wrap_v, nearest, bilinear, color);
 
 }
 
-static void texture_cubemap_grad_mag_linear_min_nearest_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+SAMPLER_INLINE void texture_lod_variant(er_Texture *tex, float *coord, float lod_level, float *color, er_TextureTargetEnum target,
+                                        er_TextureFilterEnum magnification, er_TextureFilterEnum minification, int components,
+                                        LevelSampler nearest, LevelSampler bilinear){
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_nearest(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_nearest(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
+    if(target == ER_TEXTURE_CUBE_MAP){
+        Cubemap_uv output;
+        calculate_cubemap_uv(tex, coord, &output);
+        sample_filters(tex, target, magnification, minification, output.cubemap_face, output.u, output.v, output.wrap_u, output.wrap_v,
+                       components, nearest, bilinear, lod_level, color);
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        float v = (target == ER_TEXTURE_2D) ? coord[VAR_T]: 0.0f;
+        sample_filters(tex, target, magnification, minification, 0, coord[VAR_S], v, tex->wrap_s, tex->wrap_t, components,
+                       nearest, bilinear, lod_level, color);
     }
 
 }
 
-static void texture_cubemap_grad_mag_linear_min_linear_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
-
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+/*
+ * Level of detail from the derivatives, skipped when both filters sample level 0 alike. 1D and 2D textures
+ * continue on texture_lod of the variant, cubemaps reuse the face of the level of detail.
+*/
+SAMPLER_INLINE void texture_grad_variant(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color, er_TextureTargetEnum target,
+                                         er_TextureFilterEnum magnification, er_TextureFilterEnum minification, int components,
+                                         LevelSampler nearest, LevelSampler bilinear,
+                                         void (*texture_lod)(er_Texture *tex, float *coord, float lod, float *color)){
+
+    er_Bool level_of_detail = (magnification != minification);
+    float lod_level = 0.0f;
+    if(target == ER_TEXTURE_CUBE_MAP){
+        Cubemap_uv output;
+        calculate_cubemap_uv(tex, coord, &output);
+        if(level_of_detail){
+            lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
+        }
+        sample_filters(tex, target, magnification, minification, output.cubemap_face, output.u, output.v, output.wrap_u, output.wrap_v,
+                       components, nearest, bilinear, lod_level, color);
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        if(level_of_detail){
+            lod_level = (target == ER_TEXTURE_2D) ? calculate_texture2D_lod_level(tex, ddx, ddy): calculate_texture1D_lod_level(tex, ddx, ddy);
+        }
+        texture_lod(tex, coord, lod_level, color);
     }
 
 }
 
-static void texture_cubemap_grad_mag_linear_min_nearest_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+typedef struct SamplerVariant{
+    er_TextureTargetEnum texture_target;
+    er_TextureFilterEnum magnification_filter;
+    er_TextureFilterEnum minification_filter;
+    er_TextureWrapModeEnum wrap_s;
+    er_TextureWrapModeEnum wrap_t;
+    int components;
+    void (*texture_lod)(er_Texture *tex, float *coord, float lod, float *color);
+    void (*texture_grad)(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color);
+} SamplerVariant;
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
+/* Components of a variant, 0 for the ones of the texture */
+#define TEXTURE_COMPONENTS(COMPONENTS) ((COMPONENTS) ? (COMPONENTS): tex->components)
 
+/*
+ * Level samplers of a target, pair of wrap modes and number of components. Every parameter is a constant,
+ * wrap modes become a mask or a clamp. 1D textures ignore the wrap mode of t, cubemaps take the wrap
+ * modes of each face when sampled.
+*/
+#define SAMPLER_LEVELS(FILTER, MAG, MIN, LEVELS, TARGET, WRAP_S, WRAP_T, COMPONENTS) \
+static void LEVELS##_nearest(er_Texture *tex, void *texels, int w, int h, float u, float v, er_TextureWrapModeEnum wrap_u, \
+                             er_TextureWrapModeEnum wrap_v, float *color){ \
+    if(TARGET == ER_TEXTURE_1D){ \
+        sample_tex1D_nearest(tex, texels, w, u, WRAP_S, TEXTURE_COMPONENTS(COMPONENTS), color); \
+    }else if(TARGET == ER_TEXTURE_2D){ \
+        sample_tex2D_nearest(tex, texels, w, h, u, v, WRAP_S, WRAP_T, TEXTURE_COMPONENTS(COMPONENTS), color); \
+    }else{ \
+        sample_tex2D_nearest(tex, texels, w, h, u, v, wrap_u, wrap_v, TEXTURE_COMPONENTS(COMPONENTS), color); \
+    } \
+} \
+static void LEVELS##_bilinear(er_Texture *tex, void *texels, int w, int h, float u, float v, er_TextureWrapModeEnum wrap_u, \
+                              er_TextureWrapModeEnum wrap_v, float *color){ \
+    if(TARGET == ER_TEXTURE_1D){ \
+        sample_tex1D_linear(tex, texels, w, u, WRAP_S, TEXTURE_COMPONENTS(COMPONENTS), color); \
+    }else if(TARGET == ER_TEXTURE_2D){ \
+        sample_tex2D_bilinear(tex, texels, w, h, u, v, WRAP_S, WRAP_T, TEXTURE_COMPONENTS(COMPONENTS), color); \
+    }else{ \
+        sample_tex2D_bilinear(tex, texels, w, h, u, v, wrap_u, wrap_v, TEXTURE_COMPONENTS(COMPONENTS), color); \
+    } \
 }
 
-static void texture_cubemap_grad_mag_nearest_min_linear_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * texture_lod and texture_grad of a combination of filters on the level samplers of a variant.
+*/
+#define SAMPLER_VARIANT(FILTER, MAG, MIN, LEVELS, TARGET, WRAP_S, WRAP_T, COMPONENTS) \
+static void LEVELS##_##FILTER##_lod(er_Texture *tex, float *coord, float lod_level, float *color){ \
+    texture_lod_variant(tex, coord, lod_level, color, TARGET, MAG, MIN, TEXTURE_COMPONENTS(COMPONENTS), LEVELS##_nearest, LEVELS##_bilinear); \
+} \
+static void LEVELS##_##FILTER##_grad(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){ \
+    texture_grad_variant(tex, coord, ddx, ddy, color, TARGET, MAG, MIN, TEXTURE_COMPONENTS(COMPONENTS), LEVELS##_nearest, LEVELS##_bilinear, \
+                         LEVELS##_##FILTER##_lod); \
+}
+
+#define SAMPLER_ENTRY(FILTER, MAG, MIN, LEVELS, TARGET, WRAP_S, WRAP_T, COMPONENTS) \
+    {TARGET, MAG, MIN, WRAP_S, WRAP_T, COMPONENTS, LEVELS##_##FILTER##_lod, LEVELS##_##FILTER##_grad},
+
+/* Four components are filtered on registers, variants of 0 components read them from the texture */
+#define SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, LEVELS, TARGET, WRAP_S, WRAP_T) \
+    X(FILTER, MAG, MIN, LEVELS##_4, TARGET, WRAP_S, WRAP_T, 4) \
+    X(FILTER, MAG, MIN, LEVELS##_n, TARGET, WRAP_S, WRAP_T, 0)
+
+/* Cubemaps take the wrap modes of each face and the components of the texture in a single variant */
+#define SAMPLER_TARGETS(X, FILTER, MAG, MIN) \
+    SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, texture1D_repeat, ER_TEXTURE_1D, ER_REPEAT, ER_REPEAT) \
+    SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, texture1D_clamp, ER_TEXTURE_1D, ER_CLAMP_TO_EDGE, ER_CLAMP_TO_EDGE) \
+    SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, texture2D_repeat_repeat, ER_TEXTURE_2D, ER_REPEAT, ER_REPEAT) \
+    SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, texture2D_repeat_clamp, ER_TEXTURE_2D, ER_REPEAT, ER_CLAMP_TO_EDGE) \
+    SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, texture2D_clamp_repeat, ER_TEXTURE_2D, ER_CLAMP_TO_EDGE, ER_REPEAT) \
+    SAMPLER_COMPONENTS(X, FILTER, MAG, MIN, texture2D_clamp_clamp, ER_TEXTURE_2D, ER_CLAMP_TO_EDGE, ER_CLAMP_TO_EDGE) \
+    X(FILTER, MAG, MIN, texture_cubemap, ER_TEXTURE_CUBE_MAP, ER_CLAMP_TO_EDGE, ER_CLAMP_TO_EDGE, 0)
+
+#define SAMPLER_FILTERS(X) \
+    SAMPLER_TARGETS(X, mag_nearest_min_nearest, ER_NEAREST, ER_NEAREST) \
+    SAMPLER_TARGETS(X, mag_nearest_min_linear, ER_NEAREST, ER_LINEAR) \
+    SAMPLER_TARGETS(X, mag_nearest_min_nearest_mip_nearest, ER_NEAREST, ER_NEAREST_MIPMAP_NEAREST) \
+    SAMPLER_TARGETS(X, mag_nearest_min_linear_mip_nearest, ER_NEAREST, ER_LINEAR_MIPMAP_NEAREST) \
+    SAMPLER_TARGETS(X, mag_nearest_min_nearest_mip_linear, ER_NEAREST, ER_NEAREST_MIPMAP_LINEAR) \
+    SAMPLER_TARGETS(X, mag_nearest_min_linear_mip_linear, ER_NEAREST, ER_LINEAR_MIPMAP_LINEAR) \
+    SAMPLER_TARGETS(X, mag_linear_min_nearest, ER_LINEAR, ER_NEAREST) \
+    SAMPLER_TARGETS(X, mag_linear_min_linear, ER_LINEAR, ER_LINEAR) \
+    SAMPLER_TARGETS(X, mag_linear_min_nearest_mip_nearest, ER_LINEAR, ER_NEAREST_MIPMAP_NEAREST) \
+    SAMPLER_TARGETS(X, mag_linear_min_linear_mip_nearest, ER_LINEAR, ER_LINEAR_MIPMAP_NEAREST) \
+    SAMPLER_TARGETS(X, mag_linear_min_nearest_mip_linear, ER_LINEAR, ER_NEAREST_MIPMAP_LINEAR) \
+    SAMPLER_TARGETS(X, mag_linear_min_linear_mip_linear, ER_LINEAR, ER_LINEAR_MIPMAP_LINEAR)
+
+SAMPLER_TARGETS(SAMPLER_LEVELS, , 0, 0)
+SAMPLER_FILTERS(SAMPLER_VARIANT)
+
+static const SamplerVariant sampler_variants[] = {
+    SAMPLER_FILTERS(SAMPLER_ENTRY)
+};
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_bilinear(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_bilinear(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
+/*
+ * Variant with the target, filters, wrap modes and number of components of a texture.
+*/
+static const SamplerVariant* select_sampler(er_Texture *tex){
+
+    unsigned int i;
+    for(i = 0; i < sizeof(sampler_variants) / sizeof(SamplerVariant); i++){
+        const SamplerVariant *variant = &sampler_variants[i];
+        if(variant->texture_target == tex->texture_target && variant->magnification_filter == tex->magnification_filter &&
+           variant->minification_filter == tex->minification_filter && (variant->components == 0 || variant->components == tex->components) &&
+           (tex->texture_target == ER_TEXTURE_CUBE_MAP || variant->wrap_s == tex->wrap_s) &&
+           (tex->texture_target != ER_TEXTURE_2D || variant->wrap_t == tex->wrap_t)){
+            return variant;
         }
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
     }
+    return NULL;
 
 }
 
-static void texture_cubemap_grad_mag_nearest_min_nearest_mip_linear(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+static void texture_cubemap_grad_anisotropic(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
 
     Cubemap_uv output;
+    float length_x, length_y;
     calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int lower_level = (int)lod_level;
-        int upper_level = lower_level+1;
-        float lod_blend_factor = lod_level - lower_level;
-        vec4 lower_color;
-        vec4 upper_color;
-        Mipmap *lower_mip = tex->mipmaps[lower_level];
-        Mipmap *upper_mip = tex->mipmaps[upper_level];
-        float *lower_texels = lower_mip->texels + output.cubemap_face * lower_mip->width * lower_mip->height * tex->components;
-        float *upper_texels = upper_mip->texels + output.cubemap_face * upper_mip->width * upper_mip->height * tex->components;
-        sample_tex2D_nearest(lower_texels, lower_mip->width, lower_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, lower_color);
-        sample_tex2D_nearest(upper_texels, upper_mip->width, upper_mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, upper_color);
-        int c;
-        for(c = 0; c < tex->components; c++){
-            color[c] = lerp(lower_color[c], upper_color[c], lod_blend_factor);
-        }
+    calculate_cubemap_footprint(coord, ddx, ddy, &output, &length_x, &length_y);
+    /* Probes along the derivative of the direction may fall on other faces */
+    if(length_x > length_y){
+        sample_anisotropic(tex, coord, 3, ddx, length_x, length_y, tex->mipmaps[0]->width, color);
     }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+        sample_anisotropic(tex, coord, 3, ddy, length_y, length_x, tex->mipmaps[0]->width, color);
     }
 
 }
 
-static void texture_cubemap_grad_mag_nearest_min_linear_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+/*
+ * Samplers of the filters, wrap modes and number of components of the texture.
+*/
+static void update_filter_functions(er_Texture *tex){
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_bilinear(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
+    const SamplerVariant *variant = select_sampler(tex);
+    tex->texture_lod = variant->texture_lod;
+    tex->texture_grad = variant->texture_grad;
+
+    /* Lanes of 2D textures are filtered together with bilinear and trilinear filters */
+    tex->texture_lod_span = texture_lod_span_lanes;
+    tex->texture_grad_span = texture_grad_span_lanes;
+#ifdef __SSE2__
+    if(tex->texture_target == ER_TEXTURE_2D && tex->magnification_filter == ER_LINEAR){
+        if(tex->minification_filter == ER_LINEAR){
+            tex->texture_lod_span = texture2D_lod_span_linear;
+            tex->texture_grad_span = texture2D_grad_span_linear;
+        }else if(tex->minification_filter == ER_LINEAR_MIPMAP_LINEAR){
+            tex->texture_lod_span = texture2D_lod_span_linear_mip_linear;
+            if(tex->max_anisotropy == 1.0f){
+                tex->texture_grad_span = texture2D_grad_span_linear_mip_linear;
+            }
+        }
     }
+#endif
 
-}
+    /* Anisotropic filtering of mipmapped 2D textures and cubemaps, probes are filtered by texture_lod */
+    if(tex->max_anisotropy > 1.0f && tex->minification_filter != ER_LINEAR && tex->minification_filter != ER_NEAREST){
+        if(tex->texture_target == ER_TEXTURE_2D){
+            tex->texture_grad = texture2D_grad_anisotropic;
+        }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
+            tex->texture_grad = texture_cubemap_grad_anisotropic;
+        }
+    }
 
-static void texture_cubemap_grad_mag_nearest_min_nearest_mip_nearest(er_Texture *tex, float *coord, float *ddx, float *ddy, float *color){
+}
 
-    Cubemap_uv output;
-    calculate_cubemap_uv(tex, coord, &output);
-    float lod_level = calculate_cubemap_lod_level(tex, coord, ddx, ddy, &output);
-    if(lod_level <= 0){
-        Mipmap *mip = tex->mipmaps[0];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else if(lod_level < tex->lod_max_level){
-        int round_level = uiround(lod_level);
-        Mipmap *mip = tex->mipmaps[round_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }else{
-        Mipmap *mip = tex->mipmaps[tex->lod_max_level];
-        float *texels = mip->texels + output.cubemap_face * mip->width * mip->height * tex->components;
-        sample_tex2D_nearest(texels, mip->width, mip->height, tex->components, output.u, output.v, output.wrap_u, output.wrap_v, color);
-    }
+/*
+ * Components, bytes per texel and bytes per block of an internal format.
+*/
+static er_Bool format_size(er_TextureFormatEnum internal_format, int *components, int *texel_size, int *block_size){
+
+    *block_size = 0;
+    switch(internal_format){
+        case ER_R32F: case ER_DEPTH32F: *components = 1; *texel_size = 4; break;
+        case ER_RG32F: *components = 2; *texel_size = 8; break;
+        case ER_RGB32F: *components = 3; *texel_size = 12; break;
+        case ER_RGBA32F: *components = 4; *texel_size = 16; break;
+        case ER_R8: *components = 1; *texel_size = 1; break;
+        case ER_RG8: *components = 2; *texel_size = 2; break;
+        case ER_RGBA8: *components = 4; *texel_size = 4; break;
+        case ER_R16F: *components = 1; *texel_size = 2; break;
+        case ER_RG16F: *components = 2; *texel_size = 4; break;
+        case ER_RGBA16F: *components = 4; *texel_size = 8; break;
+        case ER_BC1: *components = 4; *texel_size = 0; *block_size = 8; break;
+        case ER_BC3: *components = 4; *texel_size = 0; *block_size = 16; break;
+        case ER_BC4: *components = 1; *texel_size = 0; *block_size = 8; break;
+        case ER_BC5: *components = 2; *texel_size = 0; *block_size = 16; break;
+        default: return ER_FALSE;
+    }
+    return ER_TRUE;
 
 }
 
@@ -1725,6 +1755,10 @@ er_StatusEnum er_delete_texture(er_Texture *tex){
         }
         free(tex->mipmaps);
     }
+    /* Cached blocks could be taken by new texels at the same address */
+    if(tex->block_size > 0){
+        invalidate_blocks();
+    }
     free(tex);
     return ER_NO_ERROR;
 }
@@ -1742,18 +1776,9 @@ er_StatusEnum er_create_texture1D(er_Texture **tex, int width, er_TextureFormatE
     if(width & (width-1)){
         return ER_NO_POWER_OF_TWO;
     }
-    int components;
-    if(internal_format == ER_R32F){
-        components = 1;
-    }else if(internal_format == ER_RG32F){
-        components = 2;
-    }else if(internal_format == ER_RGB32F){
-        components = 3;
-    }else if(internal_format == ER_RGBA32F){
-        components = 4;
-    }else if(internal_format == ER_DEPTH32F){
-        components = 1;
-    }else{
+    /* Compressed formats are only for 2D textures and cubemaps */
+    int components, texel_size, block_size;
+    if(format_size(internal_format, &components, &texel_size, &block_size) == ER_FALSE || block_size > 0){
         return ER_INVALID_ARGUMENT;
     }
 
@@ -1764,14 +1789,17 @@ er_StatusEnum er_create_texture1D(er_Texture **tex, int width, er_TextureFormatE
     new_texture->texture_target = ER_TEXTURE_1D;
     new_texture->texture_format = internal_format;
     new_texture->components = components;
-    new_texture->wrap_s = clamp_to_edge;
+    new_texture->texel_size = texel_size;
+    new_texture->block_size = 0;
+    new_texture->layout = ER_ROW_MAJOR;
+    new_texture->wrap_s = ER_CLAMP_TO_EDGE;
     new_texture->magnification_filter = ER_NEAREST;
     new_texture->minification_filter = ER_NEAREST;
+    new_texture->max_anisotropy = 1.0f;
     new_texture->texture_size = texture1D_size;
     new_texture->texel_fetch = texture1D_texel_fetch;
-    new_texture->texture_lod = texture1D_lod_mag_nearest_min_nearest;
-    new_texture->texture_grad = texture1D_grad_mag_nearest_min_nearest;
     new_texture->write_texture = write_texture1D;
+    update_filter_functions(new_texture);
     int max_level = (int)(log( (float)width) / log(2.0f));
     int mip_levels = max_level+1;
     new_texture->mipmaps = (Mipmap**)malloc(mip_levels*sizeof(Mipmap*));
@@ -1792,7 +1820,7 @@ er_StatusEnum er_create_texture1D(er_Texture **tex, int width, er_TextureFormatE
     }
     new_texture->mipmaps[0] = mip0;
     mip0->width = width;
-    mip0->texels = (float*)malloc(width * new_texture->components * sizeof(float));
+    mip0->texels = malloc(width * texel_size);
     if(mip0->texels == NULL){
         er_delete_texture(new_texture);
         return ER_OUT_OF_MEMORY;
@@ -1816,18 +1844,8 @@ er_StatusEnum er_create_texture2D(er_Texture** tex, int width, int height, er_Te
     if(width & (width-1) || height & (height-1)){
         return ER_NO_POWER_OF_TWO;
     }
-    int components;
-    if(internal_format == ER_R32F){
-        components = 1;
-    }else if(internal_format == ER_RG32F){
-        components = 2;
-    }else if(internal_format == ER_RGB32F){
-        components = 3;
-    }else if(internal_format == ER_RGBA32F){
-        components = 4;
-    }else if(internal_format == ER_DEPTH32F){
-        components = 1;
-    }else{
+    int components, texel_size, block_size;
+    if(format_size(internal_format, &components, &texel_size, &block_size) == ER_FALSE){
         return ER_INVALID_ARGUMENT;
     }
 
@@ -1838,16 +1856,19 @@ er_StatusEnum er_create_texture2D(er_Texture** tex, int width, int height, er_Te
     new_texture->texture_target = ER_TEXTURE_2D;
     new_texture->texture_format = internal_format;
     new_texture->components = components;
-    new_texture->wrap_s = clamp_to_edge;
-    new_texture->wrap_t = clamp_to_edge;
-    new_texture->wrap_r = clamp_to_edge;
+    new_texture->texel_size = texel_size;
+    new_texture->block_size = block_size;
+    new_texture->layout = (block_size > 0) ? ER_TILED_4X4: ER_ROW_MAJOR;
+    new_texture->wrap_s = ER_CLAMP_TO_EDGE;
+    new_texture->wrap_t = ER_CLAMP_TO_EDGE;
+    new_texture->wrap_r = ER_CLAMP_TO_EDGE;
     new_texture->magnification_filter = ER_NEAREST;
     new_texture->minification_filter = ER_NEAREST;
+    new_texture->max_anisotropy = 1.0f;
     new_texture->texture_size = texture2D_size;
     new_texture->texel_fetch = texture2D_texel_fetch;
-    new_texture->texture_lod = texture2D_lod_mag_nearest_min_nearest;
-    new_texture->texture_grad = texture2D_grad_mag_nearest_min_nearest;
     new_texture->write_texture = write_texture2D;
+    update_filter_functions(new_texture);
     int max_dimension = max(width, height);
     int max_level = (int)(log( (float)max_dimension) / log(2.0f));
     int mip_levels = max_level+1;
@@ -1870,7 +1891,7 @@ er_StatusEnum er_create_texture2D(er_Texture** tex, int width, int height, er_Te
     new_texture->mipmaps[0] = mip0;
     mip0->width = width;
     mip0->height = height;
-    mip0->texels = (float*)malloc(width * height * new_texture->components * sizeof(float));
+    mip0->texels = malloc(level_size(new_texture, new_texture->layout, width, height));
     if(mip0->texels == NULL){
         er_delete_texture(new_texture);
         return ER_OUT_OF_MEMORY;
@@ -1894,18 +1915,8 @@ er_StatusEnum er_create_texture_cubemap(er_Texture **tex, int size, er_TextureFo
     if(size & (size-1)){
         return ER_NO_POWER_OF_TWO;
     }
-    int components;
-    if(internal_format == ER_R32F){
-        components = 1;
-    }else if(internal_format == ER_RG32F){
-        components = 2;
-    }else if(internal_format == ER_RGB32F){
-        components = 3;
-    }else if(internal_format == ER_RGBA32F){
-        components = 4;
-    }else if(internal_format == ER_DEPTH32F){
-        components = 1;
-    }else{
+    int components, texel_size, block_size;
+    if(format_size(internal_format, &components, &texel_size, &block_size) == ER_FALSE){
         return ER_INVALID_ARGUMENT;
     }
 
@@ -1916,16 +1927,19 @@ er_StatusEnum er_create_texture_cubemap(er_Texture **tex, int size, er_TextureFo
     new_texture->texture_target = ER_TEXTURE_CUBE_MAP;
     new_texture->texture_format = internal_format;
     new_texture->components = components;
-    new_texture->wrap_s = clamp_to_edge;
-    new_texture->wrap_t = clamp_to_edge;
-    new_texture->wrap_r = clamp_to_edge;
+    new_texture->texel_size = texel_size;
+    new_texture->block_size = block_size;
+    new_texture->layout = (block_size > 0) ? ER_TILED_4X4: ER_ROW_MAJOR;
+    new_texture->wrap_s = ER_CLAMP_TO_EDGE;
+    new_texture->wrap_t = ER_CLAMP_TO_EDGE;
+    new_texture->wrap_r = ER_CLAMP_TO_EDGE;
     new_texture->magnification_filter = ER_NEAREST;
     new_texture->minification_filter = ER_NEAREST;
+    new_texture->max_anisotropy = 1.0f;
     new_texture->texture_size = texture_cubemap_size;
     new_texture->texel_fetch = texture_cubemap_texel_fetch;
-    new_texture->texture_lod = texture_cubemap_lod_mag_nearest_min_nearest;
-    new_texture->texture_grad = texture_cubemap_grad_mag_nearest_min_nearest;
     new_texture->write_texture = write_texture_cubemap;
+    update_filter_functions(new_texture);
     int max_level = (int)(log( (float)size) / log(2.0f));
     int mip_levels = max_level+1;
     new_texture->mipmaps = (Mipmap**)malloc(mip_levels*sizeof(Mipmap*));
@@ -1947,7 +1961,7 @@ er_StatusEnum er_create_texture_cubemap(er_Texture **tex, int size, er_TextureFo
     new_texture->mipmaps[0] = mip0;
     mip0->width = size;
     mip0->height = size;
-    mip0->texels = (float*)malloc(6 * size * size * new_texture->components * sizeof(float));
+    mip0->texels = malloc(6 * level_size(new_texture, new_texture->layout, size, size));
     if(mip0->texels == NULL){
         er_delete_texture(new_texture);
         return ER_OUT_OF_MEMORY;
@@ -1957,17 +1971,11 @@ er_StatusEnum er_create_texture_cubemap(er_Texture **tex, int size, er_TextureFo
 
 }
 
-er_StatusEnum er_texture_ptr(er_Texture *tex, er_TextureTargetEnum texture_target, int level, float **data){
+/*
+ * Texels of a level or cubemap face, and their number.
+*/
+static er_StatusEnum level_texels(er_Texture *tex, er_TextureTargetEnum texture_target, int level, void **texels, int *size){
 
-    if(tex == NULL){
-        return ER_NULL_POINTER;
-    }
-    
-    if(data == NULL) {
-        return ER_NULL_POINTER;
-    }
-    *data = NULL;
-    
     if(texture_target != ER_TEXTURE_1D && texture_target != ER_TEXTURE_2D && 
         texture_target != ER_TEXTURE_CUBE_MAP_POSITIVE_X && texture_target != ER_TEXTURE_CUBE_MAP_NEGATIVE_X && 
         texture_target != ER_TEXTURE_CUBE_MAP_POSITIVE_Y && texture_target != ER_TEXTURE_CUBE_MAP_NEGATIVE_Y &&
@@ -1986,167 +1994,140 @@ er_StatusEnum er_texture_ptr(er_Texture *tex, er_TextureTargetEnum texture_targe
     }
     
     level = clamp(level, 0, tex->lod_max_level);
+    Mipmap *mip = tex->mipmaps[level];
+    if(mip == NULL){
+        return ER_INVALID_OPERATION;
+    }
 
     if(texture_target == ER_TEXTURE_1D){
-        *data = tex->mipmaps[level]->texels;
+        *texels = mip->texels;
+        *size = mip->width;
     }else if(texture_target == ER_TEXTURE_2D){
-        *data = tex->mipmaps[level]->texels;
-    }else if(texture_target >= ER_TEXTURE_CUBE_MAP_POSITIVE_X && texture_target <= ER_TEXTURE_CUBE_MAP_NEGATIVE_Z){
-        int cubemap_face = texture_target - ER_TEXTURE_CUBE_MAP_POSITIVE_X;
-        *data = (tex->mipmaps[level]->texels + cubemap_face * tex->mipmaps[level]->width * tex->mipmaps[level]->width * tex->components);
+        *texels = mip->texels;
+        *size = mip->width * mip->height;
+    }else{
+        *texels = face_texels(tex, mip, texture_target - ER_TEXTURE_CUBE_MAP_POSITIVE_X);
+        *size = mip->width * mip->height;
     }
-
     return ER_NO_ERROR;
 
 }
 
-static void update_filter_functions(er_Texture *tex){
+er_StatusEnum er_texture_ptr(er_Texture *tex, er_TextureTargetEnum texture_target, int level, float **data){
 
-    if(tex->minification_filter == ER_LINEAR){
-        if(tex->magnification_filter == ER_LINEAR){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_linear_min_linear;
-                tex->texture_grad = texture1D_grad_mag_linear_min_linear;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_linear_min_linear;
-                tex->texture_grad = texture2D_grad_mag_linear_min_linear;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_linear_min_linear;
-                tex->texture_grad = texture_cubemap_grad_mag_linear_min_linear;
-            }
-        }else if(tex->magnification_filter == ER_NEAREST){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_nearest_min_linear;
-                tex->texture_grad = texture1D_grad_mag_nearest_min_linear;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_nearest_min_linear;
-                tex->texture_grad = texture2D_grad_mag_nearest_min_linear;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_nearest_min_linear;
-                tex->texture_grad = texture_cubemap_grad_mag_nearest_min_linear;
-            }
-        }
-    }else if(tex->minification_filter == ER_NEAREST){
-        if(tex->magnification_filter == ER_LINEAR){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_linear_min_nearest;
-                tex->texture_grad = texture1D_grad_mag_linear_min_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_linear_min_nearest;
-                tex->texture_grad = texture2D_grad_mag_linear_min_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_linear_min_nearest;
-                tex->texture_grad = texture_cubemap_grad_mag_linear_min_nearest;
-            }
-        }else if(tex->magnification_filter == ER_NEAREST){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_nearest_min_nearest;
-                tex->texture_grad = texture1D_grad_mag_nearest_min_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_nearest_min_nearest;
-                tex->texture_grad = texture2D_grad_mag_nearest_min_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_nearest_min_nearest;
-                tex->texture_grad = texture_cubemap_grad_mag_nearest_min_nearest;
+    if(tex == NULL){
+        return ER_NULL_POINTER;
+    }
+    
+    if(data == NULL) {
+        return ER_NULL_POINTER;
+    }
+    *data = NULL;
+
+    /* Packed formats and reordered texels are written through er_texture_image */
+    if(packed_format(tex) || tex->layout != ER_ROW_MAJOR){
+        return ER_INVALID_OPERATION;
+    }
+
+    void *texels;
+    int size;
+    er_StatusEnum status = level_texels(tex, texture_target, level, &texels, &size);
+    if(status == ER_NO_ERROR){
+        *data = (float*)texels;
+    }
+    return status;
+
+}
+
+/*
+ * Copy a level or cubemap face from floats with the components of the texture, converted to its internal format.
+*/
+er_StatusEnum er_texture_image(er_Texture *tex, er_TextureTargetEnum texture_target, int level, float *data){
+
+    if(tex == NULL || data == NULL){
+        return ER_NULL_POINTER;
+    }
+
+    void *texels;
+    int size;
+    er_StatusEnum status = level_texels(tex, texture_target, level, &texels, &size);
+    if(status != ER_NO_ERROR){
+        return status;
+    }
+    if(tex->block_size > 0){
+        Mipmap *mip = tex->mipmaps[clamp(level, 0, tex->lod_max_level)];
+        encode_texels(tex, texels, mip->width, mip->height, data);
+    }else if(tex->layout != ER_ROW_MAJOR){
+        Mipmap *mip = tex->mipmaps[clamp(level, 0, tex->lod_max_level)];
+        int s, t;
+        for(t = 0; t < mip->height; t++){
+            for(s = 0; s < mip->width; s++){
+                store_texel(tex, texels, texel_index(tex->layout, mip->width, mip->height, s, t), data + (t * mip->width + s) * tex->components);
             }
         }
-    }else if(tex->minification_filter == ER_NEAREST_MIPMAP_NEAREST){
-        if(tex->magnification_filter == ER_LINEAR){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_linear_min_nearest_mip_nearest;
-                tex->texture_grad = texture1D_grad_mag_linear_min_nearest_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_linear_min_nearest_mip_nearest;
-                tex->texture_grad = texture2D_grad_mag_linear_min_nearest_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_linear_min_nearest_mip_nearest;
-                tex->texture_grad = texture_cubemap_grad_mag_linear_min_nearest_mip_nearest;
-            }
-        }else if(tex->magnification_filter == ER_NEAREST){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_nearest_min_nearest_mip_nearest;
-                tex->texture_grad = texture1D_grad_mag_nearest_min_nearest_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_nearest_min_nearest_mip_nearest;
-                tex->texture_grad = texture2D_grad_mag_nearest_min_nearest_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_nearest_min_nearest_mip_nearest;
-                tex->texture_grad = texture_cubemap_grad_mag_nearest_min_nearest_mip_nearest;
-            }
+    }else if(packed_format(tex)){
+        int i;
+        for(i = 0; i < size; i++){
+            store_texel(tex, texels, i, data + i * tex->components);
         }
-    }else if(tex->minification_filter == ER_NEAREST_MIPMAP_LINEAR){
-        if(tex->magnification_filter == ER_LINEAR){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_linear_min_nearest_mip_linear;
-                tex->texture_grad = texture1D_grad_mag_linear_min_nearest_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_linear_min_nearest_mip_linear;
-                tex->texture_grad = texture2D_grad_mag_linear_min_nearest_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_linear_min_nearest_mip_linear;
-                tex->texture_grad = texture_cubemap_grad_mag_linear_min_nearest_mip_linear;
-            }
-        }else if(tex->magnification_filter == ER_NEAREST){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_nearest_min_nearest_mip_linear;
-                tex->texture_grad = texture1D_grad_mag_nearest_min_nearest_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_nearest_min_nearest_mip_linear;
-                tex->texture_grad = texture2D_grad_mag_nearest_min_nearest_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_nearest_min_nearest_mip_linear;
-                tex->texture_grad = texture_cubemap_grad_mag_nearest_min_nearest_mip_linear;
-            }
+    }else{
+        memcpy(texels, data, size * tex->texel_size);
+    }
+    return ER_NO_ERROR;
+
+}
+
+/*
+ * Reorder the texels of every level and cubemap face.
+*/
+er_StatusEnum er_texture_layout(er_Texture *tex, er_TextureLayoutEnum layout){
+
+    if(tex == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(layout != ER_ROW_MAJOR && layout != ER_TILED_4X4 && layout != ER_MORTON_ORDER){
+        return ER_INVALID_ARGUMENT;
+    }
+    if(tex->texture_target == ER_TEXTURE_1D){
+        return (layout == ER_ROW_MAJOR) ? ER_NO_ERROR: ER_INVALID_OPERATION;
+    }
+    /* Compressed blocks keep the tiled order */
+    if(tex->block_size > 0){
+        return (layout == ER_TILED_4X4) ? ER_NO_ERROR: ER_INVALID_OPERATION;
+    }
+    if(layout == tex->layout){
+        return ER_NO_ERROR;
+    }
+
+    int faces = (tex->texture_target == ER_TEXTURE_CUBE_MAP) ? 6: 1;
+    int l, face, s, t;
+    for(l = 0; l <= tex->lod_max_level; l++){
+        Mipmap *mip = tex->mipmaps[l];
+        if(mip == NULL){
+            continue;
         }
-    }else if(tex->minification_filter == ER_LINEAR_MIPMAP_NEAREST){
-        if(tex->magnification_filter == ER_LINEAR){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_linear_min_linear_mip_nearest;
-                tex->texture_grad = texture1D_grad_mag_linear_min_linear_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_linear_min_linear_mip_nearest;
-                tex->texture_grad = texture2D_grad_mag_linear_min_linear_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_linear_min_linear_mip_nearest;
-                tex->texture_grad = texture_cubemap_grad_mag_linear_min_linear_mip_nearest;
-            }
-        }else if(tex->magnification_filter == ER_NEAREST){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_nearest_min_linear_mip_nearest;
-                tex->texture_grad = texture1D_grad_mag_nearest_min_linear_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_nearest_min_linear_mip_nearest;
-                tex->texture_grad = texture2D_grad_mag_nearest_min_linear_mip_nearest;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_nearest_min_linear_mip_nearest;
-                tex->texture_grad = texture_cubemap_grad_mag_nearest_min_linear_mip_nearest;
-            }
+        /* Tiled levels are completed to whole tiles */
+        int size = level_size(tex, layout, mip->width, mip->height);
+        uint8_t *texels = (uint8_t*)malloc(faces * size);
+        if(texels == NULL){
+            return ER_OUT_OF_MEMORY;
         }
-    }else if(tex->minification_filter == ER_LINEAR_MIPMAP_LINEAR){
-        if(tex->magnification_filter == ER_LINEAR){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_linear_min_linear_mip_linear;
-                tex->texture_grad = texture1D_grad_mag_linear_min_linear_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_linear_min_linear_mip_linear;
-                tex->texture_grad = texture2D_grad_mag_linear_min_linear_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_linear_min_linear_mip_linear;
-                tex->texture_grad = texture_cubemap_grad_mag_linear_min_linear_mip_linear;
-            }
-        }else if(tex->magnification_filter == ER_NEAREST){
-            if(tex->texture_target == ER_TEXTURE_1D){
-                tex->texture_lod = texture1D_lod_mag_nearest_min_linear_mip_linear;
-                tex->texture_grad = texture1D_grad_mag_nearest_min_linear_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_2D){
-                tex->texture_lod = texture2D_lod_mag_nearest_min_linear_mip_linear;
-                tex->texture_grad = texture2D_grad_mag_nearest_min_linear_mip_linear;
-            }else if(tex->texture_target == ER_TEXTURE_CUBE_MAP){
-                tex->texture_lod = texture_cubemap_lod_mag_nearest_min_linear_mip_linear;
-                tex->texture_grad = texture_cubemap_grad_mag_nearest_min_linear_mip_linear;
+        for(face = 0; face < faces; face++){
+            uint8_t *source = face_texels(tex, mip, face);
+            uint8_t *destination = texels + face * size;
+            for(t = 0; t < mip->height; t++){
+                for(s = 0; s < mip->width; s++){
+                    int from = texel_index(tex->layout, mip->width, mip->height, s, t);
+                    int to = texel_index(layout, mip->width, mip->height, s, t);
+                    memcpy(destination + to * tex->texel_size, source + from * tex->texel_size, tex->texel_size);
+                }
             }
         }
+        free(mip->texels);
+        mip->texels = texels;
     }
+    tex->layout = layout;
+    return ER_NO_ERROR;
 
 }
 
@@ -2157,7 +2138,8 @@ er_StatusEnum er_texture_filtering(er_Texture *tex, er_TextureParamEnum paramete
     }
 
     if(parameter == ER_MINIFICATION_FILTER){
-        if(value == ER_LINEAR || value == ER_NEAREST || value == ER_LINEAR_MIPMAP_LINEAR || ER_LINEAR_MIPMAP_NEAREST || ER_NEAREST_MIPMAP_LINEAR || ER_NEAREST_MIPMAP_NEAREST){
+        if(value == ER_LINEAR || value == ER_NEAREST || value == ER_LINEAR_MIPMAP_LINEAR || value == ER_LINEAR_MIPMAP_NEAREST ||
+           value == ER_NEAREST_MIPMAP_LINEAR || value == ER_NEAREST_MIPMAP_NEAREST){
             tex->minification_filter = value;
             update_filter_functions(tex);
         }else{
@@ -2176,6 +2158,27 @@ er_StatusEnum er_texture_filtering(er_Texture *tex, er_TextureParamEnum paramete
     return ER_NO_ERROR;
 }
 
+/*
+ * Anisotropy is clamped to MAX_ANISOTROPY, 1 keeps the isotropic filters.
+*/
+er_StatusEnum er_texture_parameterf(er_Texture *tex, er_TextureParamEnum parameter, float value){
+
+    if(tex == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(parameter == ER_TEXTURE_MAX_ANISOTROPY){
+        if(!(value >= 1.0f)){
+            return ER_INVALID_ARGUMENT;
+        }
+        tex->max_anisotropy = min(value, (float)MAX_ANISOTROPY);
+        update_filter_functions(tex);
+    }else{
+        return ER_INVALID_ARGUMENT;
+    }
+    return ER_NO_ERROR;
+
+}
+
 er_StatusEnum er_texture_wrap_mode(er_Texture *tex, er_TextureParamEnum parameter, er_TextureWrapModeEnum value){
 
     if(tex == NULL){
@@ -2183,34 +2186,107 @@ er_StatusEnum er_texture_wrap_mode(er_Texture *tex, er_TextureParamEnum paramete
     }
     if(parameter == ER_WRAP_S){
         if(value == ER_REPEAT){
-            tex->wrap_s = repeat;
+            tex->wrap_s = ER_REPEAT;
         }else if (value == ER_CLAMP_TO_EDGE){
-            tex->wrap_s = clamp_to_edge;
+            tex->wrap_s = ER_CLAMP_TO_EDGE;
         }else{
             return ER_INVALID_ARGUMENT;
         }
     }else if(parameter == ER_WRAP_T){
         if(value == ER_REPEAT){
-            tex->wrap_t = repeat;
+            tex->wrap_t = ER_REPEAT;
         }else if (value == ER_CLAMP_TO_EDGE){
-            tex->wrap_t = clamp_to_edge;
+            tex->wrap_t = ER_CLAMP_TO_EDGE;
         }else{
             return ER_INVALID_ARGUMENT;
         }
     }else if(parameter == ER_WRAP_R){
         if(value == ER_REPEAT){
-            tex->wrap_r = repeat;
+            tex->wrap_r = ER_REPEAT;
         }else if (value == ER_CLAMP_TO_EDGE){
-            tex->wrap_r = clamp_to_edge;
+            tex->wrap_r = ER_CLAMP_TO_EDGE;
         }else{
             return ER_INVALID_ARGUMENT;
         }
     }else{
         return ER_INVALID_ARGUMENT;
     }
+    update_filter_functions(tex);
     return ER_NO_ERROR;
 }
 
+/*
+ * Box filter of a level of a packed or reordered texture, rows and columns of size 1 aren't halved.
+*/
+static void downsample_texels(er_Texture *tex, void *current, int cur_width, int cur_height, void *previous, int prev_width, int prev_height){
+
+    int i, j, c;
+    vec4 texel00, texel01, texel10, texel11, average;
+    int step_i = (prev_height > 1) ? 1: 0;
+    int step_j = (prev_width > 1) ? 1: 0;
+    for(i = 0; i < cur_height; i++){
+        int ip = i << step_i;
+        for(j = 0; j < cur_width; j++){
+            int jp = j << step_j;
+            load_texel(tex, previous, texel_index(tex->layout, prev_width, prev_height, jp, ip), texel00);
+            load_texel(tex, previous, texel_index(tex->layout, prev_width, prev_height, jp + step_j, ip), texel01);
+            load_texel(tex, previous, texel_index(tex->layout, prev_width, prev_height, jp, ip + step_i), texel10);
+            load_texel(tex, previous, texel_index(tex->layout, prev_width, prev_height, jp + step_j, ip + step_i), texel11);
+            for(c = 0; c < tex->components; c++){
+                if(step_i && step_j){
+                    average[c] = 0.25f * (texel00[c] + texel01[c] + texel10[c] + texel11[c]);
+                }else{
+                    average[c] = 0.5f * (texel00[c] + texel11[c]);
+                }
+            }
+            store_texel(tex, current, texel_index(tex->layout, cur_width, cur_height, j, i), average);
+        }
+    }
+
+}
+
+/*
+ * Box filter of a level of a compressed texture. The previous level is decoded and the result encoded as a whole.
+*/
+static er_Bool downsample_blocks(er_Texture *tex, void *current, int cur_width, int cur_height, void *previous, int prev_width, int prev_height){
+
+    int components = tex->components;
+    float *source = (float*)malloc(prev_width * prev_height * components * sizeof(float));
+    float *result = (float*)malloc(cur_width * cur_height * components * sizeof(float));
+    if(source == NULL || result == NULL){
+        free(source);
+        free(result);
+        return ER_FALSE;
+    }
+    int i, j, c;
+    for(i = 0; i < prev_height; i++){
+        for(j = 0; j < prev_width; j++){
+            load_texel(tex, previous, texel_index(ER_TILED_4X4, prev_width, prev_height, j, i), source + (i * prev_width + j) * components);
+        }
+    }
+    int step_i = (prev_height > 1) ? 1: 0;
+    int step_j = (prev_width > 1) ? 1: 0;
+    for(i = 0; i < cur_height; i++){
+        float *row0 = source + (i << step_i) * prev_width * components;
+        float *row1 = row0 + step_i * prev_width * components;
+        for(j = 0; j < cur_width; j++){
+            int jp0 = (j << step_j) * components, jp1 = jp0 + step_j * components;
+            for(c = 0; c < components; c++){
+                if(step_i && step_j){
+                    result[(i * cur_width + j) * components + c] = 0.25f * (row0[jp0 + c] + row0[jp1 + c] + row1[jp0 + c] + row1[jp1 + c]);
+                }else{
+                    result[(i * cur_width + j) * components + c] = 0.5f * (row0[jp0 + c] + row1[jp1 + c]);
+                }
+            }
+        }
+    }
+    encode_texels(tex, current, cur_width, cur_height, result);
+    free(source);
+    free(result);
+    return ER_TRUE;
+
+}
+
 /*
  * Generate mipmap stack for a texture 1D.
  * Used box filtering.
@@ -2228,7 +2304,7 @@ static er_StatusEnum generate_mipmaps_texture1D(er_Texture *tex){
             if(tex->mipmaps[l] == NULL){
                 return ER_OUT_OF_MEMORY;
             }
-            tex->mipmaps[l]->texels = (float*)malloc(cur_width * compsize * sizeof(float));
+            tex->mipmaps[l]->texels = malloc(cur_width * tex->texel_size);
             if(tex->mipmaps[l]->texels == NULL){
                 free(tex->mipmaps[l]);
                 tex->mipmaps[l] = NULL;
@@ -2236,13 +2312,17 @@ static er_StatusEnum generate_mipmaps_texture1D(er_Texture *tex){
             }
             tex->mipmaps[l]->width = cur_width;
         }
-        float *current = tex->mipmaps[l]->texels;
-        float *previous = tex->mipmaps[l-1]->texels;
-        int i, ip, c;
-        for(i = 0; i < cur_width; i++){
-            ip = i << 1;
-            for(c = 0; c < compsize; c++){
-                current[i*compsize + c] = 0.5f * (previous[ip*compsize + c] + previous[(ip+1)*compsize + c]);
+        if(packed_format(tex)){
+            downsample_texels(tex, tex->mipmaps[l]->texels, cur_width, 1, tex->mipmaps[l-1]->texels, cur_width << 1, 1);
+        }else{
+            float *current = tex->mipmaps[l]->texels;
+            float *previous = tex->mipmaps[l-1]->texels;
+            int i, ip, c;
+            for(i = 0; i < cur_width; i++){
+                ip = i << 1;
+                for(c = 0; c < compsize; c++){
+                    current[i*compsize + c] = 0.5f * (previous[ip*compsize + c] + previous[(ip+1)*compsize + c]);
+                }
             }
         }
         cur_width = cur_width >> 1;
@@ -2275,7 +2355,7 @@ static er_StatusEnum generate_mipmaps_texture2D(er_Texture *tex){
             if(tex->mipmaps[l] == NULL){
                 return ER_OUT_OF_MEMORY;
             }
-            tex->mipmaps[l]->texels = (float*)malloc(cur_width * cur_height * compsize * sizeof(float));
+            tex->mipmaps[l]->texels = malloc(level_size(tex, tex->layout, cur_width, cur_height));
             if(tex->mipmaps[l]->texels == NULL){
                 free(tex->mipmaps[l]);
                 tex->mipmaps[l] = NULL;
@@ -2287,7 +2367,13 @@ static er_StatusEnum generate_mipmaps_texture2D(er_Texture *tex){
         float *current = tex->mipmaps[l]->texels;
         float *previous = tex->mipmaps[l-1]->texels;
         int i, j, ip, jp, c;
-        if(prev_width > 1 && prev_height > 1 ){
+        if(tex->block_size > 0){
+            if(downsample_blocks(tex, current, cur_width, cur_height, previous, prev_width, prev_height) == ER_FALSE){
+                return ER_OUT_OF_MEMORY;
+            }
+        }else if(packed_format(tex) || tex->layout != ER_ROW_MAJOR){
+            downsample_texels(tex, current, cur_width, cur_height, previous, prev_width, prev_height);
+        }else if(prev_width > 1 && prev_height > 1 ){
             for(i = 0; i < cur_height; i++){
                 ip = i << 1;
                 for(j = 0; j < cur_width; j++){
@@ -2342,7 +2428,7 @@ static er_StatusEnum generate_mipmaps_texture_cubemap(er_Texture *tex){
             if(tex->mipmaps[l] == NULL){
                 return ER_OUT_OF_MEMORY;
             }
-            tex->mipmaps[l]->texels = (float*)malloc( 6 * cur_dim * cur_dim * compsize * sizeof(float));
+            tex->mipmaps[l]->texels = malloc(6 * level_size(tex, tex->layout, cur_dim, cur_dim));
             if(tex->mipmaps[l]->texels == NULL){
                 free(tex->mipmaps[l]);
                 tex->mipmaps[l] = NULL;
@@ -2353,14 +2439,22 @@ static er_StatusEnum generate_mipmaps_texture_cubemap(er_Texture *tex){
         }
         int cf, i, j, ip, jp, c;
         for(cf = 0; cf < 6; cf++){
-            float *current = (tex->mipmaps[l]->texels + cf * tex->mipmaps[l]->width * tex->mipmaps[l]->width * compsize);
-            float *previous = (tex->mipmaps[l-1]->texels + cf * tex->mipmaps[l-1]->width * tex->mipmaps[l-1]->width * compsize);
-            for(i = 0; i < cur_dim; i++){
-                ip = i << 1;
-                for(j = 0; j < cur_dim; j++){
-                    jp = j << 1;
-                    for(c = 0; c < compsize; c++){
-                        current[i*cur_dim*compsize + j*compsize + c] = 0.25f * (previous[ip*prev_dim*compsize + jp*compsize + c] + previous[ip*prev_dim*compsize + (jp+1)*compsize + c] + previous[(ip+1)*prev_dim*compsize + jp*compsize + c] + previous[(ip+1)*prev_dim*compsize + (jp+1)*compsize + c]);
+            float *current = face_texels(tex, tex->mipmaps[l], cf);
+            float *previous = face_texels(tex, tex->mipmaps[l-1], cf);
+            if(tex->block_size > 0){
+                if(downsample_blocks(tex, current, cur_dim, cur_dim, previous, prev_dim, prev_dim) == ER_FALSE){
+                    return ER_OUT_OF_MEMORY;
+                }
+            }else if(packed_format(tex) || tex->layout != ER_ROW_MAJOR){
+                downsample_texels(tex, current, cur_dim, cur_dim, previous, prev_dim, prev_dim);
+            }else{
+                for(i = 0; i < cur_dim; i++){
+                    ip = i << 1;
+                    for(j = 0; j < cur_dim; j++){
+                        jp = j << 1;
+                        for(c = 0; c < compsize; c++){
+                            current[i*cur_dim*compsize + j*compsize + c] = 0.25f * (previous[ip*prev_dim*compsize + jp*compsize + c] + previous[ip*prev_dim*compsize + (jp+1)*compsize + c] + previous[(ip+1)*prev_dim*compsize + jp*compsize + c] + previous[(ip+1)*prev_dim*compsize + (jp+1)*compsize + c]);
+                        }
                     }
                 }
             }
@@ -0,0 +1,437 @@
+#include "pipeline.h"
+
+/*
+ * Sort-middle backend: primitives that reach the rasterizer are copied and binned into the
+ * TILE_SIZE x TILE_SIZE screen tiles overlapped by their bounding box, and the tiles are
+ * rasterized by a pool of threads when the draw call finishes. A tile is drawn by only one
+ * thread, and its primitives are drawn in submission order. Triangles and polygons are set up
+ * once when they are binned, every tile only walks its own pixels.
+*/
+
+static int tile_columns(er_Context *ctx){
+
+    return (ctx->window_width + TILE_SIZE - 1) / TILE_SIZE;
+
+}
+
+static void draw_tile(er_Context *ctx, unsigned int index){
+
+    Tile *tile = &ctx->tiles[index];
+    int min_x = (index % tile_columns(ctx)) * TILE_SIZE;
+    int max_x = min(min_x + TILE_SIZE - 1, (int)ctx->window_width - 1);
+    int min_y = (index / tile_columns(ctx)) * TILE_SIZE;
+    int max_y = min(min_y + TILE_SIZE - 1, (int)ctx->window_height - 1);
+    TiledPrimitive *p;
+    er_VertexOutput *vertices[MAX_POLYGON_SIZE];
+    unsigned int i, k;
+
+    for(i = 0; i < tile->size; i++){
+        p = &ctx->primitives[ tile->primitives[i] ];
+        if(p->primitive == ER_TRIANGLES && p->polygon_size > 0){
+            for(k = 0; k < p->polygon_size; k++){
+                vertices[k] = &ctx->polygon_vertices[p->polygon_first + k];
+            }
+            draw_polygon(ctx, vertices, p->polygon_size, &p->setup, min_x, max_x, min_y, max_y);
+        }else if(p->primitive == ER_TRIANGLES){
+            draw_triangle(ctx, &p->vertex[0], &p->vertex[1], &p->vertex[2], &p->setup, min_x, max_x, min_y, max_y);
+        }else if(p->primitive == ER_LINES){
+            draw_line(ctx, &p->vertex[0], &p->vertex[1], p->face, min_x, max_x, min_y, max_y);
+        }else if(p->point_sprite == ER_TRUE){
+            draw_point_sprite(ctx, &p->vertex[0], p->face, min_x, max_x, min_y, max_y);
+        }else{
+            draw_point(ctx, &p->vertex[0], p->face, min_x, max_x, min_y, max_y);
+        }
+    }
+
+}
+
+static void draw_tiles(er_Context *ctx){
+
+    unsigned int index;
+    while(1){
+        pthread_mutex_lock(&ctx->tiling_mutex);
+        index = ctx->next_tile++;
+        pthread_mutex_unlock(&ctx->tiling_mutex);
+        if(index >= ctx->tiles_number){
+            break;
+        }
+        draw_tile(ctx, index);
+    }
+
+}
+
+static void* worker_main(void *arg){
+
+    er_Context *ctx = (er_Context*)arg;
+    unsigned int generation = ctx->spawn_generation;
+    current_context = ctx;
+
+    pthread_mutex_lock(&ctx->tiling_mutex);
+    while(1){
+        while(ctx->job_generation == generation && ctx->quit_workers == ER_FALSE){
+            pthread_cond_wait(&ctx->job_cond, &ctx->tiling_mutex);
+        }
+        if(ctx->quit_workers == ER_TRUE){
+            break;
+        }
+        generation = ctx->job_generation;
+        pthread_mutex_unlock(&ctx->tiling_mutex);
+        draw_tiles(ctx);
+        pthread_mutex_lock(&ctx->tiling_mutex);
+        ctx->active_workers--;
+        if(ctx->active_workers == 0){
+            pthread_cond_signal(&ctx->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&ctx->tiling_mutex);
+    return NULL;
+
+}
+
+static void stop_workers(er_Context *ctx){
+
+    unsigned int i;
+    pthread_mutex_lock(&ctx->tiling_mutex);
+    ctx->quit_workers = ER_TRUE;
+    pthread_cond_broadcast(&ctx->job_cond);
+    pthread_mutex_unlock(&ctx->tiling_mutex);
+    for(i = 0; i < ctx->workers_size; i++){
+        pthread_join(ctx->workers[i], NULL);
+    }
+    ctx->workers_size = 0;
+
+}
+
+/*
+ * The calling thread also draws tiles, so the pool has thread_count - 1 workers.
+*/
+static void update_workers(er_Context *ctx){
+
+    if(ctx->workers_size == ctx->thread_count - 1){
+        return;
+    }
+    stop_workers(ctx);
+    ctx->quit_workers = ER_FALSE;
+    ctx->spawn_generation = ctx->job_generation;
+    while(ctx->workers_size < ctx->thread_count - 1){
+        if(pthread_create(&ctx->workers[ctx->workers_size], NULL, worker_main, ctx) != 0){
+            break;
+        }
+        ctx->workers_size++;
+    }
+
+}
+
+static er_Bool reserve(void **buffer, unsigned int *capacity, unsigned int size, size_t element_size){
+
+    if(size < *capacity){
+        return ER_TRUE;
+    }
+    unsigned int new_capacity = (*capacity == 0) ? 64 : 2 * (*capacity);
+    void *new_buffer = realloc(*buffer, new_capacity * element_size);
+    if(new_buffer == NULL){
+        return ER_FALSE;
+    }
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+    return ER_TRUE;
+
+}
+
+static er_Bool reserve_tiles(er_Context *ctx, unsigned int number){
+
+    if(number <= ctx->tiles_capacity){
+        return ER_TRUE;
+    }
+    Tile *new_tiles = (Tile*)realloc(ctx->tiles, number * sizeof(Tile));
+    if(new_tiles == NULL){
+        return ER_FALSE;
+    }
+    ctx->tiles = new_tiles;
+    for(; ctx->tiles_capacity < number; ctx->tiles_capacity++){
+        ctx->tiles[ctx->tiles_capacity].primitives = NULL;
+        ctx->tiles[ctx->tiles_capacity].size = 0;
+        ctx->tiles[ctx->tiles_capacity].capacity = 0;
+    }
+    return ER_TRUE;
+
+}
+
+/*
+ * Allocate a primitive whose bounding box is [min_x, max_x] x [min_y, max_y] and add it to the tiles it overlaps.
+ * Returns NULL if the primitive doesn't touch the viewport, or if memory is exhausted even
+ * after flushing, in which case it must be drawn right away.
+*/
+static TiledPrimitive* bin_primitive(er_Context *ctx, int min_x, int max_x, int min_y, int max_y, er_Bool *draw_now){
+
+    int columns = tile_columns(ctx);
+    int first_column, last_column, first_row, last_row, row, column, t, last_tile;
+    *draw_now = ER_FALSE;
+    min_x = max(min_x, 0);
+    max_x = min(max_x, (int)ctx->window_width - 1);
+    min_y = max(min_y, 0);
+    max_y = min(max_y, (int)ctx->window_height - 1);
+    if(min_x > max_x || min_y > max_y){
+        return NULL;
+    }
+    first_column = min_x / TILE_SIZE;
+    last_column = max_x / TILE_SIZE;
+    first_row = min_y / TILE_SIZE;
+    last_row = max_y / TILE_SIZE;
+    last_tile = last_row * columns + last_column;
+
+    if(reserve_tiles(ctx, last_tile + 1) == ER_FALSE || reserve((void**)&ctx->primitives, &ctx->primitives_capacity, ctx->primitives_size, sizeof(TiledPrimitive)) == ER_FALSE){
+        flush_tiles(ctx);
+        *draw_now = ER_TRUE;
+        return NULL;
+    }
+    for(row = first_row; row <= last_row; row++){
+        for(column = first_column; column <= last_column; column++){
+            t = row * columns + column;
+            if(reserve((void**)&ctx->tiles[t].primitives, &ctx->tiles[t].capacity, ctx->tiles[t].size, sizeof(unsigned int)) == ER_FALSE){
+                /* Drop the references already added, and draw everything binned until now */
+                for(; row >= first_row; row--, column = last_column + 1){
+                    for(column--; column >= first_column; column--){
+                        ctx->tiles[row * columns + column].size--;
+                    }
+                }
+                flush_tiles(ctx);
+                *draw_now = ER_TRUE;
+                return NULL;
+            }
+            ctx->tiles[t].primitives[ ctx->tiles[t].size++ ] = ctx->primitives_size;
+        }
+    }
+    if((unsigned int)last_tile >= ctx->tiles_number){
+        ctx->tiles_number = last_tile + 1;
+    }
+    return &ctx->primitives[ctx->primitives_size++];
+
+}
+
+void submit_point(er_Context *ctx, er_VertexOutput *vertex, er_PolygonFaceEnum face){
+
+    if(ctx->tiling_enable == ER_TRUE){
+        float half_size = 0.5f * vertex->point_size;
+        int min_x = (int)ceil( vertex->position[VAR_X] - half_size );
+        int max_x = (int)ceil( vertex->position[VAR_X] + half_size ) - 1;
+        int min_y = (int)ceil( vertex->position[VAR_Y] - half_size );
+        int max_y = (int)ceil( vertex->position[VAR_Y] + half_size ) - 1;
+        er_Bool draw_now;
+        TiledPrimitive *p = bin_primitive(ctx, min_x, max_x, min_y, max_y, &draw_now);
+        if(p != NULL){
+            p->primitive = ER_POINTS;
+            p->face = face;
+            p->polygon_size = 0;
+            p->point_sprite = ctx->point_sprite_enable;
+            p->vertex[0] = *vertex;
+            return;
+        }
+        if(draw_now == ER_FALSE){
+            return;
+        }
+    }
+    if(ctx->point_sprite_enable == ER_TRUE){
+        draw_point_sprite(ctx, vertex, face, 0, ctx->window_width - 1, 0, ctx->window_height - 1);
+    }else{
+        draw_point(ctx, vertex, face, 0, ctx->window_width - 1, 0, ctx->window_height - 1);
+    }
+
+}
+
+void submit_line(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_PolygonFaceEnum face){
+
+    if(ctx->tiling_enable == ER_TRUE){
+        int x0 = uiround(vertex0->position[VAR_X]);
+        int x1 = uiround(vertex1->position[VAR_X]);
+        int y0 = uiround(vertex0->position[VAR_Y]);
+        int y1 = uiround(vertex1->position[VAR_Y]);
+        er_Bool draw_now;
+        TiledPrimitive *p = bin_primitive(ctx, min(x0, x1), max(x0, x1), min(y0, y1), max(y0, y1), &draw_now);
+        if(p != NULL){
+            p->primitive = ER_LINES;
+            p->face = face;
+            p->polygon_size = 0;
+            p->vertex[0] = *vertex0;
+            p->vertex[1] = *vertex1;
+            return;
+        }
+        if(draw_now == ER_FALSE){
+            return;
+        }
+    }
+    draw_line(ctx, vertex0, vertex1, face, 0, ctx->window_width - 1, 0, ctx->window_height - 1);
+
+}
+
+/*
+ * Triangles and polygons are binned by their bounding box with one pixel of margin, so the tiles
+ * cover the pixels of the snapped vertices of the fixed point and half-space rasterizers.
+*/
+void submit_triangle(er_Context *ctx, er_VertexOutput *vertex0, er_VertexOutput *vertex1, er_VertexOutput *vertex2, er_PolygonFaceEnum face){
+
+    er_VertexOutput *vertices[3] = {vertex0, vertex1, vertex2};
+    er_FragInput setup;
+    if(ctx->tiling_enable == ER_TRUE){
+        float left = min( vertex0->position[VAR_X], min(vertex1->position[VAR_X], vertex2->position[VAR_X]) );
+        float right = max( vertex0->position[VAR_X], max(vertex1->position[VAR_X], vertex2->position[VAR_X]) );
+        float bottom = min( vertex0->position[VAR_Y], min(vertex1->position[VAR_Y], vertex2->position[VAR_Y]) );
+        float top = max( vertex0->position[VAR_Y], max(vertex1->position[VAR_Y], vertex2->position[VAR_Y]) );
+        er_Bool draw_now;
+        TiledPrimitive *p = bin_primitive(ctx, (int)floor(left), (int)ceil(right), (int)floor(bottom), (int)ceil(top), &draw_now);
+        if(p != NULL){
+            p->primitive = ER_TRIANGLES;
+            p->face = face;
+            p->polygon_size = 0;
+            p->vertex[0] = *vertex0;
+            p->vertex[1] = *vertex1;
+            p->vertex[2] = *vertex2;
+            setup_polygon(ctx, vertices, 3, face, &p->setup);
+            return;
+        }
+        if(draw_now == ER_FALSE){
+            return;
+        }
+    }
+    setup_polygon(ctx, vertices, 3, face, &setup);
+    draw_triangle(ctx, vertex0, vertex1, vertex2, &setup, 0, ctx->window_width - 1, 0, ctx->window_height - 1);
+
+}
+
+void submit_polygon(er_Context *ctx, er_VertexOutput **vertices, unsigned int size, er_PolygonFaceEnum face){
+
+    unsigned int i;
+    er_FragInput setup;
+    if(ctx->tiling_enable == ER_TRUE){
+        float left = vertices[0]->position[VAR_X];
+        float right = vertices[0]->position[VAR_X];
+        float bottom = vertices[0]->position[VAR_Y];
+        float top = vertices[0]->position[VAR_Y];
+        for(i = 1; i < size; i++){
+            left = min(left, vertices[i]->position[VAR_X]);
+            right = max(right, vertices[i]->position[VAR_X]);
+            bottom = min(bottom, vertices[i]->position[VAR_Y]);
+            top = max(top, vertices[i]->position[VAR_Y]);
+        }
+        er_Bool draw_now = ER_FALSE;
+        TiledPrimitive *p = NULL;
+        if(reserve((void**)&ctx->polygon_vertices, &ctx->polygon_vertices_capacity, ctx->polygon_vertices_size + size - 1, sizeof(er_VertexOutput)) == ER_FALSE){
+            flush_tiles(ctx);
+            draw_now = ER_TRUE;
+        }else{
+            p = bin_primitive(ctx, (int)floor(left), (int)ceil(right), (int)floor(bottom), (int)ceil(top), &draw_now);
+        }
+        if(p != NULL){
+            p->primitive = ER_TRIANGLES;
+            p->face = face;
+            p->polygon_first = ctx->polygon_vertices_size;
+            p->polygon_size = size;
+            for(i = 0; i < size; i++){
+                ctx->polygon_vertices[ctx->polygon_vertices_size++] = *vertices[i];
+            }
+            setup_polygon(ctx, vertices, size, face, &p->setup);
+            return;
+        }
+        if(draw_now == ER_FALSE){
+            return;
+        }
+    }
+    setup_polygon(ctx, vertices, size, face, &setup);
+    draw_polygon(ctx, vertices, size, &setup, 0, ctx->window_width - 1, 0, ctx->window_height - 1);
+
+}
+
+/*
+ * Rasterize all binned primitives. Called at the end of every draw call, so the pipeline
+ * state seen by the shaders is the same one used to process the geometry.
+*/
+void flush_tiles(er_Context *ctx){
+
+    unsigned int i;
+    if(ctx->primitives_size == 0){
+        return;
+    }
+
+    ctx->next_tile = 0;
+    if(ctx->thread_count > 1){
+        update_workers(ctx);
+    }
+    if(ctx->thread_count > 1 && ctx->workers_size > 0){
+        pthread_mutex_lock(&ctx->tiling_mutex);
+        ctx->active_workers = ctx->workers_size;
+        ctx->job_generation++;
+        pthread_cond_broadcast(&ctx->job_cond);
+        pthread_mutex_unlock(&ctx->tiling_mutex);
+        draw_tiles(ctx);
+        pthread_mutex_lock(&ctx->tiling_mutex);
+        while(ctx->active_workers > 0){
+            pthread_cond_wait(&ctx->done_cond, &ctx->tiling_mutex);
+        }
+        pthread_mutex_unlock(&ctx->tiling_mutex);
+    }else{
+        draw_tiles(ctx);
+    }
+
+    for(i = 0; i < ctx->tiles_number; i++){
+        ctx->tiles[i].size = 0;
+    }
+    ctx->tiles_number = 0;
+    ctx->primitives_size = 0;
+    ctx->polygon_vertices_size = 0;
+
+}
+
+void init_tiling(er_Context *ctx){
+
+    ctx->tiling_enable = ER_FALSE;
+    ctx->thread_count = 1;
+    ctx->primitives = NULL;
+    ctx->primitives_size = 0;
+    ctx->primitives_capacity = 0;
+    ctx->polygon_vertices = NULL;
+    ctx->polygon_vertices_size = 0;
+    ctx->polygon_vertices_capacity = 0;
+    ctx->tiles = NULL;
+    ctx->tiles_capacity = 0;
+    ctx->tiles_number = 0;
+    ctx->workers_size = 0;
+    ctx->job_generation = 0;
+    ctx->quit_workers = ER_FALSE;
+    pthread_mutex_init(&ctx->tiling_mutex, NULL);
+    pthread_cond_init(&ctx->job_cond, NULL);
+    pthread_cond_init(&ctx->done_cond, NULL);
+
+}
+
+void quit_tiling(er_Context *ctx){
+
+    unsigned int i;
+    stop_workers(ctx);
+    if(ctx->primitives != NULL){
+        free(ctx->primitives);
+        ctx->primitives = NULL;
+    }
+    ctx->primitives_size = 0;
+    ctx->primitives_capacity = 0;
+    if(ctx->polygon_vertices != NULL){
+        free(ctx->polygon_vertices);
+        ctx->polygon_vertices = NULL;
+    }
+    ctx->polygon_vertices_size = 0;
+    ctx->polygon_vertices_capacity = 0;
+    for(i = 0; i < ctx->tiles_capacity; i++){
+        if(ctx->tiles[i].primitives != NULL){
+            free(ctx->tiles[i].primitives);
+        }
+    }
+    if(ctx->tiles != NULL){
+        free(ctx->tiles);
+        ctx->tiles = NULL;
+    }
+    ctx->tiles_capacity = 0;
+    ctx->tiles_number = 0;
+    pthread_mutex_destroy(&ctx->tiling_mutex);
+    pthread_cond_destroy(&ctx->job_cond);
+    pthread_cond_destroy(&ctx->done_cond);
+
+}
@@ -1,7 +1,5 @@
 #include "pipeline.h"
 
-er_VertexArray *current_vertex_array;
-
 er_VertexArray* er_create_vertex_array(){
 
     er_VertexArray *new_vertex_array = (struct er_VertexArray*)malloc(sizeof(struct er_VertexArray));
@@ -16,6 +14,8 @@ er_VertexArray* er_create_vertex_array(){
         new_vertex_array->tex_coord.pointer = NULL;
         new_vertex_array->fog_coord.enabled = ER_FALSE;
         new_vertex_array->fog_coord.pointer = NULL;
+        new_vertex_array->instance.enabled = ER_FALSE;
+        new_vertex_array->instance.pointer = NULL;
     }
     return new_vertex_array;
 
@@ -32,10 +32,12 @@ er_StatusEnum er_delete_vertex_array(er_VertexArray *va){
 
 er_StatusEnum er_use_vertex_array(er_VertexArray *va){
 
+    er_Context *ctx = current_context;
+
     if(va == NULL){
         return ER_NULL_POINTER;
     }
-    current_vertex_array = va;
+    ctx->current_vertex_array = va;
     return ER_NO_ERROR;
 }
 
@@ -54,6 +56,8 @@ er_StatusEnum er_enable_attribute_array(er_VertexArray *va, er_VertexArrayEnum a
         va->fog_coord.enabled = enable;
     }else if(array_enum == ER_TEX_COORD_ARRAY){
         va->tex_coord.enabled = enable;
+    }else if(array_enum == ER_INSTANCE_ARRAY){
+        va->instance.enabled = enable;
     }else{
         return ER_INVALID_ARGUMENT;
     }
@@ -137,7 +141,23 @@ er_StatusEnum er_tex_coord_pointer(er_VertexArray *va, unsigned int stride, unsi
     return ER_NO_ERROR;
 }
 
-void vertex_assembly(er_VertexArray *vertex_array, er_VertexInput *vertex, unsigned int vertex_index){
+/*
+ * Per instance attributes, the vertex shader of instance i reads the row starting at pointer + i * stride.
+*/
+er_StatusEnum er_instance_pointer(er_VertexArray *va, unsigned int stride, float *pointer){
+
+    if(va == NULL){
+        return ER_NULL_POINTER;
+    }
+    if(pointer == NULL){
+        return ER_NULL_POINTER;
+    }
+    va->instance.pointer = pointer;
+    va->instance.stride = stride;
+    return ER_NO_ERROR;
+}
+
+void vertex_assembly(er_Context *ctx, er_VertexArray *vertex_array, er_VertexInput *vertex, unsigned int vertex_index){
 
     float *vertex_data;
     float *normal_data;
@@ -172,9 +192,9 @@ void vertex_assembly(er_VertexArray *vertex_array, er_VertexInput *vertex, unsig
         vertex->normal[VAR_Y] = normal_data[VAR_Y];
         vertex->normal[VAR_Z] = normal_data[VAR_Z];
     }else{
-        vertex->normal[VAR_X] = current_normal[VAR_X];
-        vertex->normal[VAR_Y] = current_normal[VAR_Y];
-        vertex->normal[VAR_Z] = current_normal[VAR_Z];
+        vertex->normal[VAR_X] = ctx->current_normal[VAR_X];
+        vertex->normal[VAR_Y] = ctx->current_normal[VAR_Y];
+        vertex->normal[VAR_Z] = ctx->current_normal[VAR_Z];
     }
     /* Color data */
     if(vertex_array->color.enabled == ER_TRUE){
@@ -191,17 +211,17 @@ void vertex_assembly(er_VertexArray *vertex_array, er_VertexInput *vertex, unsig
         vertex->color[VAR_A] = color_data[VAR_A];
         }
     }else{
-        vertex->color[VAR_R] = current_color[VAR_R];
-        vertex->color[VAR_G] = current_color[VAR_G];
-        vertex->color[VAR_B] = current_color[VAR_B];
-        vertex->color[VAR_A] = current_color[VAR_A];
+        vertex->color[VAR_R] = ctx->current_color[VAR_R];
+        vertex->color[VAR_G] = ctx->current_color[VAR_G];
+        vertex->color[VAR_B] = ctx->current_color[VAR_B];
+        vertex->color[VAR_A] = ctx->current_color[VAR_A];
     }
     /* Fog data */
     if(vertex_array->fog_coord.enabled == ER_TRUE){
         fog_coord_data = (vertex_array->fog_coord.pointer + vertex_index * vertex_array->fog_coord.stride);
         vertex->fog_coord = *fog_coord_data;
     }else{
-        vertex->fog_coord = current_fog_coord;
+        vertex->fog_coord = ctx->current_fog_coord;
     }
     /* Texture coord data */
     if(vertex_array->tex_coord.enabled == ER_TRUE){
@@ -228,10 +248,10 @@ void vertex_assembly(er_VertexArray *vertex_array, er_VertexInput *vertex, unsig
             vertex->tex_coord[VAR_Q] = tex_coord_data[VAR_Q];
         }
     }else{
-        vertex->tex_coord[VAR_S] = current_tex_coord[VAR_S];
-        vertex->tex_coord[VAR_T] = current_tex_coord[VAR_T];
-        vertex->tex_coord[VAR_P] = current_tex_coord[VAR_P];
-        vertex->tex_coord[VAR_Q] = current_tex_coord[VAR_Q];
+        vertex->tex_coord[VAR_S] = ctx->current_tex_coord[VAR_S];
+        vertex->tex_coord[VAR_T] = ctx->current_tex_coord[VAR_T];
+        vertex->tex_coord[VAR_P] = ctx->current_tex_coord[VAR_P];
+        vertex->tex_coord[VAR_Q] = ctx->current_tex_coord[VAR_Q];
     }
 
 }